@@ -0,0 +1,579 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <ctype.h>
+
+#include "endian.h"
+#include "scsi.h"
+#include "ata.h"
+#include "smart.h"
+
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <sstream>
+
+/* SAT CDB variants in the order they are probed */
+const uint8_t sat_variants[] = {
+  SAT_VARIANT_DEFAULT,
+  SAT_VARIANT_12,
+  SAT_VARIANT_CK_COND,
+  SAT_VARIANT_12 | SAT_VARIANT_CK_COND,
+  SAT_VARIANT_T_TYPE,
+  SAT_VARIANT_12 | SAT_VARIANT_T_TYPE,
+};
+
+const int sat_variant_num = sizeof(sat_variants) / sizeof(uint8_t);
+
+/* SAT CDB variant of each descriptor, only those not using the default */
+static map<int, uint8_t> sat_variant;
+static mutex sat_variant_lock;
+
+/*
+ * Function: ata_set_sat_variant
+ * -----------------------------
+ * Selects the form of ATA PASS-THROUGH CDB used for ATA commands sent to a
+ * device.  Devices behind different bridges may be checked at once, from
+ * any thread, each keeps its own.
+ * fd: Descriptor the device is open on
+ * variant: Combination of SAT_VARIANT_* flags
+ */
+void ata_set_sat_variant(int fd, uint8_t variant) {
+
+  lock_guard<mutex> guard(sat_variant_lock);
+
+  if(variant == SAT_VARIANT_DEFAULT)
+    sat_variant.erase(fd);
+  else
+    sat_variant[fd] = variant;
+
+}
+
+/*
+ * Function: ata_get_sat_variant
+ * -----------------------------
+ * Returns the form of ATA PASS-THROUGH CDB used for ATA commands sent to a
+ * device
+ * fd: Descriptor the device is open on
+ */
+uint8_t ata_get_sat_variant(int fd) {
+
+  lock_guard<mutex> guard(sat_variant_lock);
+
+  map<int, uint8_t>::const_iterator i = sat_variant.find(fd);
+
+  return i == sat_variant.end() ? SAT_VARIANT_DEFAULT : i->second;
+
+}
+
+/*
+ * Function: ata_send
+ * ------------------
+ * Sends an ATA PASS-THROUGH(16) CDB in the selected variant.  The 12-byte
+ * form cannot carry 48-bit registers, so extended commands are always sent
+ * in the 16-byte form.
+ */
+static SgioResult ata_send(int fd, sbc_ata_pass_through& ata_pass_through, unsigned char* buf, int len,
+                           int direction = SG_DXFER_FROM_DEV) {
+
+  uint8_t variant = ata_get_sat_variant(fd);
+
+  if(variant & SAT_VARIANT_CK_COND)
+    ata_pass_through.ck_cond = 1;
+
+  if((variant & SAT_VARIANT_T_TYPE) && ata_pass_through.t_length != ATA_TRANSFER_LENGTH_NONE)
+    ata_pass_through.t_type = ATA_TRANSFER_TYPE_LOGICAL_SECTOR;
+
+  if(!(variant & SAT_VARIANT_12) || ata_pass_through.extend)
+    return sgio(fd, reinterpret_cast<unsigned char*>(&ata_pass_through), sizeof(ata_pass_through), buf, len, direction);
+
+  sbc_ata_pass_through_12 ata_pass_through_12;
+  memset(reinterpret_cast<unsigned char*>(&ata_pass_through_12), 0, sizeof(sbc_ata_pass_through_12));
+
+  // Byte 1 lacks the extend bit, byte 2 is common to both forms
+  ata_pass_through_12.operation_code = SBC_ATA_PASS_THROUGH_12;
+  ata_pass_through_12.protocol       = ata_pass_through.protocol << 1 | ata_pass_through.multiple_count << 5;
+  memcpy(&ata_pass_through_12.flags, reinterpret_cast<unsigned char*>(&ata_pass_through) + 2, 1);
+  ata_pass_through_12.features       = ata_pass_through.features_7_0;
+  ata_pass_through_12.count          = ata_pass_through.count_7_0;
+  ata_pass_through_12.lba_low        = ata_pass_through.lba_7_0;
+  ata_pass_through_12.lba_mid        = ata_pass_through.lba_15_8;
+  ata_pass_through_12.lba_high       = ata_pass_through.lba_23_16;
+  ata_pass_through_12.device         = ata_pass_through.device;
+  ata_pass_through_12.command        = ata_pass_through.command;
+  ata_pass_through_12.control        = ata_pass_through.control;
+
+  return sgio(fd, reinterpret_cast<unsigned char*>(&ata_pass_through_12), sizeof(ata_pass_through_12), buf, len, direction);
+
+}
+
+/*
+ * Function: ata_checksum
+ * ----------------------
+ * Returns the 8-bit sum of a data structure sector, which for a valid
+ * SMART page including its trailing checksum byte is zero
+ *
+ * buf: Sector to sum, must be at least SECTOR bytes
+ */
+uint8_t ata_checksum(const unsigned char* buf) {
+
+  const uint64_t mask = 0x00ff00ff00ff00ffULL;
+  uint64_t even = 0;
+  uint64_t odd = 0;
+
+  // Sum eight bytes per iteration into 16-bit lanes, each lane sees at most
+  // 64 bytes per sector so none can overflow
+  for(size_t i=0; i<SECTOR_SIZE; i+=sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, buf + i, sizeof(uint64_t));
+    even += word & mask;
+    odd += (word >> 8) & mask;
+  }
+
+  // Fold the lanes together, byte order is irrelevant to the sum
+  uint64_t sum = even + odd;
+  sum += sum >> 32;
+  sum += sum >> 16;
+
+  return sum;
+
+}
+
+/*
+ * Function: ata_identify
+ * ----------------------
+ * Send an IDENTIFY command to the ATA device and recieve the data
+ *
+ * fd: File descriptor pointing at a SCSI or SCSI generic device node
+ * buf: Data buffer to receive the data into, must be at least SECTOR
+ */
+SgioResult ata_identify(int fd, unsigned char* buf) {
+
+  sbc_ata_pass_through ata_pass_through;
+  memset(reinterpret_cast<unsigned char*>(&ata_pass_through), 0, sizeof(sbc_ata_pass_through));
+
+  ata_pass_through.operation_code = SBC_ATA_PASS_THROUGH;
+  ata_pass_through.protocol       = ATA_PROTOCOL_PIO_DATA_IN;
+  ata_pass_through.t_dir          = ATA_TRANSFER_DIRECTION_FROM_DEVICE;
+  ata_pass_through.byte_block     = ATA_TRANSFER_SIZE_BLOCK;
+  ata_pass_through.t_type         = ATA_TRANSFER_TYPE_SECTOR;
+  ata_pass_through.t_length       = ATA_TRANSFER_LENGTH_COUNT;
+  ata_pass_through.count_7_0      = 1;
+  ata_pass_through.command        = ATA_IDENTIFY_DEVICE;
+
+  return ata_send(fd, ata_pass_through, buf, SECTOR_SIZE);
+
+}
+
+/*
+ * Function: ata_identify_valid
+ * ----------------------------
+ * Sanity checks IDENTIFY DEVICE data, rejecting an empty buffer or one
+ * carrying an integrity word whose checksum doesn't match
+ * identify: IDENTIFY DEVICE data as read from the device
+ */
+bool ata_identify_valid(const uint16_t* identify) {
+
+  const unsigned char* buf = reinterpret_cast<const unsigned char*>(identify);
+
+  // Word 255 holds the checksum in its high byte when the low byte is 0xa5
+  if((StorageEndian::swap(identify[255]) & 0xff) == 0xa5)
+    return !ata_checksum(buf);
+
+  for(size_t i=0; i<SECTOR_SIZE; i++)
+    if(buf[i])
+      return true;
+
+  return false;
+
+}
+
+/*
+ * Function: ata_identify_string
+ * -----------------------------
+ * Returns an ASCII string field from IDENTIFY DEVICE data with padding
+ * removed.  Each word holds two characters, the first in its high byte.
+ * identify: IDENTIFY DEVICE data as read from the device
+ * word: First word of the field
+ * words: Length of the field in words
+ */
+string ata_identify_string(const uint16_t* identify, int word, int words) {
+
+  string field;
+  for(int i = word; i < word + words; i++) {
+    uint16_t value = StorageEndian::swap(identify[i]);
+    field += static_cast<char>(value >> 8);
+    field += static_cast<char>(value & 0xff);
+  }
+
+  // Fields are space padded, but some devices pad with NUL
+  const string padding(" \0", 2);
+
+  string::size_type first = field.find_first_not_of(padding);
+  if(first == string::npos)
+    return "";
+
+  return field.substr(first, field.find_last_not_of(padding) - first + 1);
+
+}
+
+/*
+ * Function: ata_smart_read_data
+ * -----------------------------
+ * Send a SMART READ DATA command to the ATA device and recieve the data
+ *
+ * fd: File descriptor pointing at a SCSI or SCSI generic device node
+ * buf: Data buffer to receive the data into, must be at least SECTOR
+ */
+SgioResult ata_smart_read_data(int fd, unsigned char* buf) {
+
+  sbc_ata_pass_through ata_pass_through;
+  memset(reinterpret_cast<unsigned char*>(&ata_pass_through), 0, sizeof(sbc_ata_pass_through));
+
+  ata_pass_through.operation_code = SBC_ATA_PASS_THROUGH;
+  ata_pass_through.protocol       = ATA_PROTOCOL_PIO_DATA_IN;
+  ata_pass_through.t_dir          = ATA_TRANSFER_DIRECTION_FROM_DEVICE;
+  ata_pass_through.byte_block     = ATA_TRANSFER_SIZE_BLOCK;
+  ata_pass_through.t_type         = ATA_TRANSFER_TYPE_SECTOR;
+  ata_pass_through.t_length       = ATA_TRANSFER_LENGTH_COUNT;
+  ata_pass_through.count_7_0      = 1;
+  ata_pass_through.command        = ATA_SMART;
+  ata_pass_through.features_7_0   = SMART_READ_DATA;
+  ata_pass_through.lba_23_16      = 0xc2;
+  ata_pass_through.lba_15_8       = 0x4f;
+
+  return ata_send(fd, ata_pass_through, buf, SECTOR_SIZE);
+
+}
+
+/*
+ * Function: ata_smart_read_thresholds
+ * -----------------------------------
+ * Send a SMART READ THRESHOLDS command to the ATA device and recieve the data
+ *
+ * fd: File descriptor pointing at a SCSI or SCSI generic device node
+ * buf: Data buffer to receive the data into, must be at least SECTOR
+ */
+SgioResult ata_smart_read_thresholds(int fd, unsigned char* buf) {
+
+  sbc_ata_pass_through ata_pass_through;
+  memset(reinterpret_cast<unsigned char*>(&ata_pass_through), 0, sizeof(sbc_ata_pass_through));
+
+  ata_pass_through.operation_code = SBC_ATA_PASS_THROUGH;
+  ata_pass_through.protocol       = ATA_PROTOCOL_PIO_DATA_IN;
+  ata_pass_through.t_dir          = ATA_TRANSFER_DIRECTION_FROM_DEVICE;
+  ata_pass_through.byte_block     = ATA_TRANSFER_SIZE_BLOCK;
+  ata_pass_through.t_type         = ATA_TRANSFER_TYPE_SECTOR;
+  ata_pass_through.t_length       = ATA_TRANSFER_LENGTH_COUNT;
+  ata_pass_through.count_7_0      = 1;
+  ata_pass_through.command        = ATA_SMART;
+  ata_pass_through.features_7_0   = SMART_READ_THRESHOLDS;
+  ata_pass_through.lba_23_16      = 0xc2;
+  ata_pass_through.lba_15_8       = 0x4f;
+
+  return ata_send(fd, ata_pass_through, buf, SECTOR_SIZE);
+
+}
+
+/*
+ * Function: ata_smart_read_log
+ * ----------------------------
+ * Send a SMART READ LOG command to the ATA device and receive the data
+ * fd: File descriptor pointing at a SCSI or SCSI generic device node
+ * buf: Data buffer to receive the data into, must be at least sectors * SECTOR
+ *      bytes.
+ * log: Log to read See A.1 for ATA8-ACS
+ */
+SgioResult ata_smart_read_log(int fd, unsigned char* buf, int log, uint16_t sectors) {
+
+  sbc_ata_pass_through ata_pass_through;
+  memset(reinterpret_cast<unsigned char*>(&ata_pass_through), 0, sizeof(sbc_ata_pass_through));
+
+  ata_pass_through.operation_code = SBC_ATA_PASS_THROUGH;
+  ata_pass_through.protocol       = ATA_PROTOCOL_PIO_DATA_IN;
+  ata_pass_through.t_dir          = ATA_TRANSFER_DIRECTION_FROM_DEVICE;
+  ata_pass_through.byte_block     = ATA_TRANSFER_SIZE_BLOCK;
+  ata_pass_through.t_type         = ATA_TRANSFER_TYPE_SECTOR;
+  ata_pass_through.t_length       = ATA_TRANSFER_LENGTH_COUNT;
+  ata_pass_through.count_15_8     = sectors >> 8;
+  ata_pass_through.count_7_0      = sectors;
+  ata_pass_through.command        = ATA_SMART;
+  ata_pass_through.features_7_0   = SMART_READ_LOG;
+  ata_pass_through.lba_23_16      = 0xc2;
+  ata_pass_through.lba_15_8       = 0x4f;
+  ata_pass_through.lba_7_0        = log;
+
+  return ata_send(fd, ata_pass_through, buf, sectors * SECTOR_SIZE);
+
+}
+
+/*
+ * Function: ata_smart_write_log
+ * -----------------------------
+ * Send a SMART WRITE LOG command to the ATA device and transmit the data
+ * fd: File descriptor pointing at a SCSI or SCSI generic device node
+ * buf: Data buffer to send, must be at least sectors * SECTOR bytes
+ * log: Log to write See A.1 for ATA8-ACS
+ */
+SgioResult ata_smart_write_log(int fd, unsigned char* buf, int log, uint16_t sectors) {
+
+  sbc_ata_pass_through ata_pass_through;
+  memset(reinterpret_cast<unsigned char*>(&ata_pass_through), 0, sizeof(sbc_ata_pass_through));
+
+  ata_pass_through.operation_code = SBC_ATA_PASS_THROUGH;
+  ata_pass_through.protocol       = ATA_PROTOCOL_PIO_DATA_OUT;
+  ata_pass_through.t_dir          = ATA_TRANSFER_DIRECTION_TO_DEVICE;
+  ata_pass_through.byte_block     = ATA_TRANSFER_SIZE_BLOCK;
+  ata_pass_through.t_type         = ATA_TRANSFER_TYPE_SECTOR;
+  ata_pass_through.t_length       = ATA_TRANSFER_LENGTH_COUNT;
+  ata_pass_through.count_15_8     = sectors >> 8;
+  ata_pass_through.count_7_0      = sectors;
+  ata_pass_through.command        = ATA_SMART;
+  ata_pass_through.features_7_0   = SMART_WRITE_LOG;
+  ata_pass_through.lba_23_16      = 0xc2;
+  ata_pass_through.lba_15_8       = 0x4f;
+  ata_pass_through.lba_7_0        = log;
+
+  return ata_send(fd, ata_pass_through, buf, sectors * SECTOR_SIZE, SG_DXFER_TO_DEV);
+
+}
+
+/*
+ * Function: ata_smart_read_log_directory
+ * --------------------------------------
+ * Reads the SMART flog directory
+ * fd: File descriptor pointing at a SCSI or SCSI generic device nod
+ * buf: Data buffer to receive the data into, must be at least SECTOR
+ */
+SgioResult ata_smart_read_log_directory(int fd, unsigned char* buf) {
+
+  return ata_smart_read_log(fd, buf, ATA_LOG_ADDRESS_DIRECTORY, 1);
+
+}
+
+/*
+ * Function: ata_smart_execute_off_line_immediate
+ * ----------------------------------------------
+ * Send a SMART EXECUTE OFF-LINE IMMEDIATE command to start a self-test
+ * fd: File descriptor pointing at a SCSI or SCSI generic device node
+ * subcommand: Self-test to run, see SMART_SELF_TEST_*
+ */
+SgioResult ata_smart_execute_off_line_immediate(int fd, uint8_t subcommand) {
+
+  sbc_ata_pass_through ata_pass_through;
+  memset(reinterpret_cast<unsigned char*>(&ata_pass_through), 0, sizeof(sbc_ata_pass_through));
+
+  ata_pass_through.operation_code = SBC_ATA_PASS_THROUGH;
+  ata_pass_through.protocol       = ATA_PROTOCOL_NON_DATA;
+  ata_pass_through.t_length       = ATA_TRANSFER_LENGTH_NONE;
+  ata_pass_through.command        = ATA_SMART;
+  ata_pass_through.features_7_0   = SMART_EXECUTE_OFF_LINE_IMMEDIATE;
+  ata_pass_through.lba_23_16      = 0xc2;
+  ata_pass_through.lba_15_8       = 0x4f;
+  ata_pass_through.lba_7_0        = subcommand;
+
+  return ata_send(fd, ata_pass_through, 0, 0);
+
+}
+
+/*
+ * Function: ata_gpl_supported
+ * ---------------------------
+ * Checks IDENTIFY data for the General Purpose Logging feature set
+ * identify: IDENTIFY DEVICE data as read from the device
+ */
+bool ata_gpl_supported(const uint16_t* identify) {
+
+  // Word 84 is only valid if bits 15:14 read 01b
+  uint16_t word84 = StorageEndian::swap(identify[84]);
+
+  return (word84 & 0xc000) == 0x4000 && (word84 & 0x0020);
+
+}
+
+/*
+ * Function: ata_dma_log_supported
+ * -------------------------------
+ * Checks IDENTIFY data for READ LOG DMA EXT support
+ * identify: IDENTIFY DEVICE data as read from the device
+ */
+bool ata_dma_log_supported(const uint16_t* identify) {
+
+  // Word 119 is only valid if bits 15:14 read 01b
+  uint16_t word119 = StorageEndian::swap(identify[119]);
+
+  return ata_gpl_supported(identify) && (word119 & 0xc000) == 0x4000 && (word119 & 0x0008);
+
+}
+
+/*
+ * Function: ata_sct_data_tables_supported
+ * ---------------------------------------
+ * Checks IDENTIFY data for the SCT Command Transport data table command
+ * identify: IDENTIFY DEVICE data as read from the device
+ */
+bool ata_sct_data_tables_supported(const uint16_t* identify) {
+
+  // Word 206 bit 0 is SCT Command Transport, bit 5 the data table command
+  uint16_t word206 = StorageEndian::swap(identify[206]);
+
+  return (word206 & 0x0001) && (word206 & 0x0020);
+
+}
+
+/*
+ * Function: ata_read_log_ext
+ * --------------------------
+ * Send a 48-bit READ LOG EXT or READ LOG DMA EXT command to the ATA device
+ * and receive the data.  Unlike SMART READ LOG this can start at any page
+ * and read several pages in a single command.
+ * fd: File descriptor pointing at a SCSI or SCSI generic device node
+ * buf: Data buffer to receive the data into, must be at least sectors * SECTOR
+ *      bytes.
+ * log: General Purpose Log address to read
+ * page: First page of the log to read
+ * sectors: Number of pages to read
+ * features: Log specific feature bits
+ * dma: Use READ LOG DMA EXT rather than PIO
+ */
+SgioResult ata_read_log_ext(int fd, unsigned char* buf, uint8_t log, uint16_t page, uint16_t sectors,
+                            uint16_t features, bool dma) {
+
+  sbc_ata_pass_through ata_pass_through;
+  memset(reinterpret_cast<unsigned char*>(&ata_pass_through), 0, sizeof(sbc_ata_pass_through));
+
+  ata_pass_through.operation_code = SBC_ATA_PASS_THROUGH;
+  ata_pass_through.extend         = 1;
+  ata_pass_through.protocol       = dma ? ATA_PROTOCOL_DMA : ATA_PROTOCOL_PIO_DATA_IN;
+  ata_pass_through.t_dir          = ATA_TRANSFER_DIRECTION_FROM_DEVICE;
+  ata_pass_through.byte_block     = ATA_TRANSFER_SIZE_BLOCK;
+  ata_pass_through.t_type         = ATA_TRANSFER_TYPE_SECTOR;
+  ata_pass_through.t_length       = ATA_TRANSFER_LENGTH_COUNT;
+  ata_pass_through.features_15_8  = features >> 8;
+  ata_pass_through.features_7_0   = features;
+  ata_pass_through.count_15_8     = sectors >> 8;
+  ata_pass_through.count_7_0      = sectors;
+  ata_pass_through.command        = dma ? ATA_READ_LOG_DMA_EXT : ATA_READ_LOG_EXT;
+  ata_pass_through.lba_7_0        = log;
+  ata_pass_through.lba_15_8       = page;
+  ata_pass_through.lba_39_32      = page >> 8;
+
+  return ata_send(fd, ata_pass_through, buf, sectors * SECTOR_SIZE);
+
+}
+
+/*
+ * Function: ata_read_gpl
+ * ----------------------
+ * Reads a General Purpose Log, preferring READ LOG DMA EXT where IDENTIFY
+ * advertises it and falling back to PIO if the SAT rejects the command
+ * fd: File descriptor pointing at a SCSI or SCSI generic device node
+ * identify: IDENTIFY DEVICE data as read from the device
+ * buf: Data buffer to receive the data into, must be at least sectors * SECTOR
+ *      bytes.
+ * log: General Purpose Log address to read
+ * page: First page of the log to read
+ * sectors: Number of pages to read
+ * features: Log specific feature bits
+ */
+SgioResult ata_read_gpl(int fd, const uint16_t* identify, unsigned char* buf, uint8_t log, uint16_t page, uint16_t sectors,
+                        uint16_t features) {
+
+  if(ata_dma_log_supported(identify)) {
+    SgioResult result = ata_read_log_ext(fd, buf, log, page, sectors, features, true);
+    if(result.ok() || result.getError())
+      return result;
+  }
+
+  return ata_read_log_ext(fd, buf, log, page, sectors, features);
+
+}
+
+/**
+ * Function: AtaIdentity::AtaIdentity(const uint16_t*)
+ * ---------------------------------------------------
+ * Class constructor to decode the identity fields
+ * identify: IDENTIFY DEVICE data as read from the device
+ */
+AtaIdentity::AtaIdentity(const uint16_t* identify)
+: serial(ata_identify_string(identify, 10, 10)),
+  firmware(ata_identify_string(identify, 23, 4)),
+  model(ata_identify_string(identify, 27, 20)),
+  wwn(0) {
+
+  // Word 87 is valid when bits 15:14 are 01, bit 8 then flags the WWN
+  uint16_t word87 = StorageEndian::swap(identify[87]);
+  if((word87 & 0xc000) != 0x4000 || !(word87 & 0x0100))
+    return;
+
+  for(int i = 108; i < 112; i++)
+    wwn = (wwn << 16) | StorageEndian::swap(identify[i]);
+
+}
+
+/**
+ * Function: AtaIdentity::key()
+ * ----------------------------
+ * Returns a file name safe key for the device, the WWN where reported
+ * otherwise the model and serial number, empty if the device reports
+ * neither
+ */
+string AtaIdentity::key() const {
+
+  if(wwn) {
+    stringstream key;
+    key << "wwn-0x" << hex << setfill('0') << setw(16) << wwn;
+    return key.str();
+  }
+
+  if(serial.empty())
+    return "";
+
+  string key = model + "_" + serial;
+  for(string::iterator i = key.begin(); i != key.end(); i++)
+    if(!isalnum(*i) && *i != '-' && *i != '.')
+      *i = '_';
+
+  return key;
+
+}
+
+/**
+ * Function: operator<<(ostream&, const AtaIdentity&)
+ * --------------------------------------------------
+ * Function to dump the identity to an output stream
+ * o: Class implementing std::ostream
+ * identity: Reference to an AtaIdentity class
+ */
+ostream& operator<<(ostream& o, const AtaIdentity& identity) {
+
+  o << "model " << identity.getModel()
+    << ", serial " << identity.getSerial()
+    << ", firmware " << identity.getFirmware();
+
+  if(identity.getWWN())
+    o << ", wwn 0x" << hex << setfill('0') << setw(16) << identity.getWWN() << dec << setfill(' ');
+
+  return o;
+
+}
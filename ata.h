@@ -24,13 +24,32 @@
 #define _ata_H_
 
 #include <stdint.h>
+#include <stddef.h>
+
+#include "sgio.h"
+
+#include <string>
+
+/* Class Declarations */
+class AtaIdentity;
+
+/* ATA sector size */
+const size_t SECTOR_SIZE = 512;
+
+/* Number of times a page with a bad checksum is read again */
+const int ATA_CHECKSUM_RETRIES = 2;
 
 /* ATA commands */
-const uint8_t ATA_IDENTIFY_DEVICE = 0xec;
-const uint8_t ATA_SMART           = 0xb0;
+const uint8_t ATA_IDENTIFY_DEVICE  = 0xec;
+const uint8_t ATA_SMART            = 0xb0;
+const uint8_t ATA_READ_LOG_EXT     = 0x2f;
+const uint8_t ATA_READ_LOG_DMA_EXT = 0x47;
 
 /* ATA protocols */
-const uint8_t ATA_PROTOCOL_PIO_DATA_IN = 0x4;
+const uint8_t ATA_PROTOCOL_NON_DATA     = 0x3;
+const uint8_t ATA_PROTOCOL_PIO_DATA_IN  = 0x4;
+const uint8_t ATA_PROTOCOL_PIO_DATA_OUT = 0x5;
+const uint8_t ATA_PROTOCOL_DMA          = 0x6;
 
 /* ATA transfer direction */
 const uint8_t ATA_TRANSFER_DIRECTION_TO_DEVICE   = 0x0;
@@ -51,7 +70,289 @@ const uint8_t ATA_TRANSFER_LENGTH_COUNT    = 0x2;
 const uint8_t ATA_TRANSFER_LENGTH_TPSIU    = 0x3;
 
 /* ATA Log Addresses */
-const uint8_t ATA_LOG_ADDRESS_DIRECTORY = 0x0;
-const uint8_t ATA_LOG_ADDRESS_SMART     = 0x1;
+const uint8_t ATA_LOG_ADDRESS_DIRECTORY         = 0x0;
+const uint8_t ATA_LOG_ADDRESS_SMART             = 0x1;
+const uint8_t ATA_LOG_ADDRESS_COMPREHENSIVE     = 0x2;
+const uint8_t ATA_LOG_ADDRESS_EXT_COMPREHENSIVE = 0x3;
+const uint8_t ATA_LOG_ADDRESS_DEVSTAT           = 0x4;
+const uint8_t ATA_LOG_ADDRESS_SELF_TEST         = 0x6;
+const uint8_t ATA_LOG_ADDRESS_EXT_SELF_TEST     = 0x7;
+const uint8_t ATA_LOG_ADDRESS_SATA_PHY          = 0x11;
+const uint8_t ATA_LOG_ADDRESS_SCT_COMMAND       = 0xe0;
+const uint8_t ATA_LOG_ADDRESS_SCT_DATA          = 0xe1;
+
+/* ATA error register bits */
+const uint8_t ATA_ERROR_ABRT = 0x04;
+const uint8_t ATA_ERROR_IDNF = 0x10;
+const uint8_t ATA_ERROR_UNC  = 0x40;
+const uint8_t ATA_ERROR_ICRC = 0x80;
+
+/* SAT CDB variants, combined as flags */
+const uint8_t SAT_VARIANT_DEFAULT = 0x00;
+const uint8_t SAT_VARIANT_12      = 0x01;
+const uint8_t SAT_VARIANT_CK_COND = 0x02;
+const uint8_t SAT_VARIANT_T_TYPE  = 0x04;
+const uint8_t SAT_VARIANT_NONE    = 0xff;
+
+/* SAT CDB variants in the order they are probed */
+extern const uint8_t sat_variants[];
+extern const int sat_variant_num;
+
+/*
+ * Function: ata_set_sat_variant
+ * -----------------------------
+ * Selects the form of ATA PASS-THROUGH CDB used for ATA commands sent to a
+ * device.  Devices behind different bridges may be checked at once, from
+ * any thread, each keeps its own.
+ * fd: Descriptor the device is open on
+ * variant: Combination of SAT_VARIANT_* flags
+ */
+void ata_set_sat_variant(int fd, uint8_t variant);
+
+/*
+ * Function: ata_get_sat_variant
+ * -----------------------------
+ * Returns the form of ATA PASS-THROUGH CDB used for ATA commands sent to a
+ * device
+ * fd: Descriptor the device is open on
+ */
+uint8_t ata_get_sat_variant(int fd);
+
+/*
+ * Function: ata_checksum
+ * ----------------------
+ * Returns the 8-bit sum of a data structure sector, which for a valid
+ * SMART page including its trailing checksum byte is zero
+ *
+ * buf: Sector to sum, must be at least SECTOR bytes
+ */
+uint8_t ata_checksum(const unsigned char* buf);
+
+/*
+ * Function: ata_identify
+ * ----------------------
+ * Send an IDENTIFY command to the ATA device and recieve the data
+ *
+ * fd: File descriptor pointing at a SCSI or SCSI generic device node
+ * buf: Data buffer to receive the data into, must be at least SECTOR
+ */
+SgioResult ata_identify(int fd, unsigned char* buf);
+
+/*
+ * Function: ata_identify_valid
+ * ----------------------------
+ * Sanity checks IDENTIFY DEVICE data, rejecting an empty buffer or one
+ * carrying an integrity word whose checksum doesn't match
+ * identify: IDENTIFY DEVICE data as read from the device
+ */
+bool ata_identify_valid(const uint16_t* identify);
+
+/*
+ * Function: ata_identify_string
+ * -----------------------------
+ * Returns an ASCII string field from IDENTIFY DEVICE data with padding
+ * removed.  Each word holds two characters, the first in its high byte.
+ * identify: IDENTIFY DEVICE data as read from the device
+ * word: First word of the field
+ * words: Length of the field in words
+ */
+string ata_identify_string(const uint16_t* identify, int word, int words);
+
+/*
+ * Function: ata_smart_read_data
+ * -----------------------------
+ * Send a SMART READ DATA command to the ATA device and recieve the data
+ *
+ * fd: File descriptor pointing at a SCSI or SCSI generic device node
+ * buf: Data buffer to receive the data into, must be at least SECTOR
+ */
+SgioResult ata_smart_read_data(int fd, unsigned char* buf);
+
+/*
+ * Function: ata_smart_read_thresholds
+ * -----------------------------------
+ * Send a SMART READ THRESHOLDS command to the ATA device and recieve the data
+ *
+ * fd: File descriptor pointing at a SCSI or SCSI generic device node
+ * buf: Data buffer to receive the data into, must be at least SECTOR
+ */
+SgioResult ata_smart_read_thresholds(int fd, unsigned char* buf);
+
+/*
+ * Function: ata_smart_read_log
+ * ----------------------------
+ * Send a SMART READ LOG command to the ATA device and receive the data
+ * fd: File descriptor pointing at a SCSI or SCSI generic device node
+ * buf: Data buffer to receive the data into, must be at least sectors * SECTOR
+ *      bytes.
+ * log: Log to read See A.1 for ATA8-ACS
+ */
+SgioResult ata_smart_read_log(int fd, unsigned char* buf, int log, uint16_t sectors);
+
+/*
+ * Function: ata_smart_write_log
+ * -----------------------------
+ * Send a SMART WRITE LOG command to the ATA device and transmit the data
+ * fd: File descriptor pointing at a SCSI or SCSI generic device node
+ * buf: Data buffer to send, must be at least sectors * SECTOR bytes
+ * log: Log to write See A.1 for ATA8-ACS
+ */
+SgioResult ata_smart_write_log(int fd, unsigned char* buf, int log, uint16_t sectors);
+
+/*
+ * Function: ata_smart_read_log_directory
+ * --------------------------------------
+ * Reads the SMART flog directory
+ * fd: File descriptor pointing at a SCSI or SCSI generic device nod
+ * buf: Data buffer to receive the data into, must be at least SECTOR
+ */
+SgioResult ata_smart_read_log_directory(int fd, unsigned char* buf);
+
+/*
+ * Function: ata_smart_execute_off_line_immediate
+ * ----------------------------------------------
+ * Send a SMART EXECUTE OFF-LINE IMMEDIATE command to start a self-test
+ * fd: File descriptor pointing at a SCSI or SCSI generic device node
+ * subcommand: Self-test to run, see SMART_SELF_TEST_*
+ */
+SgioResult ata_smart_execute_off_line_immediate(int fd, uint8_t subcommand);
+
+/*
+ * Function: ata_gpl_supported
+ * ---------------------------
+ * Checks IDENTIFY data for the General Purpose Logging feature set
+ * identify: IDENTIFY DEVICE data as read from the device
+ */
+bool ata_gpl_supported(const uint16_t* identify);
+
+/*
+ * Function: ata_dma_log_supported
+ * -------------------------------
+ * Checks IDENTIFY data for READ LOG DMA EXT support
+ * identify: IDENTIFY DEVICE data as read from the device
+ */
+bool ata_dma_log_supported(const uint16_t* identify);
+
+/*
+ * Function: ata_sct_data_tables_supported
+ * ---------------------------------------
+ * Checks IDENTIFY data for the SCT Command Transport data table command
+ * identify: IDENTIFY DEVICE data as read from the device
+ */
+bool ata_sct_data_tables_supported(const uint16_t* identify);
+
+/*
+ * Function: ata_read_log_ext
+ * --------------------------
+ * Send a 48-bit READ LOG EXT or READ LOG DMA EXT command to the ATA device
+ * and receive the data.  Unlike SMART READ LOG this can start at any page
+ * and read several pages in a single command.
+ * fd: File descriptor pointing at a SCSI or SCSI generic device node
+ * buf: Data buffer to receive the data into, must be at least sectors * SECTOR
+ *      bytes.
+ * log: General Purpose Log address to read
+ * page: First page of the log to read
+ * sectors: Number of pages to read
+ * features: Log specific feature bits
+ * dma: Use READ LOG DMA EXT rather than PIO
+ */
+SgioResult ata_read_log_ext(int fd, unsigned char* buf, uint8_t log, uint16_t page, uint16_t sectors,
+                            uint16_t features = 0, bool dma = false);
+
+/*
+ * Function: ata_read_gpl
+ * ----------------------
+ * Reads a General Purpose Log, preferring READ LOG DMA EXT where IDENTIFY
+ * advertises it and falling back to PIO if the SAT rejects the command
+ * fd: File descriptor pointing at a SCSI or SCSI generic device node
+ * identify: IDENTIFY DEVICE data as read from the device
+ * buf: Data buffer to receive the data into, must be at least sectors * SECTOR
+ *      bytes.
+ * log: General Purpose Log address to read
+ * page: First page of the log to read
+ * sectors: Number of pages to read
+ * features: Log specific feature bits
+ */
+SgioResult ata_read_gpl(int fd, const uint16_t* identify, unsigned char* buf, uint8_t log, uint16_t page, uint16_t sectors,
+                        uint16_t features = 0);
+
+/*
+ * Class: AtaIdentity
+ * ------------------
+ * Stable identity of an ATA device decoded from IDENTIFY DEVICE data, used
+ * to key per-device state so it survives node renumbering
+ */
+class AtaIdentity {
+
+public:
+  /**
+   * Function: AtaIdentity::AtaIdentity(const uint16_t*)
+   * ---------------------------------------------------
+   * Class constructor to decode the identity fields
+   * identify: IDENTIFY DEVICE data as read from the device
+   */
+  AtaIdentity(const uint16_t* identify);
+
+  /**
+   * Function: AtaIdentity::getSerial()
+   * ----------------------------------
+   * Returns the serial number, words 10-19
+   */
+  inline const string& getSerial() const {
+    return serial;
+  }
+
+  /**
+   * Function: AtaIdentity::getFirmware()
+   * ------------------------------------
+   * Returns the firmware revision, words 23-26
+   */
+  inline const string& getFirmware() const {
+    return firmware;
+  }
+
+  /**
+   * Function: AtaIdentity::getModel()
+   * ---------------------------------
+   * Returns the model number, words 27-46
+   */
+  inline const string& getModel() const {
+    return model;
+  }
+
+  /**
+   * Function: AtaIdentity::getWWN()
+   * -------------------------------
+   * Returns the world wide name, words 108-111, or zero if not reported
+   */
+  inline uint64_t getWWN() const {
+    return wwn;
+  }
+
+  /**
+   * Function: AtaIdentity::key()
+   * ----------------------------
+   * Returns a file name safe key for the device, the WWN where reported
+   * otherwise the model and serial number, empty if the device reports
+   * neither
+   */
+  string key() const;
+
+private:
+  string serial;
+  string firmware;
+  string model;
+  uint64_t wwn;
+
+};
+
+/**
+ * Function: operator<<(ostream&, const AtaIdentity&)
+ * --------------------------------------------------
+ * Function to dump the identity to an output stream
+ * o: Class implementing std::ostream
+ * identity: Reference to an AtaIdentity class
+ */
+ostream& operator<<(ostream& o, const AtaIdentity& identity);
 
 #endif//_ata_H_
@@ -0,0 +1,1845 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <scsi/sg.h>
+
+#include "check.h"
+#include "scsi.h"
+#include "ata.h"
+#include "smart.h"
+#include "endian.h"
+#include "devstat.h"
+#include "phy.h"
+#include "sct.h"
+#include "nvme.h"
+#include "logsense.h"
+#include "megaraid.h"
+#include "flight.h"
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <set>
+#include <algorithm>
+
+/*
+ * Struct: CheckResult
+ * -------------------
+ * Accumulated state and performance data for a single device check.  If
+ * a command fails the check is abandoned and error describes why.
+ */
+struct CheckResult {
+  int code;
+  int prdfail;
+  int advisory;
+  int crit;
+  int warn;
+  int logs;
+  int checksum_errors;
+  int new_errors;
+  uint64_t error_count;
+  int margin;
+  string counters;
+  string identity;
+  string key;
+  vector<shm_attribute> attributes;
+  vector<metric> values;
+  string self_test;
+  string prefix;
+  stringstream perfdata;
+  string error;
+
+  CheckResult()
+  : code(NAGIOS_OK), prdfail(0), advisory(0), crit(0), warn(0), logs(0), checksum_errors(0), new_errors(0),
+    error_count(0), margin(DAEMON_MARGIN_NONE)
+  {}
+};
+
+/*
+ * Function: command_failed
+ * ------------------------
+ * Records a failed command against the check result and returns false so
+ * callers can bail out in a single statement
+ * result: Reference to the check result
+ * command: Name of the failed command
+ * sgio_result: Reference to the failed command's result
+ */
+bool command_failed(CheckResult& result, const char* command, const SgioResult& sgio_result) {
+
+  stringstream error;
+  error << command << " failed: " << sgio_result;
+  result.error = error.str();
+
+  return false;
+
+}
+
+/*
+ * Function: track_counter
+ * -----------------------
+ * Records the value of a failure counter, the daemon checks a device more
+ * often while any is moving
+ * result: Reference to the check result
+ * label: Identifies the counter
+ * value: Raw value of the counter
+ */
+void track_counter(CheckResult& result, const string& label, uint64_t value) {
+
+  stringstream counter;
+  counter << label << "=" << value << " ";
+  result.counters += counter.str();
+
+}
+
+/*
+ * Function: lookup
+ * ----------------
+ * Returns the threshold for a key, or zero if none was specified
+ * thresholds: Map of keys to thresholds
+ * key: Key to look up
+ */
+template<class Map>
+typename Map::mapped_type lookup(const Map& thresholds, const typename Map::key_type& key) {
+
+  typename Map::const_iterator i = thresholds.find(key);
+
+  return i == thresholds.end() ? 0 : i->second;
+
+}
+
+/*
+ * Function: check_metric
+ * ----------------------
+ * Checks a named statistic against user thresholds and accumulates its
+ * performance data
+ * options: Reference to the check options holding named thresholds
+ * result: Reference to the check result to accumulate into
+ * label: Performance data label, also used to look up thresholds
+ * value: Value of the statistic
+ */
+void check_metric(const CheckOptions& options, CheckResult& result, const string& label, int64_t value) {
+
+  int64_t crit_threshold = lookup(options.critical_named, label);
+  int64_t warn_threshold = lookup(options.warning_named, label);
+
+  if(crit_threshold && value >= crit_threshold) {
+    result.crit++;
+    result.code = max(result.code, NAGIOS_CRITICAL);
+  } else if(warn_threshold && value >= warn_threshold) {
+    result.warn++;
+    result.code = max(result.code, NAGIOS_WARNING);
+  }
+
+  result.values.push_back(metric{label, value});
+  result.perfdata << " " << result.prefix << label << "=" << value << ";";
+  if(warn_threshold)
+    result.perfdata << warn_threshold;
+  result.perfdata << ";";
+  if(crit_threshold)
+    result.perfdata << crit_threshold;
+  result.perfdata << ";;";
+
+}
+
+/*
+ * Function: check_floor
+ * ---------------------
+ * Checks a named statistic where lower values are worse, such as remaining
+ * spare capacity, alerting when it falls below a user threshold.  The
+ * performance data thresholds use the N: range form to match.
+ * options: Reference to the check options holding named thresholds
+ * result: Reference to the check result to accumulate into
+ * label: Performance data label, also used to look up thresholds
+ * value: Value of the statistic
+ */
+void check_floor(const CheckOptions& options, CheckResult& result, const string& label, int64_t value) {
+
+  int64_t crit_threshold = lookup(options.critical_named, label);
+  int64_t warn_threshold = lookup(options.warning_named, label);
+
+  if(crit_threshold && value < crit_threshold) {
+    result.crit++;
+    result.code = max(result.code, NAGIOS_CRITICAL);
+  } else if(warn_threshold && value < warn_threshold) {
+    result.warn++;
+    result.code = max(result.code, NAGIOS_WARNING);
+  }
+
+  result.values.push_back(metric{label, value});
+  result.perfdata << " " << result.prefix << label << "=" << value << ";";
+  if(warn_threshold)
+    result.perfdata << warn_threshold << ":";
+  result.perfdata << ";";
+  if(crit_threshold)
+    result.perfdata << crit_threshold << ":";
+  result.perfdata << ";;";
+
+}
+
+/*
+ * Function: identify_device
+ * -------------------------
+ * Reads IDENTIFY DEVICE data.  Direct access devices which reject the
+ * default ATA PASS-THROUGH CDB are probed with each variant in turn, and
+ * whichever works, or that none does, is cached against the bridge's
+ * identity so later checks go straight to it after the default is
+ * rejected.  Returns false if the ATA
+ * command set is unavailable, sgio_result holds an error if the device
+ * itself failed.
+ * fd: File descriptor pointing at a SCSI or SCSI generic device node
+ * identify: Buffer to receive the IDENTIFY DEVICE data
+ * state_dir: Directory holding the variant cache
+ * sgio_result: Reference to receive the result of the last command
+ */
+bool identify_device(int fd, uint16_t* identify, const string& state_dir, SgioResult& sgio_result) {
+
+  unsigned char* buf = reinterpret_cast<unsigned char*>(identify);
+
+  ata_set_sat_variant(fd, SAT_VARIANT_DEFAULT);
+  sgio_result = ata_identify(fd, buf);
+  if(sgio_result.ok() || sgio_result.getError())
+    return sgio_result.ok();
+
+  // Only devices rejecting the default form pay for the identity lookup
+  StateFile cache(state_path(state_dir, STATE_SAT_VARIANTS));
+  cache.load();
+
+  string identity = scsi_identity(fd);
+  uint64_t cached;
+  if(!identity.empty() && cache.get(identity, cached)) {
+    if(cached == SAT_VARIANT_NONE)
+      return false;
+    ata_set_sat_variant(fd, cached);
+    sgio_result = ata_identify(fd, buf);
+    if(sgio_result.ok() || sgio_result.getError())
+      return sgio_result.ok();
+  }
+
+  // Opcode 0xa1 is BLANK to an optical drive so only block devices are
+  // probed, and data from an unproven variant must look like IDENTIFY data
+  uint8_t variant = SAT_VARIANT_NONE;
+  if(scsi_direct_access(fd)) {
+    for(int i=1; i<sat_variant_num; i++) {
+      ata_set_sat_variant(fd, sat_variants[i]);
+      memset(buf, 0, SECTOR_SIZE);
+      sgio_result = ata_identify(fd, buf);
+      if(sgio_result.getError())
+        return false;
+      if(sgio_result.ok() && ata_identify_valid(identify)) {
+        variant = sat_variants[i];
+        break;
+      }
+    }
+  }
+
+  // Remember the outcome, a cache which can't be written only costs the
+  // probe next time
+  if(!identity.empty())
+    cache.update(identity, variant);
+
+  if(variant == SAT_VARIANT_NONE) {
+    ata_set_sat_variant(fd, SAT_VARIANT_DEFAULT);
+    return false;
+  }
+
+  return true;
+
+}
+
+/*
+ * Function: read_validated
+ * ------------------------
+ * Reads a checksummed page, or set of pages, re-reading while any sector
+ * fails validation.  Each bad read is counted so flaky bridges can be
+ * identified, and a page which never validates fails the check.
+ * read: Functor issuing the read command
+ * command: Name of the command for error reporting
+ * buf: Buffer the functor reads into
+ * sectors: Number of sectors to validate
+ * result: Reference to the check result to accumulate into
+ * retries: Number of times to re-read, zero for reads with side effects
+ */
+template<class Reader>
+bool read_validated(Reader read, const char* command, const unsigned char* buf, int sectors, CheckResult& result,
+                    int retries = ATA_CHECKSUM_RETRIES) {
+
+  for(int attempt = 0; ; attempt++) {
+
+    SgioResult sgio_result = read();
+    if(!sgio_result.ok())
+      return command_failed(result, command, sgio_result);
+
+    bool valid = true;
+    for(int i=0; i<sectors && valid; i++)
+      valid = !ata_checksum(buf + i * SECTOR_SIZE);
+
+    if(valid)
+      return true;
+
+    result.checksum_errors++;
+
+    if(attempt == retries) {
+      result.error = string(command) + " failed: invalid checksum";
+      return false;
+    }
+
+  }
+
+}
+
+/*
+ * Function: check_smart_attributes
+ * --------------------------------
+ * Checks attributes against vendor thresholds, returns false if the data
+ * could not be read
+ * fd: File descriptor pointing at a SCSI or SCSI generic device node
+ * options: Reference to the check options holding attribute thresholds
+ * sd: Reference to receive the SMART data page for later checks
+ * result: Reference to the check result to accumulate into
+ */
+bool check_smart_attributes(int fd, const CheckOptions& options, smart_data& sd, CheckResult& result) {
+
+  // Load the SMART data and thresholds pages, each is validated and re-read
+  // independently so a corrupt thresholds page doesn't cost a data read
+  unsigned char* sd_buf = reinterpret_cast<unsigned char*>(&sd);
+  if(!read_validated([&]() { return ata_smart_read_data(fd, sd_buf); }, "SMART READ DATA", sd_buf, 1, result))
+    return false;
+
+  smart_thresholds st;
+  unsigned char* st_buf = reinterpret_cast<unsigned char*>(&st);
+  if(!read_validated([&]() { return ata_smart_read_thresholds(fd, st_buf); }, "SMART READ THRESHOLDS", st_buf, 1, result))
+    return false;
+
+  // Perform actual SMART threshold checks
+  for(int i=0; i<SMART_ATTRIBUTE_NUM; i++) {
+
+    SmartAttribute attribute(sd.attributes[i]);
+    SmartThreshold threshold(st.thresholds[i]);
+
+    if(!attribute.idValid())
+      continue;
+
+    shm_attribute published;
+    memset(&published, 0, sizeof(published));
+    published.id = attribute.getID();
+    published.value = attribute.getValue();
+    published.worst = attribute.getWorst();
+    published.threshold = threshold.getThreshold();
+    published.prefail = attribute.getPreFail();
+    published.raw = attribute.getRaw();
+    result.attributes.push_back(published);
+
+    if(attribute.isFailureCounter())
+      track_counter(result, to_string(attribute.getID()), attribute.getRaw());
+
+    // How near a value is to its threshold, a zero threshold never trips
+    if(attribute.valueValid() && threshold.getThreshold())
+      result.margin = min<int>(result.margin, attribute.getValue() - threshold.getThreshold());
+
+    // Check the validity of the attribute value and whether the threshold has been exceeded
+    if(attribute.valueValid() && (attribute <= threshold)) {
+
+      // Predicted failure is within 24 hours, otherwise the device lifespan has been exceeded
+      if(attribute.getPreFail())
+        result.prdfail++;
+      else
+        result.advisory++;
+
+    }
+
+    // Check against custom raw thresholds
+    uint64_t crit_threshold = lookup(options.critical_thresholds, attribute.getID());
+    uint64_t warn_threshold = lookup(options.warning_thresholds, attribute.getID());
+
+    if(crit_threshold && (attribute.getRaw() >= crit_threshold)) {
+      result.crit++;
+    } else if(warn_threshold && (attribute.getRaw() >= warn_threshold)) {
+      result.warn++;
+    }
+
+    // Accumulate the performance data
+    stringstream label;
+    label << static_cast<unsigned int>(attribute.getID()) << "_" << smart_attribute_label(attribute.getID());
+    result.values.push_back(metric{label.str(), static_cast<int64_t>(attribute.getRaw())});
+    result.perfdata << " " << result.prefix << attribute << ";";
+    if(warn_threshold)
+      result.perfdata << warn_threshold;
+    result.perfdata << ";";
+    if(crit_threshold)
+      result.perfdata << crit_threshold;
+    result.perfdata << ";;";
+
+  }
+
+  // Determine the state to report
+  if(result.advisory || result.warn)
+    result.code = max(result.code, NAGIOS_WARNING);
+
+  if(result.prdfail || result.crit)
+    result.code = max(result.code, NAGIOS_CRITICAL);
+
+  return true;
+
+}
+
+/*
+ * Function: check_smart_log
+ * -------------------------
+ * Checks for the existence of SMART logs, returns false if the logs could
+ * not be read
+ * fd: File descriptor pointing at a SCSI or SCSI generic device node
+ * log_directory: Reference to receive the SMART log directory for later checks
+ * result: Reference to the check result to accumulate into
+ */
+bool check_smart_log(int fd, smart_log_directory& log_directory, CheckResult& result) {
+
+  // Read the SMART log directory
+  SgioResult sgio_result = ata_smart_read_log_directory(fd, reinterpret_cast<unsigned char*>(&log_directory));
+  if(!sgio_result.ok())
+    return command_failed(result, "SMART READ LOG directory", sgio_result);
+
+  // Calculate the number of SMART log sectors to read and allocate a buffer
+  uint16_t smart_log_sectors = StorageEndian::swap(log_directory.data_blocks[ATA_LOG_ADDRESS_SMART]);
+  if(!smart_log_sectors)
+    return true;
+
+  vector<smart_log_summary> summaries(smart_log_sectors);
+  unsigned char* summaries_buf = reinterpret_cast<unsigned char*>(&summaries[0]);
+
+  // Read the logs in
+  if(!read_validated([&]() { return ata_smart_read_log(fd, summaries_buf, ATA_LOG_ADDRESS_SMART, smart_log_sectors); },
+                     "SMART READ LOG", summaries_buf, smart_log_sectors, result))
+    return false;
+
+  // Check for any logged errors
+  for(int i=0; i<smart_log_sectors; i++) {
+
+    // If the index is zero there are no entries
+    if(!StorageEndian::swap(summaries[i].index))
+      continue;
+
+    result.logs += StorageEndian::swap(summaries[i].count);
+
+  }
+
+  result.error_count = max<uint64_t>(result.error_count, result.logs);
+
+  if(result.logs)
+    result.code = max(result.code, NAGIOS_WARNING);
+
+  return true;
+
+}
+
+/*
+ * Function: walk_error_log
+ * ------------------------
+ * Walks a comprehensive error log ring back from the most recent entry to
+ * the last one seen by a previous check, tallying the new errors.  Only the
+ * first page is read up front, further pages are read only if they hold
+ * new entries.  Returns false if the log could not be read.
+ * read: Functor reading a number of pages from a first page into pages
+ * pages: Reference to the buffer of log pages, sized to the whole log
+ * seen: Device error count at the last check, or null if never checked
+ * options: Reference to the check options
+ * result: Reference to the check result to accumulate into
+ * count: Reference to receive the device error count
+ */
+template<class Page, class Reader>
+bool walk_error_log(Reader read, vector<Page>& pages, const uint64_t* seen, const CheckOptions& options,
+                    CheckResult& result, uint16_t& count) {
+
+  const int entries = sizeof(pages[0].data) / sizeof(pages[0].data[0]);
+  const int capacity = pages.size() * entries;
+
+  if(!read(0, 1))
+    return false;
+
+  int index = StorageEndian::swap(pages[0].index);
+  count = StorageEndian::swap(pages[0].count);
+
+  // An index of zero means the log is empty, and the count saturates so a
+  // drop means the device, or its log, has been replaced
+  int fresh = 0;
+  if(index && index <= capacity)
+    fresh = min<int>(seen && *seen <= count ? count - *seen : count, capacity);
+
+  // Work out which pages hold the new entries, the ring runs backwards from
+  // the index and wraps at the end of the log
+  vector<bool> wanted(pages.size());
+  for(int i=0; i<fresh; i++)
+    wanted[((index - 1 - i + capacity) % capacity) / entries] = true;
+
+  for(size_t i=1; i<pages.size(); ) {
+
+    if(!wanted[i]) {
+      i++;
+      continue;
+    }
+
+    size_t j = i + 1;
+    while(j < pages.size() && wanted[j])
+      j++;
+
+    if(!read(i, j - i))
+      return false;
+
+    i = j;
+
+  }
+
+  int unc = 0, icrc = 0, idnf = 0, abrt = 0;
+  for(int i=0; i<fresh; i++) {
+
+    int entry = (index - 1 - i + capacity) % capacity;
+    uint8_t error = StorageEndian::swap(pages[entry / entries].data[entry % entries].error.error);
+
+    if(error & ATA_ERROR_UNC)
+      unc++;
+    if(error & ATA_ERROR_ICRC)
+      icrc++;
+    if(error & ATA_ERROR_IDNF)
+      idnf++;
+    if(error & ATA_ERROR_ABRT)
+      abrt++;
+
+  }
+
+  result.new_errors = fresh;
+  result.error_count = max<uint64_t>(result.error_count, count);
+  if(fresh)
+    result.code = max(result.code, NAGIOS_WARNING);
+
+  check_metric(options, result, "error_log_count", count);
+  check_metric(options, result, "new_errors", fresh);
+  check_metric(options, result, "new_unc_errors", unc);
+  check_metric(options, result, "new_icrc_errors", icrc);
+  check_metric(options, result, "new_idnf_errors", idnf);
+  check_metric(options, result, "new_abrt_errors", abrt);
+
+  return true;
+
+}
+
+/*
+ * Function: check_error_log
+ * -------------------------
+ * Reports errors added to the comprehensive error log since the last check,
+ * preferring the extended log which holds 48-bit LBAs.  Returns false if
+ * the log could not be read.
+ * fd: File descriptor pointing at a SCSI or SCSI generic device node
+ * identify: IDENTIFY DEVICE data as read from the device
+ * gpl_directory: Reference to the General Purpose Log directory
+ * log_directory: Reference to the SMART log directory
+ * options: Reference to the check options
+ * state: Reference to the device state, updated with the error count
+ * result: Reference to the check result to accumulate into
+ */
+bool check_error_log(int fd, const uint16_t* identify, const smart_log_directory& gpl_directory,
+                     const smart_log_directory& log_directory, const CheckOptions& options,
+                     StateFile& state, CheckResult& result) {
+
+  if(!options.error_log)
+    return true;
+
+  uint64_t last;
+  const uint64_t* seen = state.get("error_log_count", last) ? &last : 0;
+  uint16_t count;
+
+  uint16_t ext_pages = StorageEndian::swap(gpl_directory.data_blocks[ATA_LOG_ADDRESS_EXT_COMPREHENSIVE]);
+  uint16_t pages = StorageEndian::swap(log_directory.data_blocks[ATA_LOG_ADDRESS_COMPREHENSIVE]);
+
+  if(ext_pages) {
+
+    vector<smart_ext_log> log(ext_pages);
+
+    auto read = [&](int first, int num) {
+      unsigned char* buf = reinterpret_cast<unsigned char*>(&log[first]);
+      return read_validated([&]() { return ata_read_gpl(fd, identify, buf, ATA_LOG_ADDRESS_EXT_COMPREHENSIVE, first, num); },
+                            "READ LOG EXT extended comprehensive error", buf, num, result);
+    };
+
+    if(!walk_error_log(read, log, seen, options, result, count))
+      return false;
+
+  } else if(pages) {
+
+    vector<smart_log_summary> log(pages);
+
+    // SMART READ LOG always starts at the first sector
+    auto read = [&](int first, int num) {
+      unsigned char* buf = reinterpret_cast<unsigned char*>(&log[0]);
+      return read_validated([&]() { return ata_smart_read_log(fd, buf, ATA_LOG_ADDRESS_COMPREHENSIVE, first + num); },
+                            "SMART READ LOG comprehensive error", buf, first + num, result);
+    };
+
+    if(!walk_error_log(read, log, seen, options, result, count))
+      return false;
+
+  } else {
+    return true;
+  }
+
+  state.set("error_log_count", count);
+
+  return true;
+
+}
+
+/*
+ * Function: check_temperature_history
+ * -----------------------------------
+ * Reports the temperature range from the device's own SCT temperature
+ * history since the last check, so thermal excursions between checks are
+ * not missed.  Returns false if the history could not be read.
+ * fd: File descriptor pointing at a SCSI or SCSI generic device node
+ * identify: IDENTIFY DEVICE data as read from the device
+ * options: Reference to the check options
+ * state: Reference to the device state, updated with the check time
+ * result: Reference to the check result to accumulate into
+ */
+bool check_temperature_history(int fd, const uint16_t* identify, const CheckOptions& options,
+                               StateFile& state, CheckResult& result) {
+
+  if(!options.temperature_history || !ata_sct_data_tables_supported(identify))
+    return true;
+
+  sct_temperature_history history;
+  SgioResult sgio_result = sct_read_temperature_history(fd, history);
+  if(!sgio_result.ok())
+    return command_failed(result, "SCT temperature history", sgio_result);
+
+  // Cover the time since the last check, rounding up so the sample which
+  // straddles it is included, or the whole table on the first check
+  time_t now = time(0);
+  int samples = SCT_TEMPERATURE_SAMPLES;
+
+  uint64_t last;
+  if(state.get("sct_temperature_time", last) && static_cast<uint64_t>(now) >= last) {
+    int interval = max<int>(StorageEndian::swap(history.interval), 1) * 60;
+    samples = min<uint64_t>((now - last + interval - 1) / interval + 1, SCT_TEMPERATURE_SAMPLES);
+  }
+
+  state.set("sct_temperature_time", now);
+
+  int low, high;
+  int valid = sct_temperature_range(history, samples, low, high);
+  if(!valid)
+    return true;
+
+  int current, unused;
+  sct_temperature_range(history, 1, current, unused);
+
+  // Going beyond the device's recommended operating range is worth a look
+  int8_t limit = StorageEndian::swap(history.max_op_limit);
+  if(limit != SCT_TEMPERATURE_INVALID && limit > 0 && high > limit)
+    result.code = max(result.code, NAGIOS_WARNING);
+
+  check_metric(options, result, "sct_temperature", current);
+  check_metric(options, result, "sct_temperature_min", low);
+  check_metric(options, result, "sct_temperature_max", high);
+  check_metric(options, result, "sct_temperature_samples", valid);
+
+  return true;
+
+}
+
+/*
+ * Function: check_device_statistics
+ * ---------------------------------
+ * Reports selected Device Statistics, returns false if the log could not
+ * be read.  Only pages both selected and supported are fetched, with each
+ * run of consecutive pages read in a single command.
+ * fd: File descriptor pointing at a SCSI or SCSI generic device node
+ * identify: IDENTIFY DEVICE data as read from the device
+ * gpl_directory: Reference to the General Purpose Log directory
+ * options: Reference to the check options holding selected pages
+ * result: Reference to the check result to accumulate into
+ */
+bool check_device_statistics(int fd, const uint16_t* identify, const smart_log_directory& gpl_directory,
+                             const CheckOptions& options, CheckResult& result) {
+
+  uint16_t log_pages = StorageEndian::swap(gpl_directory.data_blocks[ATA_LOG_ADDRESS_DEVSTAT]);
+  if(options.devstat_pages.empty() || !log_pages)
+    return true;
+
+  // Page zero lists the pages the device implements
+  vector<unsigned char> buf(log_pages * SECTOR_SIZE);
+  SgioResult sgio_result = ata_read_gpl(fd, identify, &buf[0], ATA_LOG_ADDRESS_DEVSTAT, DEVSTAT_PAGE_SUPPORTED, 1);
+  if(!sgio_result.ok())
+    return command_failed(result, "READ LOG EXT device statistics", sgio_result);
+
+  vector<uint8_t> pages;
+  int count = min(static_cast<int>(buf[DEVSTAT_SUPPORTED_COUNT]), static_cast<int>(SECTOR_SIZE) - DEVSTAT_SUPPORTED_COUNT - 1);
+  for(int i=0; i<count; i++) {
+    uint8_t page = buf[DEVSTAT_SUPPORTED_COUNT + 1 + i];
+    if(page && page < log_pages && find(options.devstat_pages.begin(), options.devstat_pages.end(), page) != options.devstat_pages.end())
+      pages.push_back(page);
+  }
+
+  sort(pages.begin(), pages.end());
+  pages.erase(unique(pages.begin(), pages.end()), pages.end());
+
+  // Coalesce consecutive pages into multi-sector reads
+  for(size_t i=0; i<pages.size(); ) {
+
+    size_t j = i + 1;
+    while(j < pages.size() && pages[j] == pages[j - 1] + 1)
+      j++;
+
+    sgio_result = ata_read_gpl(fd, identify, &buf[pages[i] * SECTOR_SIZE], ATA_LOG_ADDRESS_DEVSTAT, pages[i], j - i);
+    if(!sgio_result.ok())
+      return command_failed(result, "READ LOG EXT device statistics", sgio_result);
+
+    i = j;
+
+  }
+
+  for(int i=0; i<devstat_descriptor_num; i++) {
+
+    const devstat_descriptor& descriptor = devstat_descriptors[i];
+    if(!binary_search(pages.begin(), pages.end(), descriptor.page))
+      continue;
+
+    // Each page repeats its page number in the header, skip any the device got wrong
+    const unsigned char* page = &buf[descriptor.page * SECTOR_SIZE];
+    if(page[2] != descriptor.page)
+      continue;
+
+    int64_t value;
+    if(devstat_value(page, descriptor, value))
+      check_metric(options, result, string("devstat_") + descriptor.name, value);
+
+  }
+
+  return true;
+
+}
+
+/*
+ * Function: check_phy_events
+ * --------------------------
+ * Reports SATA Phy Event Counters, returns false if the log could not be
+ * read.  Counters may optionally be reset as they are read so each check
+ * reports the events since the last.
+ * fd: File descriptor pointing at a SCSI or SCSI generic device node
+ * identify: IDENTIFY DEVICE data as read from the device
+ * gpl_directory: Reference to the General Purpose Log directory
+ * options: Reference to the check options
+ * result: Reference to the check result to accumulate into
+ */
+bool check_phy_events(int fd, const uint16_t* identify, const smart_log_directory& gpl_directory,
+                      const CheckOptions& options, CheckResult& result) {
+
+  if(!options.phy_events || !StorageEndian::swap(gpl_directory.data_blocks[ATA_LOG_ADDRESS_SATA_PHY]))
+    return true;
+
+  unsigned char page[SECTOR_SIZE];
+  uint16_t features = options.phy_reset ? PHY_EVENT_FEATURE_RESET : 0;
+
+  // Re-reading after a reset would only return the events since, so a
+  // corrupt page is fatal in that mode
+  if(!read_validated([&]() { return ata_read_gpl(fd, identify, page, ATA_LOG_ADDRESS_SATA_PHY, 0, 1, features); },
+                     "READ LOG EXT SATA phy event counters", page, 1, result, options.phy_reset ? 0 : ATA_CHECKSUM_RETRIES))
+    return false;
+
+  int offset = PHY_EVENT_FIRST;
+  phy_event event;
+
+  while(phy_event_next(page, offset, event)) {
+
+    const char* name = phy_event_name(event.id);
+    if(event.vendor || !name)
+      continue;
+
+    check_metric(options, result, name, event.value);
+
+  }
+
+  return true;
+
+}
+
+/*
+ * Function: power_on_hours
+ * ------------------------
+ * Reads the power on hours attribute, returning false if the device lacks one
+ * sd: Reference to the SMART data page
+ * hours: Reference to receive the power on hours
+ */
+bool power_on_hours(const smart_data& sd, uint64_t& hours) {
+
+  for(int i=0; i<SMART_ATTRIBUTE_NUM; i++) {
+    SmartAttribute attribute(sd.attributes[i]);
+    if(attribute.getID() == 9) {
+      hours = attribute.getRaw();
+      return true;
+    }
+  }
+
+  return false;
+
+}
+
+/*
+ * Function: in_self_test_window
+ * -----------------------------
+ * Checks whether the local time falls within the self-test window, which
+ * may span midnight.  No window means any time will do.
+ * options: Reference to the check options holding the window
+ */
+bool in_self_test_window(const CheckOptions& options) {
+
+  if(options.self_test_window_start < 0)
+    return true;
+
+  time_t now = time(0);
+  struct tm local;
+  localtime_r(&now, &local);
+
+  int minute = local.tm_hour * 60 + local.tm_min;
+  int start = options.self_test_window_start;
+  int end = options.self_test_window_end;
+
+  if(start <= end)
+    return minute >= start && minute < end;
+
+  return minute >= start || minute < end;
+
+}
+
+/*
+ * Function: check_self_test
+ * -------------------------
+ * Reports the outcome of the most recent self-test and the hours since an
+ * extended self-test last passed, optionally starting a new self-test if
+ * none has run recently enough and we are in the allowed window.  Returns
+ * false if the log could not be read or the test failed to start.
+ * fd: File descriptor pointing at a SCSI or SCSI generic device node
+ * identify: IDENTIFY DEVICE data as read from the device
+ * gpl_directory: Reference to the General Purpose Log directory
+ * sd: Reference to the SMART data page
+ * options: Reference to the check options
+ * result: Reference to the check result to accumulate into
+ */
+bool check_self_test(int fd, const uint16_t* identify, const smart_log_directory& gpl_directory,
+                     const smart_data& sd, const CheckOptions& options, CheckResult& result) {
+
+  if(!options.self_test_log && !options.self_test)
+    return true;
+
+  // Offline data collection capability bit 4 indicates self-test support
+  if(!(StorageEndian::swap(sd.offline_collection_capability) & 0x10)) {
+    result.self_test = "unsupported";
+    return true;
+  }
+
+  // Prefer the extended log which holds more history and 48-bit LBAs
+  vector<smart_self_test_result> tests;
+
+  uint16_t ext_pages = StorageEndian::swap(gpl_directory.data_blocks[ATA_LOG_ADDRESS_EXT_SELF_TEST]);
+  if(ext_pages) {
+
+    vector<smart_ext_self_test_log> pages(ext_pages);
+    unsigned char* buf = reinterpret_cast<unsigned char*>(&pages[0]);
+
+    if(!read_validated([&]() { return ata_read_gpl(fd, identify, buf, ATA_LOG_ADDRESS_EXT_SELF_TEST, 0, ext_pages); },
+                       "READ LOG EXT extended self-test", buf, ext_pages, result))
+      return false;
+
+    tests.resize(ext_pages * SMART_EXT_SELF_TEST_LOG_DESCRIPTORS);
+    tests.resize(smart_ext_self_test_results(&pages[0], ext_pages, &tests[0]));
+
+  } else {
+
+    smart_self_test_log log;
+    unsigned char* buf = reinterpret_cast<unsigned char*>(&log);
+
+    if(!read_validated([&]() { return ata_smart_read_log(fd, buf, ATA_LOG_ADDRESS_SELF_TEST, 1); },
+                       "SMART READ LOG self-test", buf, 1, result))
+      return false;
+
+    tests.resize(SMART_SELF_TEST_LOG_DESCRIPTORS);
+    tests.resize(smart_self_test_results(log, &tests[0]));
+
+  }
+
+  // Test ages are measured in power on hours, without them neither the
+  // coverage metric nor the schedule can be trusted
+  uint64_t hours = 0;
+  bool have_hours = power_on_hours(sd, hours);
+  uint8_t execution = StorageEndian::swap(sd.self_test_execution_status);
+
+  // Report the most recent result, or progress of a running test
+  if(execution >> 4 == SMART_SELF_TEST_STATUS_IN_PROGRESS) {
+    result.self_test = "in progress";
+    check_metric(options, result, "self_test_remaining", (execution & 0x0f) * 10);
+  } else if(tests.empty()) {
+    result.self_test = "none";
+  } else {
+    uint8_t status = tests[0].status >> 4;
+    if(status == SMART_SELF_TEST_STATUS_COMPLETED) {
+      result.self_test = "passed";
+    } else if(status == SMART_SELF_TEST_STATUS_ABORTED || status == SMART_SELF_TEST_STATUS_INTERRUPTED) {
+      result.self_test = "aborted";
+    } else if(status >= SMART_SELF_TEST_STATUS_FATAL && status <= SMART_SELF_TEST_STATUS_DAMAGE) {
+      result.self_test = "failed";
+      result.code = max(result.code, NAGIOS_CRITICAL);
+    } else {
+      result.self_test = "unknown";
+    }
+    check_metric(options, result, "self_test_status", status);
+  }
+
+  // Timestamps are the low 16 bits of the power on hours
+  for(size_t i=0; have_hours && i<tests.size(); i++) {
+    if((tests[i].type & ~SMART_SELF_TEST_CAPTIVE) == SMART_SELF_TEST_EXTENDED &&
+       tests[i].status >> 4 == SMART_SELF_TEST_STATUS_COMPLETED) {
+      check_metric(options, result, "hours_since_extended_self_test", static_cast<uint16_t>(hours - tests[i].timestamp));
+      break;
+    }
+  }
+
+  // Start a new test if the last of that type is old enough
+  if(!options.self_test || execution >> 4 == SMART_SELF_TEST_STATUS_IN_PROGRESS || !in_self_test_window(options))
+    return true;
+
+  if(!have_hours) {
+    result.self_test += ", not scheduled without power on hours";
+    return true;
+  }
+
+  int interval = options.self_test_interval;
+  if(!interval)
+    interval = options.self_test == SMART_SELF_TEST_EXTENDED ? 168 : 24;
+
+  // Aborted or interrupted tests don't count, they covered nothing
+  for(size_t i=0; i<tests.size(); i++) {
+    if((tests[i].type & ~SMART_SELF_TEST_CAPTIVE) == options.self_test &&
+       tests[i].status >> 4 == SMART_SELF_TEST_STATUS_COMPLETED &&
+       static_cast<uint16_t>(hours - tests[i].timestamp) < interval)
+      return true;
+  }
+
+  SgioResult sgio_result = ata_smart_execute_off_line_immediate(fd, options.self_test);
+  if(!sgio_result.ok())
+    return command_failed(result, "SMART EXECUTE OFF-LINE IMMEDIATE", sgio_result);
+
+  result.self_test += options.self_test == SMART_SELF_TEST_EXTENDED ? ", started extended" : ", started short";
+
+  return true;
+
+}
+
+/*
+ * Function: check_nvme
+ * --------------------
+ * Checks an NVMe controller's SMART / Health Information log.  Any critical
+ * warning is CRITICAL, and the controller's own temperature thresholds are
+ * applied unless the user gave their own.  Returns false if the log could
+ * not be read.
+ * fd: File descriptor pointing at an NVMe controller or namespace node
+ * id: Reference to the Identify Controller data
+ * options: Reference to the check options holding named thresholds
+ * result: Reference to the check result to accumulate into
+ */
+bool check_nvme(int fd, const nvme_id_ctrl& id, const CheckOptions& options, CheckResult& result) {
+
+  nvme_smart_log log;
+  NvmeResult nvme_result = nvme_get_log_page(fd, NVME_LOG_SMART, NVME_NSID_ALL, reinterpret_cast<unsigned char*>(&log),
+                                             sizeof(nvme_smart_log));
+  if(!nvme_result.ok()) {
+    stringstream error;
+    error << "Get Log Page SMART / Health Information failed: " << nvme_result;
+    result.error = error.str();
+    return false;
+  }
+
+  // Temperatures are reported in Kelvin, zero thresholds are unimplemented
+  CheckOptions nvme_options = options;
+  int wctemp, cctemp;
+  if(nvme_temperature(StorageEndian::swap(id.wctemp), wctemp) && wctemp > 0 &&
+     !nvme_options.warning_named.count("nvme_temperature"))
+    nvme_options.warning_named["nvme_temperature"] = wctemp;
+  if(nvme_temperature(StorageEndian::swap(id.cctemp), cctemp) && cctemp > 0 &&
+     !nvme_options.critical_named.count("nvme_temperature"))
+    nvme_options.critical_named["nvme_temperature"] = cctemp;
+
+  // Spare is only worrying once it drops below the controller's own threshold
+  uint8_t spare_threshold = StorageEndian::swap(log.available_spare_threshold);
+  if(spare_threshold && !nvme_options.critical_named.count("nvme_available_spare"))
+    nvme_options.critical_named["nvme_available_spare"] = spare_threshold;
+
+  // Media, reliability and read only warnings predict failure, temperature
+  // is a threshold the controller has seen exceeded
+  uint8_t critical_warning = StorageEndian::swap(log.critical_warning);
+  if(critical_warning & NVME_CRITICAL_WARNING_PREDICTIVE)
+    result.prdfail++;
+  if(critical_warning & NVME_CRITICAL_WARNING_TEMPERATURE)
+    result.crit++;
+  if(critical_warning)
+    result.code = max(result.code, NAGIOS_CRITICAL);
+
+  check_metric(nvme_options, result, "nvme_critical_warning", critical_warning);
+
+  int temperature;
+  if(nvme_temperature(StorageEndian::swap(log.temperature), temperature))
+    check_metric(nvme_options, result, "nvme_temperature", temperature);
+
+  check_floor(nvme_options, result, "nvme_available_spare", StorageEndian::swap(log.available_spare));
+  check_metric(nvme_options, result, "nvme_percentage_used", StorageEndian::swap(log.percentage_used));
+  check_metric(nvme_options, result, "nvme_media_errors", nvme_counter(log.media_errors));
+  track_counter(result, "nvme_media_errors", nvme_counter(log.media_errors));
+  result.error_count = nvme_counter(log.error_log_entries);
+  check_metric(nvme_options, result, "nvme_error_log_entries", nvme_counter(log.error_log_entries));
+  check_metric(nvme_options, result, "nvme_unsafe_shutdowns", nvme_counter(log.unsafe_shutdowns));
+  check_metric(nvme_options, result, "nvme_power_on_hours", nvme_counter(log.power_on_hours));
+  check_metric(nvme_options, result, "nvme_data_units_read", nvme_counter(log.data_units_read));
+  check_metric(nvme_options, result, "nvme_data_units_written", nvme_counter(log.data_units_written));
+
+  return true;
+
+}
+
+/*
+ * Function: read_log_page
+ * -----------------------
+ * Reads a SCSI log page with exactly the allocation length it needs, the
+ * header is read first to learn the length so nothing is over-transferred
+ * fd: File descriptor pointing at a SCSI or SCSI generic device node
+ * page: Log page code
+ * buf: Reference to receive the page, header included
+ * result: Reference to the check result to accumulate into
+ */
+bool read_log_page(int fd, uint8_t page, vector<unsigned char>& buf, CheckResult& result) {
+
+  unsigned char header[LOG_PAGE_HEADER];
+  SgioResult sgio_result = scsi_log_sense(fd, page, header, LOG_PAGE_HEADER);
+  if(!sgio_result.ok())
+    return command_failed(result, "LOG SENSE", sgio_result);
+
+  int length = min(log_page_length(header), 0xffff);
+
+  buf.resize(length);
+  sgio_result = scsi_log_sense(fd, page, &buf[0], length);
+  if(!sgio_result.ok())
+    return command_failed(result, "LOG SENSE", sgio_result);
+
+  // Counters may have been added between the two reads, only trust what fits
+  buf.resize(min(length, log_page_length(&buf[0])));
+
+  if((buf[0] & LOG_PAGE_CODE_MASK) != page) {
+    result.error = "LOG SENSE failed: device returned the wrong page";
+    return false;
+  }
+
+  return true;
+
+}
+
+/*
+ * Struct: scsi_error_page
+ * -----------------------
+ * Error counter log page and the prefix its counters are reported under
+ */
+struct scsi_error_page {
+  uint8_t     page;
+  const char* name;
+};
+
+const scsi_error_page scsi_error_pages[] = {
+  { LOG_PAGE_READ_ERRORS,   "scsi_read"   },
+  { LOG_PAGE_WRITE_ERRORS,  "scsi_write"  },
+  { LOG_PAGE_VERIFY_ERRORS, "scsi_verify" },
+};
+
+/*
+ * Function: check_scsi
+ * --------------------
+ * Checks a native SCSI device, typically SAS, via LOG SENSE.  Only pages
+ * listed in the supported pages page are read.  An informational exception
+ * is a predicted failure, and exceeding the specified start-stop or
+ * load-unload cycles is advisory.  Returns false if a page could not be
+ * read.
+ * fd: File descriptor pointing at a SCSI or SCSI generic device node
+ * supported: Reference to the supported pages log page
+ * options: Reference to the check options holding named thresholds
+ * result: Reference to the check result to accumulate into
+ */
+bool check_scsi(int fd, const vector<unsigned char>& supported, const CheckOptions& options, CheckResult& result) {
+
+  set<uint8_t> pages;
+  for(size_t i=LOG_PAGE_HEADER; i<supported.size(); i++)
+    pages.insert(supported[i] & LOG_PAGE_CODE_MASK);
+
+  vector<unsigned char> buf;
+  log_parameter parameter;
+  int offset;
+
+  // Informational exceptions report a failure prediction as an ASC
+  if(pages.count(LOG_PAGE_INFORMATIONAL_EXCEPTIONS)) {
+
+    if(!read_log_page(fd, LOG_PAGE_INFORMATIONAL_EXCEPTIONS, buf, result))
+      return false;
+
+    offset = LOG_PAGE_HEADER;
+    while(log_parameter_next(&buf[0], buf.size(), offset, parameter)) {
+      if(parameter.code != LOG_IE_GENERAL || parameter.length < 2)
+        continue;
+      if(parameter.raw[0]) {
+        result.prdfail++;
+        result.code = max(result.code, NAGIOS_CRITICAL);
+      }
+      check_metric(options, result, "scsi_ie_asc", parameter.raw[0]);
+      check_metric(options, result, "scsi_ie_ascq", parameter.raw[1]);
+    }
+
+  }
+
+  // The reference temperature is the device's own maximum, applied unless
+  // the user gave a threshold
+  if(pages.count(LOG_PAGE_TEMPERATURE)) {
+
+    if(!read_log_page(fd, LOG_PAGE_TEMPERATURE, buf, result))
+      return false;
+
+    int current = -1, reference = -1;
+
+    offset = LOG_PAGE_HEADER;
+    while(log_parameter_next(&buf[0], buf.size(), offset, parameter)) {
+      if(parameter.length < 2 || parameter.raw[1] == LOG_TEMPERATURE_INVALID)
+        continue;
+      if(parameter.code == LOG_TEMPERATURE_CURRENT)
+        current = parameter.raw[1];
+      else if(parameter.code == LOG_TEMPERATURE_REFERENCE)
+        reference = parameter.raw[1];
+    }
+
+    if(current >= 0) {
+      CheckOptions temperature_options = options;
+      if(reference > 0 && !temperature_options.critical_named.count("scsi_temperature"))
+        temperature_options.critical_named["scsi_temperature"] = reference;
+      check_metric(temperature_options, result, "scsi_temperature", current);
+    }
+
+  }
+
+  for(size_t i=0; i<sizeof(scsi_error_pages) / sizeof(scsi_error_page); i++) {
+
+    const scsi_error_page& error_page = scsi_error_pages[i];
+    if(!pages.count(error_page.page))
+      continue;
+
+    if(!read_log_page(fd, error_page.page, buf, result))
+      return false;
+
+    offset = LOG_PAGE_HEADER;
+    while(log_parameter_next(&buf[0], buf.size(), offset, parameter)) {
+      if(parameter.code == LOG_ERRORS_CORRECTED)
+        check_metric(options, result, string(error_page.name) + "_corrected", parameter.value);
+      else if(parameter.code == LOG_ERRORS_UNCORRECTED) {
+        check_metric(options, result, string(error_page.name) + "_uncorrected", parameter.value);
+        track_counter(result, string(error_page.name) + "_uncorrected", parameter.value);
+      }
+      else if(parameter.code == LOG_ERRORS_PROCESSED)
+        check_metric(options, result, string(error_page.name) + "_gigabytes", parameter.value / 1000000000);
+    }
+
+  }
+
+  if(pages.count(LOG_PAGE_NON_MEDIUM_ERRORS)) {
+
+    if(!read_log_page(fd, LOG_PAGE_NON_MEDIUM_ERRORS, buf, result))
+      return false;
+
+    offset = LOG_PAGE_HEADER;
+    while(log_parameter_next(&buf[0], buf.size(), offset, parameter))
+      if(!parameter.code) {
+        check_metric(options, result, "scsi_non_medium_errors", parameter.value);
+        track_counter(result, "scsi_non_medium_errors", parameter.value);
+      }
+
+  }
+
+  if(pages.count(LOG_PAGE_START_STOP)) {
+
+    if(!read_log_page(fd, LOG_PAGE_START_STOP, buf, result))
+      return false;
+
+    map<uint16_t, uint64_t> cycles;
+
+    offset = LOG_PAGE_HEADER;
+    while(log_parameter_next(&buf[0], buf.size(), offset, parameter))
+      cycles[parameter.code] = parameter.value;
+
+    // Running beyond the specified lifetime is advisory, as with ATA
+    // attributes which aren't pre-failure
+    if(cycles.count(LOG_START_STOP_ACCUMULATED)) {
+      uint64_t specified = cycles[LOG_START_STOP_SPECIFIED];
+      if(specified && cycles[LOG_START_STOP_ACCUMULATED] >= specified)
+        result.advisory++;
+      check_metric(options, result, "scsi_start_stop_cycles", cycles[LOG_START_STOP_ACCUMULATED]);
+    }
+
+    if(cycles.count(LOG_LOAD_UNLOAD_ACCUMULATED)) {
+      uint64_t specified = cycles[LOG_LOAD_UNLOAD_SPECIFIED];
+      if(specified && cycles[LOG_LOAD_UNLOAD_ACCUMULATED] >= specified)
+        result.advisory++;
+      check_metric(options, result, "scsi_load_unload_cycles", cycles[LOG_LOAD_UNLOAD_ACCUMULATED]);
+    }
+
+    if(result.advisory)
+      result.code = max(result.code, NAGIOS_WARNING);
+
+  }
+
+  return true;
+
+}
+
+/*
+ * Function: print_result
+ * ----------------------
+ * Prints the status line and performance data for devices checked without
+ * SMART attributes, returning the Nagios code
+ * result: Reference to the check result
+ * out: Stream to receive the status
+ * perf: Stream to receive the performance data
+ */
+int print_result(const CheckResult& result, ostream& out, ostream& perf) {
+
+  const char* status[] = { "OK", "WARNING", "CRITICAL" };
+  out << status[result.code]
+      << ": prdfail " << result.prdfail
+      << ", advisory " << result.advisory
+      << ", critical " << result.crit
+      << ", warning " << result.warn;
+
+  perf << result.perfdata.str();
+
+  return result.code;
+
+}
+
+/*
+ * Function: report_health
+ * -----------------------
+ * Summarizes a completed check for the daemon's scheduler, returning the
+ * Nagios code
+ * result: Reference to the check result
+ * health: Pointer to receive the summary, or null if not wanted
+ */
+int report_health(const CheckResult& result, device_health* health) {
+
+  if(health) {
+    health->valid = true;
+    health->degraded = result.code != NAGIOS_OK;
+    health->counters = state_hash(result.counters);
+    health->errors = result.error_count;
+    health->margin = result.margin;
+    health->key = result.key;
+    health->values = result.values;
+
+    shm_report& report = health->report;
+    shm_copy(report.key, sizeof(report.key), result.key);
+    shm_copy(report.identity, sizeof(report.identity), result.identity);
+    report.attributes_num = min<size_t>(result.attributes.size(), SMART_ATTRIBUTE_NUM);
+    copy(result.attributes.begin(), result.attributes.begin() + report.attributes_num, report.attributes);
+  }
+
+  return result.code;
+
+}
+
+/*
+ * Function: open_device
+ * ---------------------
+ * Opens a device node, or for megaraid,N:VOLUME returns a handle on
+ * physical drive N behind the controller exporting VOLUME.  Returns -1
+ * with errno set on failure.
+ * device: Device as given on the command line
+ */
+int open_device(const string& device) {
+
+  const string megaraid = "megaraid,";
+  if(device.compare(0, megaraid.size(), megaraid))
+    return open(device.c_str(), O_RDWR);
+
+  string::size_type colon = device.find(':');
+  if(colon == string::npos || colon == megaraid.size()) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  char* p;
+  string drive = device.substr(megaraid.size(), colon - megaraid.size());
+  long id = strtol(drive.c_str(), &p, 10);
+  if(*p) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  return megaraid_open(device.substr(colon + 1).c_str(), id);
+
+}
+
+/*
+ * Function: close_device
+ * ----------------------
+ * Closes a descriptor returned by open_device, controller handles are
+ * shared so stay open until the process exits
+ * fd: Descriptor to close
+ */
+void close_device(int fd) {
+
+  // A descriptor reused for another device starts from the default form
+  ata_set_sat_variant(fd, SAT_VARIANT_DEFAULT);
+
+  if(!sgio_handle(fd))
+    close(fd);
+
+}
+
+/*
+ * Function: device_label
+ * ----------------------
+ * Returns a performance data label prefix identifying a device when
+ * several are checked at once e.g. megaraid,3:/dev/sda becomes megaraid_3_sda_
+ * device: Device as given on the command line
+ */
+string device_label(const string& device) {
+
+  string path = device;
+
+  string::size_type dev;
+  while((dev = path.find("/dev/")) != string::npos)
+    path.erase(dev, 5);
+
+  // Runs of punctuation collapse to a single separator
+  string label;
+  for(string::iterator i = path.begin(); i != path.end(); i++) {
+    if(isalnum(*i))
+      label += *i;
+    else if(!label.empty() && label[label.size() - 1] != '_')
+      label += '_';
+  }
+
+  if(label.empty() || label[label.size() - 1] != '_')
+    label += '_';
+
+  return label;
+
+}
+
+/**
+ * Function: parse_thresholds
+ * --------------------------
+ * Parses an input string and returns a map of attribute IDs to raw value thresholds
+ * and a map of named statistics to thresholds
+ * thresholds: map of attribute IDs to threshold values
+ * named: map of statistic labels to threshold values
+ * in: input string in the form "k1:v1,k2:v2,..."
+ */
+bool parse_thresholds(SmartThresholdMap& thresholds, NamedThresholdMap& named, const string in) {
+
+  istringstream in_stream(in);
+  vector<string> tokens;
+  string token1, token2;
+
+  // Split the input into key value pairs
+  vector<string> key_value_pairs;
+  while(getline(in_stream, token1, ',')) {
+    tokens.push_back(token1);
+  }
+
+  // Split each key value pair
+  for(vector<string>::iterator i = tokens.begin(); i != tokens.end(); i++) {
+
+    istringstream tok_stream(*i);
+
+    // Read the first token delimited by =
+    getline(tok_stream, token1, ':');
+    if(!tok_stream.good()) {
+      return false;
+    }
+
+    // Read the second token, which shoud result in EOF
+    getline(tok_stream, token2);
+    if(!tok_stream.eof()) {
+      return false;
+    }
+
+    // Parse the tokens and ensure they are integers
+    char* p1;
+    char* p2;
+
+    unsigned long k = strtol(token1.c_str(), &p1, 10);
+    long v = strtol(token2.c_str(), &p2, 10);
+
+    if(token1.empty() || *p2) {
+      return false;
+    }
+
+    // Anything that isn't an attribute ID is a named statistic
+    if(*p1)
+      named[token1] = v;
+    else
+      thresholds[k] = v;
+
+  }
+
+  return true;
+}
+
+/**
+ * Function: parse_pages
+ * ---------------------
+ * Parses an input string into a list of log page numbers
+ * pages: list of page numbers
+ * in: input string in the form "p1,p2,..."
+ */
+bool parse_pages(vector<uint8_t>& pages, const string in) {
+
+  istringstream in_stream(in);
+  string token;
+
+  while(getline(in_stream, token, ',')) {
+
+    char* p;
+    unsigned long page = strtoul(token.c_str(), &p, 10);
+
+    if(token.empty() || *p || !page || page > 0xff) {
+      return false;
+    }
+
+    pages.push_back(page);
+
+  }
+
+  return true;
+
+}
+
+/**
+ * Function: parse_window
+ * ----------------------
+ * Parses a time window into minutes past midnight
+ * start: Reference to receive the start of the window
+ * end: Reference to receive the end of the window
+ * in: input string in the form "HH:MM-HH:MM"
+ */
+bool parse_window(int& start, int& end, const string in) {
+
+  unsigned int start_hour, start_minute, end_hour, end_minute;
+  char trailing;
+
+  if(sscanf(in.c_str(), "%u:%u-%u:%u%c", &start_hour, &start_minute, &end_hour, &end_minute, &trailing) != 4)
+    return false;
+
+  if(start_hour > 23 || end_hour > 23 || start_minute > 59 || end_minute > 59)
+    return false;
+
+  start = start_hour * 60 + start_minute;
+  end = end_hour * 60 + end_minute;
+
+  return true;
+
+}
+
+/*
+ * Function: check_open_device
+ * ---------------------------
+ * Checks a single device that is already open, writing its status and
+ * performance data to the given streams and returning the Nagios code
+ * fd: Descriptor returned by open_device
+ * device: Device as given on the command line or found in sysfs
+ * options: Reference to the check options
+ * prefix: Prepended to performance data labels
+ * out: Stream to receive the status
+ * perf: Stream to receive the performance data
+ * health: Pointer to receive what the daemon schedules by, or null
+ */
+int check_open_device(int fd, const sg_device& device, const CheckOptions& options, const string& prefix,
+                      ostream& out, ostream& perf, device_health* health) {
+
+  CheckResult result;
+  result.prefix = prefix;
+
+  int sg_version;
+  if(!sgio_handle(fd) && ((ioctl(fd, SG_GET_VERSION_NUM, &sg_version) == -1) || sg_version < 30000)) {
+
+    // NVMe devices are checked natively rather than through a SAT
+    nvme_id_ctrl id;
+    NvmeResult nvme_result = nvme_identify_controller(fd, id);
+    if(nvme_result.getError()) {
+      out << "UNKNOWN: " << device.node << " is either not an sg or NVMe device, or the driver is old";
+      return NAGIOS_UNKNOWN;
+    }
+
+    if(!nvme_result.ok()) {
+      out << "UNKNOWN: Identify Controller failed: " << nvme_result;
+      return NAGIOS_UNKNOWN;
+    }
+
+    if(!check_nvme(fd, id, options, result)) {
+      out << "UNKNOWN: " << result.error;
+      return NAGIOS_UNKNOWN;
+    }
+
+    print_result(result, out, perf);
+    return report_health(result, health);
+
+  }
+
+  // Check the device can use SMART and that it is enabled
+  uint16_t identify[SECTOR_SIZE / 2];
+  SgioResult sgio_result;
+  bool ata = false;
+
+  // Native SCSI disks found in sysfs are known to reject ATA PASS-THROUGH
+  if(device.device_class != DEVICE_CLASS_SAS)
+    ata = identify_device(fd, identify, options.state_dir, sgio_result);
+
+  if(sgio_result.getError()) {
+    out << "UNKNOWN: IDENTIFY DEVICE failed: " << sgio_result;
+    return NAGIOS_UNKNOWN;
+  }
+
+  // Native SCSI devices fall back to their log pages
+  if(!ata) {
+
+    vector<unsigned char> supported;
+    if(!read_log_page(fd, LOG_PAGE_SUPPORTED, supported, result)) {
+      out << "OK: ATA command set unsupported";
+      return NAGIOS_OK;
+    }
+
+    if(!check_scsi(fd, supported, options, result)) {
+      out << "UNKNOWN: " << result.error;
+      return NAGIOS_UNKNOWN;
+    }
+
+    print_result(result, out, perf);
+    return report_health(result, health);
+
+  }
+
+  if(~StorageEndian::swap(identify[82]) & 0x01) {
+    out << "OK: SMART feature set unsupported";
+    return NAGIOS_OK;
+  }
+
+  if(~StorageEndian::swap(identify[85]) & 0x01) {
+    out << "UNKNOWN: SMART feature set disabled";
+    return NAGIOS_UNKNOWN;
+  }
+
+  // State is keyed by the drive's identity rather than its node, which
+  // renumbers across reboots and hotplug, so each check only reports what
+  // is new
+  AtaIdentity identity(identify);
+  string key = identity.key();
+  result.key = key;
+  if(key.empty())
+    key = device.node;
+
+  string path = state_path(options.state_dir, key);
+  StateFile state(path);
+  if(options.stateful() && !state.load()) {
+    out << "UNKNOWN: unable to read state file " << path;
+    return NAGIOS_UNKNOWN;
+  }
+
+  // State left by another drive would hide this one's errors
+  uint64_t hash = state_hash(identity.getModel() + "/" + identity.getSerial());
+  uint64_t saved;
+  if(state.get(STATE_IDENTITY, saved) && saved != hash)
+    state.clear();
+  state.set(STATE_IDENTITY, hash);
+
+  // General Purpose Logs are only read if the device supports them and the
+  // user asked for something that lives in one
+  smart_log_directory gpl_directory;
+  memset(&gpl_directory, 0, sizeof(smart_log_directory));
+
+  if(ata_gpl_supported(identify) && options.gpl()) {
+    sgio_result = ata_read_gpl(fd, identify, reinterpret_cast<unsigned char*>(&gpl_directory), ATA_LOG_ADDRESS_DIRECTORY, 0, 1);
+    if(!sgio_result.ok()) {
+      out << "UNKNOWN: READ LOG EXT directory failed: " << sgio_result;
+      return NAGIOS_UNKNOWN;
+    }
+  }
+
+  // Perform the checks, a failed command means the data cannot be trusted
+  smart_data sd;
+  smart_log_directory log_directory;
+  if(!check_smart_attributes(fd, options, sd, result) ||
+     !check_smart_log(fd, log_directory, result) ||
+     !check_device_statistics(fd, identify, gpl_directory, options, result) ||
+     !check_phy_events(fd, identify, gpl_directory, options, result) ||
+     !check_self_test(fd, identify, gpl_directory, sd, options, result) ||
+     !check_error_log(fd, identify, gpl_directory, log_directory, options, state, result) ||
+     !check_temperature_history(fd, identify, options, state, result)) {
+    out << "UNKNOWN: " << result.error;
+    // A page that never validated is the bad bridge case the counter exists for
+    perf << " " << prefix << "checksum_errors=" << result.checksum_errors << ";;;;";
+    if(health)
+      health->values.assign(1, metric{"checksum_errors", result.checksum_errors});
+    return NAGIOS_UNKNOWN;
+  }
+
+  // Without saved state the next check would report the same errors again
+  if(options.stateful() && !state.save()) {
+    out << "UNKNOWN: unable to write state file " << path;
+    return NAGIOS_UNKNOWN;
+  }
+
+  // Print out the results and performance data
+  const char* status[] = { "OK", "WARNING", "CRITICAL" };
+  out << status[result.code]
+      << ": prdfail " << result.prdfail
+      << ", advisory " << result.advisory
+      << ", critical " << result.crit
+      << ", warning " << result.warn
+      << ", logs " << result.logs;
+
+  if(!result.self_test.empty())
+    out << ", self-test " << result.self_test;
+
+  if(options.error_log)
+    out << ", new errors " << result.new_errors;
+
+  out << ", " << identity;
+
+  stringstream description;
+  description << identity;
+  result.identity = description.str();
+
+  perf << result.perfdata.str()
+       << " " << prefix << "checksum_errors=" << result.checksum_errors << ";;;;";
+  result.values.push_back(metric{"checksum_errors", result.checksum_errors});
+
+  return report_health(result, health);
+
+}
+
+/*
+ * Function: check_fingerprint
+ * ---------------------------
+ * Returns a digest of the options which change what a check reports, for
+ * naming the results checks with those options share
+ * options: Reference to the check options
+ */
+static string check_fingerprint(const CheckOptions& options) {
+
+  stringstream text;
+
+  const SmartThresholdMap* thresholds[] = { &options.warning_thresholds, &options.critical_thresholds };
+  for(int i=0; i<2; i++) {
+    for(SmartThresholdMap::const_iterator j = thresholds[i]->begin(); j != thresholds[i]->end(); j++)
+      text << static_cast<int>(j->first) << ":" << j->second << ",";
+    text << "/";
+  }
+
+  const NamedThresholdMap* named[] = { &options.warning_named, &options.critical_named };
+  for(int i=0; i<2; i++) {
+    for(NamedThresholdMap::const_iterator j = named[i]->begin(); j != named[i]->end(); j++)
+      text << j->first << ":" << j->second << ",";
+    text << "/";
+  }
+
+  for(vector<uint8_t>::const_iterator i = options.devstat_pages.begin(); i != options.devstat_pages.end(); i++)
+    text << static_cast<int>(*i) << ",";
+
+  text << "/" << options.phy_events << options.self_test_log << options.error_log << options.temperature_history
+       << "/" << static_cast<int>(options.self_test) << "," << options.self_test_window_start << ","
+       << options.self_test_window_end << "," << options.self_test_interval << "/" << options.state_dir;
+
+  stringstream digest;
+  digest << hex << setw(16) << setfill('0') << state_hash(text.str());
+
+  return digest.str();
+
+}
+
+/*
+ * Function: check_coalesced
+ * -------------------------
+ * Checks a single device that is already open as check_open_device does,
+ * unless a concurrent invocation checking it with the same options has a
+ * result fresh within options.coalesce, which is reused instead.  Only the
+ * result is shared, every read behind it was validated by the invocation
+ * which made it.
+ * fd: Descriptor returned by open_device
+ * device: Device as given on the command line or found in sysfs
+ * options: Reference to the check options
+ * dir: Directory holding the locks and recorded results
+ * prefix: Prepended to performance data labels
+ * out: Stream to receive the status
+ * perf: Stream to receive the performance data
+ * health: Pointer to receive what the check saw, or null.  A reused
+ *         result only carries the key and whether the check warned.
+ */
+int check_coalesced(int fd, const sg_device& device, const CheckOptions& options, const string& dir,
+                    const string& prefix, ostream& out, ostream& perf, device_health* health) {
+
+  SingleFlight flight;
+  if(!flight.begin(dir, flight_key(SYSFS_ROOT_DEFAULT, device.node)))
+    return check_open_device(fd, device, options, prefix, out, perf, health);
+
+  string fingerprint = check_fingerprint(options);
+
+  flight_result result;
+  if(flight.load(fingerprint, options.coalesce, result)) {
+    out << result.out;
+    perf << prefix_labels(result.perf, prefix);
+    if(health) {
+      health->valid = true;
+      health->degraded = result.code != NAGIOS_OK;
+      health->key = result.key;
+    }
+    return result.code;
+  }
+
+  // Labels are recorded unprefixed as other invocations may use another
+  device_health seen;
+  stringstream device_out, device_perf;
+  result.code = check_open_device(fd, device, options, "", device_out, device_perf, health ? health : &seen);
+  result.key = health ? health->key : seen.key;
+  result.out = device_out.str();
+  result.perf = device_perf.str();
+
+  // A check which couldn't complete is the next invocation's to retry
+  if(result.code != NAGIOS_UNKNOWN)
+    flight.save(fingerprint, result);
+
+  out << result.out;
+  perf << prefix_labels(result.perf, prefix);
+
+  return result.code;
+
+}
+
+/*
+ * Function: check_device
+ * ----------------------
+ * Opens and checks a single device, writing its status and performance
+ * data to the given streams and returning the Nagios code
+ * device: Device as given on the command line or found in sysfs
+ * options: Reference to the check options
+ * prefix: Prepended to performance data labels
+ * out: Stream to receive the status
+ * perf: Stream to receive the performance data
+ * health: Pointer to receive what the check saw, or null
+ */
+int check_device(const sg_device& device, const CheckOptions& options, const string& prefix, ostream& out,
+                 ostream& perf, device_health* health) {
+
+  int fd = open_device(device.node);
+  if(fd == -1) {
+    out << "UNKNOWN: unable to open device " << device.node << ": " << strerror(errno);
+    return NAGIOS_UNKNOWN;
+  }
+
+  // Resetting the phy counters as they are read must reach the drive
+  // every time
+  int code;
+  if(options.coalesce && !options.phy_reset)
+    code = check_coalesced(fd, device, options, FLIGHT_DIR_DEFAULT, prefix, out, perf, health);
+  else
+    code = check_open_device(fd, device, options, prefix, out, perf, health);
+
+  close_device(fd);
+
+  return code;
+
+}
+
+/*
+ * Function: prefix_labels
+ * -----------------------
+ * Returns performance data with a prefix added to each label, which all
+ * follow a space
+ * perfdata: Performance data with unprefixed labels
+ * prefix: Prefix to add
+ */
+string prefix_labels(const string& perfdata, const string& prefix) {
+
+  string prefixed = perfdata;
+  for(string::size_type i = 0; (i = prefixed.find(' ', i)) != string::npos; i += prefix.size() + 1)
+    prefixed.insert(i + 1, prefix);
+
+  return prefixed;
+
+}
+
+/*
+ * Function: read_published
+ * ------------------------
+ * Reports the result the daemon last published for a device instead of
+ * checking it, returning the Nagios code.  A result older than its next
+ * check plus a grace period is UNKNOWN as the daemon has stopped.
+ * reader: Reference to the open segment
+ * device: Device as given on the command line or found in sysfs
+ * prefix: Prepended to performance data labels
+ * out: Stream to receive the status
+ * perf: Stream to receive the performance data
+ */
+int read_published(const ShmReader& reader, const sg_device& device, const string& prefix, ostream& out,
+                   ostream& perf) {
+
+  // The plugin is given nodes, the daemon republishes whichever drive sits
+  // at each node on every check
+  shm_report report;
+  if(!reader.find_node(device.node, report)) {
+    if(errno == EAGAIN)
+      out << "UNKNOWN: result for " << device.node << " is mid update, the daemon may have died publishing it";
+    else
+      out << "UNKNOWN: no result published for " << device.node;
+    return NAGIOS_UNKNOWN;
+  }
+
+  time_t now = time(0);
+  if(now > static_cast<time_t>(report.due) + SHM_STALE_GRACE) {
+    out << "UNKNOWN: result for " << device.node << " is " << (now - report.checked) << " seconds old";
+    return NAGIOS_UNKNOWN;
+  }
+
+  out << report.status;
+
+  // Labels are published unprefixed
+  perf << prefix_labels(report.perfdata, prefix);
+
+  return report.code;
+
+}
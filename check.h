@@ -0,0 +1,246 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef _check_H_
+#define _check_H_
+
+#include <stdint.h>
+#include <time.h>
+
+#include "sgio.h"
+#include "state.h"
+#include "discover.h"
+#include "daemon.h"
+#include "shm.h"
+
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Nagios return codes
+const int NAGIOS_OK       = 0;
+const int NAGIOS_WARNING  = 1;
+const int NAGIOS_CRITICAL = 2;
+const int NAGIOS_UNKNOWN  = 3;
+
+// Mapping to hold attribute -> threshold data
+typedef map<uint8_t, uint64_t> SmartThresholdMap;
+
+// Mapping to hold named statistic -> threshold data
+typedef map<string, int64_t> NamedThresholdMap;
+
+/*
+ * Struct: CheckOptions
+ * --------------------
+ * Thresholds and optional checks selected on the command line
+ */
+struct CheckOptions {
+  SmartThresholdMap warning_thresholds;
+  SmartThresholdMap critical_thresholds;
+  NamedThresholdMap warning_named;
+  NamedThresholdMap critical_named;
+  vector<uint8_t> devstat_pages;
+  bool phy_events;
+  bool phy_reset;
+  bool self_test_log;
+  uint8_t self_test;
+  int self_test_window_start;
+  int self_test_window_end;
+  int self_test_interval;
+  bool error_log;
+  bool temperature_history;
+  string state_dir;
+  time_t coalesce;
+
+  CheckOptions()
+  : phy_events(false), phy_reset(false), self_test_log(false), self_test(0),
+    self_test_window_start(-1), self_test_window_end(-1), self_test_interval(0),
+    error_log(false), temperature_history(false), state_dir(STATE_DIR_DEFAULT), coalesce(0)
+  {}
+
+  // Whether any requested check lives in a General Purpose Log
+  bool gpl() const {
+    return !devstat_pages.empty() || phy_events || self_test_log || error_log;
+  }
+
+  // Whether any requested check depends on what the last check saw
+  bool stateful() const {
+    return error_log || temperature_history;
+  }
+};
+
+/*
+ * Function: identify_device
+ * -------------------------
+ * Reads IDENTIFY DEVICE data.  Direct access devices which reject the
+ * default ATA PASS-THROUGH CDB are probed with each variant in turn, and
+ * whichever works, or that none does, is cached against the bridge's
+ * identity so later checks go straight to it after the default is
+ * rejected.  Returns false if the ATA
+ * command set is unavailable, sgio_result holds an error if the device
+ * itself failed.
+ * fd: File descriptor pointing at a SCSI or SCSI generic device node
+ * identify: Buffer to receive the IDENTIFY DEVICE data
+ * state_dir: Directory holding the variant cache
+ * sgio_result: Reference to receive the result of the last command
+ */
+bool identify_device(int fd, uint16_t* identify, const string& state_dir, SgioResult& sgio_result);
+
+/*
+ * Function: open_device
+ * ---------------------
+ * Opens a device node, or for megaraid,N:VOLUME returns a handle on
+ * physical drive N behind the controller exporting VOLUME.  Returns -1
+ * with errno set on failure.
+ * device: Device as given on the command line
+ */
+int open_device(const string& device);
+
+/*
+ * Function: close_device
+ * ----------------------
+ * Closes a descriptor returned by open_device, controller handles are
+ * shared so stay open until the process exits
+ * fd: Descriptor to close
+ */
+void close_device(int fd);
+
+/*
+ * Function: device_label
+ * ----------------------
+ * Returns a performance data label prefix identifying a device when
+ * several are checked at once e.g. megaraid,3:/dev/sda becomes megaraid_3_sda_
+ * device: Device as given on the command line
+ */
+string device_label(const string& device);
+
+/**
+ * Function: parse_thresholds
+ * --------------------------
+ * Parses an input string and returns a map of attribute IDs to raw value thresholds
+ * and a map of named statistics to thresholds
+ * thresholds: map of attribute IDs to threshold values
+ * named: map of statistic labels to threshold values
+ * in: input string in the form "k1:v1,k2:v2,..."
+ */
+bool parse_thresholds(SmartThresholdMap& thresholds, NamedThresholdMap& named, const string in);
+
+/**
+ * Function: parse_pages
+ * ---------------------
+ * Parses an input string into a list of log page numbers
+ * pages: list of page numbers
+ * in: input string in the form "p1,p2,..."
+ */
+bool parse_pages(vector<uint8_t>& pages, const string in);
+
+/**
+ * Function: parse_window
+ * ----------------------
+ * Parses a time window into minutes past midnight
+ * start: Reference to receive the start of the window
+ * end: Reference to receive the end of the window
+ * in: input string in the form "HH:MM-HH:MM"
+ */
+bool parse_window(int& start, int& end, const string in);
+
+/*
+ * Function: check_open_device
+ * ---------------------------
+ * Checks a single device that is already open, writing its status and
+ * performance data to the given streams and returning the Nagios code
+ * fd: Descriptor returned by open_device
+ * device: Device as given on the command line or found in sysfs
+ * options: Reference to the check options
+ * prefix: Prepended to performance data labels
+ * out: Stream to receive the status
+ * perf: Stream to receive the performance data
+ * health: Pointer to receive what the daemon schedules by, or null
+ */
+int check_open_device(int fd, const sg_device& device, const CheckOptions& options, const string& prefix,
+                      ostream& out, ostream& perf, device_health* health = 0);
+
+/*
+ * Function: check_coalesced
+ * -------------------------
+ * Checks a single device that is already open as check_open_device does,
+ * unless a concurrent invocation checking it with the same options has a
+ * result fresh within options.coalesce, which is reused instead
+ * fd: Descriptor returned by open_device
+ * device: Device as given on the command line or found in sysfs
+ * options: Reference to the check options
+ * dir: Directory holding the locks and recorded results
+ * prefix: Prepended to performance data labels
+ * out: Stream to receive the status
+ * perf: Stream to receive the performance data
+ * health: Pointer to receive what the check saw, or null.  A reused
+ *         result only carries the key and whether the check warned.
+ */
+int check_coalesced(int fd, const sg_device& device, const CheckOptions& options, const string& dir,
+                    const string& prefix, ostream& out, ostream& perf, device_health* health = 0);
+
+/*
+ * Function: check_device
+ * ----------------------
+ * Opens and checks a single device, writing its status and performance
+ * data to the given streams and returning the Nagios code
+ * device: Device as given on the command line or found in sysfs
+ * options: Reference to the check options
+ * prefix: Prepended to performance data labels
+ * out: Stream to receive the status
+ * perf: Stream to receive the performance data
+ * health: Pointer to receive what the check saw, or null
+ */
+int check_device(const sg_device& device, const CheckOptions& options, const string& prefix, ostream& out,
+                 ostream& perf, device_health* health = 0);
+
+/*
+ * Function: prefix_labels
+ * -----------------------
+ * Returns performance data with a prefix added to each label, which all
+ * follow a space
+ * perfdata: Performance data with unprefixed labels
+ * prefix: Prefix to add
+ */
+string prefix_labels(const string& perfdata, const string& prefix);
+
+/*
+ * Function: read_published
+ * ------------------------
+ * Reports the result the daemon last published for a device instead of
+ * checking it, returning the Nagios code.  A result older than its next
+ * check plus a grace period is UNKNOWN as the daemon has stopped.
+ * reader: Reference to the open segment
+ * device: Device as given on the command line or found in sysfs
+ * prefix: Prepended to performance data labels
+ * out: Stream to receive the status
+ * perf: Stream to receive the performance data
+ */
+int read_published(const ShmReader& reader, const sg_device& device, const string& prefix, ostream& out,
+                   ostream& perf);
+
+#endif//_check_H_
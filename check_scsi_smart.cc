@@ -25,48 +25,43 @@
  * and flawed check_ide_smart this check uses the SCSI protocol to access
  * drives.  This allows the SCSI command to be translated by the relevant
  * SAT in the IO chain, be it linux's libata for SATA controllers, an HBA
- * for direct attached SAS controllers or SAS expander.
+ * for direct attached SAS controllers or SAS expander.  Native SCSI
+ * devices are checked via their log pages, and NVMe devices via the NVMe
+ * admin command set.
  */
 
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
-#include <stdint.h>
-#include <fcntl.h>
 #include <unistd.h>
 #include <getopt.h>
-#include <sys/ioctl.h>
-#include <scsi/sg.h>
-
-#include "scsi.h"
-#include "ata.h"
-#include "smart.h"
-#include "endian.h"
+#include <time.h>
+#include <errno.h>
+#include <signal.h>
+#include <limits.h>
+
+#include "check.h"
+#include "trace.h"
+#include "state.h"
+#include "discover.h"
+#include "daemon.h"
+#include "shm.h"
+#include "flight.h"
+#include "passive.h"
+#include "metrics.h"
+#include "sweep.h"
 
 #include <iostream>
-#include <iomanip>
 #include <memory>
 #include <sstream>
 #include <string>
 #include <vector>
-#include <map>
 
 using namespace std;
 
 const char* const BINARY  = "check_scsi_smart";
 const char* const VERSION = "1.2.3";
 
-// Nagios return codes
-const int NAGIOS_OK       = 0;
-const int NAGIOS_WARNING  = 1;
-const int NAGIOS_CRITICAL = 2;
-const int NAGIOS_UNKNOWN  = 3;
-
-const size_t SECTOR_SIZE = 512;
-
-// Mapping to hold attribute -> threshold data
-typedef map<uint8_t, uint64_t> SmartThresholdMap;
-
 /*
  * Function: version
  * -----------------
@@ -111,348 +106,203 @@ void help() {
        << "-V, --version" << endl
        << "   Print version information" << endl
        << "-d, --device=DEVICE" << endl
-       << "   Select device DEVICE" << endl
+       << "   Select device DEVICE, may be repeated to check several devices at once" << endl
+       << "   megaraid,N:VOLUME selects physical drive N behind the controller exporting VOLUME" << endl
+       << "-a, --all" << endl
+       << "   Check every ATA and SAS device found in sysfs, enclosures, RAID volumes and" << endl
+       << "   other devices are skipped without being opened" << endl
+       << "-D, --daemon" << endl
+       << "   Run in the foreground checking every ATA and SAS device, following hotplug events" << endl
+       << "   and writing each result to standard output as a line prefixed by the device" << endl
+       << "-i, --interval=SECONDS" << endl
+       << "   Seconds between checks of a device in the normal daemon tier, defaults to " << DAEMON_INTERVAL_DEFAULT << endl
+       << "-m, --shared-memory=NAME" << endl
+       << "   In daemon mode publish every result in shared memory segment NAME e.g. " << SHM_NAME_DEFAULT << endl
+       << "   otherwise report the result the daemon last published rather than reading the device" << endl
+       << "-P, --passive=FILE" << endl
+       << "   Submit a passive result for each device to the external command file FILE, or in" << endl
+       << "   send_nsca format to standard output if FILE is -, services are named SMART IDENTITY" << endl
+       << "-n, --hostname=NAME" << endl
+       << "   Host passive results and metrics are submitted for, defaults to this host's name" << endl
+       << "-G, --graphite=HOST[:PORT]" << endl
+       << "   Push performance data to Graphite over one TCP connection, the port defaults to " << GRAPHITE_PORT_DEFAULT << endl
+       << "   metrics are named " << METRICS_PREFIX << ".HOST.IDENTITY.LABEL" << endl
+       << "-U, --statsd=HOST[:PORT]" << endl
+       << "   Push performance data to StatsD as gauges over UDP, the port defaults to " << STATSD_PORT_DEFAULT << endl
        << "-w, --warning=ID:THRESHOLD[,ID:THRESHOLD]" << endl
        << "   Specify warning thresholds as a list of integer attributes to integer thresholds" << endl
+       << "   statistics may be given by their performance data label e.g. devstat_pending_errors:1" << endl
        << "-c, --critical=ID:THRESHOLD[,ID:THRESHOLD]" << endl
        << "   Specify critical thresholds as a list of integer attributes to integer thresholds" << endl
+       << "-s, --statistics=PAGE[,PAGE]" << endl
+       << "   Report Device Statistics from the listed pages, 1 general, 2 free-fall," << endl
+       << "   3 rotating media, 4 general errors, 5 temperature, 6 transport, 7 solid state" << endl
+       << "-p, --phy-events" << endl
+       << "   Report SATA phy event counters e.g. interface CRC and R_ERR responses" << endl
+       << "-r, --phy-reset" << endl
+       << "   Reset the phy event counters when read, reporting only events since the last check" << endl
+       << "-l, --self-test-log" << endl
+       << "   Report the most recent self-test result and hours since an extended self-test passed" << endl
+       << "-x, --self-test=short|extended" << endl
+       << "   Start a self-test if none of this type has run within the interval" << endl
+       << "-T, --self-test-window=HH:MM-HH:MM" << endl
+       << "   Only start self-tests within this local time window" << endl
+       << "-I, --self-test-interval=HOURS" << endl
+       << "   Hours between self-tests, defaults to 24 for short and 168 for extended" << endl
+       << "-e, --error-log" << endl
+       << "   Report errors added to the comprehensive error log since the last check" << endl
+       << "-H, --temperature-history" << endl
+       << "   Report the temperature range sampled by the device since the last check" << endl
+       << "-S, --state-dir=DIR" << endl
+       << "   Directory holding what the last check of each device saw and the ATA PASS-THROUGH" << endl
+       << "   form each bridge needs, defaults to " << STATE_DIR_DEFAULT << endl
+       << "-C, --coalesce=SECONDS" << endl
+       << "   Share the result of checking a drive with other checks of it running at the same" << endl
+       << "   time with the same options, reusing results up to SECONDS old from " << FLIGHT_DIR_DEFAULT << endl
+       << "-t, --trace=FILE" << endl
+       << "   Append a binary record of every SCSI command to FILE" << endl
        << endl;
 
 }
 
-/*
- * Function: sgio
- * --------------
- * Sends a CDB to the target device and recieves a response
- *
- * fd: File descriptor pointing at a SCSI or SCSI generic device node
- * cmdp: Pointer to a SCSI CDB
- * cmd_len: Length of the CDB
- * dxferp: Pointer to the SCSI data buffer
- * dxfer_len: Length of the SCSI data buffer
- */
-bool sgio(int fd, unsigned char* cmdp, int cmd_len, unsigned char* dxferp, int dxfer_len) {
-
-  sg_io_hdr_t sgio_hdr;
-  unsigned char sense[32];
-
-  memset(&sgio_hdr, 0, sizeof(sg_io_hdr_t));
-  sgio_hdr.interface_id = 'S';
-  sgio_hdr.dxfer_direction = SG_DXFER_FROM_DEV;
-  sgio_hdr.cmd_len = cmd_len;
-  sgio_hdr.mx_sb_len = 32;
-  sgio_hdr.dxfer_len = dxfer_len;
-  sgio_hdr.dxferp = dxferp;
-  sgio_hdr.cmdp = cmdp;
-  sgio_hdr.sbp = sense;
-
-  if(ioctl(fd, SG_IO, &sgio_hdr) < 0) {
-    cerr << "UNKNOWN: SG_IO ioctl error" << endl;
-    exit(NAGIOS_UNKNOWN);
-  }
-
-  return !sgio_hdr.status;
-
-}
-
-/*
- * Function: ata_identify
- * ----------------------
- * Send an IDENTIFY command to the ATA device and recieve the data
- *
- * fd: File descriptor pointing at a SCSI or SCSI generic device node
- * buf: Data buffer to receive the data into, must be at least SECTOR
- */
-bool ata_identify(int fd, unsigned char* buf) {
-
-  sbc_ata_pass_through ata_pass_through;
-  memset(reinterpret_cast<unsigned char*>(&ata_pass_through), 0, sizeof(sbc_ata_pass_through));
-
-  ata_pass_through.operation_code = SBC_ATA_PASS_THROUGH;
-  ata_pass_through.protocol       = ATA_PROTOCOL_PIO_DATA_IN;
-  ata_pass_through.t_dir          = ATA_TRANSFER_DIRECTION_FROM_DEVICE;
-  ata_pass_through.byte_block     = ATA_TRANSFER_SIZE_BLOCK;
-  ata_pass_through.t_type         = ATA_TRANSFER_TYPE_SECTOR;
-  ata_pass_through.t_length       = ATA_TRANSFER_LENGTH_COUNT;
-  ata_pass_through.count_7_0      = 1;
-  ata_pass_through.command        = ATA_IDENTIFY_DEVICE;
 
-  return sgio(fd, reinterpret_cast<unsigned char*>(&ata_pass_through), sizeof(ata_pass_through), buf, SECTOR_SIZE);
-
-}
+/* Set by SIGTERM or SIGINT to stop the daemon between checks */
+static volatile sig_atomic_t daemon_stop = 0;
 
 /*
- * Function: ata_smart_read_data
- * -----------------------------
- * Send a SMART READ DATA command to the ATA device and recieve the data
- *
- * fd: File descriptor pointing at a SCSI or SCSI generic device node
- * buf: Data buffer to receive the data into, must be at least SECTOR
+ * Function: daemon_signal
+ * -----------------------
+ * Asks the daemon to stop
+ * signum: Signal received
  */
-bool ata_smart_read_data(int fd, unsigned char* buf) {
+static void daemon_signal(int signum) {
 
-  sbc_ata_pass_through ata_pass_through;
-  memset(reinterpret_cast<unsigned char*>(&ata_pass_through), 0, sizeof(sbc_ata_pass_through));
-
-  ata_pass_through.operation_code = SBC_ATA_PASS_THROUGH;
-  ata_pass_through.protocol       = ATA_PROTOCOL_PIO_DATA_IN;
-  ata_pass_through.t_dir          = ATA_TRANSFER_DIRECTION_FROM_DEVICE;
-  ata_pass_through.byte_block     = ATA_TRANSFER_SIZE_BLOCK;
-  ata_pass_through.t_type         = ATA_TRANSFER_TYPE_SECTOR;
-  ata_pass_through.t_length       = ATA_TRANSFER_LENGTH_COUNT;
-  ata_pass_through.count_7_0      = 1;
-  ata_pass_through.command        = ATA_SMART;
-  ata_pass_through.features_7_0   = SMART_READ_DATA;
-  ata_pass_through.lba_23_16      = 0xc2;
-  ata_pass_through.lba_15_8       = 0x4f;
-
-  return sgio(fd, reinterpret_cast<unsigned char*>(&ata_pass_through), sizeof(ata_pass_through), buf, SECTOR_SIZE);
+  daemon_stop = 1;
 
 }
 
 /*
- * Function: ata_smart_read_thresholds
- * -----------------------------------
- * Send a SMART READ THRESHOLDS command to the ATA device and recieve the data
- *
- * fd: File descriptor pointing at a SCSI or SCSI generic device node
- * buf: Data buffer to receive the data into, must be at least SECTOR
+ * Function: push_metrics
+ * ----------------------
+ * Buffers the performance data of a device in a sink as metrics named
+ * smart.HOST.IDENTITY.LABEL, returning false if a full batch could not
+ * be sent
+ * sink: Reference to the sink
+ * host: Host the device belongs to
+ * device: Reference to the device
+ * health: Reference to the health of the device, which holds its identity
+ * prefix: Prefix of the performance data labels, removed from the metrics
+ * perfdata: Performance data of the device
  */
-bool ata_smart_read_thresholds(int fd, unsigned char* buf) {
+bool push_metrics(MetricSink& sink, const string& host, const sg_device& device, const device_health& health,
+                  const string& prefix, const string& perfdata) {
 
-  sbc_ata_pass_through ata_pass_through;
-  memset(reinterpret_cast<unsigned char*>(&ata_pass_through), 0, sizeof(sbc_ata_pass_through));
+  string identity = health.key.empty() ? flight_key(SYSFS_ROOT_DEFAULT, device.node) : health.key;
+  string path = string(METRICS_PREFIX) + "." + metrics_component(host) + "." + metrics_component(identity);
 
-  ata_pass_through.operation_code = SBC_ATA_PASS_THROUGH;
-  ata_pass_through.protocol       = ATA_PROTOCOL_PIO_DATA_IN;
-  ata_pass_through.t_dir          = ATA_TRANSFER_DIRECTION_FROM_DEVICE;
-  ata_pass_through.byte_block     = ATA_TRANSFER_SIZE_BLOCK;
-  ata_pass_through.t_type         = ATA_TRANSFER_TYPE_SECTOR;
-  ata_pass_through.t_length       = ATA_TRANSFER_LENGTH_COUNT;
-  ata_pass_through.count_7_0      = 1;
-  ata_pass_through.command        = ATA_SMART;
-  ata_pass_through.features_7_0   = SMART_READ_THRESHOLDS;
-  ata_pass_through.lba_23_16      = 0xc2;
-  ata_pass_through.lba_15_8       = 0x4f;
+  vector<metric> metrics = perfdata_metrics(perfdata);
+  for(vector<metric>::iterator i = metrics.begin(); i != metrics.end(); i++)
+    if(!prefix.empty() && !i->name.compare(0, prefix.size(), prefix))
+      i->name.erase(0, prefix.size());
 
-  return sgio(fd, reinterpret_cast<unsigned char*>(&ata_pass_through), sizeof(ata_pass_through), buf, SECTOR_SIZE);
+  return sink.add(path, metrics, time(0));
 
 }
 
 /*
- * Function: ata_smart_read_log
- * ----------------------------
- * Send a SMART READ LOG command to the ATA device and receive the data
- * fd: File descriptor pointing at a SCSI or SCSI generic device node
- * buf: Data buffer to receive the data into, must be at least sectors * SECTOR
- *      bytes.
- * log: Log to read See A.1 for ATA8-ACS
- */
-bool ata_smart_read_log(int fd, unsigned char* buf, int log, uint16_t sectors) {
-
-  sbc_ata_pass_through ata_pass_through;
-  memset(reinterpret_cast<unsigned char*>(&ata_pass_through), 0, sizeof(sbc_ata_pass_through));
-
-  ata_pass_through.operation_code = SBC_ATA_PASS_THROUGH;
-  ata_pass_through.protocol       = ATA_PROTOCOL_PIO_DATA_IN;
-  ata_pass_through.t_dir          = ATA_TRANSFER_DIRECTION_FROM_DEVICE;
-  ata_pass_through.byte_block     = ATA_TRANSFER_SIZE_BLOCK;
-  ata_pass_through.t_type         = ATA_TRANSFER_TYPE_SECTOR;
-  ata_pass_through.t_length       = ATA_TRANSFER_LENGTH_COUNT;
-  ata_pass_through.count_15_8     = sectors >> 8;
-  ata_pass_through.count_7_0      = sectors;
-  ata_pass_through.command        = ATA_SMART;
-  ata_pass_through.features_7_0   = SMART_READ_LOG;
-  ata_pass_through.lba_23_16      = 0xc2;
-  ata_pass_through.lba_15_8       = 0x4f;
-  ata_pass_through.lba_7_0        = log;
-
-  return sgio(fd, reinterpret_cast<unsigned char*>(&ata_pass_through), sizeof(ata_pass_through), buf, sectors * SECTOR_SIZE);
-
-}
-
-/*
- * Function: ata_smart_read_log_directory
- * --------------------------------------
- * Reads the SMART flog directory
- * fd: File descriptor pointing at a SCSI or SCSI generic device nod
- * buf: Data buffer to receive the data into, must be at least SECTOR
- */
-bool ata_smart_read_log_directory(int fd, unsigned char* buf) {
-
-  return ata_smart_read_log(fd, buf, ATA_LOG_ADDRESS_DIRECTORY, 1);
-
-}
-
-/*
- * Function: check_smart_attributes
- * --------------------------------
- * Checks attributes against vendor thresholds
- * fd: File descriptor pointing at a SCSI or SCSI generic device node
- * critical_thresholds: Map of atrribute IDs to raw thresholds
- * warning_thresholds: Map of atrribute IDs to raw thresholds
- * code: Reference to the current return code
- * prdfail: Reference to a counter of vendor predicted fails
- * advisory: Reference to a counter of vendor advisory end of life
- * crit: Reference to a counter of critical attributes
- * warn: Reference to a counter of advisory attributes
- * perfdata: Output stream to dump performance data to
+ * Function: metrics_host
+ * ----------------------
+ * Returns the host metrics and passive results are submitted for
+ * host: Host given on the command line, or null for this host's name
  */
-void check_smart_attributes(int fd, SmartThresholdMap& critical_thresholds, SmartThresholdMap& warning_thresholds,
-                            int& code, int& prdfail, int& advisory, int& crit, int& warn, ostream& perfdata) {
-
-  // Load the SMART data and thresholds pages
-  smart_data sd;
-  ata_smart_read_data(fd, reinterpret_cast<unsigned char*>(&sd));
-
-  smart_thresholds st;
-  ata_smart_read_thresholds(fd, reinterpret_cast<unsigned char*>(&st));
-
-  // Perform actual SMART threshold checks
-  for(int i=0; i<SMART_ATTRIBUTE_NUM; i++) {
-
-    SmartAttribute attribute(sd.attributes[i]);
-    SmartThreshold threshold(st.thresholds[i]);
-
-    if(!attribute.idValid())
-      continue;
-
-    // Check the validity of the attribute value and whether the threshold has been exceeded
-    if(attribute.valueValid() && (attribute <= threshold)) {
+string metrics_host(const char* host) {
 
-      // Predicted failure is within 24 hours, otherwise the device lifespan has been exceeded
-      if(attribute.getPreFail())
-        prdfail++;
-      else
-        advisory++;
+  if(host)
+    return host;
 
-    }
-
-    // Check against custom raw thresholds
-    uint64_t crit_threshold = critical_thresholds[attribute.getID()];
-    uint64_t warn_threshold = warning_thresholds[attribute.getID()];
+  char hostname[HOST_NAME_MAX + 1] = "";
+  gethostname(hostname, sizeof(hostname) - 1);
 
-    if(crit_threshold && (attribute.getRaw() >= crit_threshold)) {
-      crit++;
-    } else if(warn_threshold && (attribute.getRaw() >= warn_threshold)) {
-      warn++;
-    }
-
-    // Accumulate the performance data
-    perfdata << " " << attribute << ";";
-    if(warn_threshold)
-      perfdata << warn_threshold;
-    perfdata << ";";
-    if(crit_threshold)
-      perfdata << crit_threshold;
-    perfdata << ";;";
-
-  }
-
-  // Determine the state to report
-  if(advisory || warn)
-    code = max(code, NAGIOS_WARNING);
-
-  if(prdfail || crit)
-    code = max(code, NAGIOS_CRITICAL);
+  return hostname;
 
 }
 
 /*
- * Function: check_smart_log
- * -------------------------
- * Checks for the existence of SMART logs
- * fd: File descriptor pointing at a SCSI or SCSI generic device node
- * fd: File descriptor pointing at a SCSI or SCSI generic device node
- * code: Reference to the current return code
- * logs: Reference to a count of the number of SMART logs
+ * Function: run_daemon
+ * --------------------
+ * Checks every device until stopped, following hotplug events.  Each
+ * result is a single line on standard output prefixed by the device.
+ * options: Reference to the check options
+ * interval: Seconds between checks of each device in the normal tier
+ * shm_name: Shared memory segment to publish results in, or null
+ * sink: Sink metrics are pushed to after each check, or null
+ * host: Host metrics are submitted for
  */
-void check_smart_log(int fd, int& code, int& logs) {
-
-  // Read the SMART log directory
-  smart_log_directory log_directory;
-  ata_smart_read_log_directory(fd, reinterpret_cast<unsigned char*>(&log_directory));
-
-  // Calculate the number of SMART log sectors to read and allocate a buffer
-  uint16_t smart_log_sectors = StorageEndian::swap(log_directory.data_blocks[ATA_LOG_ADDRESS_SMART]);
-  if(!smart_log_sectors)
-    return;
-
-  smart_log_summary* summaries = new smart_log_summary[smart_log_sectors];
-
-  // Read the logs in
-  ata_smart_read_log(fd, reinterpret_cast<unsigned char*>(summaries), ATA_LOG_ADDRESS_SMART, smart_log_sectors);
-
-  // Check for any logged errors
-  for(int i=0; i<smart_log_sectors; i++) {
-
-    // If the index is zero there are no entries
-    if(!StorageEndian::swap(summaries[i].index))
-      continue;
-
-    logs += StorageEndian::swap(summaries[i].count);
+int run_daemon(const CheckOptions& options, time_t interval, const char* shm_name, MetricSink* sink,
+               const string& host) {
 
+  NetlinkUeventSource source;
+  if(!source.open()) {
+    cerr << "UNKNOWN: unable to subscribe to uevents: " << strerror(errno) << endl;
+    return NAGIOS_UNKNOWN;
   }
 
-  if(logs)
-    code = max(code, NAGIOS_WARNING);
+  Daemon daemon(source, SYSFS_ROOT_DEFAULT, "/dev", [&](const vector<sg_device>& devices, vector<int>& fds) {
 
-  delete [] summaries;
+    vector<sweep_result> results = sweep_open_devices(devices, fds, options);
 
-}
+    vector<device_health> healths;
+    for(size_t i = 0; i < results.size(); i++) {
 
-/**
- * Function: parse_thresholds
- * --------------------------
- * Parses an input string and returns a map of attribute IDs to raw value thresholds
- * thresholds: map of attribute IDs to threshold values
- * in: input string in the form "k1:v1,k2:v2,..."
- */
-bool parse_thresholds(SmartThresholdMap& thresholds, const string in) {
+      sweep_result& result = results[i];
 
-  istringstream in_stream(in);
-  vector<string> tokens;
-  string token1, token2;
+      cout << devices[i].node << ": " << result.out;
+      if(!result.perf.empty())
+        cout << " |" << result.perf;
+      cout << endl;
 
-  // Split the input into key value pairs
-  vector<string> key_value_pairs;
-  while(getline(in_stream, token1, ',')) {
-    tokens.push_back(token1);
-  }
+      device_health& health = result.health;
+      health.report.code = result.code;
+      shm_copy(health.report.status, sizeof(health.report.status), result.out);
+      shm_copy(health.report.perfdata, sizeof(health.report.perfdata), result.perf);
+      healths.push_back(health);
 
-  // Split each key value pair
-  for(vector<string>::iterator i = tokens.begin(); i != tokens.end(); i++) {
+      if(sink && !push_metrics(*sink, host, devices[i], health, "", result.perf))
+        cerr << devices[i].node << ": unable to push metrics: " << strerror(errno) << endl;
 
-    istringstream tok_stream(*i);
-
-    // Read the first token delimited by =
-    getline(tok_stream, token1, ':');
-    if(!tok_stream.good()) {
-      return false;
     }
 
-    // Read the second token, which shoud result in EOF
-    getline(tok_stream, token2);
-    if(!tok_stream.eof()) {
-      return false;
-    }
+    // The devices due at once are sent together over the connection kept
+    // open between them
+    if(sink && !sink->flush())
+      cerr << "unable to push metrics: " << strerror(errno) << endl;
 
-    // Parse the tokens and ensure they are integers
-    char* p1;
-    char* p2;
+    return healths;
 
-    unsigned long k = strtol(token1.c_str(), &p1, 10);
-    unsigned long v = strtol(token2.c_str(), &p2, 10);
+  }, interval);
 
-    if(*p1 || *p2) {
-      return false;
+  ShmWriter writer;
+  if(shm_name) {
+    if(!writer.open(shm_name)) {
+      cerr << "UNKNOWN: unable to create shared memory " << shm_name << ": " << strerror(errno) << endl;
+      return NAGIOS_UNKNOWN;
     }
+    daemon.publish(writer);
+  }
 
-    thresholds[k] = v;
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = daemon_signal;
+  sigaction(SIGTERM, &action, 0);
+  sigaction(SIGINT, &action, 0);
 
+  if(!daemon.run(daemon_stop)) {
+    cerr << "UNKNOWN: unable to wait for uevents: " << strerror(errno) << endl;
+    return NAGIOS_UNKNOWN;
   }
 
-  return true;
+  return NAGIOS_OK;
+
 }
 
 /*
@@ -463,21 +313,61 @@ bool parse_thresholds(SmartThresholdMap& thresholds, const string in) {
  */
 int main(int argc, char** argv) {
 
-  const char* device = 0;
+  vector<sg_device> devices;
+  bool all = false;
+  bool daemon = false;
+  const char* interval = 0;
+  const char* shm_name = 0;
+  const char* coalesce = 0;
+  const char* passive = 0;
+  const char* host = 0;
+  const char* graphite = 0;
+  const char* statsd = 0;
   const char* warning = "";
   const char* critical = "";
+  const char* trace_file = 0;
+  const char* statistics = "";
+  bool phy_events = false;
+  bool phy_reset = false;
+  bool self_test_log = false;
+  const char* self_test = 0;
+  const char* self_test_window = 0;
+  const char* self_test_interval = 0;
+  bool error_log = false;
+  bool temperature_history = false;
+  const char* state_dir = STATE_DIR_DEFAULT;
 
   static struct option long_options[] = {
-    { "help",     no_argument,       0, 'h' },
-    { "version",  no_argument,       0, 'V' },
-    { "device",   required_argument, 0, 'd' },
-    { "warning",  required_argument, 0, 'w' },
-    { "critical", required_argument, 0, 'c' },
-    { 0,          0,                 0, 0   }
+    { "help",                no_argument,       0, 'h' },
+    { "version",             no_argument,       0, 'V' },
+    { "device",              required_argument, 0, 'd' },
+    { "all",                 no_argument,       0, 'a' },
+    { "daemon",              no_argument,       0, 'D' },
+    { "interval",            required_argument, 0, 'i' },
+    { "shared-memory",       required_argument, 0, 'm' },
+    { "passive",             required_argument, 0, 'P' },
+    { "hostname",            required_argument, 0, 'n' },
+    { "graphite",            required_argument, 0, 'G' },
+    { "statsd",              required_argument, 0, 'U' },
+    { "warning",             required_argument, 0, 'w' },
+    { "critical",            required_argument, 0, 'c' },
+    { "trace",               required_argument, 0, 't' },
+    { "statistics",          required_argument, 0, 's' },
+    { "phy-events",          no_argument,       0, 'p' },
+    { "phy-reset",           no_argument,       0, 'r' },
+    { "self-test-log",       no_argument,       0, 'l' },
+    { "self-test",           required_argument, 0, 'x' },
+    { "self-test-window",    required_argument, 0, 'T' },
+    { "self-test-interval",  required_argument, 0, 'I' },
+    { "error-log",           no_argument,       0, 'e' },
+    { "temperature-history", no_argument,       0, 'H' },
+    { "state-dir",           required_argument, 0, 'S' },
+    { "coalesce",            required_argument, 0, 'C' },
+    { 0,                     0,                 0, 0   }
   };
 
   int c;
-  while((c = getopt_long(argc, argv, "hVd:w:c:", long_options, 0)) != -1) {
+  while((c = getopt_long(argc, argv, "hVd:aDi:m:P:n:G:U:w:c:t:s:prlx:T:I:eHS:C:", long_options, 0)) != -1) {
     switch(c) {
       case 'h':
         help();
@@ -486,7 +376,33 @@ int main(int argc, char** argv) {
         version();
         exit(0);
       case 'd':
-        device = optarg;
+        devices.push_back(sg_device());
+        devices.back().node = optarg;
+        devices.back().device_class = DEVICE_CLASS_UNKNOWN;
+        break;
+      case 'a':
+        all = true;
+        break;
+      case 'D':
+        daemon = true;
+        break;
+      case 'i':
+        interval = optarg;
+        break;
+      case 'm':
+        shm_name = optarg;
+        break;
+      case 'P':
+        passive = optarg;
+        break;
+      case 'n':
+        host = optarg;
+        break;
+      case 'G':
+        graphite = optarg;
+        break;
+      case 'U':
+        statsd = optarg;
         break;
       case 'w':
         warning = optarg;
@@ -494,6 +410,42 @@ int main(int argc, char** argv) {
       case 'c':
         critical = optarg;
         break;
+      case 't':
+        trace_file = optarg;
+        break;
+      case 's':
+        statistics = optarg;
+        break;
+      case 'p':
+        phy_events = true;
+        break;
+      case 'r':
+        phy_events = phy_reset = true;
+        break;
+      case 'l':
+        self_test_log = true;
+        break;
+      case 'x':
+        self_test = optarg;
+        break;
+      case 'T':
+        self_test_window = optarg;
+        break;
+      case 'I':
+        self_test_interval = optarg;
+        break;
+      case 'e':
+        error_log = true;
+        break;
+      case 'H':
+        temperature_history = true;
+        break;
+      case 'S':
+        state_dir = optarg;
+        break;
+      case 'C':
+        coalesce = optarg;
+        break;
       default:
         usage();
         exit(1);
@@ -502,78 +454,247 @@ int main(int argc, char** argv) {
   }
 
   // Check for required arguments
-  if(!device) {
+  if((devices.empty() && !all && !daemon) || (daemon && (all || passive || !devices.empty()))) {
     help();
     exit(NAGIOS_UNKNOWN);
   }
 
   // Parse optional arguments
-  SmartThresholdMap warning_thresholds;
-  if(!parse_thresholds(warning_thresholds, warning)) {
+  CheckOptions options;
+  if(!parse_thresholds(options.warning_thresholds, options.warning_named, warning)) {
     help();
     exit(NAGIOS_UNKNOWN);
   }
 
-  SmartThresholdMap critical_thresholds;
-  if(!parse_thresholds(critical_thresholds, critical)) {
+  if(!parse_thresholds(options.critical_thresholds, options.critical_named, critical)) {
     help();
     exit(NAGIOS_UNKNOWN);
   }
 
-  // Check the device is compatible with the check
-  int fd = open(device, O_RDWR);
-  if(fd == -1) {
-    cerr << "UNKNOWN: unable to open device " << device << endl;
+  if(!parse_pages(options.devstat_pages, statistics)) {
+    help();
     exit(NAGIOS_UNKNOWN);
   }
 
-  int sg_version;
-  if((ioctl(fd, SG_GET_VERSION_NUM, &sg_version) == -1) || sg_version < 30000) {
-    cerr << "UNKNOWN: " << device << " is either not an sg device, or the driver is old" << endl;
+  options.phy_events = phy_events;
+  options.phy_reset = phy_reset;
+  options.self_test_log = self_test_log || self_test;
+  options.error_log = error_log;
+  options.temperature_history = temperature_history;
+  options.state_dir = state_dir;
+
+  if(self_test) {
+    if(!strcmp(self_test, "short")) {
+      options.self_test = SMART_SELF_TEST_SHORT;
+    } else if(!strcmp(self_test, "extended") || !strcmp(self_test, "long")) {
+      options.self_test = SMART_SELF_TEST_EXTENDED;
+    } else {
+      help();
+      exit(NAGIOS_UNKNOWN);
+    }
+  }
+
+  if(self_test_window && !parse_window(options.self_test_window_start, options.self_test_window_end, self_test_window)) {
+    help();
     exit(NAGIOS_UNKNOWN);
   }
 
-  // Check the device can use SMART and that it is enabled
-  uint16_t identify[SECTOR_SIZE / 2];
-  if(!ata_identify(fd, reinterpret_cast<unsigned char*>(identify))) {
-    cout << "OK: ATA command set unsupported" << endl;
-    exit(NAGIOS_OK);
+  if(coalesce) {
+    char* p;
+    options.coalesce = strtol(coalesce, &p, 10);
+    if(*p || options.coalesce <= 0) {
+      help();
+      exit(NAGIOS_UNKNOWN);
+    }
   }
 
-  if(~StorageEndian::swap(identify[82]) & 0x01) {
-    cout << "OK: SMART feature set unsupported" << endl;
-    exit(NAGIOS_OK);
+  // Both protocols carry the same metrics, so only one sink is used
+  unique_ptr<MetricSink> sink;
+  if(graphite || statsd) {
+    string sink_host, sink_port;
+    if((graphite && statsd) ||
+       !metrics_endpoint(graphite ? graphite : statsd, graphite ? GRAPHITE_PORT_DEFAULT : STATSD_PORT_DEFAULT,
+                         sink_host, sink_port)) {
+      help();
+      exit(NAGIOS_UNKNOWN);
+    }
+    if(graphite)
+      sink.reset(new GraphiteSink(sink_host, sink_port));
+    else
+      sink.reset(new StatsdSink(sink_host, sink_port));
   }
 
-  if(~StorageEndian::swap(identify[85]) & 0x01) {
-    cout << "UNKNOWN: SMART feature set disabled" << endl;
+  if(self_test_interval) {
+    char* p;
+    options.self_test_interval = strtol(self_test_interval, &p, 10);
+    if(*p || options.self_test_interval <= 0) {
+      help();
+      exit(NAGIOS_UNKNOWN);
+    }
+  }
+
+  // Enable command tracing, records are flushed when the process exits
+  if(trace_file && !trace.open(trace_file)) {
+    cerr << "UNKNOWN: unable to open trace file " << trace_file << endl;
     exit(NAGIOS_UNKNOWN);
   }
 
+  if(daemon) {
+
+    time_t seconds = DAEMON_INTERVAL_DEFAULT;
+    if(interval) {
+      char* p;
+      seconds = strtol(interval, &p, 10);
+      if(*p || seconds <= 0) {
+        help();
+        exit(NAGIOS_UNKNOWN);
+      }
+    }
+
+    return run_daemon(options, seconds, shm_name, sink.get(), metrics_host(host));
+
+  }
+
+  // Discovery reads sysfs only, devices which can't be checked are never opened
+  if(all) {
+    vector<sg_device> found = sysfs_discover(SYSFS_ROOT_DEFAULT);
+    for(vector<sg_device>::iterator i = found.begin(); i != found.end(); i++)
+      if(i->device_class == DEVICE_CLASS_ATA || i->device_class == DEVICE_CLASS_SAS)
+        devices.push_back(*i);
+  }
+
+  // Results published by a daemon stand in for reading the devices
+  ShmReader reader;
+  if(shm_name && !reader.open(shm_name)) {
+    cout << "UNKNOWN: unable to open shared memory " << shm_name << ": " << strerror(errno) << endl;
+    exit(NAGIOS_UNKNOWN);
+  }
+
+  // Many devices are checked at once up front, each waiting on its own
+  // commands.  Coalesced checks share results between processes, so go one
+  // device at a time.
+  vector<sweep_result> swept;
+  if(devices.size() > 1 && !shm_name && !options.coalesce)
+    swept = sweep_devices(devices, options);
+
+  auto read = [&](const sg_device& device, const string& prefix, ostream& out, ostream& perf,
+                  device_health* health) {
+    if(shm_name)
+      return read_published(reader, device, prefix, out, perf);
+    if(swept.empty())
+      return check_device(device, options, prefix, out, perf, health);
+    const sweep_result& result = swept[&device - devices.data()];
+    out << result.out;
+    perf << prefix_labels(result.perf, prefix);
+    if(health)
+      *health = result.health;
+    return result.code;
+  };
+
+  // Metrics are buffered as each device is checked and sent in one batch
+  string metrics_hostname = metrics_host(host);
+  auto check = [&](const sg_device& device, const string& prefix, ostream& out, ostream& perf,
+                   device_health* health) {
+    if(!sink)
+      return read(device, prefix, out, perf, health);
+    stringstream device_perf;
+    device_health identity;
+    if(!health)
+      health = &identity;
+    int code = read(device, prefix, out, device_perf, health);
+    if(!push_metrics(*sink, metrics_hostname, device, *health, prefix, device_perf.str()))
+      cerr << device.node << ": unable to push metrics: " << strerror(errno) << endl;
+    perf << device_perf.str();
+    return code;
+  };
+
+  auto flush = [&]() {
+    if(sink && !sink->flush())
+      cerr << "unable to push metrics: " << strerror(errno) << endl;
+  };
+
+  // Results go to the monitoring server once every device has been
+  // checked, a line at a time, so a failed write leaves those before it
+  // submitted
+  if(passive) {
+
+    vector<passive_result> results;
+    for(vector<sg_device>::iterator i = devices.begin(); i != devices.end(); i++) {
+
+      stringstream out, perf;
+      device_health health;
+
+      passive_result result;
+      result.code = check(*i, "", out, perf, &health);
+      result.timestamp = time(0);
+      result.host = metrics_hostname;
+      result.service = PASSIVE_SERVICE_PREFIX + (health.key.empty() ? flight_key(SYSFS_ROOT_DEFAULT, i->node) : health.key);
+      result.output = out.str();
+      if(!perf.str().empty())
+        result.output += " |" + perf.str();
+
+      results.push_back(result);
+
+    }
+
+    flush();
+
+    string buffer = strcmp(passive, PASSIVE_STDOUT) ? passive_external_commands(results) : passive_nsca(results);
+    if(!passive_write(passive, buffer)) {
+      cerr << "UNKNOWN: unable to write passive results to " << passive << ": " << strerror(errno) << endl;
+      return NAGIOS_UNKNOWN;
+    }
+
+    return NAGIOS_OK;
+
+  }
+
+  // Check each device in turn, a single device keeps the plain output
+  if(devices.size() == 1) {
+
+    stringstream out, perf;
+    int code = check(devices[0], "", out, perf, 0);
+    flush();
+
+    cout << out.str();
+    if(!perf.str().empty())
+      cout << " |" << perf.str();
+    cout << endl;
+
+    return code;
+
+  }
+
+  // Otherwise summarise the array with one line per device beneath
+  int counts[NAGIOS_UNKNOWN + 1] = { 0 };
+  stringstream lines, perf;
+  for(vector<sg_device>::iterator i = devices.begin(); i != devices.end(); i++) {
+
+    stringstream out;
+    counts[check(*i, device_label(i->node), out, perf, 0)]++;
+
+    lines << i->node << ": " << out.str() << endl;
+
+  }
+
+  flush();
+
   int code = NAGIOS_OK;
-  int prdfail = 0;
-  int advisory = 0;
-  int crit = 0;
-  int warn = 0;
-  int logs = 0;
-  stringstream perfdata;
-
-  // Perform the checks
-  check_smart_attributes(fd, critical_thresholds, warning_thresholds, code, prdfail, advisory, crit, warn, perfdata);
-  check_smart_log(fd, code, logs);
-
-  // Print out the results and performance data
-  const char* status[] = { "OK", "WARNING", "CRITICAL" };
+  if(counts[NAGIOS_CRITICAL])
+    code = NAGIOS_CRITICAL;
+  else if(counts[NAGIOS_WARNING])
+    code = NAGIOS_WARNING;
+  else if(counts[NAGIOS_UNKNOWN])
+    code = NAGIOS_UNKNOWN;
+
+  const char* status[] = { "OK", "WARNING", "CRITICAL", "UNKNOWN" };
   cout << status[code]
-       << ": prdfail " << prdfail
-       << ", advisory " << advisory
-       << ", critical " << crit
-       << ", warning " << warn
-       << ", logs " << logs
-       << " |" << perfdata.str()
-       << endl;
-
-  close(fd);
+       << ": devices " << devices.size()
+       << ", critical " << counts[NAGIOS_CRITICAL]
+       << ", warning " << counts[NAGIOS_WARNING]
+       << ", unknown " << counts[NAGIOS_UNKNOWN]
+       << " |" << perf.str() << endl
+       << lines.str();
 
   return code;
 
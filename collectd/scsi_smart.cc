@@ -0,0 +1,353 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+/*
+ * collectd plugin
+ * ---------------
+ * Reads SMART data in process with libscsismart.  Devices are opened once
+ * and every configured disk is checked in one sweep each read interval.
+ *
+ * <Plugin scsi_smart>
+ *   Device "/dev/sda"
+ *   Device "megaraid,3:/dev/sdb"
+ *   ErrorLog true
+ * </Plugin>
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+
+extern "C" {
+#include "collectd.h"
+#include "plugin.h"
+}
+
+#include "scsismart.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/* Name the plugin registers and dispatches values under */
+const char* const SCSI_SMART_PLUGIN = "scsi_smart";
+
+/* Attributes given collectd types of their own as well as smart_attribute */
+const uint8_t SCSI_SMART_POWER_ON_HOURS       = 9;
+const uint8_t SCSI_SMART_POWER_CYCLE_COUNT    = 12;
+const uint8_t SCSI_SMART_REALLOCATED_SECTORS  = 5;
+const uint8_t SCSI_SMART_AIRFLOW_TEMPERATURE  = 190;
+const uint8_t SCSI_SMART_TEMPERATURE          = 194;
+const uint8_t SCSI_SMART_PENDING_SECTORS      = 197;
+
+/*
+ * Struct: scsi_smart_disk
+ * -----------------------
+ * A configured disk, its device stays open between reads.  The key is the
+ * last the drive was identified by, so a failed read is dispatched under
+ * the same name as the reads either side of it.
+ */
+struct scsi_smart_disk {
+  string node;
+  string key;
+  scsismart_device device;
+};
+
+static vector<scsi_smart_disk> disks;
+static scsismart_options options;
+static string state_dir;
+
+/* Opens a disk, tests substitute a fake transport */
+int (*scsi_smart_open)(scsismart_device* device, const char* node) = scsismart_open;
+
+/*
+ * Function: scsi_smart_name
+ * -------------------------
+ * Returns text usable as a collectd name component
+ * text: Text to convert
+ */
+static string scsi_smart_name(const string& text) {
+
+  string name;
+  for(string::const_iterator i = text.begin(); i != text.end() && name.size() < DATA_MAX_NAME_LEN - 1; i++)
+    name += isalnum(*i) || *i == '_' || *i == '.' ? *i : '_';
+
+  return name;
+
+}
+
+/*
+ * Function: scsi_smart_config
+ * ---------------------------
+ * Reads the plugin's configuration block
+ * ci: Configuration block
+ */
+static int scsi_smart_config(oconfig_item_t* ci) {
+
+  for(int i = 0; i < ci->children_num; i++) {
+
+    oconfig_item_t* child = ci->children + i;
+    string key = child->key;
+
+    bool string_value = child->values_num == 1 && child->values[0].type == OCONFIG_TYPE_STRING;
+    bool boolean_value = child->values_num == 1 && child->values[0].type == OCONFIG_TYPE_BOOLEAN;
+
+    uint32_t check = 0;
+    if(key == "PhyEvents")
+      check = SCSISMART_PHY_EVENTS;
+    else if(key == "SelfTestLog")
+      check = SCSISMART_SELF_TEST_LOG;
+    else if(key == "ErrorLog")
+      check = SCSISMART_ERROR_LOG;
+    else if(key == "TemperatureHistory")
+      check = SCSISMART_TEMPERATURE_HISTORY;
+
+    if(key == "Device" && string_value) {
+      scsi_smart_disk disk;
+      disk.node = child->values[0].value.string;
+      disk.device.fd = -1;
+      disks.push_back(disk);
+    } else if(key == "StateDir" && string_value) {
+      state_dir = child->values[0].value.string;
+    } else if(key == "Statistics") {
+      for(int j = 0; j < child->values_num; j++) {
+        if(child->values[j].type != OCONFIG_TYPE_NUMBER || child->values[j].value.number < 1 ||
+           child->values[j].value.number > 31) {
+          ERROR("%s: Statistics takes device statistics page numbers", SCSI_SMART_PLUGIN);
+          return -1;
+        }
+        options.statistics |= 1u << static_cast<int>(child->values[j].value.number);
+      }
+    } else if(check && boolean_value) {
+      if(child->values[0].value.boolean)
+        options.checks |= check;
+    } else {
+      ERROR("%s: invalid option %s", SCSI_SMART_PLUGIN, child->key);
+      return -1;
+    }
+
+  }
+
+  return 0;
+
+}
+
+/*
+ * Function: scsi_smart_init
+ * -------------------------
+ * Opens every configured disk, one that can't be opened is tried again
+ * at each read
+ */
+static int scsi_smart_init(void) {
+
+  options.state_dir = state_dir.empty() ? 0 : state_dir.c_str();
+
+  for(vector<scsi_smart_disk>::iterator i = disks.begin(); i != disks.end(); i++)
+    if(scsi_smart_open(&i->device, i->node.c_str()))
+      WARNING("%s: unable to open %s: %s", SCSI_SMART_PLUGIN, i->node.c_str(), strerror(errno));
+
+  return 0;
+
+}
+
+/*
+ * Function: scsi_smart_dispatch
+ * -----------------------------
+ * Dispatches values read from a disk
+ * instance: Plugin instance identifying the disk
+ * type: collectd type of the values
+ * type_instance: Names the values within the type
+ * values: Values to dispatch
+ * values_len: Number of values
+ */
+static void scsi_smart_dispatch(const string& instance, const char* type, const string& type_instance,
+                                value_t* values, size_t values_len) {
+
+  value_list_t vl;
+  memset(&vl, 0, sizeof(vl));
+  vl.values = values;
+  vl.values_len = values_len;
+  snprintf(vl.plugin, sizeof(vl.plugin), "%s", SCSI_SMART_PLUGIN);
+  snprintf(vl.plugin_instance, sizeof(vl.plugin_instance), "%s", instance.c_str());
+  snprintf(vl.type, sizeof(vl.type), "%s", type);
+  snprintf(vl.type_instance, sizeof(vl.type_instance), "%s", type_instance.c_str());
+
+  plugin_dispatch_values(&vl);
+
+}
+
+/*
+ * Function: scsi_smart_gauge
+ * --------------------------
+ * Dispatches a single gauge read from a disk
+ * instance: Plugin instance identifying the disk
+ * type: collectd type of the value
+ * type_instance: Names the value within the type
+ * gauge: Value to dispatch
+ */
+static void scsi_smart_gauge(const string& instance, const char* type, const string& type_instance, gauge_t gauge) {
+
+  value_t value;
+  value.gauge = gauge;
+
+  scsi_smart_dispatch(instance, type, type_instance, &value, 1);
+
+}
+
+/*
+ * Function: scsi_smart_submit
+ * ---------------------------
+ * Dispatches everything a check of a disk read.  The disk is named by its
+ * identity so its history follows it between nodes, a check that couldn't
+ * identify it uses the last identity read, or the node's name if there
+ * has never been one.  Each SMART attribute is a smart_attribute, those
+ * collectd has a type for are also dispatched as that type, and any other
+ * value is a gauge named by its label.
+ * disk: Reference to the disk
+ * result: Reference to the check result
+ */
+static void scsi_smart_submit(scsi_smart_disk& disk, const scsismart_result& result) {
+
+  if(result.key[0])
+    disk.key = result.key;
+
+  string instance = scsi_smart_name(!disk.key.empty() ? disk.key : disk.node.substr(disk.node.rfind('/') + 1));
+
+  scsi_smart_gauge(instance, "gauge", "status", result.code);
+
+  vector<string> labels;
+  for(uint32_t i = 0; i < result.attributes_num; i++) {
+
+    const scsismart_attribute& attribute = result.attributes[i];
+
+    string label = to_string(attribute.id) + "_" + scsismart_attribute_label(attribute.id);
+    labels.push_back(label);
+
+    value_t values[4];
+    values[0].gauge = attribute.value;
+    values[1].gauge = attribute.worst;
+    values[2].gauge = attribute.threshold;
+    values[3].gauge = attribute.raw;
+    scsi_smart_dispatch(instance, "smart_attribute", label, values, 4);
+
+    switch(attribute.id) {
+      case SCSI_SMART_TEMPERATURE:
+      case SCSI_SMART_AIRFLOW_TEMPERATURE:
+        scsi_smart_gauge(instance, "temperature", label, attribute.raw);
+        break;
+      case SCSI_SMART_POWER_ON_HOURS:
+        scsi_smart_gauge(instance, "smart_poweron", label, attribute.raw * 3600.0);
+        break;
+      case SCSI_SMART_POWER_CYCLE_COUNT:
+        scsi_smart_gauge(instance, "smart_powercycles", label, attribute.raw);
+        break;
+      case SCSI_SMART_REALLOCATED_SECTORS:
+      case SCSI_SMART_PENDING_SECTORS:
+        scsi_smart_gauge(instance, "smart_badsectors", label, attribute.raw);
+        break;
+    }
+
+  }
+
+  // Attributes also appear amongst the values under the same labels
+  for(uint32_t i = 0; i < result.values_num; i++) {
+    string label = result.values[i].label;
+    if(find(labels.begin(), labels.end(), label) == labels.end())
+      scsi_smart_gauge(instance, "gauge", label, result.values[i].value);
+  }
+
+}
+
+/*
+ * Function: scsi_smart_read
+ * -------------------------
+ * Checks every configured disk.  A disk whose check is UNKNOWN is closed
+ * and opened again at the next read, so a replaced drive is picked up.
+ */
+static int scsi_smart_read(void) {
+
+  int checked = 0;
+  for(vector<scsi_smart_disk>::iterator i = disks.begin(); i != disks.end(); i++) {
+
+    if(i->device.fd == -1 && scsi_smart_open(&i->device, i->node.c_str()))
+      continue;
+
+    scsismart_result result;
+    result.size = sizeof(result);
+    int code = scsismart_check(&i->device, &options, &result);
+    if(code == -1) {
+      ERROR("%s: unable to check %s: %s", SCSI_SMART_PLUGIN, i->node.c_str(), strerror(errno));
+      continue;
+    }
+
+    if(code == SCSISMART_UNKNOWN) {
+      WARNING("%s: %s: %s", SCSI_SMART_PLUGIN, i->node.c_str(), result.status);
+      scsismart_close(&i->device);
+    }
+
+    scsi_smart_submit(*i, result);
+    checked++;
+
+  }
+
+  // collectd backs off a read callback that keeps failing
+  return checked || disks.empty() ? 0 : -1;
+
+}
+
+/*
+ * Function: scsi_smart_shutdown
+ * -----------------------------
+ * Closes every disk
+ */
+static int scsi_smart_shutdown(void) {
+
+  for(vector<scsi_smart_disk>::iterator i = disks.begin(); i != disks.end(); i++)
+    if(i->device.fd != -1)
+      scsismart_close(&i->device);
+
+  disks.clear();
+
+  return 0;
+
+}
+
+/*
+ * Function: module_register
+ * -------------------------
+ * Registers the plugin's callbacks, called by collectd when it loads
+ */
+extern "C" __attribute__((visibility("default"))) void module_register(void) {
+
+  scsismart_options_init(&options);
+
+  plugin_register_complex_config(SCSI_SMART_PLUGIN, scsi_smart_config);
+  plugin_register_init(SCSI_SMART_PLUGIN, scsi_smart_init);
+  plugin_register_read(SCSI_SMART_PLUGIN, scsi_smart_read);
+  plugin_register_shutdown(SCSI_SMART_PLUGIN, scsi_smart_shutdown);
+
+}
@@ -0,0 +1,402 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "daemon.h"
+
+#include <algorithm>
+#include <iostream>
+#include <set>
+
+/*
+ * Function: daemon_monitored
+ * --------------------------
+ * Returns whether devices of a class are checked, as for --all enclosures,
+ * RAID volumes and anything else can't be
+ * device_class: Class returned by sysfs_classify
+ */
+static bool daemon_monitored(uint8_t device_class) {
+
+  return device_class == DEVICE_CLASS_ATA || device_class == DEVICE_CLASS_SAS;
+
+}
+
+Daemon::~Daemon() {
+
+  for(map<string, daemon_device>::iterator i = devices.begin(); i != devices.end(); i++)
+    if(i->second.fd != -1)
+      close(i->second.fd);
+
+}
+
+/*
+ * Function: daemon_tier
+ * ---------------------
+ * Returns the cadence tier of a device after a check.  New errors or a
+ * value nearing its threshold are urgent, failure counters moving or a
+ * warning are suspect, otherwise the device backs off once it has been
+ * quiet for a few checks in a row.
+ * device: Reference to the device, its quiet count is updated
+ * health: What the check saw
+ */
+int daemon_tier(daemon_device& device, const device_health& health) {
+
+  // Nothing can be compared with a failed check or the first one
+  if(!health.valid) {
+    device.quiet = 0;
+    return DAEMON_TIER_NORMAL;
+  }
+
+  const device_health& last = device.health;
+  bool compare = last.valid;
+
+  if((compare && health.errors > last.errors) || health.margin <= DAEMON_MARGIN_URGENT) {
+    device.quiet = 0;
+    return DAEMON_TIER_URGENT;
+  }
+
+  if((compare && health.counters != last.counters) || health.degraded || health.margin <= DAEMON_MARGIN_SUSPECT) {
+    device.quiet = 0;
+    return DAEMON_TIER_SUSPECT;
+  }
+
+  if(compare)
+    device.quiet++;
+
+  return device.quiet >= DAEMON_QUIET_CHECKS ? DAEMON_TIER_HEALTHY : DAEMON_TIER_NORMAL;
+
+}
+
+/*
+ * Method: tier_interval
+ * ---------------------
+ * Returns the seconds between checks in a tier, the tighter tiers are never
+ * slower and the healthy tier never faster than the normal interval
+ * tier: Cadence tier
+ */
+time_t Daemon::tier_interval(int tier) const {
+
+  switch(tier) {
+    case DAEMON_TIER_URGENT:
+      return min(DAEMON_URGENT_INTERVAL, interval);
+    case DAEMON_TIER_SUSPECT:
+      return min(DAEMON_SUSPECT_INTERVAL, interval);
+    case DAEMON_TIER_HEALTHY:
+      return max(DAEMON_HEALTHY_INTERVAL, interval);
+    default:
+      return interval;
+  }
+
+}
+
+/*
+ * Method: publish
+ * ---------------
+ * Adds the schedule to a device's report and publishes it in the device's
+ * slot.  Published times are wall clock times, which consumers can compare
+ * with their own.
+ * device: The device
+ * report: Reference to the report of the check
+ * now: Current time
+ */
+void Daemon::publish(daemon_device& device, shm_report& report, time_t now) {
+
+  // A device added while the segment was full takes a slot once one frees
+  if(device.slot == -1 && shm)
+    device.slot = shm->allocate();
+  if(device.slot == -1)
+    return;
+
+  time_t wall = time(0);
+
+  report.in_use = 1;
+  report.tier = device.tier;
+  report.checked = wall;
+  report.due = wall + (device.due - now);
+  shm_copy(report.node, sizeof(report.node), device.device.node);
+
+  shm->publish(device.slot, report);
+
+}
+
+/*
+ * Method: add
+ * -----------
+ * Starts monitoring a device if it is one that can be checked
+ * name: SCSI generic device name e.g. sg3
+ * due: When it is first checked
+ */
+void Daemon::add(const string& name, time_t due) {
+
+  if(devices.count(name))
+    return;
+
+  uint8_t device_class = sysfs_classify(sysfs_root, name);
+  if(!daemon_monitored(device_class))
+    return;
+
+  daemon_device& device = devices[name];
+  device.device.name = name;
+  device.device.node = dev_root + "/" + name;
+  device.device.device_class = device_class;
+  device.fd = -1;
+  device.attempts = 0;
+  device.tier = DAEMON_TIER_NORMAL;
+  device.quiet = 0;
+  device.due = due;
+  device.timer = wheel.add(due, name);
+  device.slot = shm ? shm->allocate() : -1;
+
+  if(shm && device.slot == -1)
+    cerr << device.device.node << ": all " << SHM_SLOTS << " shared memory slots are in use, results are not published" << endl;
+
+}
+
+/*
+ * Method: remove
+ * --------------
+ * Stops monitoring a device, what was saved about it stays in the state
+ * directory in case it returns
+ * name: SCSI generic device name e.g. sg3
+ */
+void Daemon::remove(const string& name) {
+
+  map<string, daemon_device>::iterator device = devices.find(name);
+  if(device == devices.end())
+    return;
+
+  if(device->second.fd != -1)
+    close(device->second.fd);
+
+  if(device->second.slot != -1)
+    shm->release(device->second.slot);
+
+  wheel.cancel(device->second.timer);
+  devices.erase(device);
+
+}
+
+/*
+ * Method: synchronize
+ * -------------------
+ * Adds devices found in sysfs and removes those no longer there, used at
+ * start up and when uevents have been lost
+ * now: Current time
+ */
+void Daemon::synchronize(time_t now) {
+
+  set<string> present;
+
+  vector<sg_device> found = sysfs_discover(sysfs_root);
+  for(vector<sg_device>::iterator i = found.begin(); i != found.end(); i++) {
+    present.insert(i->name);
+    add(i->name, now);
+  }
+
+  vector<string> gone;
+  for(map<string, daemon_device>::iterator i = devices.begin(); i != devices.end(); i++)
+    if(!present.count(i->first))
+      gone.push_back(i->first);
+
+  for(vector<string>::iterator i = gone.begin(); i != gone.end(); i++)
+    remove(*i);
+
+}
+
+/*
+ * Method: dispatch
+ * ----------------
+ * Acts upon a uevent, new devices are checked once udev has had time to
+ * create their node
+ * event: The uevent
+ * now: Current time
+ */
+void Daemon::dispatch(const uevent& event, time_t now) {
+
+  if(event.subsystem != UEVENT_SUBSYSTEM_SG || event.devname.empty())
+    return;
+
+  if(event.action == UEVENT_ACTION_ADD)
+    add(event.devname, now + DAEMON_SETTLE);
+  else if(event.action == UEVENT_ACTION_REMOVE)
+    remove(event.devname);
+
+}
+
+/*
+ * Method: drain
+ * -------------
+ * Dispatches every pending uevent
+ * now: Current time
+ */
+void Daemon::drain(time_t now) {
+
+  uevent event;
+
+  int result;
+  while((result = source.receive(event)) != UEVENT_NONE) {
+    if(result == UEVENT_OVERFLOW)
+      synchronize(now);
+    else
+      dispatch(event, now);
+  }
+
+}
+
+/*
+ * Method: run_due
+ * ---------------
+ * Checks every device whose time has come, all at once so a slow drive
+ * doesn't hold up the rest, and moves each to the tier its health calls
+ * for
+ * now: Current time
+ */
+void Daemon::run_due(time_t now) {
+
+  vector<string> expired;
+  wheel.expire(now, expired);
+
+  vector<string> names;
+  vector<sg_device> due;
+  vector<int> fds;
+
+  for(vector<string>::iterator i = expired.begin(); i != expired.end(); i++) {
+
+    daemon_device& device = devices[*i];
+
+    if(device.fd == -1) {
+      device.fd = open(device.device.node.c_str(), O_RDWR | O_CLOEXEC);
+      if(device.fd == -1) {
+        bool retry = ++device.attempts < DAEMON_OPEN_ATTEMPTS;
+        if(!retry)
+          device.attempts = 0;
+        device.due = now + (retry ? DAEMON_SETTLE : interval);
+        device.timer = wheel.add(device.due, *i);
+        continue;
+      }
+    }
+
+    names.push_back(*i);
+    due.push_back(device.device);
+    fds.push_back(device.fd);
+
+  }
+
+  if(due.empty())
+    return;
+
+  vector<device_health> healths = check(due, fds);
+
+  for(size_t i = 0; i < names.size(); i++) {
+
+    daemon_device& device = devices[names[i]];
+    device_health& health = healths[i];
+
+    device.fd = fds[i];
+    device.tier = daemon_tier(device, health);
+    if(health.valid)
+      device.health = health;
+
+    device.due = now + tier_interval(device.tier);
+    device.timer = wheel.add(device.due, names[i]);
+
+    publish(device, health.report, now);
+
+  }
+
+}
+
+/*
+ * Method: timeout
+ * ---------------
+ * Returns milliseconds until the next check may be due, or -1 if none is
+ * now: Current time
+ */
+int Daemon::timeout(time_t now) const {
+
+  return wheel.timeout(now);
+
+}
+
+/*
+ * Method: find
+ * ------------
+ * Returns the monitored device with a name, or null if there isn't one
+ * name: SCSI generic device name e.g. sg3
+ */
+const daemon_device* Daemon::find(const string& name) const {
+
+  map<string, daemon_device>::const_iterator device = devices.find(name);
+  return device == devices.end() ? 0 : &device->second;
+
+}
+
+/*
+ * Method: run
+ * -----------
+ * Monitors devices until stop is set, returning false with errno set if
+ * waiting for events fails
+ * stop: Flag set asynchronously e.g. by a signal handler
+ */
+bool Daemon::run(volatile sig_atomic_t& stop) {
+
+  // Subscribe before enumerating so nothing added in between is missed
+  synchronize(daemon_now());
+
+  while(!stop) {
+
+    struct pollfd fds = { source.fd(), POLLIN, 0 };
+    int ready = poll(&fds, 1, timeout(daemon_now()));
+    if(ready == -1 && errno != EINTR)
+      return false;
+
+    time_t now = daemon_now();
+    if(ready > 0)
+      drain(now);
+
+    run_due(now);
+
+  }
+
+  return true;
+
+}
+
+/*
+ * Function: daemon_now
+ * --------------------
+ * Returns seconds on a clock unaffected by changes to the time of day
+ */
+time_t daemon_now() {
+
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return now.tv_sec;
+
+}
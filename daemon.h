@@ -0,0 +1,250 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef _daemon_H_
+#define _daemon_H_
+
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+
+#include "discover.h"
+#include "metrics.h"
+#include "shm.h"
+#include "uevent.h"
+#include "wheel.h"
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/* Default seconds between checks of each device in the normal tier */
+const time_t DAEMON_INTERVAL_DEFAULT = 3600;
+
+/* Cadence tiers, a device moves between them as its health changes */
+const int DAEMON_TIER_URGENT         = 0;
+const int DAEMON_TIER_SUSPECT        = 1;
+const int DAEMON_TIER_NORMAL         = 2;
+const int DAEMON_TIER_HEALTHY        = 3;
+
+/* Seconds between checks in the tiers either side of the normal one */
+const time_t DAEMON_URGENT_INTERVAL  = 300;
+const time_t DAEMON_SUSPECT_INTERVAL = 1800;
+const time_t DAEMON_HEALTHY_INTERVAL = 6 * 3600;
+
+/* Uneventful checks in a row before a device backs off to the healthy tier */
+const int DAEMON_QUIET_CHECKS        = 3;
+
+/* Normalized values this close to their vendor threshold tighten the cadence */
+const int DAEMON_MARGIN_URGENT       = 10;
+const int DAEMON_MARGIN_SUSPECT      = 25;
+const int DAEMON_MARGIN_NONE         = 255;
+
+/* Seconds allowed for udev to create the node of a hotplugged device */
+const time_t DAEMON_SETTLE           = 2;
+
+/* Attempts to open a new device before falling back to the interval */
+const int DAEMON_OPEN_ATTEMPTS       = 5;
+
+/*
+ * Function: daemon_now
+ * --------------------
+ * Returns seconds on a clock unaffected by changes to the time of day
+ */
+time_t daemon_now();
+
+/*
+ * Struct: device_health
+ * ---------------------
+ * What a check saw that decides how soon the device is checked again, the
+ * report published for other processes to read and the values behind its
+ * performance data, labelled without a prefix
+ */
+struct device_health {
+  bool valid;
+  bool degraded;
+  uint64_t counters;
+  uint64_t errors;
+  int margin;
+  string key;
+  shm_report report;
+  vector<metric> values;
+
+  device_health()
+  : valid(false), degraded(false), counters(0), errors(0), margin(DAEMON_MARGIN_NONE)
+  {
+    memset(&report, 0, sizeof(report));
+  }
+};
+
+/*
+ * Type: DaemonCheck
+ * -----------------
+ * Checks every device that is due at once and reports the result of each,
+ * in device order.  The health returned is valid if the check completed,
+ * degraded if it warned, counters a digest of the raw values of failure
+ * counters, errors the size of the device's error log and margin the
+ * smallest distance of a normalized value above its threshold.  The key
+ * identifies the drive, empty if it has no identity of its own.  The
+ * report need only describe the check, the daemon adds the schedule.  A
+ * descriptor the check had to close is set to -1, the device is opened
+ * again for its next check.
+ */
+typedef function<vector<device_health>(const vector<sg_device>& devices, vector<int>& fds)> DaemonCheck;
+
+/*
+ * Struct: daemon_device
+ * ---------------------
+ * A device being monitored, its descriptor stays open between checks
+ */
+struct daemon_device {
+  sg_device device;
+  int fd;
+  time_t due;
+  TimerWheel::Timer timer;
+  int attempts;
+  int tier;
+  int quiet;
+  int slot;
+  device_health health;
+};
+
+/*
+ * Function: daemon_tier
+ * ---------------------
+ * Returns the cadence tier of a device after a check.  New errors or a
+ * value nearing its threshold are urgent, failure counters moving or a
+ * warning are suspect, otherwise the device backs off once it has been
+ * quiet for a few checks in a row.
+ * device: Reference to the device, its quiet count is updated
+ * health: What the check saw
+ */
+int daemon_tier(daemon_device& device, const device_health& health);
+
+/*
+ * Class: Daemon
+ * -------------
+ * Monitors devices as they come and go.  Devices present at start up are
+ * found in sysfs, after that only uevents add or remove them.  Each is
+ * checked when added and then every interval.
+ */
+class Daemon {
+
+private:
+
+  UeventSource& source;
+  string sysfs_root;
+  string dev_root;
+  DaemonCheck check;
+  time_t interval;
+
+  map<string, daemon_device> devices;
+  TimerWheel wheel;
+  ShmWriter* shm;
+
+  void publish(daemon_device& device, shm_report& report, time_t now);
+
+  void add(const string& name, time_t due);
+  void remove(const string& name);
+  time_t tier_interval(int tier) const;
+
+public:
+
+  Daemon(UeventSource& source, const string& sysfs_root, const string& dev_root, DaemonCheck check,
+         time_t interval = DAEMON_INTERVAL_DEFAULT, time_t now = daemon_now()) :
+    source(source), sysfs_root(sysfs_root), dev_root(dev_root), check(check), interval(interval), wheel(now), shm(0) {}
+  ~Daemon();
+
+  /*
+   * Method: publish
+   * ---------------
+   * Publishes the report of each check in a shared memory segment, a slot
+   * is held for each device from when it is added until it is removed
+   * writer: Reference to the open segment
+   */
+  void publish(ShmWriter& writer) { shm = &writer; }
+
+  /*
+   * Method: synchronize
+   * -------------------
+   * Adds devices found in sysfs and removes those no longer there, used at
+   * start up and when uevents have been lost
+   * now: Current time
+   */
+  void synchronize(time_t now);
+
+  /*
+   * Method: dispatch
+   * ----------------
+   * Acts upon a uevent, new devices are checked once udev has had time to
+   * create their node
+   * event: The uevent
+   * now: Current time
+   */
+  void dispatch(const uevent& event, time_t now);
+
+  /*
+   * Method: drain
+   * -------------
+   * Dispatches every pending uevent
+   * now: Current time
+   */
+  void drain(time_t now);
+
+  /*
+   * Method: run_due
+   * ---------------
+   * Checks every device whose time has come and moves it to the tier its
+   * health calls for
+   * now: Current time
+   */
+  void run_due(time_t now);
+
+  /*
+   * Method: timeout
+   * ---------------
+   * Returns milliseconds until the next check may be due, or -1 if none is
+   * now: Current time
+   */
+  int timeout(time_t now) const;
+
+  /*
+   * Method: run
+   * -----------
+   * Monitors devices until stop is set, returning false with errno set if
+   * waiting for events fails
+   * stop: Flag set asynchronously e.g. by a signal handler
+   */
+  bool run(volatile sig_atomic_t& stop);
+
+  size_t size() const { return devices.size(); }
+  bool monitoring(const string& name) const { return devices.count(name) != 0; }
+  const daemon_device* find(const string& name) const;
+
+};
+
+#endif//_daemon_H_
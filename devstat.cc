@@ -0,0 +1,105 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "endian.h"
+#include "devstat.h"
+
+const devstat_descriptor devstat_descriptors[] = {
+  // General Statistics
+  { DEVSTAT_PAGE_GENERAL,        0x08, 32, false, "power_on_resets" },
+  { DEVSTAT_PAGE_GENERAL,        0x10, 32, false, "power_on_hours" },
+  { DEVSTAT_PAGE_GENERAL,        0x18, 48, false, "logical_sectors_written" },
+  { DEVSTAT_PAGE_GENERAL,        0x20, 48, false, "write_commands" },
+  { DEVSTAT_PAGE_GENERAL,        0x28, 48, false, "logical_sectors_read" },
+  { DEVSTAT_PAGE_GENERAL,        0x30, 48, false, "read_commands" },
+  { DEVSTAT_PAGE_GENERAL,        0x40, 32, false, "pending_errors" },
+  { DEVSTAT_PAGE_GENERAL,        0x48, 16, false, "workload_utilization" },
+  // Free-Fall Statistics
+  { DEVSTAT_PAGE_FREE_FALL,      0x08, 32, false, "free_fall_events" },
+  { DEVSTAT_PAGE_FREE_FALL,      0x10, 32, false, "overlimit_shock_events" },
+  // Rotating Media Statistics
+  { DEVSTAT_PAGE_ROTATING_MEDIA, 0x08, 32, false, "spindle_motor_power_on_hours" },
+  { DEVSTAT_PAGE_ROTATING_MEDIA, 0x10, 32, false, "head_flying_hours" },
+  { DEVSTAT_PAGE_ROTATING_MEDIA, 0x18, 32, false, "head_load_events" },
+  { DEVSTAT_PAGE_ROTATING_MEDIA, 0x20, 32, false, "reallocated_sectors" },
+  { DEVSTAT_PAGE_ROTATING_MEDIA, 0x28, 32, false, "read_recovery_attempts" },
+  { DEVSTAT_PAGE_ROTATING_MEDIA, 0x30, 32, false, "mechanical_start_failures" },
+  { DEVSTAT_PAGE_ROTATING_MEDIA, 0x38, 32, false, "reallocation_candidates" },
+  { DEVSTAT_PAGE_ROTATING_MEDIA, 0x40, 32, false, "high_priority_unloads" },
+  // General Errors Statistics
+  { DEVSTAT_PAGE_GENERAL_ERRORS, 0x08, 32, false, "reported_uncorrectable_errors" },
+  { DEVSTAT_PAGE_GENERAL_ERRORS, 0x10, 32, false, "command_resets" },
+  // Temperature Statistics
+  { DEVSTAT_PAGE_TEMPERATURE,    0x08,  8, true,  "current_temperature" },
+  { DEVSTAT_PAGE_TEMPERATURE,    0x10,  8, true,  "average_short_term_temperature" },
+  { DEVSTAT_PAGE_TEMPERATURE,    0x18,  8, true,  "average_long_term_temperature" },
+  { DEVSTAT_PAGE_TEMPERATURE,    0x20,  8, true,  "highest_temperature" },
+  { DEVSTAT_PAGE_TEMPERATURE,    0x28,  8, true,  "lowest_temperature" },
+  { DEVSTAT_PAGE_TEMPERATURE,    0x30,  8, true,  "highest_average_short_term_temperature" },
+  { DEVSTAT_PAGE_TEMPERATURE,    0x38,  8, true,  "lowest_average_short_term_temperature" },
+  { DEVSTAT_PAGE_TEMPERATURE,    0x40,  8, true,  "highest_average_long_term_temperature" },
+  { DEVSTAT_PAGE_TEMPERATURE,    0x48,  8, true,  "lowest_average_long_term_temperature" },
+  { DEVSTAT_PAGE_TEMPERATURE,    0x50, 32, false, "time_over_temperature" },
+  { DEVSTAT_PAGE_TEMPERATURE,    0x58,  8, true,  "maximum_operating_temperature" },
+  { DEVSTAT_PAGE_TEMPERATURE,    0x60, 32, false, "time_under_temperature" },
+  { DEVSTAT_PAGE_TEMPERATURE,    0x68,  8, true,  "minimum_operating_temperature" },
+  // Transport Statistics
+  { DEVSTAT_PAGE_TRANSPORT,      0x08, 32, false, "hardware_resets" },
+  { DEVSTAT_PAGE_TRANSPORT,      0x10, 32, false, "asr_events" },
+  { DEVSTAT_PAGE_TRANSPORT,      0x18, 32, false, "interface_crc_errors" },
+  // Solid State Device Statistics
+  { DEVSTAT_PAGE_SSD,            0x08,  8, false, "percentage_used" },
+};
+
+const int devstat_descriptor_num = sizeof(devstat_descriptors) / sizeof(devstat_descriptor);
+
+/*
+ * Function: devstat_value
+ * -----------------------
+ * Extracts a statistic from its page, returns false if the device doesn't
+ * support the statistic or its value is currently invalid
+ * page: Device Statistics page the descriptor refers to
+ * descriptor: Reference to the statistic's descriptor
+ * value: Reference to receive the sign extended value
+ */
+bool devstat_value(const unsigned char* page, const devstat_descriptor& descriptor, int64_t& value) {
+
+  uint64_t qword;
+  memcpy(&qword, page + descriptor.offset, sizeof(uint64_t));
+  qword = StorageEndian::swap(qword);
+
+  if((qword & (DEVSTAT_FLAG_SUPPORTED | DEVSTAT_FLAG_VALID)) != (DEVSTAT_FLAG_SUPPORTED | DEVSTAT_FLAG_VALID))
+    return false;
+
+  uint64_t raw = qword & ((1ULL << descriptor.bits) - 1);
+
+  // Sign extend from the top bit of the field
+  if(descriptor.is_signed && (raw & (1ULL << (descriptor.bits - 1))))
+    raw |= ~((1ULL << descriptor.bits) - 1);
+
+  value = static_cast<int64_t>(raw);
+
+  return true;
+
+}
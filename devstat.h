@@ -0,0 +1,74 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _devstat_H_
+#define _devstat_H_
+
+#include <stdint.h>
+
+/* Device Statistics pages */
+const uint8_t DEVSTAT_PAGE_SUPPORTED      = 0x00;
+const uint8_t DEVSTAT_PAGE_GENERAL        = 0x01;
+const uint8_t DEVSTAT_PAGE_FREE_FALL      = 0x02;
+const uint8_t DEVSTAT_PAGE_ROTATING_MEDIA = 0x03;
+const uint8_t DEVSTAT_PAGE_GENERAL_ERRORS = 0x04;
+const uint8_t DEVSTAT_PAGE_TEMPERATURE    = 0x05;
+const uint8_t DEVSTAT_PAGE_TRANSPORT      = 0x06;
+const uint8_t DEVSTAT_PAGE_SSD            = 0x07;
+
+/* Device Statistics flags, held in the top byte of each statistic */
+const uint64_t DEVSTAT_FLAG_SUPPORTED = 1ULL << 63;
+const uint64_t DEVSTAT_FLAG_VALID     = 1ULL << 62;
+
+/* Offset of the supported page count in page 0 */
+const int DEVSTAT_SUPPORTED_COUNT = 8;
+
+/*
+ * Struct: devstat_descriptor
+ * --------------------------
+ * Location and format of a single statistic within the Device Statistics
+ * log, see ACS-3 9.5
+ */
+typedef struct {
+  uint8_t     page;
+  uint16_t    offset;
+  uint8_t     bits;
+  bool        is_signed;
+  const char* name;
+} devstat_descriptor;
+
+/* Table of known statistics, ordered by page and offset */
+extern const devstat_descriptor devstat_descriptors[];
+extern const int devstat_descriptor_num;
+
+/*
+ * Function: devstat_value
+ * -----------------------
+ * Extracts a statistic from its page, returns false if the device doesn't
+ * support the statistic or its value is currently invalid
+ * page: Device Statistics page the descriptor refers to
+ * descriptor: Reference to the statistic's descriptor
+ * value: Reference to receive the sign extended value
+ */
+bool devstat_value(const unsigned char* page, const devstat_descriptor& descriptor, int64_t& value);
+
+#endif//_devstat_H_
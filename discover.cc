@@ -0,0 +1,171 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdlib.h>
+#include <limits.h>
+#include <dirent.h>
+#include <unistd.h>
+
+#include "discover.h"
+
+#include <algorithm>
+#include <fstream>
+
+/* Host drivers whose disks are logical volumes rather than drives */
+static const char* const raid_drivers[] = { "megaraid_sas", "aacraid", "hpsa", "smartpqi" };
+
+/*
+ * Function: sysfs_read
+ * --------------------
+ * Returns the first line of a sysfs attribute with trailing space removed,
+ * or an empty string if it can't be read
+ * path: Path of the attribute
+ */
+static string sysfs_read(const string& path) {
+
+  ifstream in(path.c_str());
+
+  string line;
+  getline(in, line);
+
+  string::size_type end = line.find_last_not_of(" \t\n");
+  return end == string::npos ? "" : line.substr(0, end + 1);
+
+}
+
+/*
+ * Function: sysfs_exists
+ * ----------------------
+ * Returns whether a sysfs attribute exists
+ * path: Path of the attribute
+ */
+static bool sysfs_exists(const string& path) {
+
+  return access(path.c_str(), F_OK) == 0;
+
+}
+
+/*
+ * Function: sysfs_host_driver
+ * ---------------------------
+ * Returns the name of the driver of the host a device is attached to, from
+ * the H:C:T:L name of the directory its device link resolves to
+ * root: sysfs mount point
+ * device: Path of the device link
+ */
+static string sysfs_host_driver(const string& root, const string& device) {
+
+  char resolved[PATH_MAX];
+  if(!realpath(device.c_str(), resolved))
+    return "";
+
+  string address = resolved;
+  address = address.substr(address.rfind('/') + 1);
+
+  string::size_type colon = address.find(':');
+  if(colon == string::npos || colon == 0)
+    return "";
+
+  return sysfs_read(root + "/class/scsi_host/host" + address.substr(0, colon) + "/proc_name");
+
+}
+
+/*
+ * Function: sysfs_classify
+ * ------------------------
+ * Classifies a SCSI generic device from its sysfs attributes.  Disks which
+ * expose the ATA Information VPD page, or that libata reports with an ATA
+ * vendor, are ATA behind a SAT.  Other disks are native SCSI, unless they
+ * are logical volumes of a RAID controller.
+ * root: sysfs mount point
+ * name: SCSI generic device name e.g. sg3
+ */
+uint8_t sysfs_classify(const string& root, const string& name) {
+
+  string device = root + "/class/scsi_generic/" + name + "/device";
+
+  string type = sysfs_read(device + "/type");
+  if(type.empty())
+    return DEVICE_CLASS_UNKNOWN;
+
+  switch(atoi(type.c_str())) {
+    case SYSFS_TYPE_DISK:
+      break;
+    case SYSFS_TYPE_ENCLOSURE:
+      return DEVICE_CLASS_ENCLOSURE;
+    default:
+      return DEVICE_CLASS_OTHER;
+  }
+
+  // Page 0x89 only exists when a SAT translates for an ATA device
+  if(sysfs_exists(device + "/vpd_pg89") || sysfs_read(device + "/vendor") == "ATA")
+    return DEVICE_CLASS_ATA;
+
+  string driver = sysfs_host_driver(root, device);
+  for(size_t i = 0; i < sizeof(raid_drivers) / sizeof(raid_drivers[0]); i++)
+    if(driver == raid_drivers[i])
+      return DEVICE_CLASS_RAID;
+
+  return DEVICE_CLASS_SAS;
+
+}
+
+/*
+ * Function: sysfs_discover
+ * ------------------------
+ * Returns every SCSI generic device registered in sysfs with its class,
+ * ordered by name
+ * root: sysfs mount point
+ */
+vector<sg_device> sysfs_discover(const string& root) {
+
+  vector<sg_device> devices;
+
+  DIR* dir = opendir((root + "/class/scsi_generic").c_str());
+  if(!dir)
+    return devices;
+
+  struct dirent* entry;
+  while((entry = readdir(dir))) {
+
+    if(entry->d_name[0] == '.')
+      continue;
+
+    sg_device device;
+    device.name = entry->d_name;
+    device.node = "/dev/" + device.name;
+    device.device_class = sysfs_classify(root, device.name);
+    devices.push_back(device);
+
+  }
+
+  closedir(dir);
+
+  // Order numerically so sg10 follows sg9
+  sort(devices.begin(), devices.end(), [](const sg_device& a, const sg_device& b) {
+    return a.name.size() != b.name.size() ? a.name.size() < b.name.size() : a.name < b.name;
+  });
+
+  return devices;
+
+}
@@ -0,0 +1,80 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _discover_H_
+#define _discover_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/* Default mount point of sysfs */
+const char* const SYSFS_ROOT_DEFAULT = "/sys";
+
+/* Device classes, decided from sysfs before any command is sent */
+const uint8_t DEVICE_CLASS_UNKNOWN   = 0;
+const uint8_t DEVICE_CLASS_ATA       = 1;
+const uint8_t DEVICE_CLASS_SAS       = 2;
+const uint8_t DEVICE_CLASS_RAID      = 3;
+const uint8_t DEVICE_CLASS_ENCLOSURE = 4;
+const uint8_t DEVICE_CLASS_OTHER     = 5;
+
+/* SCSI peripheral device types as reported in sysfs */
+const int SYSFS_TYPE_DISK      = 0;
+const int SYSFS_TYPE_ENCLOSURE = 13;
+
+/*
+ * Struct: sg_device
+ * -----------------
+ * A SCSI generic device found in sysfs and how it should be checked
+ */
+struct sg_device {
+  string name;
+  string node;
+  uint8_t device_class;
+};
+
+/*
+ * Function: sysfs_classify
+ * ------------------------
+ * Classifies a SCSI generic device from its sysfs attributes.  Disks which
+ * expose the ATA Information VPD page, or that libata reports with an ATA
+ * vendor, are ATA behind a SAT.  Other disks are native SCSI, unless they
+ * are logical volumes of a RAID controller.
+ * root: sysfs mount point
+ * name: SCSI generic device name e.g. sg3
+ */
+uint8_t sysfs_classify(const string& root, const string& name);
+
+/*
+ * Function: sysfs_discover
+ * ------------------------
+ * Returns every SCSI generic device registered in sysfs with its class,
+ * ordered by name
+ * root: sysfs mount point
+ */
+vector<sg_device> sysfs_discover(const string& root);
+
+#endif//_discover_H_
@@ -46,7 +46,7 @@ public:
         return bswap_16(t);
       case 4:
         return bswap_32(t);
-      case 16:
+      case 8:
         return bswap_64(t);
     }
 #endif
@@ -0,0 +1,210 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+
+#include "flight.h"
+
+#include <fstream>
+#include <sstream>
+
+/*
+ * Function: flight_sanitize
+ * -------------------------
+ * Returns text usable as a file name, runs of anything but letters,
+ * digits, dots and dashes collapse to an underscore
+ * text: Text to sanitize
+ */
+static string flight_sanitize(const string& text) {
+
+  string name;
+  for(string::const_iterator i = text.begin(); i != text.end(); i++) {
+    if(isalnum(*i) || *i == '.' || *i == '-')
+      name += *i;
+    else if(!name.empty() && name[name.size() - 1] != '_')
+      name += '_';
+  }
+
+  while(!name.empty() && name[name.size() - 1] == '_')
+    name.erase(name.size() - 1);
+
+  return name;
+
+}
+
+/*
+ * Function: flight_key
+ * --------------------
+ * Returns a file name identifying the device behind a node without sending
+ * it a command.  SCSI devices are named by their sysfs wwid, so a disk's sd
+ * and sg nodes share a key, anything else by its device number or name.
+ * sysfs_root: sysfs mount point
+ * node: Device as given on the command line or found in sysfs
+ */
+string flight_key(const string& sysfs_root, const string& node) {
+
+  struct stat st;
+  if(stat(node.c_str(), &st) == -1 || !(S_ISCHR(st.st_mode) || S_ISBLK(st.st_mode)))
+    return flight_sanitize(node);
+
+  stringstream device;
+  device << (S_ISCHR(st.st_mode) ? "char" : "block") << "/" << major(st.st_rdev) << ":" << minor(st.st_rdev);
+
+  ifstream in((sysfs_root + "/dev/" + device.str() + "/device/wwid").c_str());
+  string wwid;
+  getline(in, wwid);
+
+  if(!flight_sanitize(wwid).empty())
+    return flight_sanitize(wwid);
+
+  return flight_sanitize("dev/" + device.str());
+
+}
+
+/*
+ * Method: begin
+ * -------------
+ * Waits for the device's lock, returning false if it can't be had, in
+ * which case nothing is shared
+ * dir: Directory holding the locks and recorded results
+ * key: Returned by flight_key
+ * wait: Seconds to wait for the lock
+ */
+bool SingleFlight::begin(const string& dir, const string& key, int wait) {
+
+  path = dir + "/" + key;
+
+  mkdir(dir.c_str(), 0755);
+
+  lock = open((path + ".lock").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if(lock == -1)
+    return false;
+
+  // Whoever holds the lock is checking the device, wait for what it found
+  struct timespec poll = { 0, FLIGHT_POLL_MS * 1000000L };
+  for(int waited = 0; flock(lock, LOCK_EX | LOCK_NB) == -1; waited += FLIGHT_POLL_MS) {
+    if(errno != EWOULDBLOCK || waited >= wait * 1000) {
+      close(lock);
+      lock = -1;
+      return false;
+    }
+    nanosleep(&poll, 0);
+  }
+
+  return true;
+
+}
+
+/*
+ * Method: finish
+ * --------------
+ * Releases the lock
+ */
+void SingleFlight::finish() {
+
+  if(lock == -1)
+    return;
+
+  close(lock);
+  lock = -1;
+
+}
+
+/*
+ * Method: load
+ * ------------
+ * Reads the result recorded by a check with the same options, returning
+ * false if there is none or it is older than the TTL
+ * options: Digest of the options the check is made with
+ * ttl: Seconds a recorded result may be reused for
+ * result: Reference to receive the result
+ */
+bool SingleFlight::load(const string& options, time_t ttl, flight_result& result) const {
+
+  if(lock == -1)
+    return false;
+
+  ifstream in((path + "." + options).c_str());
+
+  // One field per line, the status and performance data hold spaces
+  string word;
+  time_t checked;
+  time_t now = time(0);
+  if(!(in >> word >> checked) || word != "checked" || checked > now || now - checked > ttl)
+    return false;
+
+  if(!(in >> word >> result.code) || word != "code")
+    return false;
+
+  in.ignore(1);
+  if(!getline(in, result.key) || !getline(in, result.out) || !getline(in, result.perf))
+    return false;
+
+  return true;
+
+}
+
+/*
+ * Method: save
+ * ------------
+ * Atomically records the result of a check
+ * options: Digest of the options the check was made with
+ * result: Reference to the result
+ */
+bool SingleFlight::save(const string& options, const flight_result& result) const {
+
+  if(lock == -1)
+    return false;
+
+  if(result.key.find('\n') != string::npos || result.out.find('\n') != string::npos ||
+     result.perf.find('\n') != string::npos)
+    return false;
+
+  string target = path + "." + options;
+  string temp = target + ".tmp." + to_string(getpid());
+
+  {
+    ofstream out(temp.c_str());
+    out << "checked " << time(0) << endl
+        << "code " << result.code << endl
+        << result.key << endl
+        << result.out << endl
+        << result.perf << endl;
+
+    if(!out) {
+      unlink(temp.c_str());
+      return false;
+    }
+  }
+
+  return rename(temp.c_str(), target.c_str()) == 0;
+
+}
@@ -0,0 +1,129 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef _flight_H_
+#define _flight_H_
+
+#include <time.h>
+
+#include <string>
+
+using namespace std;
+
+/* Where invocations checking the same device meet */
+const char* const FLIGHT_DIR_DEFAULT = "/run/check_scsi_smart";
+
+/* Seconds to wait for another invocation to finish with a device, half
+ * the default NRPE and check timeouts of ten seconds so a waiter still has
+ * time to read the drive itself */
+const int FLIGHT_WAIT = 5;
+
+/* Milliseconds between attempts to take the lock */
+const int FLIGHT_POLL_MS = 50;
+
+/*
+ * Struct: flight_result
+ * ---------------------
+ * The outcome of a check as its invocation reported it, performance data
+ * labels are unprefixed
+ */
+struct flight_result {
+  int code;
+  string key;
+  string out;
+  string perf;
+};
+
+/*
+ * Function: flight_key
+ * --------------------
+ * Returns a file name identifying the device behind a node without sending
+ * it a command.  SCSI devices are named by their sysfs wwid, so a disk's sd
+ * and sg nodes share a key, anything else by its device number or name.
+ * sysfs_root: sysfs mount point
+ * node: Device as given on the command line or found in sysfs
+ */
+string flight_key(const string& sysfs_root, const string& node);
+
+/*
+ * Class: SingleFlight
+ * -------------------
+ * Coalesces concurrent invocations checking the same device.  They take
+ * turns holding the device's lock, the first to check with a set of
+ * options records its result and later ones with the same options reuse
+ * it while it is fresh, never touching the device.
+ */
+class SingleFlight {
+
+private:
+
+  int lock;
+  string path;
+
+public:
+
+  SingleFlight() : lock(-1) {}
+  ~SingleFlight() { finish(); }
+
+  /*
+   * Method: begin
+   * -------------
+   * Waits for the device's lock, returning false if it can't be had, in
+   * which case nothing is shared
+   * dir: Directory holding the locks and recorded results
+   * key: Returned by flight_key
+   * wait: Seconds to wait for the lock
+   */
+  bool begin(const string& dir, const string& key, int wait = FLIGHT_WAIT);
+
+  /*
+   * Method: load
+   * ------------
+   * Reads the result recorded by a check with the same options, returning
+   * false if there is none or it is older than the TTL
+   * options: Digest of the options the check is made with
+   * ttl: Seconds a recorded result may be reused for
+   * result: Reference to receive the result
+   */
+  bool load(const string& options, time_t ttl, flight_result& result) const;
+
+  /*
+   * Method: save
+   * ------------
+   * Atomically records the result of a check
+   * options: Digest of the options the check was made with
+   * result: Reference to the result
+   */
+  bool save(const string& options, const flight_result& result) const;
+
+  /*
+   * Method: finish
+   * --------------
+   * Releases the lock
+   */
+  void finish();
+
+};
+
+#endif//_flight_H_
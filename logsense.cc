@@ -0,0 +1,95 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "scsi.h"
+#include "logsense.h"
+
+/*
+ * Function: scsi_log_sense
+ * ------------------------
+ * Send a LOG SENSE command for the cumulative values of a page
+ * fd: File descriptor pointing at a SCSI or SCSI generic device node
+ * page: Log page code
+ * buf: Data buffer to receive the data into, must be at least len bytes
+ * len: Allocation length
+ */
+SgioResult scsi_log_sense(int fd, uint8_t page, unsigned char* buf, uint16_t len) {
+
+  spc_log_sense log_sense;
+  memset(reinterpret_cast<unsigned char*>(&log_sense), 0, sizeof(spc_log_sense));
+
+  log_sense.operation_code       = SPC_LOG_SENSE;
+  log_sense.page_control_code    = LOG_PAGE_CONTROL_CUMULATIVE | (page & LOG_PAGE_CODE_MASK);
+  log_sense.allocation_length[0] = len >> 8;
+  log_sense.allocation_length[1] = len;
+
+  return sgio(fd, reinterpret_cast<unsigned char*>(&log_sense), sizeof(log_sense), buf, len);
+
+}
+
+/*
+ * Function: log_page_length
+ * -------------------------
+ * Returns the total length of a log page, header included, from its header
+ * page: Log page, at least LOG_PAGE_HEADER bytes
+ */
+int log_page_length(const unsigned char* page) {
+
+  return LOG_PAGE_HEADER + ((page[2] << 8) | page[3]);
+
+}
+
+/*
+ * Function: log_parameter_next
+ * ----------------------------
+ * Decodes the parameter at offset and advances offset to the next one.
+ * Returns false at the end of the page or if a parameter is truncated.
+ * page: Log page
+ * length: Total length of the page as read
+ * offset: Reference to the current offset, start at LOG_PAGE_HEADER
+ * parameter: Reference to receive the decoded parameter
+ */
+bool log_parameter_next(const unsigned char* page, int length, int& offset, log_parameter& parameter) {
+
+  if(offset + LOG_PARAMETER_HEADER > length)
+    return false;
+
+  const unsigned char* header = page + offset;
+
+  parameter.code = (header[0] << 8) | header[1];
+  parameter.length = header[3];
+  parameter.raw = header + LOG_PARAMETER_HEADER;
+
+  if(offset + LOG_PARAMETER_HEADER + parameter.length > length)
+    return false;
+
+  parameter.value = 0;
+  for(int i=0; i<parameter.length && i<8; i++)
+    parameter.value = (parameter.value << 8) | parameter.raw[i];
+
+  offset += LOG_PARAMETER_HEADER + parameter.length;
+
+  return true;
+
+}
@@ -0,0 +1,111 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _logsense_H_
+#define _logsense_H_
+
+#include <stdint.h>
+
+#include "sgio.h"
+
+/* Log pages */
+const uint8_t LOG_PAGE_SUPPORTED                = 0x00;
+const uint8_t LOG_PAGE_WRITE_ERRORS             = 0x02;
+const uint8_t LOG_PAGE_READ_ERRORS              = 0x03;
+const uint8_t LOG_PAGE_VERIFY_ERRORS            = 0x05;
+const uint8_t LOG_PAGE_NON_MEDIUM_ERRORS        = 0x06;
+const uint8_t LOG_PAGE_TEMPERATURE              = 0x0d;
+const uint8_t LOG_PAGE_START_STOP               = 0x0e;
+const uint8_t LOG_PAGE_INFORMATIONAL_EXCEPTIONS = 0x2f;
+
+/* Page control selecting cumulative values */
+const uint8_t LOG_PAGE_CONTROL_CUMULATIVE = 0x40;
+const uint8_t LOG_PAGE_CODE_MASK          = 0x3f;
+
+/* Size of the page and parameter headers */
+const int LOG_PAGE_HEADER      = 4;
+const int LOG_PARAMETER_HEADER = 4;
+
+/* Error counter page parameters */
+const uint16_t LOG_ERRORS_CORRECTED   = 0x0003;
+const uint16_t LOG_ERRORS_PROCESSED   = 0x0005;
+const uint16_t LOG_ERRORS_UNCORRECTED = 0x0006;
+
+/* Temperature page parameters */
+const uint16_t LOG_TEMPERATURE_CURRENT   = 0x0000;
+const uint16_t LOG_TEMPERATURE_REFERENCE = 0x0001;
+const uint8_t  LOG_TEMPERATURE_INVALID   = 0xff;
+
+/* Start-stop cycle counter page parameters */
+const uint16_t LOG_START_STOP_SPECIFIED    = 0x0003;
+const uint16_t LOG_START_STOP_ACCUMULATED  = 0x0004;
+const uint16_t LOG_LOAD_UNLOAD_SPECIFIED   = 0x0005;
+const uint16_t LOG_LOAD_UNLOAD_ACCUMULATED = 0x0006;
+
+/* Informational exceptions page general parameter */
+const uint16_t LOG_IE_GENERAL = 0x0000;
+
+/*
+ * Struct: log_parameter
+ * ---------------------
+ * A decoded log parameter, values of up to eight bytes are assembled from
+ * big-endian, raw points at the parameter value for anything else
+ */
+typedef struct {
+  uint16_t             code;
+  uint8_t              length;
+  uint64_t             value;
+  const unsigned char* raw;
+} log_parameter;
+
+/*
+ * Function: scsi_log_sense
+ * ------------------------
+ * Send a LOG SENSE command for the cumulative values of a page
+ * fd: File descriptor pointing at a SCSI or SCSI generic device node
+ * page: Log page code
+ * buf: Data buffer to receive the data into, must be at least len bytes
+ * len: Allocation length
+ */
+SgioResult scsi_log_sense(int fd, uint8_t page, unsigned char* buf, uint16_t len);
+
+/*
+ * Function: log_page_length
+ * -------------------------
+ * Returns the total length of a log page, header included, from its header
+ * page: Log page, at least LOG_PAGE_HEADER bytes
+ */
+int log_page_length(const unsigned char* page);
+
+/*
+ * Function: log_parameter_next
+ * ----------------------------
+ * Decodes the parameter at offset and advances offset to the next one.
+ * Returns false at the end of the page or if a parameter is truncated.
+ * page: Log page
+ * length: Total length of the page as read
+ * offset: Reference to the current offset, start at LOG_PAGE_HEADER
+ * parameter: Reference to receive the decoded parameter
+ */
+bool log_parameter_next(const unsigned char* page, int length, int& offset, log_parameter& parameter);
+
+#endif//_logsense_H_
@@ -0,0 +1,187 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <scsi/scsi.h>
+
+#include "scsi.h"
+#include "sgio.h"
+#include "megaraid.h"
+
+#include <vector>
+
+using namespace std;
+
+/*
+ * Struct: megaraid_drive
+ * ----------------------
+ * Addressing of a physical drive registered with sgio
+ */
+struct megaraid_drive {
+  uint16_t host;
+  uint8_t  target;
+};
+
+/* Drives registered with sgio, indexed by handler context */
+static vector<megaraid_drive> drives;
+
+/* Controller node shared by every drive */
+static int controller = -1;
+
+/*
+ * Function: megaraid_ioctl_default
+ * --------------------------------
+ * Issues a request to the kernel
+ */
+static int megaraid_ioctl_default(int fd, unsigned long request, void* arg) {
+
+  return ioctl(fd, request, arg);
+
+}
+
+/* Function used to talk to the controller, defaults to ioctl(2) */
+MegaraidIoctl megaraid_ioctl = megaraid_ioctl_default;
+
+/* Controller node opened by megaraid_open, defaults to MEGARAID_NODE */
+const char* megaraid_node = MEGARAID_NODE;
+
+/*
+ * Function: megaraid_command
+ * --------------------------
+ * Executes an SG_IO request by wrapping the CDB in a pass-through frame
+ * addressed to a physical drive.  The drive's SCSI status and sense data
+ * are passed back as if the drive had been addressed directly.
+ * context: Index of the drive
+ * hdr: SG_IO request to execute
+ */
+static int megaraid_command(int context, sg_io_hdr_t& hdr) {
+
+  const megaraid_drive& drive = drives[context];
+
+  megasas_iocpacket packet;
+  memset(&packet, 0, sizeof(megasas_iocpacket));
+
+  megasas_pthru_frame* frame = reinterpret_cast<megasas_pthru_frame*>(packet.frame);
+  frame->cmd = MFI_CMD_PD_SCSI_IO;
+  frame->cmd_status = MFI_STAT_INVALID_STATUS;
+  frame->target_id = drive.target;
+  frame->cdb_len = hdr.cmd_len;
+  memcpy(frame->cdb, hdr.cmdp, hdr.cmd_len);
+
+  if(hdr.dxfer_len) {
+    frame->flags = hdr.dxfer_direction == SG_DXFER_TO_DEV ? MFI_FRAME_DIR_WRITE : MFI_FRAME_DIR_READ;
+    frame->sge_count = 1;
+    frame->data_xfer_len = hdr.dxfer_len;
+    frame->sgl.length = hdr.dxfer_len;
+
+    packet.sgl_off = offsetof(megasas_pthru_frame, sgl);
+    packet.sge_count = 1;
+    packet.sgl[0].iov_base = hdr.dxferp;
+    packet.sgl[0].iov_len = hdr.dxfer_len;
+  }
+
+  // The driver copies sense data to the user address held at sense_off
+  memset(hdr.sbp, 0, hdr.mx_sb_len);
+  frame->sense_len = hdr.mx_sb_len;
+  packet.sense_off = offsetof(megasas_pthru_frame, sense_buf_phys_addr_lo);
+  packet.sense_len = hdr.mx_sb_len;
+
+  unsigned long sense = reinterpret_cast<unsigned long>(hdr.sbp);
+  memcpy(packet.frame + packet.sense_off, &sense, sizeof(sense));
+
+  packet.host_no = drive.host;
+
+  if(megaraid_ioctl(controller, MEGASAS_IOC_FIRMWARE, &packet) < 0)
+    return errno;
+
+  switch(frame->cmd_status) {
+    case MFI_STAT_OK:
+      break;
+    case MFI_STAT_SCSI_DONE_WITH_ERROR:
+      // Older drivers don't copy the SCSI status back, never let it read as good
+      hdr.status = frame->scsi_status ? frame->scsi_status : SCSI_STATUS_CHECK_CONDITION;
+      if(hdr.status == SCSI_STATUS_CHECK_CONDITION && hdr.sbp[0]) {
+        hdr.driver_status = SG_DRIVER_SENSE;
+        hdr.sb_len_wr = hdr.mx_sb_len;
+      }
+      break;
+    case MFI_STAT_DEVICE_NOT_FOUND:
+      return ENODEV;
+    default:
+      hdr.host_status = SG_HOST_ERROR;
+      break;
+  }
+
+  return 0;
+
+}
+
+/*
+ * Function: megaraid_open
+ * -----------------------
+ * Returns a handle addressing a physical drive behind a MegaRAID controller
+ * which may be used with sgio like any other descriptor, or -1 with errno
+ * set.  The controller node is opened once and shared by every drive.
+ * volume: Any SCSI device node the controller exports, selects the host
+ * drive: Firmware device ID of the physical drive
+ */
+int megaraid_open(const char* volume, int drive) {
+
+  if(drive < 0 || drive > 0xff) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // The host number is the top byte of the packed SCSI address
+  int fd = open(volume, O_RDONLY | O_NONBLOCK);
+  if(fd == -1)
+    return -1;
+
+  int idlun[2];
+  int rc = megaraid_ioctl(fd, SCSI_IOCTL_GET_IDLUN, idlun);
+  int error = errno;
+  close(fd);
+
+  if(rc < 0) {
+    errno = error;
+    return -1;
+  }
+
+  if(controller == -1) {
+    controller = open(megaraid_node, O_RDWR);
+    if(controller == -1)
+      return -1;
+  }
+
+  megaraid_drive target;
+  target.host = (idlun[0] >> 24) & 0xff;
+  target.target = drive;
+  drives.push_back(target);
+
+  return sgio_register(megaraid_command, drives.size() - 1);
+
+}
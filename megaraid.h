@@ -0,0 +1,133 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _megaraid_H_
+#define _megaraid_H_
+
+#include <stdint.h>
+#include <sys/uio.h>
+#include <sys/ioctl.h>
+
+/* Node through which the megaraid_sas driver accepts firmware commands */
+const char* const MEGARAID_NODE = "/dev/megaraid_sas_ioctl_node";
+
+/* Firmware interface commands */
+const uint8_t MFI_CMD_PD_SCSI_IO = 0x04;
+
+/* Firmware interface frame flags */
+const uint16_t MFI_FRAME_DIR_WRITE = 0x0008;
+const uint16_t MFI_FRAME_DIR_READ  = 0x0010;
+
+/* Firmware interface command status */
+const uint8_t MFI_STAT_OK                   = 0x00;
+const uint8_t MFI_STAT_DEVICE_NOT_FOUND     = 0x0c;
+const uint8_t MFI_STAT_SCSI_DONE_WITH_ERROR = 0x2d;
+const uint8_t MFI_STAT_INVALID_STATUS       = 0xff;
+
+/* Maximum scatter gather elements in an ioctl packet */
+const int MEGASAS_MAX_IOCTL_SGE = 16;
+
+/* Size of the raw frame in an ioctl packet */
+const int MEGASAS_FRAME_SIZE = 128;
+
+/*
+ * Struct: megasas_sge32
+ * ---------------------
+ * Scatter gather element, the driver substitutes its own bounce buffer
+ */
+typedef struct __attribute__((packed)) {
+  uint32_t phys_addr;
+  uint32_t length;
+} megasas_sge32;
+
+/*
+ * Struct: megasas_pthru_frame
+ * ---------------------------
+ * Firmware frame passing a CDB through to a physical drive
+ */
+typedef struct __attribute__((packed)) {
+  uint8_t       cmd;
+  uint8_t       sense_len;
+  uint8_t       cmd_status;
+  uint8_t       scsi_status;
+  uint8_t       target_id;
+  uint8_t       lun;
+  uint8_t       cdb_len;
+  uint8_t       sge_count;
+  uint32_t      context;
+  uint32_t      pad_0;
+  uint16_t      flags;
+  uint16_t      timeout;
+  uint32_t      data_xfer_len;
+  uint32_t      sense_buf_phys_addr_lo;
+  uint32_t      sense_buf_phys_addr_hi;
+  uint8_t       cdb[16];
+  megasas_sge32 sgl;
+} megasas_pthru_frame;
+
+/*
+ * Struct: megasas_iocpacket
+ * -------------------------
+ * Argument of MEGASAS_IOC_FIRMWARE, the frame is copied to the controller
+ * with the user buffers described by sgl and sense_off patched into it
+ */
+typedef struct __attribute__((packed)) {
+  uint16_t     host_no;
+  uint16_t     pad_1;
+  uint32_t     sgl_off;
+  uint32_t     sge_count;
+  uint32_t     sense_off;
+  uint32_t     sense_len;
+  uint8_t      frame[MEGASAS_FRAME_SIZE];
+  struct iovec sgl[MEGASAS_MAX_IOCTL_SGE];
+} megasas_iocpacket;
+
+/* Issue a firmware command to the controller */
+#define MEGASAS_IOC_FIRMWARE _IOWR('M', 1, megasas_iocpacket)
+
+/*
+ * Type: MegaraidIoctl
+ * -------------------
+ * Signature of the function used to talk to the controller, replaceable so
+ * the pass-through can be driven without a controller
+ */
+typedef int (*MegaraidIoctl)(int fd, unsigned long request, void* arg);
+
+/* Function used to talk to the controller, defaults to ioctl(2) */
+extern MegaraidIoctl megaraid_ioctl;
+
+/* Controller node opened by megaraid_open, defaults to MEGARAID_NODE */
+extern const char* megaraid_node;
+
+/*
+ * Function: megaraid_open
+ * -----------------------
+ * Returns a handle addressing a physical drive behind a MegaRAID controller
+ * which may be used with sgio like any other descriptor, or -1 with errno
+ * set.  The controller node is opened once and shared by every drive.
+ * volume: Any SCSI device node the controller exports, selects the host
+ * drive: Firmware device ID of the physical drive
+ */
+int megaraid_open(const char* volume, int drive);
+
+#endif//_megaraid_H_
@@ -0,0 +1,371 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include "metrics.h"
+
+#include <sstream>
+
+/* Function metrics are sent with, defaults to send(2) */
+MetricsSend metrics_send = send;
+
+/*
+ * Function: metrics_component
+ * ---------------------------
+ * Returns text usable as one component of a dotted metric path
+ * text: Text to convert
+ */
+string metrics_component(const string& text) {
+
+  string component;
+  for(string::const_iterator i = text.begin(); i != text.end(); i++)
+    component += isalnum(*i) || *i == '-' || *i == '_' ? *i : '_';
+
+  return component;
+
+}
+
+/*
+ * Function: perfdata_metrics
+ * --------------------------
+ * Extracts the value of every label in Nagios performance data
+ * perfdata: Performance data e.g. " 5_reallocated_sectors_count=8;;;;"
+ */
+vector<metric> perfdata_metrics(const string& perfdata) {
+
+  vector<metric> metrics;
+
+  stringstream in(perfdata);
+  string item;
+  while(in >> item) {
+
+    string::size_type equals = item.find('=');
+    if(equals == string::npos || !equals)
+      continue;
+
+    const char* value = item.c_str() + equals + 1;
+    char* end;
+    errno = 0;
+    long long number = strtoll(value, &end, 10);
+    if(end == value || errno || (*end && *end != ';'))
+      continue;
+
+    metric m;
+    m.name = metrics_component(item.substr(0, equals));
+    m.value = number;
+    metrics.push_back(m);
+
+  }
+
+  return metrics;
+
+}
+
+/*
+ * Function: metrics_endpoint
+ * --------------------------
+ * Splits HOST[:PORT] into its parts, an IPv6 address must be bracketed
+ * endpoint: Endpoint as given on the command line
+ * port_default: Port if none is given
+ * host: Reference to receive the host
+ * port: Reference to receive the port
+ */
+bool metrics_endpoint(const string& endpoint, const char* port_default, string& host, string& port) {
+
+  string rest;
+  if(!endpoint.empty() && endpoint[0] == '[') {
+    string::size_type close = endpoint.find(']');
+    if(close == string::npos)
+      return false;
+    host = endpoint.substr(1, close - 1);
+    rest = endpoint.substr(close + 1);
+  } else {
+    string::size_type colon = endpoint.find(':');
+    host = endpoint.substr(0, colon);
+    rest = colon == string::npos ? "" : endpoint.substr(colon);
+  }
+
+  if(rest.empty())
+    port = port_default;
+  else if(rest[0] == ':' && rest.size() > 1)
+    port = rest.substr(1);
+  else
+    return false;
+
+  return !host.empty();
+
+}
+
+/*
+ * Function: metrics_connect
+ * -------------------------
+ * Connects a non-blocking socket, waiting at most METRICS_TIMEOUT for the
+ * server to answer.  Returns false with errno set, ETIMEDOUT if it never
+ * did.
+ * sock: Non-blocking socket
+ * address: Address to connect to
+ */
+static bool metrics_connect(int sock, const struct addrinfo* address) {
+
+  if(connect(sock, address->ai_addr, address->ai_addrlen) == 0)
+    return true;
+
+  if(errno != EINPROGRESS)
+    return false;
+
+  struct pollfd pending;
+  pending.fd = sock;
+  pending.events = POLLOUT;
+
+  int ready;
+  do {
+    ready = poll(&pending, 1, METRICS_TIMEOUT);
+  } while(ready == -1 && errno == EINTR);
+
+  if(ready == 0)
+    errno = ETIMEDOUT;
+  if(ready != 1)
+    return false;
+
+  int error;
+  socklen_t length = sizeof(error);
+  if(getsockopt(sock, SOL_SOCKET, SO_ERROR, &error, &length) == -1)
+    return false;
+
+  errno = error;
+  return !error;
+
+}
+
+/*
+ * Method: connect
+ * ---------------
+ * Connects to the first address of the endpoint that accepts, returning
+ * false with errno set on error.  Neither connecting nor sending waits
+ * longer than METRICS_TIMEOUT, so an unreachable server doesn't hold up
+ * the checks.
+ * type: SOCK_STREAM or SOCK_DGRAM
+ */
+bool MetricSink::connect(int type) {
+
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = type;
+
+  struct addrinfo* addresses;
+  if(getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses)) {
+    errno = EHOSTUNREACH;
+    return false;
+  }
+
+  int error = ECONNREFUSED;
+  for(struct addrinfo* address = addresses; address; address = address->ai_next) {
+
+    sock = socket(address->ai_family, address->ai_socktype | SOCK_CLOEXEC | SOCK_NONBLOCK, address->ai_protocol);
+    if(sock == -1) {
+      error = errno;
+      continue;
+    }
+
+    if(metrics_connect(sock, address)) {
+      struct timeval timeout;
+      timeout.tv_sec = METRICS_TIMEOUT / 1000;
+      timeout.tv_usec = METRICS_TIMEOUT % 1000 * 1000;
+      fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) & ~O_NONBLOCK);
+      setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+      break;
+    }
+
+    error = errno;
+    close(sock);
+    sock = -1;
+
+  }
+
+  freeaddrinfo(addresses);
+
+  errno = error;
+  return sock != -1;
+
+}
+
+/*
+ * Method: disconnect
+ * ------------------
+ * Closes the connection if there is one
+ */
+void MetricSink::disconnect() {
+
+  if(sock != -1)
+    close(sock);
+
+  sock = -1;
+
+}
+
+/*
+ * Method: add
+ * -----------
+ * Buffers the metrics of a device as "path.name value timestamp" lines,
+ * sending a batch once enough have built up
+ */
+bool GraphiteSink::add(const string& path, const vector<metric>& metrics, time_t timestamp) {
+
+  stringstream lines;
+  for(vector<metric>::const_iterator i = metrics.begin(); i != metrics.end(); i++)
+    lines << path << "." << i->name << " " << i->value << " " << timestamp << "\n";
+
+  buffer += lines.str();
+
+  return buffer.size() < METRICS_BATCH || flush();
+
+}
+
+/*
+ * Method: flush
+ * -------------
+ * Sends the buffered lines over the connection, reconnecting once if the
+ * server has closed it since the last batch.  A line cut short by the
+ * connection failing is dropped rather than resent in part.
+ */
+bool GraphiteSink::flush() {
+
+  for(int attempt = 0; !buffer.empty(); attempt++) {
+
+    if(sock == -1 && !connect(SOCK_STREAM))
+      return false;
+
+    size_t sent = 0;
+    while(sent < buffer.size()) {
+      ssize_t written = metrics_send(sock, buffer.data() + sent, buffer.size() - sent, MSG_NOSIGNAL);
+      if(written == -1) {
+        if(errno == EINTR)
+          continue;
+        break;
+      }
+      sent += written;
+    }
+
+    if(sent == buffer.size()) {
+      buffer.clear();
+      break;
+    }
+
+    // Whatever the server took before the error counts as delivered.  The
+    // rest of a line it took part of would arrive on the new connection as
+    // a line of its own, so it goes too.
+    int error = errno;
+    if(sent && buffer[sent - 1] != '\n') {
+      string::size_type end = buffer.find('\n', sent);
+      sent = end == string::npos ? buffer.size() : end + 1;
+    }
+    buffer.erase(0, sent);
+    disconnect();
+
+    if(attempt) {
+      errno = error;
+      return false;
+    }
+
+  }
+
+  return true;
+
+}
+
+/*
+ * Method: append
+ * --------------
+ * Adds a line to the current datagram, sending it first if the line
+ * won't fit
+ * line: Line to add, terminated by a newline
+ */
+bool StatsdSink::append(const string& line) {
+
+  bool ok = true;
+  if(datagram.size() + line.size() > METRICS_DATAGRAM)
+    ok = flush();
+
+  datagram += line;
+
+  return ok;
+
+}
+
+/*
+ * Method: add
+ * -----------
+ * Packs the metrics of a device as gauges into datagrams.  StatsD reads a
+ * signed gauge as a change, so negative values are sent as a reset to zero
+ * followed by the change.
+ */
+bool StatsdSink::add(const string& path, const vector<metric>& metrics, time_t timestamp) {
+
+  bool ok = true;
+  for(vector<metric>::const_iterator i = metrics.begin(); i != metrics.end(); i++) {
+
+    string name = path + "." + i->name;
+
+    if(i->value < 0)
+      ok = append(name + ":0|g\n") && ok;
+
+    ok = append(name + ":" + to_string(i->value) + "|g\n") && ok;
+
+  }
+
+  return ok;
+
+}
+
+/*
+ * Method: flush
+ * -------------
+ * Sends the current datagram
+ */
+bool StatsdSink::flush() {
+
+  if(datagram.empty())
+    return true;
+
+  if(sock == -1 && !connect(SOCK_DGRAM))
+    return false;
+
+  // The final newline is optional and saves a byte
+  ssize_t sent = metrics_send(sock, datagram.data(), datagram.size() - 1, 0);
+  datagram.clear();
+
+  return sent != -1;
+
+}
@@ -0,0 +1,190 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef _metrics_H_
+#define _metrics_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/socket.h>
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/* Default ports of the Graphite plaintext and StatsD protocols */
+const char* const GRAPHITE_PORT_DEFAULT = "2003";
+const char* const STATSD_PORT_DEFAULT   = "8125";
+
+/* Prefixes every metric, followed by the host name */
+const char* const METRICS_PREFIX        = "smart";
+
+/* Bytes buffered before a Graphite batch is sent */
+const size_t METRICS_BATCH              = 64 * 1024;
+
+/* Largest StatsD datagram, an Ethernet MTU less IPv6 and UDP headers */
+const size_t METRICS_DATAGRAM           = 1452;
+
+/* Milliseconds a connect or send may take before the server is given up
+ * on, well inside the plugin's timeout so checks are never held up */
+const int METRICS_TIMEOUT               = 2000;
+
+/*
+ * Struct: metric
+ * --------------
+ * A named value read from a device
+ */
+struct metric {
+  string name;
+  int64_t value;
+};
+
+/*
+ * Type: MetricsSend
+ * -----------------
+ * Signature of the function metrics are sent with, replaceable so short
+ * sends can be tested
+ */
+typedef ssize_t (*MetricsSend)(int sock, const void* buf, size_t len, int flags);
+
+/* Function metrics are sent with, defaults to send(2) */
+extern MetricsSend metrics_send;
+
+/*
+ * Function: metrics_component
+ * ---------------------------
+ * Returns text usable as one component of a dotted metric path
+ * text: Text to convert
+ */
+string metrics_component(const string& text);
+
+/*
+ * Function: perfdata_metrics
+ * --------------------------
+ * Extracts the value of every label in Nagios performance data
+ * perfdata: Performance data e.g. " 5_reallocated_sectors_count=8;;;;"
+ */
+vector<metric> perfdata_metrics(const string& perfdata);
+
+/*
+ * Class: MetricSink
+ * -----------------
+ * Somewhere metrics are pushed to.  Metrics are buffered and sent in
+ * batches, the connection is kept open between them.
+ */
+class MetricSink {
+
+protected:
+
+  string host;
+  string port;
+  int sock;
+
+  bool connect(int type);
+  void disconnect();
+
+public:
+
+  MetricSink(const string& host, const string& port) : host(host), port(port), sock(-1) {}
+  virtual ~MetricSink() { disconnect(); }
+
+  /*
+   * Method: add
+   * -----------
+   * Buffers the metrics of a device, sending full batches, returning false
+   * with errno set if a batch could not be sent
+   * path: Dotted path prefixing the metric names
+   * metrics: Metrics to add
+   * timestamp: When the metrics were read
+   */
+  virtual bool add(const string& path, const vector<metric>& metrics, time_t timestamp) = 0;
+
+  /*
+   * Method: flush
+   * -------------
+   * Sends anything buffered, returning false with errno set on error
+   */
+  virtual bool flush() = 0;
+
+};
+
+/*
+ * Class: GraphiteSink
+ * -------------------
+ * Pushes metrics over a persistent TCP connection in the Graphite
+ * plaintext protocol.  A connection dropped by the server is reopened
+ * once per batch, any line it was dropped part way through is lost.
+ */
+class GraphiteSink : public MetricSink {
+
+private:
+
+  string buffer;
+
+public:
+
+  GraphiteSink(const string& host, const string& port) : MetricSink(host, port) {}
+
+  bool add(const string& path, const vector<metric>& metrics, time_t timestamp);
+  bool flush();
+
+};
+
+/*
+ * Class: StatsdSink
+ * -----------------
+ * Pushes metrics as StatsD gauges over UDP, packing as many as fit into
+ * each datagram
+ */
+class StatsdSink : public MetricSink {
+
+private:
+
+  string datagram;
+
+  bool append(const string& line);
+
+public:
+
+  StatsdSink(const string& host, const string& port) : MetricSink(host, port) {}
+
+  bool add(const string& path, const vector<metric>& metrics, time_t timestamp);
+  bool flush();
+
+};
+
+/*
+ * Function: metrics_endpoint
+ * --------------------------
+ * Splits HOST[:PORT] into its parts, an IPv6 address must be bracketed
+ * endpoint: Endpoint as given on the command line
+ * port_default: Port if none is given
+ * host: Reference to receive the host
+ * port: Reference to receive the port
+ */
+bool metrics_endpoint(const string& endpoint, const char* port_default, string& host, string& port);
+
+#endif//_metrics_H_
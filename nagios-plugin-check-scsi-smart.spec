@@ -12,6 +12,23 @@ to work for SATA drives which are directly attached to a SATA controller a SAS
 HBA or a SAS expander.  The SAT translation layer handles decpasulating the
 ATA command at the relvant boundary between SCSI and SATA protocols.
 
+%package -n libscsismart
+Summary: Library to perform SMART checks on SATA devices on SCSI buses
+Group: System Environment/Libraries
+
+%description -n libscsismart
+Performs the plugin's SMART checks in process, so agents can query disks each
+interval without forking the plugin, and reads the results the plugin's daemon
+publishes in shared memory.
+
+%package -n libscsismart-devel
+Summary: Development files for libscsismart
+Group: Development/Libraries
+Requires: libscsismart = %{version}-%{release}
+
+%description -n libscsismart-devel
+Header and link library for programs using libscsismart.
+
 %build
 make
 
@@ -20,3 +37,15 @@ make install LIBDIR=lib64 DESTDIR=%{buildroot}
 
 %files
 /usr/lib64/nagios/plugins/check_scsi_smart
+/usr/bin/smart_trace_decode
+
+%post -n libscsismart -p /sbin/ldconfig
+
+%postun -n libscsismart -p /sbin/ldconfig
+
+%files -n libscsismart
+/usr/lib64/libscsismart.so.1
+
+%files -n libscsismart-devel
+/usr/lib64/libscsismart.so
+/usr/include/scsismart.h
@@ -0,0 +1,180 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <sys/ioctl.h>
+#include <linux/nvme_ioctl.h>
+
+#include "nvme.h"
+
+#include <iomanip>
+
+/*
+ * Function: nvme_ioctl_default
+ * ----------------------------
+ * Issues an admin command to the kernel
+ */
+static int nvme_ioctl_default(int fd, unsigned long request, void* arg) {
+
+  return ioctl(fd, request, arg);
+
+}
+
+/* Function used to issue admin commands, defaults to ioctl(2) */
+NvmeIoctl nvme_ioctl = nvme_ioctl_default;
+
+/**
+ * Function: NvmeResult::NvmeResult(int, uint16_t)
+ * -----------------------------------------------
+ * Class constructor
+ * error: errno of a failed ioctl, otherwise zero
+ * status: NVMe completion status field
+ */
+NvmeResult::NvmeResult(int error, uint16_t status)
+: error(error),
+  status(status)
+{}
+
+/**
+ * Function: operator<<(ostream&, const NvmeResult&)
+ * -------------------------------------------------
+ * Function to dump a human readable failure reason to an output stream
+ * o: Class implementing std::ostream
+ * result: Reference to a NvmeResult class
+ */
+ostream& operator<<(ostream& o, const NvmeResult& result) {
+
+  if(result.error)
+    return o << "NVMe ioctl error: " << strerror(result.error);
+
+  return o << hex << setfill('0') << "status 0x" << setw(4) << result.status << dec << setfill(' ');
+
+}
+
+/*
+ * Function: nvme_admin
+ * --------------------
+ * Issues an admin command reading data from the controller, the ioctl
+ * returns the completion status when the command itself fails
+ */
+static NvmeResult nvme_admin(int fd, nvme_admin_cmd& cmd) {
+
+  int rc = nvme_ioctl(fd, NVME_IOCTL_ADMIN_CMD, &cmd);
+  if(rc < 0)
+    return NvmeResult(errno, 0);
+
+  return NvmeResult(0, rc);
+
+}
+
+/*
+ * Function: nvme_identify_controller
+ * ----------------------------------
+ * Send an Identify command for the controller data structure
+ * fd: File descriptor pointing at an NVMe controller or namespace node
+ * id: Reference to receive the controller data
+ */
+NvmeResult nvme_identify_controller(int fd, nvme_id_ctrl& id) {
+
+  nvme_admin_cmd cmd;
+  memset(&cmd, 0, sizeof(nvme_admin_cmd));
+
+  cmd.opcode   = NVME_ADMIN_IDENTIFY;
+  cmd.addr     = reinterpret_cast<uintptr_t>(&id);
+  cmd.data_len = sizeof(nvme_id_ctrl);
+  cmd.cdw10    = NVME_IDENTIFY_CNS_CONTROLLER;
+
+  return nvme_admin(fd, cmd);
+
+}
+
+/*
+ * Function: nvme_get_log_page
+ * ---------------------------
+ * Send a Get Log Page command and receive the data
+ * fd: File descriptor pointing at an NVMe controller or namespace node
+ * log: Log page identifier
+ * nsid: Namespace the log applies to, or NVME_NSID_ALL
+ * buf: Data buffer to receive the data into, must be at least len bytes
+ * len: Number of bytes to read, a multiple of four
+ */
+NvmeResult nvme_get_log_page(int fd, uint8_t log, uint32_t nsid, unsigned char* buf, uint32_t len) {
+
+  // The transfer length is a zero based count of dwords split across two
+  // command dwords
+  uint32_t dwords = len / 4 - 1;
+
+  nvme_admin_cmd cmd;
+  memset(&cmd, 0, sizeof(nvme_admin_cmd));
+
+  cmd.opcode   = NVME_ADMIN_GET_LOG_PAGE;
+  cmd.nsid     = nsid;
+  cmd.addr     = reinterpret_cast<uintptr_t>(buf);
+  cmd.data_len = len;
+  cmd.cdw10    = log | ((dwords & 0xffff) << 16);
+  cmd.cdw11    = dwords >> 16;
+
+  return nvme_admin(fd, cmd);
+
+}
+
+/*
+ * Function: nvme_counter
+ * ----------------------
+ * Returns a 128-bit log counter as a signed 64-bit value, saturating if it
+ * does not fit
+ * counter: Little-endian bytes of the counter
+ */
+int64_t nvme_counter(const uint8_t* counter) {
+
+  for(int i=8; i<16; i++)
+    if(counter[i])
+      return INT64_MAX;
+
+  uint64_t value = 0;
+  for(int i=0; i<8; i++)
+    value |= static_cast<uint64_t>(counter[i]) << (i * 8);
+
+  return value > static_cast<uint64_t>(INT64_MAX) ? INT64_MAX : value;
+
+}
+
+/*
+ * Function: nvme_temperature
+ * --------------------------
+ * Converts a temperature reported in Kelvin to Celsius, returning false if
+ * the controller left it unreported as zero
+ * kelvin: Temperature as reported by the controller
+ * celsius: Reference to receive the temperature
+ */
+bool nvme_temperature(uint16_t kelvin, int& celsius) {
+
+  if(!kelvin)
+    return false;
+
+  celsius = static_cast<int>(kelvin) - NVME_KELVIN;
+
+  return true;
+
+}
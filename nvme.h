@@ -0,0 +1,223 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _nvme_H_
+#define _nvme_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <iostream>
+
+using namespace std;
+
+/* Class Declarations */
+class NvmeResult;
+
+/* NVMe admin commands */
+const uint8_t NVME_ADMIN_GET_LOG_PAGE = 0x02;
+const uint8_t NVME_ADMIN_IDENTIFY     = 0x06;
+
+/* Identify controller or namespace structure */
+const uint32_t NVME_IDENTIFY_CNS_CONTROLLER = 0x01;
+const size_t   NVME_IDENTIFY_SIZE           = 4096;
+
+/* Log pages */
+const uint8_t NVME_LOG_SMART = 0x02;
+
+/* Namespace identifier selecting controller wide data */
+const uint32_t NVME_NSID_ALL = 0xffffffff;
+
+/* Critical warning bits */
+const uint8_t NVME_CRITICAL_WARNING_SPARE       = 0x01;
+const uint8_t NVME_CRITICAL_WARNING_TEMPERATURE = 0x02;
+const uint8_t NVME_CRITICAL_WARNING_RELIABILITY = 0x04;
+const uint8_t NVME_CRITICAL_WARNING_READ_ONLY   = 0x08;
+const uint8_t NVME_CRITICAL_WARNING_VOLATILE    = 0x10;
+
+/* Critical warning bits which predict failure of the media or controller */
+const uint8_t NVME_CRITICAL_WARNING_PREDICTIVE = NVME_CRITICAL_WARNING_SPARE | NVME_CRITICAL_WARNING_RELIABILITY |
+                                                 NVME_CRITICAL_WARNING_READ_ONLY | NVME_CRITICAL_WARNING_VOLATILE;
+
+/* Offset between Kelvin as reported and Celsius as displayed */
+const int NVME_KELVIN = 273;
+
+/*
+ * Struct: nvme_id_ctrl
+ * --------------------
+ * Identify Controller data structure, only the fields we use are broken out
+ */
+typedef struct __attribute__((packed)) {
+  uint16_t vid;
+  uint16_t ssvid;
+  char     sn[20];
+  char     mn[40];
+  char     fr[8];
+  uint8_t  reserved1[184];
+  uint16_t oacs;
+  uint8_t  acl;
+  uint8_t  aerl;
+  uint8_t  frmw;
+  uint8_t  lpa;
+  uint8_t  elpe;
+  uint8_t  npss;
+  uint8_t  avscc;
+  uint8_t  apsta;
+  uint16_t wctemp;
+  uint16_t cctemp;
+  uint8_t  reserved2[3826];
+} nvme_id_ctrl;
+
+/*
+ * Struct: nvme_smart_log
+ * ----------------------
+ * SMART / Health Information log page, 128-bit counters are held as raw
+ * little-endian bytes
+ */
+typedef struct __attribute__((packed)) {
+  uint8_t  critical_warning;
+  uint16_t temperature;
+  uint8_t  available_spare;
+  uint8_t  available_spare_threshold;
+  uint8_t  percentage_used;
+  uint8_t  endurance_group_warning;
+  uint8_t  reserved1[25];
+  uint8_t  data_units_read[16];
+  uint8_t  data_units_written[16];
+  uint8_t  host_reads[16];
+  uint8_t  host_writes[16];
+  uint8_t  controller_busy_time[16];
+  uint8_t  power_cycles[16];
+  uint8_t  power_on_hours[16];
+  uint8_t  unsafe_shutdowns[16];
+  uint8_t  media_errors[16];
+  uint8_t  error_log_entries[16];
+  uint32_t warning_temperature_time;
+  uint32_t critical_temperature_time;
+  uint16_t temperature_sensors[8];
+  uint8_t  reserved2[296];
+} nvme_smart_log;
+
+/*
+ * Type: NvmeIoctl
+ * ---------------
+ * Signature of the function used to issue admin commands, replaceable so
+ * the backend can be driven without NVMe hardware
+ */
+typedef int (*NvmeIoctl)(int fd, unsigned long request, void* arg);
+
+/* Function used to issue admin commands, defaults to ioctl(2) */
+extern NvmeIoctl nvme_ioctl;
+
+/*
+ * Class: NvmeResult
+ * -----------------
+ * Outcome of an NVMe admin command, covering ioctl failure and the
+ * completion status returned by the controller
+ */
+class NvmeResult {
+
+public:
+  /**
+   * Function: NvmeResult::NvmeResult(int, uint16_t)
+   * -----------------------------------------------
+   * Class constructor
+   * error: errno of a failed ioctl, otherwise zero
+   * status: NVMe completion status field
+   */
+  NvmeResult(int error, uint16_t status);
+
+  /**
+   * Function: NvmeResult::ok()
+   * --------------------------
+   * Returns whether the command completed and the data can be trusted
+   */
+  inline bool ok() const {
+    return !error && !status;
+  }
+
+  /**
+   * Function: NvmeResult::getError()
+   * --------------------------------
+   * Returns the errno of a failed ioctl, or zero if it was issued
+   */
+  inline int getError() const {
+    return error;
+  }
+
+  friend ostream& operator<<(ostream& o, const NvmeResult& result);
+
+private:
+  int error;
+  uint16_t status;
+
+};
+
+/**
+ * Function: operator<<(ostream&, const NvmeResult&)
+ * -------------------------------------------------
+ * Function to dump a human readable failure reason to an output stream
+ * o: Class implementing std::ostream
+ * result: Reference to a NvmeResult class
+ */
+ostream& operator<<(ostream& o, const NvmeResult& result);
+
+/*
+ * Function: nvme_identify_controller
+ * ----------------------------------
+ * Send an Identify command for the controller data structure
+ * fd: File descriptor pointing at an NVMe controller or namespace node
+ * id: Reference to receive the controller data
+ */
+NvmeResult nvme_identify_controller(int fd, nvme_id_ctrl& id);
+
+/*
+ * Function: nvme_get_log_page
+ * ---------------------------
+ * Send a Get Log Page command and receive the data
+ * fd: File descriptor pointing at an NVMe controller or namespace node
+ * log: Log page identifier
+ * nsid: Namespace the log applies to, or NVME_NSID_ALL
+ * buf: Data buffer to receive the data into, must be at least len bytes
+ * len: Number of bytes to read, a multiple of four
+ */
+NvmeResult nvme_get_log_page(int fd, uint8_t log, uint32_t nsid, unsigned char* buf, uint32_t len);
+
+/*
+ * Function: nvme_counter
+ * ----------------------
+ * Returns a 128-bit log counter as a signed 64-bit value, saturating if it
+ * does not fit
+ * counter: Little-endian bytes of the counter
+ */
+int64_t nvme_counter(const uint8_t* counter);
+
+/*
+ * Function: nvme_temperature
+ * --------------------------
+ * Converts a temperature reported in Kelvin to Celsius, returning false if
+ * the controller left it unreported as zero
+ * kelvin: Temperature as reported by the controller
+ * celsius: Reference to receive the temperature
+ */
+bool nvme_temperature(uint16_t kelvin, int& celsius);
+
+#endif//_nvme_H_
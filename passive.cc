@@ -0,0 +1,188 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "passive.h"
+
+#include <sstream>
+
+/*
+ * Function: passive_clean
+ * -----------------------
+ * Returns text with the separators of both formats replaced so a result
+ * can't be split or inject a command
+ * text: Text to clean
+ * separator: Field separator of the format
+ */
+static string passive_clean(const string& text, char separator) {
+
+  string clean = text;
+  for(string::iterator i = clean.begin(); i != clean.end(); i++)
+    if(*i == '\n' || *i == '\r' || *i == separator)
+      *i = ' ';
+
+  return clean;
+
+}
+
+/* Function results are written with, defaults to write(2) */
+PassiveWrite passive_write_fd = write;
+
+/*
+ * Function: passive_fit
+ * ---------------------
+ * Returns output shortened so a line made of it and a prefix fits in
+ * PASSIVE_LINE_MAX with its newline.  Performance data is cut back to the
+ * last whole label so a truncated value is never reported.
+ * prefix: Everything on the line before the output
+ * output: Output to shorten
+ */
+static string passive_fit(const string& prefix, const string& output) {
+
+  if(prefix.size() + output.size() + 1 <= PASSIVE_LINE_MAX)
+    return output;
+
+  size_t room = PASSIVE_LINE_MAX > prefix.size() + 1 ? PASSIVE_LINE_MAX - prefix.size() - 1 : 0;
+  string fitted = output.substr(0, room);
+
+  // A label cut short goes, and the bar if nothing is left after it
+  string::size_type bar = output.find('|');
+  if(bar != string::npos && bar < room) {
+    if(output[room] != ' ') {
+      string::size_type space = fitted.rfind(' ');
+      fitted.erase(space != string::npos && space > bar ? space : bar);
+    }
+    if(fitted.find_first_not_of(' ', bar + 1) == string::npos)
+      fitted.erase(bar);
+    while(!fitted.empty() && fitted[fitted.size() - 1] == ' ')
+      fitted.erase(fitted.size() - 1);
+  }
+
+  return fitted;
+
+}
+
+/*
+ * Function: passive_external_commands
+ * -----------------------------------
+ * Formats results as PROCESS_SERVICE_CHECK_RESULT external commands, one
+ * per line.  Output is truncated so no line is longer than
+ * PASSIVE_LINE_MAX, dropping any performance data label cut short.
+ * results: Results to format
+ */
+string passive_external_commands(const vector<passive_result>& results) {
+
+  stringstream buffer;
+  for(vector<passive_result>::const_iterator i = results.begin(); i != results.end(); i++) {
+    stringstream prefix;
+    prefix << "[" << i->timestamp << "] PROCESS_SERVICE_CHECK_RESULT;"
+           << passive_clean(i->host, ';') << ";"
+           << passive_clean(i->service, ';') << ";"
+           << i->code << ";";
+    buffer << prefix.str() << passive_fit(prefix.str(), passive_clean(i->output, '\n')) << "\n";
+  }
+
+  return buffer.str();
+
+}
+
+/*
+ * Function: passive_nsca
+ * ----------------------
+ * Formats results as send_nsca input, tab separated host, service, code
+ * and output
+ * results: Results to format
+ */
+string passive_nsca(const vector<passive_result>& results) {
+
+  stringstream buffer;
+  for(vector<passive_result>::const_iterator i = results.begin(); i != results.end(); i++)
+    buffer << passive_clean(i->host, '\t') << "\t"
+           << passive_clean(i->service, '\t') << "\t"
+           << i->code << "\t"
+           << passive_clean(i->output, '\t') << "\n";
+
+  return buffer.str();
+
+}
+
+/*
+ * Function: passive_write
+ * -----------------------
+ * Writes formatted results a line at a time, so each external command
+ * reaches a FIFO whole even with other writers, returning false with errno
+ * set on error.  A command file with no reader, such as the FIFO of a
+ * monitoring server that is down, fails at once with ENXIO rather than
+ * blocking.
+ * path: Command file, or PASSIVE_STDOUT
+ * buffer: Formatted results
+ */
+bool passive_write(const string& path, const string& buffer) {
+
+  int fd = STDOUT_FILENO;
+  if(path != PASSIVE_STDOUT) {
+
+    fd = open(path.c_str(), O_WRONLY | O_APPEND | O_NONBLOCK | O_CLOEXEC);
+    if(fd == -1)
+      return false;
+
+    // Having found a reader, block until the whole buffer is taken
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+
+  }
+
+  // A write of one line to a FIFO is atomic, one of several could be
+  // split around another writer's commands
+  bool complete = true;
+  int error = 0;
+  for(string::size_type start = 0; start < buffer.size(); ) {
+
+    string::size_type end = buffer.find('\n', start);
+    end = end == string::npos ? buffer.size() : end + 1;
+
+    ssize_t written = passive_write_fd(fd, buffer.data() + start, end - start);
+    if(written != static_cast<ssize_t>(end - start)) {
+      complete = false;
+      error = written == -1 ? errno : EIO;
+      break;
+    }
+
+    start = end;
+
+  }
+
+  if(fd != STDOUT_FILENO)
+    close(fd);
+
+  if(!complete) {
+    errno = error;
+    return false;
+  }
+
+  return true;
+
+}
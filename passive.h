@@ -0,0 +1,103 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef _passive_H_
+#define _passive_H_
+
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/* Passive results are written to standard output rather than a file */
+const char* const PASSIVE_STDOUT = "-";
+
+/* Prefixes the identity of a device to name its service */
+const char* const PASSIVE_SERVICE_PREFIX = "SMART ";
+
+/* Longest external command written, writes of up to PIPE_BUF to a FIFO
+   are never interleaved with another writer's */
+const size_t PASSIVE_LINE_MAX = PIPE_BUF;
+
+/*
+ * Struct: passive_result
+ * ----------------------
+ * The result of checking one device, as submitted to the monitoring server
+ */
+struct passive_result {
+  time_t timestamp;
+  string host;
+  string service;
+  int code;
+  string output;
+};
+
+/*
+ * Type: PassiveWrite
+ * ------------------
+ * Signature of the function results are written with, replaceable so the
+ * writes can be observed
+ */
+typedef ssize_t (*PassiveWrite)(int fd, const void* buf, size_t count);
+
+/* Function results are written with, defaults to write(2) */
+extern PassiveWrite passive_write_fd;
+
+/*
+ * Function: passive_external_commands
+ * -----------------------------------
+ * Formats results as PROCESS_SERVICE_CHECK_RESULT external commands, one
+ * per line.  Output is truncated so no line is longer than
+ * PASSIVE_LINE_MAX, dropping any performance data label cut short.
+ * results: Results to format
+ */
+string passive_external_commands(const vector<passive_result>& results);
+
+/*
+ * Function: passive_nsca
+ * ----------------------
+ * Formats results as send_nsca input, tab separated host, service, code
+ * and output
+ * results: Results to format
+ */
+string passive_nsca(const vector<passive_result>& results);
+
+/*
+ * Function: passive_write
+ * -----------------------
+ * Writes formatted results a line at a time, so each external command
+ * reaches a FIFO whole even with other writers, returning false with errno
+ * set on error.  A command file with no reader, such as the FIFO of a
+ * monitoring server that is down, fails at once with ENXIO rather than
+ * blocking.
+ * path: Command file, or PASSIVE_STDOUT
+ * buffer: Formatted results
+ */
+bool passive_write(const string& path, const string& buffer);
+
+#endif//_passive_H_
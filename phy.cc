@@ -0,0 +1,94 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ata.h"
+#include "phy.h"
+
+/*
+ * Function: phy_event_next
+ * ------------------------
+ * Decodes the counter at offset and advances offset to the next one.
+ * Returns false at the end of the list or if an entry is malformed.
+ * page: SATA Phy Event Counters log page
+ * offset: Reference to the current offset, start at PHY_EVENT_FIRST
+ * event: Reference to receive the decoded counter
+ */
+bool phy_event_next(const unsigned char* page, int& offset, phy_event& event) {
+
+  // The final byte of the page is the checksum
+  const int end = SECTOR_SIZE - 1;
+
+  if(offset + 2 > end)
+    return false;
+
+  uint16_t header = page[offset] | (page[offset + 1] << 8);
+
+  event.id = header & PHY_EVENT_ID_MASK;
+  event.vendor = header & PHY_EVENT_VENDOR_FLAG;
+
+  // Size is encoded in words, 1 to 4 for 16 to 64-bit counters
+  int size = ((header & PHY_EVENT_SIZE_MASK) >> PHY_EVENT_SIZE_SHIFT) * 2;
+
+  if(!event.id || size < 2 || size > 8 || offset + 2 + size > end)
+    return false;
+
+  event.value = 0;
+  for(int i=0; i<size; i++)
+    event.value |= static_cast<uint64_t>(page[offset + 2 + i]) << (i * 8);
+
+  offset += 2 + size;
+
+  return true;
+
+}
+
+/*
+ * Function: phy_event_name
+ * ------------------------
+ * Returns the performance data name of a standard counter, or null if the
+ * counter isn't one we report
+ * id: Counter identifier
+ */
+const char* phy_event_name(uint16_t id) {
+
+  switch(id) {
+    case 0x001: return "phy_icrc_errors";
+    case 0x002: return "phy_data_fis_r_err";
+    case 0x003: return "phy_d2h_data_fis_r_err";
+    case 0x004: return "phy_h2d_data_fis_r_err";
+    case 0x005: return "phy_non_data_fis_r_err";
+    case 0x006: return "phy_d2h_non_data_fis_r_err";
+    case 0x007: return "phy_h2d_non_data_fis_r_err";
+    case 0x008: return "phy_d2h_non_data_fis_retries";
+    case 0x009: return "phy_rdy_to_nrdy_transitions";
+    case 0x00a: return "phy_comreset_register_fis";
+    case 0x00b: return "phy_h2d_fis_crc_errors";
+    case 0x00d: return "phy_h2d_fis_non_crc_errors";
+    case 0x00f: return "phy_h2d_data_fis_r_err_crc";
+    case 0x010: return "phy_h2d_data_fis_r_err_non_crc";
+    case 0x012: return "phy_h2d_non_data_fis_r_err_crc";
+    case 0x013: return "phy_h2d_non_data_fis_r_err_non_crc";
+  }
+
+  return 0;
+
+}
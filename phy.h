@@ -0,0 +1,71 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _phy_H_
+#define _phy_H_
+
+#include <stdint.h>
+
+/* READ LOG EXT feature to reset counters once read */
+const uint16_t PHY_EVENT_FEATURE_RESET = 0x0001;
+
+/* Phy event counter identifier fields */
+const uint16_t PHY_EVENT_ID_MASK     = 0x0fff;
+const uint16_t PHY_EVENT_SIZE_MASK   = 0x7000;
+const uint16_t PHY_EVENT_SIZE_SHIFT  = 12;
+const uint16_t PHY_EVENT_VENDOR_FLAG = 0x8000;
+
+/* Offset of the first counter, the first dword is reserved */
+const int PHY_EVENT_FIRST = 4;
+
+/*
+ * Struct: phy_event
+ * -----------------
+ * A decoded phy event counter, see SATA 3.2 13.7
+ */
+typedef struct {
+  uint16_t id;
+  bool     vendor;
+  uint64_t value;
+} phy_event;
+
+/*
+ * Function: phy_event_next
+ * ------------------------
+ * Decodes the counter at offset and advances offset to the next one.
+ * Returns false at the end of the list or if an entry is malformed.
+ * page: SATA Phy Event Counters log page
+ * offset: Reference to the current offset, start at PHY_EVENT_FIRST
+ * event: Reference to receive the decoded counter
+ */
+bool phy_event_next(const unsigned char* page, int& offset, phy_event& event);
+
+/*
+ * Function: phy_event_name
+ * ------------------------
+ * Returns the performance data name of a standard counter, or null if the
+ * counter isn't one we report
+ * id: Counter identifier
+ */
+const char* phy_event_name(uint16_t id);
+
+#endif//_phy_H_
@@ -0,0 +1,119 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <ctype.h>
+
+#include "scsi.h"
+
+/*
+ * Function: scsi_inquiry
+ * ----------------------
+ * Send an INQUIRY command for standard data or a vital product data page
+ * fd: File descriptor pointing at a SCSI or SCSI generic device node
+ * evpd: Whether to read a vital product data page
+ * page: Vital product data page, ignored for standard data
+ * buf: Data buffer to receive the data into, must be at least len bytes
+ * len: Allocation length
+ */
+SgioResult scsi_inquiry(int fd, bool evpd, uint8_t page, unsigned char* buf, uint16_t len) {
+
+  spc_inquiry inquiry;
+  memset(reinterpret_cast<unsigned char*>(&inquiry), 0, sizeof(spc_inquiry));
+
+  inquiry.operation_code       = SPC_INQUIRY;
+  inquiry.evpd                 = evpd ? 1 : 0;
+  inquiry.page_code            = evpd ? page : 0;
+  inquiry.allocation_length[0] = len >> 8;
+  inquiry.allocation_length[1] = len;
+
+  return sgio(fd, reinterpret_cast<unsigned char*>(&inquiry), sizeof(inquiry), buf, len);
+
+}
+
+/*
+ * Function: scsi_direct_access
+ * ----------------------------
+ * Checks standard INQUIRY data for a direct access block device, other
+ * device types may give the ATA PASS-THROUGH opcodes another meaning
+ * fd: File descriptor pointing at a SCSI or SCSI generic device node
+ */
+bool scsi_direct_access(int fd) {
+
+  unsigned char standard[SCSI_INQUIRY_LENGTH];
+  memset(standard, 0, sizeof(standard));
+
+  return scsi_inquiry(fd, false, 0, standard, sizeof(standard)).ok() &&
+         (standard[0] & SCSI_TYPE_MASK) == SCSI_TYPE_DIRECT_ACCESS;
+
+}
+
+/*
+ * Function: scsi_identity_append
+ * ------------------------------
+ * Appends an ASCII INQUIRY field to an identity, squeezing out padding and
+ * anything which would upset a whitespace separated state file
+ */
+static void scsi_identity_append(string& identity, const unsigned char* field, int len) {
+
+  if(!identity.empty())
+    identity += '_';
+
+  for(int i=0; i<len; i++) {
+    if(isalnum(field[i]) || field[i] == '-' || field[i] == '.')
+      identity += field[i];
+    else if(isgraph(field[i]))
+      identity += '_';
+  }
+
+}
+
+/*
+ * Function: scsi_identity
+ * -----------------------
+ * Returns a string identifying the device as seen by the host, made of the
+ * vendor, product and unit serial number, or empty if it has none.  For a
+ * bridged device this identifies the bridge.
+ * fd: File descriptor pointing at a SCSI or SCSI generic device node
+ */
+string scsi_identity(int fd) {
+
+  unsigned char standard[SCSI_INQUIRY_LENGTH];
+  memset(standard, 0, sizeof(standard));
+  if(!scsi_inquiry(fd, false, 0, standard, sizeof(standard)).ok())
+    return "";
+
+  unsigned char serial[256];
+  memset(serial, 0, sizeof(serial));
+  if(!scsi_inquiry(fd, true, SCSI_VPD_UNIT_SERIAL_NUMBER, serial, sizeof(serial)).ok() ||
+     serial[1] != SCSI_VPD_UNIT_SERIAL_NUMBER || !serial[3])
+    return "";
+
+  // Vendor is bytes 8-15 and product 16-31, the serial follows the VPD header
+  string identity;
+  scsi_identity_append(identity, standard + 8, 8);
+  scsi_identity_append(identity, standard + 16, 16);
+  scsi_identity_append(identity, serial + 4, min<int>(serial[3], sizeof(serial) - 4));
+
+  return identity;
+
+}
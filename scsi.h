@@ -25,8 +25,49 @@
 
 #include <stdint.h>
 
+#include <string>
+
+#include "sgio.h"
+
+using namespace std;
+
 /* SCSI primary commands */
-#define SBC_ATA_PASS_THROUGH 0x85
+#define SPC_INQUIRY             0x12
+#define SPC_LOG_SENSE           0x4d
+#define SBC_ATA_PASS_THROUGH    0x85
+#define SBC_ATA_PASS_THROUGH_12 0xa1
+
+/* Vital product data pages */
+const uint8_t SCSI_VPD_UNIT_SERIAL_NUMBER = 0x80;
+
+/* Standard INQUIRY data length covering the vendor, product and revision */
+const uint8_t SCSI_INQUIRY_LENGTH = 36;
+
+/* Peripheral device types */
+const uint8_t SCSI_TYPE_DIRECT_ACCESS = 0x00;
+const uint8_t SCSI_TYPE_MASK          = 0x1f;
+
+/* SCSI status codes */
+const uint8_t SCSI_STATUS_GOOD            = 0x00;
+const uint8_t SCSI_STATUS_CHECK_CONDITION = 0x02;
+const uint8_t SCSI_STATUS_BUSY            = 0x08;
+const uint8_t SCSI_STATUS_TASK_SET_FULL   = 0x28;
+
+/* SCSI sense keys */
+const uint8_t SCSI_SENSE_KEY_NO_SENSE        = 0x0;
+const uint8_t SCSI_SENSE_KEY_RECOVERED_ERROR = 0x1;
+const uint8_t SCSI_SENSE_KEY_NOT_READY       = 0x2;
+const uint8_t SCSI_SENSE_KEY_MEDIUM_ERROR    = 0x3;
+const uint8_t SCSI_SENSE_KEY_HARDWARE_ERROR  = 0x4;
+const uint8_t SCSI_SENSE_KEY_ILLEGAL_REQUEST = 0x5;
+const uint8_t SCSI_SENSE_KEY_UNIT_ATTENTION  = 0x6;
+const uint8_t SCSI_SENSE_KEY_ABORTED_COMMAND = 0xb;
+
+/* SCSI sense data response codes */
+const uint8_t SCSI_SENSE_FIXED_CURRENT       = 0x70;
+const uint8_t SCSI_SENSE_FIXED_DEFERRED      = 0x71;
+const uint8_t SCSI_SENSE_DESCRIPTOR_CURRENT  = 0x72;
+const uint8_t SCSI_SENSE_DESCRIPTOR_DEFERRED = 0x73;
 
 /*
  * Struct: sbc_ata_pass_through
@@ -77,4 +118,86 @@ typedef struct {
   uint8_t control;
 } sbc_ata_pass_through;
 
+/*
+ * Struct: sbc_ata_pass_through_12
+ * -------------------------------
+ * 12-byte form of the ATA PASS-THROUGH CDB, which can only carry 28-bit
+ * commands but is all some older bridges accept.  The flags byte matches
+ * byte 2 of the 16-byte form.
+ */
+typedef struct {
+  uint8_t operation_code;
+  uint8_t protocol;
+  uint8_t flags;
+  uint8_t features;
+  uint8_t count;
+  uint8_t lba_low;
+  uint8_t lba_mid;
+  uint8_t lba_high;
+  uint8_t device;
+  uint8_t command;
+  uint8_t reserved;
+  uint8_t control;
+} sbc_ata_pass_through_12;
+
+/*
+ * Struct: spc_inquiry
+ * -------------------
+ * SCSI CDB for reading standard INQUIRY data or a vital product data page
+ */
+typedef struct {
+  uint8_t operation_code;
+  uint8_t evpd;
+  uint8_t page_code;
+  uint8_t allocation_length[2];
+  uint8_t control;
+} spc_inquiry;
+
+/*
+ * Struct: spc_log_sense
+ * ---------------------
+ * SCSI CDB for reading a log page, multi-byte fields are big-endian
+ */
+typedef struct {
+  uint8_t operation_code;
+  uint8_t flags;
+  uint8_t page_control_code;
+  uint8_t subpage_code;
+  uint8_t reserved;
+  uint8_t parameter_pointer[2];
+  uint8_t allocation_length[2];
+  uint8_t control;
+} spc_log_sense;
+
+/*
+ * Function: scsi_inquiry
+ * ----------------------
+ * Send an INQUIRY command for standard data or a vital product data page
+ * fd: File descriptor pointing at a SCSI or SCSI generic device node
+ * evpd: Whether to read a vital product data page
+ * page: Vital product data page, ignored for standard data
+ * buf: Data buffer to receive the data into, must be at least len bytes
+ * len: Allocation length
+ */
+SgioResult scsi_inquiry(int fd, bool evpd, uint8_t page, unsigned char* buf, uint16_t len);
+
+/*
+ * Function: scsi_direct_access
+ * ----------------------------
+ * Checks standard INQUIRY data for a direct access block device, other
+ * device types may give the ATA PASS-THROUGH opcodes another meaning
+ * fd: File descriptor pointing at a SCSI or SCSI generic device node
+ */
+bool scsi_direct_access(int fd);
+
+/*
+ * Function: scsi_identity
+ * -----------------------
+ * Returns a string identifying the device as seen by the host, made of the
+ * vendor, product and unit serial number, or empty if it has none.  For a
+ * bridged device this identifies the bridge.
+ * fd: File descriptor pointing at a SCSI or SCSI generic device node
+ */
+string scsi_identity(int fd);
+
 #endif//_scsi_H_
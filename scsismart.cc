@@ -0,0 +1,454 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "scsismart.h"
+#include "check.h"
+#include "shm.h"
+#include "smart.h"
+
+#include <algorithm>
+#include <new>
+#include <sstream>
+
+// Size of a structure up to its last field in version 1 of the header, the
+// smallest a caller can declare
+#define SCSISMART_V1_SIZE(type, last) (offsetof(type, last) + sizeof(static_cast<type*>(0)->last))
+
+/*
+ * Function: fill_sized
+ * --------------------
+ * Copies a structure the library filled to the caller's, writing only the
+ * fields the caller's size covers and setting its size to the bytes written
+ * caller: Structure the caller provided, beginning with its size
+ * filled: Structure the library filled
+ * size: Size of the structure the library filled
+ */
+static void fill_sized(void* caller, const void* filled, uint32_t size) {
+
+  uint32_t covered = min(*static_cast<const uint32_t*>(caller), size);
+  memcpy(caller, filled, covered);
+  *static_cast<uint32_t*>(caller) = covered;
+
+}
+
+/*
+ * Function: scsismart_abi_version
+ * -------------------------------
+ * Returns the ABI version the library was built with
+ */
+uint32_t scsismart_abi_version(void) {
+
+  return SCSISMART_ABI_VERSION;
+
+}
+
+/*
+ * Function: scsismart_attribute_label
+ * -----------------------------------
+ * Returns the name of a SMART attribute e.g. reallocated_sectors_count
+ * id: Attribute ID
+ */
+const char* scsismart_attribute_label(uint8_t id) {
+
+  return smart_attribute_label(id);
+
+}
+
+/*
+ * Function: scsismart_options_init
+ * --------------------------------
+ * Selects the default checks, those made by the plugin without options
+ * options: Options to initialize
+ */
+void scsismart_options_init(scsismart_options* options) {
+
+  memset(options, 0, sizeof(scsismart_options));
+  options->size = sizeof(scsismart_options);
+
+}
+
+/*
+ * Function: scsismart_open
+ * ------------------------
+ * Opens a device node, or megaraid,N:VOLUME for a drive behind a RAID
+ * controller.  Returns 0, or -1 with errno set.
+ * device: Device to fill in
+ * node: Device node
+ */
+int scsismart_open(scsismart_device* device, const char* node) {
+
+  if(!device || !node || strlen(node) >= sizeof(device->node)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  try {
+    device->fd = open_device(node);
+  } catch(const bad_alloc&) {
+    errno = ENOMEM;
+    return -1;
+  } catch(...) {
+    errno = EIO;
+    return -1;
+  }
+
+  if(device->fd == -1)
+    return -1;
+
+  strcpy(device->node, node);
+
+  return 0;
+
+}
+
+/*
+ * Function: scsismart_close
+ * -------------------------
+ * Closes a device opened by scsismart_open
+ * device: Device to close
+ */
+void scsismart_close(scsismart_device* device) {
+
+  // Nothing is left for the caller to retry, the descriptor is gone either way
+  try {
+    if(device->fd != -1)
+      close_device(device->fd);
+  } catch(...) {
+  }
+
+  device->fd = -1;
+
+}
+
+/*
+ * Function: scsismart_identify
+ * ----------------------------
+ * Reads the IDENTIFY DEVICE data of an ATA device.  Returns 0, or -1 with
+ * errno ENOTSUP if the device doesn't accept ATA commands or EIO if the
+ * command, or anything else, failed.
+ * device: Open device
+ * state_dir: Directory caching the ATA PASS-THROUGH form the bridge needs,
+ *            or null for the plugin's default
+ * identify: Buffer of SCSISMART_IDENTIFY_WORDS words to fill
+ */
+int scsismart_identify(const scsismart_device* device, const char* state_dir, uint16_t* identify) {
+
+  // No C++ exception may cross into the caller
+  try {
+
+    SgioResult sgio_result;
+    if(identify_device(device->fd, identify, state_dir ? state_dir : STATE_DIR_DEFAULT, sgio_result))
+      return 0;
+
+    errno = sgio_result.getError() ? EIO : ENOTSUP;
+    return -1;
+
+  } catch(const bad_alloc&) {
+    errno = ENOMEM;
+    return -1;
+  } catch(...) {
+    errno = EIO;
+    return -1;
+  }
+
+}
+
+/*
+ * Function: scsismart_check
+ * -------------------------
+ * Checks a device as the plugin would.  Returns the result code, or -1
+ * with errno EINVAL if the options or result are malformed, ENOMEM if
+ * memory ran out or EIO if the check failed in any other way.
+ * device: Open device
+ * options: Checks to make
+ * result: Result to fill in, its size must be set
+ */
+int scsismart_check(const scsismart_device* device, const scsismart_options* options, scsismart_result* result) {
+
+  if(!device || !options || !result || options->size < SCSISMART_V1_SIZE(scsismart_options, state_dir) ||
+     result->size < SCSISMART_V1_SIZE(scsismart_result, values)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // Options a caller built against an earlier header lacks are left unset
+  scsismart_options given;
+  memset(&given, 0, sizeof(given));
+  memcpy(&given, options, min<uint32_t>(options->size, sizeof(given)));
+  options = &given;
+
+  try {
+
+    CheckOptions check;
+    if(!parse_thresholds(check.warning_thresholds, check.warning_named, options->warning ? options->warning : "") ||
+       !parse_thresholds(check.critical_thresholds, check.critical_named, options->critical ? options->critical : "")) {
+      errno = EINVAL;
+      return -1;
+    }
+
+    for(uint8_t page = 1; page < 32; page++)
+      if(options->statistics & (1u << page))
+        check.devstat_pages.push_back(page);
+
+    check.phy_events = options->checks & SCSISMART_PHY_EVENTS;
+    check.self_test_log = options->checks & SCSISMART_SELF_TEST_LOG;
+    check.error_log = options->checks & SCSISMART_ERROR_LOG;
+    check.temperature_history = options->checks & SCSISMART_TEMPERATURE_HISTORY;
+    if(options->state_dir)
+      check.state_dir = options->state_dir;
+
+    sg_device sg;
+    sg.node = device->node;
+    sg.device_class = DEVICE_CLASS_UNKNOWN;
+
+    stringstream out, perf;
+    device_health health;
+    int code = check_open_device(device->fd, sg, check, "", out, perf, &health);
+
+    scsismart_result filled;
+    memset(&filled, 0, sizeof(filled));
+    filled.size = sizeof(filled);
+    filled.code = code;
+    shm_copy(filled.identity, sizeof(filled.identity), health.report.identity);
+    shm_copy(filled.key, sizeof(filled.key), health.key);
+    shm_copy(filled.status, sizeof(filled.status), out.str());
+
+    filled.attributes_num = min<uint32_t>(health.report.attributes_num, SCSISMART_ATTRIBUTES);
+    for(uint32_t i = 0; i < filled.attributes_num; i++) {
+      const shm_attribute& attribute = health.report.attributes[i];
+      filled.attributes[i].raw = attribute.raw;
+      filled.attributes[i].id = attribute.id;
+      filled.attributes[i].value = attribute.value;
+      filled.attributes[i].worst = attribute.worst;
+      filled.attributes[i].threshold = attribute.threshold;
+      filled.attributes[i].prefail = attribute.prefail;
+    }
+
+    for(vector<metric>::iterator i = health.values.begin(); i != health.values.end(); i++) {
+      if(filled.values_num == SCSISMART_VALUES || i->name.size() >= SCSISMART_LABEL_SIZE) {
+        filled.values_dropped++;
+        continue;
+      }
+      scsismart_value& value = filled.values[filled.values_num++];
+      shm_copy(value.label, sizeof(value.label), i->name);
+      value.value = i->value;
+    }
+
+    fill_sized(result, &filled, sizeof(filled));
+
+    return code;
+
+  } catch(const bad_alloc&) {
+    errno = ENOMEM;
+    return -1;
+  } catch(...) {
+    errno = EIO;
+    return -1;
+  }
+
+}
+
+/*
+ * Function: copy_published
+ * ------------------------
+ * Fills as much of a caller's result as its size covers from a published
+ * report
+ * report: Reference to the report read from the segment
+ * published: Result to fill in
+ */
+static void copy_published(const shm_report& report, scsismart_published* published) {
+
+  scsismart_published filled;
+  memset(&filled, 0, sizeof(filled));
+  filled.size = sizeof(filled);
+  filled.code = report.code;
+  filled.tier = report.tier;
+  filled.checked = report.checked;
+  filled.due = report.due;
+
+  shm_copy(filled.node, sizeof(filled.node), report.node);
+  shm_copy(filled.key, sizeof(filled.key), report.key);
+  shm_copy(filled.identity, sizeof(filled.identity), report.identity);
+  shm_copy(filled.status, sizeof(filled.status), report.status);
+  shm_copy(filled.perfdata, sizeof(filled.perfdata), report.perfdata);
+
+  filled.attributes_num = min<uint32_t>(report.attributes_num, SCSISMART_ATTRIBUTES);
+  for(uint32_t i = 0; i < filled.attributes_num; i++) {
+    const shm_attribute& attribute = report.attributes[i];
+    filled.attributes[i].raw = attribute.raw;
+    filled.attributes[i].id = attribute.id;
+    filled.attributes[i].value = attribute.value;
+    filled.attributes[i].worst = attribute.worst;
+    filled.attributes[i].threshold = attribute.threshold;
+    filled.attributes[i].prefail = attribute.prefail;
+  }
+
+  fill_sized(published, &filled, sizeof(filled));
+
+}
+
+/*
+ * Function: scsismart_reader_open
+ * -------------------------------
+ * Maps the segment the daemon publishes results in.  Reads make no system
+ * calls and never block the daemon.  Returns 0, or -1 with errno set,
+ * EPROTO if the segment was published by an incompatible version.
+ * reader: Reader to fill in
+ * name: Name of the segment, or null for the daemon's default
+ */
+int scsismart_reader_open(scsismart_reader* reader, const char* name) {
+
+  if(!reader) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  reader->segment = 0;
+
+  ShmReader* shm = new(nothrow) ShmReader;
+  if(!shm) {
+    errno = ENOMEM;
+    return -1;
+  }
+
+  try {
+    if(!shm->open(name ? name : SHM_NAME_DEFAULT)) {
+      int error = errno;
+      delete shm;
+      errno = error;
+      return -1;
+    }
+  } catch(const bad_alloc&) {
+    delete shm;
+    errno = ENOMEM;
+    return -1;
+  } catch(...) {
+    delete shm;
+    errno = EIO;
+    return -1;
+  }
+
+  reader->segment = shm;
+
+  return 0;
+
+}
+
+/*
+ * Function: scsismart_reader_close
+ * --------------------------------
+ * Unmaps a segment opened by scsismart_reader_open
+ * reader: Reader to close
+ */
+void scsismart_reader_close(scsismart_reader* reader) {
+
+  delete static_cast<ShmReader*>(reader->segment);
+  reader->segment = 0;
+
+}
+
+/*
+ * Function: scsismart_reader_slots
+ * --------------------------------
+ * Returns the number of slots in the segment, each holding one device
+ * reader: Open reader
+ */
+int scsismart_reader_slots(const scsismart_reader* reader) {
+
+  return static_cast<const ShmReader*>(reader->segment)->slots();
+
+}
+
+/*
+ * Function: scsismart_reader_read
+ * -------------------------------
+ * Copies a consistent snapshot of a slot.  Returns 1, 0 if the slot holds
+ * no device, or -1 with errno EINVAL if the slot or result is malformed,
+ * or EAGAIN if the daemon never finished updating the slot.
+ * reader: Open reader
+ * slot: Slot to read, from zero up to scsismart_reader_slots
+ * published: Result to fill in, its size must be set
+ */
+int scsismart_reader_read(const scsismart_reader* reader, int slot, scsismart_published* published) {
+
+  if(!reader || !reader->segment || !published ||
+     published->size < SCSISMART_V1_SIZE(scsismart_published, attributes) || slot < 0 || slot >= scsismart_reader_slots(reader)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  shm_report report;
+  int used = static_cast<const ShmReader*>(reader->segment)->read(slot, report);
+  if(used <= 0)
+    return used;
+
+  copy_published(report, published);
+
+  return 1;
+
+}
+
+/*
+ * Function: scsismart_reader_find
+ * -------------------------------
+ * Copies a consistent snapshot of a drive's result, found by the key which
+ * identifies it whichever node it appears as.  Returns 0, or -1 with errno
+ * ENOENT if no result is published for it, EAGAIN if the daemon never
+ * finished updating a slot that may hold it, or EINVAL if the result is
+ * malformed.
+ * reader: Open reader
+ * key: Identity key of the drive, as in scsismart_result
+ * published: Result to fill in, its size must be set
+ */
+int scsismart_reader_find(const scsismart_reader* reader, const char* key, scsismart_published* published) {
+
+  if(!reader || !reader->segment || !key || !published ||
+     published->size < SCSISMART_V1_SIZE(scsismart_published, attributes)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  try {
+
+    shm_report report;
+    if(!static_cast<const ShmReader*>(reader->segment)->find(key, report))
+      return -1;
+
+    copy_published(report, published);
+
+    return 0;
+
+  } catch(const bad_alloc&) {
+    errno = ENOMEM;
+    return -1;
+  } catch(...) {
+    errno = EIO;
+    return -1;
+  }
+
+}
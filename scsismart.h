@@ -0,0 +1,306 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef _scsismart_H_
+#define _scsismart_H_
+
+/*
+ * libscsismart
+ * ------------
+ * Checks SMART health in process.  Every function fills structures the
+ * caller provides, nothing is allocated for the caller to free, so agents
+ * can query disks each interval without forking the plugin.  Structures
+ * begin with their size, set by the caller to the size it was built with.
+ * The library reads and writes only the fields that size covers, and sets
+ * it to the bytes written, so later versions can grow them.  Results the
+ * plugin's daemon publishes in shared memory can be read without touching
+ * the disks at all.
+ *
+ * Different devices may be checked at once from different threads, but a
+ * device must only be used by one thread at a time.  Opening a drive
+ * behind a RAID controller registers it with the library, so must not
+ * overlap any other call.  Readers only read the segment and may be shared.
+ */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SCSISMART_API __attribute__((visibility("default")))
+
+/* Incremented whenever a structure or function changes incompatibly */
+#define SCSISMART_ABI_VERSION         1
+
+/* Result codes, as for Nagios plugins */
+#define SCSISMART_OK                  0
+#define SCSISMART_WARNING             1
+#define SCSISMART_CRITICAL            2
+#define SCSISMART_UNKNOWN             3
+
+/* Optional checks, or'd together in scsismart_options.checks */
+#define SCSISMART_PHY_EVENTS          0x01
+#define SCSISMART_SELF_TEST_LOG       0x02
+#define SCSISMART_ERROR_LOG           0x04
+#define SCSISMART_TEMPERATURE_HISTORY 0x08
+
+/* Sizes of the fixed buffers in the structures below */
+#define SCSISMART_NODE_SIZE           256
+#define SCSISMART_IDENTITY_SIZE       128
+#define SCSISMART_STATUS_SIZE         512
+#define SCSISMART_PERFDATA_SIZE       4096
+#define SCSISMART_LABEL_SIZE          64
+#define SCSISMART_ATTRIBUTES          30
+#define SCSISMART_VALUES              64
+#define SCSISMART_IDENTIFY_WORDS      256
+
+/*
+ * Struct: scsismart_device
+ * ------------------------
+ * A device opened by scsismart_open, it stays open across checks
+ */
+typedef struct {
+  int  fd;
+  char node[SCSISMART_NODE_SIZE];
+} scsismart_device;
+
+/*
+ * Struct: scsismart_options
+ * -------------------------
+ * What to check, initialized with scsismart_options_init.  Thresholds
+ * take the form of the plugin's --warning and --critical options.
+ */
+typedef struct {
+  uint32_t    size;
+  uint32_t    checks;
+  uint32_t    statistics;
+  const char* warning;
+  const char* critical;
+  const char* state_dir;
+} scsismart_options;
+
+/*
+ * Struct: scsismart_attribute
+ * ---------------------------
+ * A SMART attribute as read from an ATA device.  Fields added after the
+ * first version follow prefail, in what was padding, so the layout of
+ * those before them never moves.
+ */
+typedef struct {
+  uint64_t raw;
+  uint8_t  id;
+  uint8_t  value;
+  uint8_t  threshold;
+  uint8_t  prefail;
+  uint8_t  worst;
+} scsismart_attribute;
+
+/*
+ * Struct: scsismart_value
+ * -----------------------
+ * A value reported by a check, labelled as in the plugin's performance data
+ */
+typedef struct {
+  char    label[SCSISMART_LABEL_SIZE];
+  int64_t value;
+} scsismart_value;
+
+/*
+ * Struct: scsismart_result
+ * ------------------------
+ * The result of checking a device.  Values that didn't fit are counted in
+ * values_dropped.
+ */
+typedef struct {
+  uint32_t            size;
+  int32_t             code;
+  char                identity[SCSISMART_IDENTITY_SIZE];
+  char                key[SCSISMART_IDENTITY_SIZE];
+  char                status[SCSISMART_STATUS_SIZE];
+  uint32_t            attributes_num;
+  scsismart_attribute attributes[SCSISMART_ATTRIBUTES];
+  uint32_t            values_num;
+  uint32_t            values_dropped;
+  scsismart_value     values[SCSISMART_VALUES];
+} scsismart_result;
+
+/*
+ * Struct: scsismart_reader
+ * ------------------------
+ * A shared memory segment the plugin's daemon publishes results in, opened
+ * by scsismart_reader_open
+ */
+typedef struct {
+  void* segment;
+} scsismart_reader;
+
+/*
+ * Struct: scsismart_published
+ * ---------------------------
+ * The result of a device's last check by the daemon.  Times are seconds
+ * since the epoch, a result still unchanged well after it is due means the
+ * daemon has stopped.  Performance data labels are unprefixed.
+ */
+typedef struct {
+  uint32_t            size;
+  int32_t             code;
+  uint32_t            tier;
+  uint64_t            checked;
+  uint64_t            due;
+  char                node[SCSISMART_NODE_SIZE];
+  char                key[SCSISMART_IDENTITY_SIZE];
+  char                identity[SCSISMART_IDENTITY_SIZE];
+  char                status[SCSISMART_STATUS_SIZE];
+  char                perfdata[SCSISMART_PERFDATA_SIZE];
+  uint32_t            attributes_num;
+  scsismart_attribute attributes[SCSISMART_ATTRIBUTES];
+} scsismart_published;
+
+/*
+ * Function: scsismart_abi_version
+ * -------------------------------
+ * Returns the ABI version the library was built with
+ */
+SCSISMART_API uint32_t scsismart_abi_version(void);
+
+/*
+ * Function: scsismart_attribute_label
+ * -----------------------------------
+ * Returns the name of a SMART attribute e.g. reallocated_sectors_count
+ * id: Attribute ID
+ */
+SCSISMART_API const char* scsismart_attribute_label(uint8_t id);
+
+/*
+ * Function: scsismart_options_init
+ * --------------------------------
+ * Selects the default checks, those made by the plugin without options
+ * options: Options to initialize
+ */
+SCSISMART_API void scsismart_options_init(scsismart_options* options);
+
+/*
+ * Function: scsismart_open
+ * ------------------------
+ * Opens a device node, or megaraid,N:VOLUME for a drive behind a RAID
+ * controller.  Returns 0, or -1 with errno set.
+ * device: Device to fill in
+ * node: Device node
+ */
+SCSISMART_API int scsismart_open(scsismart_device* device, const char* node);
+
+/*
+ * Function: scsismart_close
+ * -------------------------
+ * Closes a device opened by scsismart_open
+ * device: Device to close
+ */
+SCSISMART_API void scsismart_close(scsismart_device* device);
+
+/*
+ * Function: scsismart_identify
+ * ----------------------------
+ * Reads the IDENTIFY DEVICE data of an ATA device.  Returns 0, or -1 with
+ * errno ENOTSUP if the device doesn't accept ATA commands or EIO if the
+ * command, or anything else, failed.
+ * device: Open device
+ * state_dir: Directory caching the ATA PASS-THROUGH form the bridge needs,
+ *            or null for the plugin's default
+ * identify: Buffer of SCSISMART_IDENTIFY_WORDS words to fill
+ */
+SCSISMART_API int scsismart_identify(const scsismart_device* device, const char* state_dir, uint16_t* identify);
+
+/*
+ * Function: scsismart_check
+ * -------------------------
+ * Checks a device as the plugin would.  Returns the result code, or -1
+ * with errno EINVAL if the options or result are malformed, ENOMEM if
+ * memory ran out or EIO if the check failed in any other way.
+ * device: Open device
+ * options: Checks to make
+ * result: Result to fill in, its size must be set
+ */
+SCSISMART_API int scsismart_check(const scsismart_device* device, const scsismart_options* options,
+                                  scsismart_result* result);
+
+/*
+ * Function: scsismart_reader_open
+ * -------------------------------
+ * Maps the segment the daemon publishes results in.  Reads make no system
+ * calls and never block the daemon.  Returns 0, or -1 with errno set,
+ * EPROTO if the segment was published by an incompatible version.
+ * reader: Reader to fill in
+ * name: Name of the segment, or null for the daemon's default
+ */
+SCSISMART_API int scsismart_reader_open(scsismart_reader* reader, const char* name);
+
+/*
+ * Function: scsismart_reader_close
+ * --------------------------------
+ * Unmaps a segment opened by scsismart_reader_open
+ * reader: Reader to close
+ */
+SCSISMART_API void scsismart_reader_close(scsismart_reader* reader);
+
+/*
+ * Function: scsismart_reader_slots
+ * --------------------------------
+ * Returns the number of slots in the segment, each holding one device
+ * reader: Open reader
+ */
+SCSISMART_API int scsismart_reader_slots(const scsismart_reader* reader);
+
+/*
+ * Function: scsismart_reader_read
+ * -------------------------------
+ * Copies a consistent snapshot of a slot.  Returns 1, 0 if the slot holds
+ * no device, or -1 with errno EINVAL if the slot or result is malformed,
+ * or EAGAIN if the daemon never finished updating the slot.
+ * reader: Open reader
+ * slot: Slot to read, from zero up to scsismart_reader_slots
+ * published: Result to fill in, its size must be set
+ */
+SCSISMART_API int scsismart_reader_read(const scsismart_reader* reader, int slot, scsismart_published* published);
+
+/*
+ * Function: scsismart_reader_find
+ * -------------------------------
+ * Copies a consistent snapshot of a drive's result, found by the key which
+ * identifies it whichever node it appears as.  Returns 0, or -1 with errno
+ * ENOENT if no result is published for it, EAGAIN if the daemon never
+ * finished updating a slot that may hold it, or EINVAL if the result is
+ * malformed.
+ * reader: Open reader
+ * key: Identity key of the drive, as in scsismart_result
+ * published: Result to fill in, its size must be set
+ */
+SCSISMART_API int scsismart_reader_find(const scsismart_reader* reader, const char* key,
+                                        scsismart_published* published);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif//_scsismart_H_
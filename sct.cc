@@ -0,0 +1,97 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "endian.h"
+#include "ata.h"
+#include "sct.h"
+
+/*
+ * Function: sct_read_temperature_history
+ * --------------------------------------
+ * Requests the temperature history table via the SCT command log and reads
+ * it from the SCT data log
+ * fd: File descriptor pointing at a SCSI or SCSI generic device node
+ * history: Reference to receive the table
+ */
+SgioResult sct_read_temperature_history(int fd, sct_temperature_history& history) {
+
+  sct_command command;
+  memset(&command, 0, sizeof(sct_command));
+
+  command.action_code   = StorageEndian::swap(SCT_ACTION_DATA_TABLE);
+  command.function_code = StorageEndian::swap(SCT_FUNCTION_READ_TABLE);
+  command.table_id      = StorageEndian::swap(SCT_TABLE_TEMPERATURE_HISTORY);
+
+  SgioResult result = ata_smart_write_log(fd, reinterpret_cast<unsigned char*>(&command), ATA_LOG_ADDRESS_SCT_COMMAND, 1);
+  if(!result.ok())
+    return result;
+
+  return ata_smart_read_log(fd, reinterpret_cast<unsigned char*>(&history), ATA_LOG_ADDRESS_SCT_DATA, 1);
+
+}
+
+/*
+ * Function: sct_temperature_range
+ * -------------------------------
+ * Finds the extremes of the most recent samples, returning the number of
+ * valid samples seen
+ * history: Reference to the temperature history table
+ * samples: Number of samples to examine back from the most recent
+ * min: Reference to receive the lowest temperature
+ * max: Reference to receive the highest temperature
+ */
+int sct_temperature_range(const sct_temperature_history& history, int samples, int& min, int& max) {
+
+  int size = StorageEndian::swap(history.size);
+  int index = StorageEndian::swap(history.index);
+
+  if(size > SCT_TEMPERATURE_SAMPLES)
+    size = SCT_TEMPERATURE_SAMPLES;
+
+  if(!size || index >= size)
+    return 0;
+
+  if(samples > size)
+    samples = size;
+
+  // Walk back from the most recent sample, skipping any not yet taken
+  int valid = 0;
+  for(int i=0; i<samples; i++) {
+
+    int8_t sample = history.samples[(index - i + size) % size];
+    if(sample == SCT_TEMPERATURE_INVALID)
+      continue;
+
+    if(!valid || sample < min)
+      min = sample;
+    if(!valid || sample > max)
+      max = sample;
+
+    valid++;
+
+  }
+
+  return valid;
+
+}
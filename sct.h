@@ -0,0 +1,95 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _sct_H_
+#define _sct_H_
+
+#include <stdint.h>
+
+#include "sgio.h"
+
+/* SCT action and function codes */
+const uint16_t SCT_ACTION_DATA_TABLE         = 0x0005;
+const uint16_t SCT_FUNCTION_READ_TABLE       = 0x0001;
+const uint16_t SCT_TABLE_TEMPERATURE_HISTORY = 0x0002;
+
+/* Temperature history samples which hold no data */
+const int8_t SCT_TEMPERATURE_INVALID = -128;
+
+/* Temperature history samples in a table */
+const int SCT_TEMPERATURE_SAMPLES = 478;
+
+/*
+ * Struct: sct_command
+ * -------------------
+ * SCT command key page written to the SCT command log
+ */
+typedef struct __attribute__((packed)) {
+  uint16_t action_code;
+  uint16_t function_code;
+  uint16_t table_id;
+  uint8_t  reserved[506];
+} sct_command;
+
+/*
+ * Struct: sct_temperature_history
+ * -------------------------------
+ * SCT temperature history table, a ring of samples in degrees Celsius
+ * taken every interval minutes where index points at the most recent
+ */
+typedef struct __attribute__((packed)) {
+  uint16_t version;
+  uint16_t sampling_period;
+  uint16_t interval;
+  int8_t   max_op_limit;
+  int8_t   over_limit;
+  int8_t   min_op_limit;
+  int8_t   under_limit;
+  uint8_t  reserved[20];
+  uint16_t size;
+  uint16_t index;
+  int8_t   samples[SCT_TEMPERATURE_SAMPLES];
+} sct_temperature_history;
+
+/*
+ * Function: sct_read_temperature_history
+ * --------------------------------------
+ * Requests the temperature history table via the SCT command log and reads
+ * it from the SCT data log
+ * fd: File descriptor pointing at a SCSI or SCSI generic device node
+ * history: Reference to receive the table
+ */
+SgioResult sct_read_temperature_history(int fd, sct_temperature_history& history);
+
+/*
+ * Function: sct_temperature_range
+ * -------------------------------
+ * Finds the extremes of the most recent samples, returning the number of
+ * valid samples seen
+ * history: Reference to the temperature history table
+ * samples: Number of samples to examine back from the most recent
+ * min: Reference to receive the lowest temperature
+ * max: Reference to receive the highest temperature
+ */
+int sct_temperature_range(const sct_temperature_history& history, int samples, int& min, int& max);
+
+#endif//_sct_H_
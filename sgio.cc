@@ -0,0 +1,336 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/ioctl.h>
+
+#include "scsi.h"
+#include "sgio.h"
+#include "trace.h"
+
+#include <iomanip>
+#include <vector>
+
+/*
+ * Struct: sgio_target
+ * -------------------
+ * A target added with sgio_register
+ */
+struct sgio_target {
+  SgioHandler handler;
+  int context;
+  bool backoff;
+  bool traced;
+};
+
+/* Targets added with sgio_register, indexed by handle */
+static vector<sgio_target> handlers;
+
+/**
+ * Function: SgioResult::SgioResult()
+ * ----------------------------------
+ * Class constructor, creates a successful result
+ */
+SgioResult::SgioResult()
+: error(0),
+  status(SCSI_STATUS_GOOD),
+  host_status(SG_HOST_OK),
+  driver_status(0),
+  sense(false),
+  sense_key(0),
+  asc(0),
+  ascq(0)
+{}
+
+/**
+ * Function: SgioResult::SgioResult(const sg_io_hdr_t&, int)
+ * ---------------------------------------------------------
+ * Class constructor to decode a completed SG_IO header
+ * hdr: Reference to the completed SG_IO header
+ * error: errno of a failed ioctl, otherwise zero
+ */
+SgioResult::SgioResult(const sg_io_hdr_t& hdr, int error)
+: error(error),
+  status(hdr.status),
+  host_status(hdr.host_status),
+  driver_status(hdr.driver_status),
+  sense(false),
+  sense_key(0),
+  asc(0),
+  ascq(0) {
+
+  if(!error && hdr.sb_len_wr)
+    sense = sense_decode(hdr.sbp, hdr.sb_len_wr, sense_key, asc, ascq);
+
+}
+
+/**
+ * Function: SgioResult::ok()
+ * --------------------------
+ * Returns whether the command completed and the data can be trusted
+ */
+bool SgioResult::ok() const {
+
+  if(error || host_status != SG_HOST_OK || (driver_status & ~SG_DRIVER_SENSE))
+    return false;
+
+  if(status == SCSI_STATUS_GOOD)
+    return true;
+
+  // Some SATs report completion with sense even when not asked to
+  return status == SCSI_STATUS_CHECK_CONDITION && sense &&
+         (sense_key == SCSI_SENSE_KEY_NO_SENSE || sense_key == SCSI_SENSE_KEY_RECOVERED_ERROR);
+
+}
+
+/**
+ * Function: SgioResult::transient()
+ * ---------------------------------
+ * Returns whether the command failed for a reason that is worth retrying
+ */
+bool SgioResult::transient() const {
+
+  if(error)
+    return error == EINTR || error == EAGAIN;
+
+  switch(host_status) {
+    case SG_HOST_BUS_BUSY:
+    case SG_HOST_SOFT_ERROR:
+    case SG_HOST_IMM_RETRY:
+    case SG_HOST_REQUEUE:
+      return true;
+  }
+
+  if(status == SCSI_STATUS_BUSY || status == SCSI_STATUS_TASK_SET_FULL)
+    return true;
+
+  if(status != SCSI_STATUS_CHECK_CONDITION || !sense)
+    return false;
+
+  // Unit attentions are reported once after a reset or media change, and
+  // "logical unit is in process of becoming ready" clears by itself
+  if(sense_key == SCSI_SENSE_KEY_UNIT_ATTENTION)
+    return true;
+
+  if(sense_key == SCSI_SENSE_KEY_NOT_READY && asc == 0x04 && ascq == 0x01)
+    return true;
+
+  return false;
+
+}
+
+/**
+ * Function: operator<<(ostream&, const SgioResult&)
+ * -------------------------------------------------
+ * Function to dump a human readable failure reason to an output stream
+ * o: Class implementing std::ostream
+ * result: Reference to a SgioResult class
+ */
+ostream& operator<<(ostream& o, const SgioResult& result) {
+
+  if(result.error)
+    return o << "SG_IO ioctl error: " << strerror(result.error);
+
+  o << hex << setfill('0')
+    << "status 0x" << setw(2) << static_cast<unsigned int>(result.status)
+    << ", host 0x" << setw(2) << result.host_status
+    << ", driver 0x" << setw(2) << result.driver_status;
+
+  if(result.sense)
+    o << ", sense " << setw(1) << static_cast<unsigned int>(result.sense_key)
+      << "/" << setw(2) << static_cast<unsigned int>(result.asc)
+      << "/" << setw(2) << static_cast<unsigned int>(result.ascq);
+
+  o << dec << setfill(' ');
+
+  return o;
+
+}
+
+/*
+ * Function: sense_decode
+ * ----------------------
+ * Extracts the sense key, ASC and ASCQ from fixed or descriptor format
+ * sense data, returns false if the format is not recognised
+ */
+bool sense_decode(const uint8_t* sense, int len, uint8_t& key, uint8_t& asc, uint8_t& ascq) {
+
+  if(len < 3)
+    return false;
+
+  key = asc = ascq = 0;
+
+  switch(sense[0] & 0x7f) {
+    case SCSI_SENSE_FIXED_CURRENT:
+    case SCSI_SENSE_FIXED_DEFERRED:
+      key = sense[2] & 0x0f;
+      if(len > 13) {
+        asc = sense[12];
+        ascq = sense[13];
+      }
+      return true;
+    case SCSI_SENSE_DESCRIPTOR_CURRENT:
+    case SCSI_SENSE_DESCRIPTOR_DEFERRED:
+      key = sense[1] & 0x0f;
+      asc = sense[2];
+      if(len > 3)
+        ascq = sense[3];
+      return true;
+  }
+
+  return false;
+
+}
+
+/*
+ * Function: sgio_once
+ * -------------------
+ * Issues a single SG_IO ioctl and records it in the command trace
+ */
+static SgioResult sgio_once(int fd, unsigned char* cmdp, int cmd_len, unsigned char* dxferp, int dxfer_len,
+                            int dxfer_direction) {
+
+  sg_io_hdr_t sgio_hdr;
+  unsigned char sense[32];
+
+  memset(&sgio_hdr, 0, sizeof(sg_io_hdr_t));
+  sgio_hdr.interface_id = 'S';
+  sgio_hdr.dxfer_direction = dxfer_len ? dxfer_direction : SG_DXFER_NONE;
+  sgio_hdr.cmd_len = cmd_len;
+  sgio_hdr.mx_sb_len = sizeof(sense);
+  sgio_hdr.dxfer_len = dxfer_len;
+  sgio_hdr.dxferp = dxferp;
+  sgio_hdr.cmdp = cmdp;
+  sgio_hdr.sbp = sense;
+
+  uint64_t timestamp = Trace::now();
+  uint64_t start = Trace::monotonic();
+
+  int error = sgio_execute(fd, sgio_hdr);
+
+  if(!sgio_handle(fd) || handlers[fd - SGIO_HANDLE_BASE].traced)
+    trace.record(sgio_hdr, error, timestamp, Trace::monotonic() - start);
+
+  return SgioResult(sgio_hdr, error);
+
+}
+
+/*
+ * Function: sgio
+ * --------------
+ * Sends a CDB to the target device and recieves a response, transient
+ * failures are retried with exponential backoff
+ *
+ * fd: File descriptor pointing at a SCSI or SCSI generic device node
+ * cmdp: Pointer to a SCSI CDB
+ * cmd_len: Length of the CDB
+ * dxferp: Pointer to the SCSI data buffer
+ * dxfer_len: Length of the SCSI data buffer
+ * dxfer_direction: SG_DXFER_FROM_DEV or SG_DXFER_TO_DEV, ignored if there
+ *                  is no data to transfer
+ */
+SgioResult sgio(int fd, unsigned char* cmdp, int cmd_len, unsigned char* dxferp, int dxfer_len,
+                int dxfer_direction) {
+
+  SgioResult result = sgio_once(fd, cmdp, cmd_len, dxferp, dxfer_len, dxfer_direction);
+
+  // Targets which delay retries themselves are asked again at once
+  bool sleeps = !sgio_handle(fd) || handlers[fd - SGIO_HANDLE_BASE].backoff;
+
+  long backoff = SGIO_BACKOFF_MS;
+  for(int retry = 0; retry < SGIO_RETRIES && result.transient(); retry++) {
+
+    if(sleeps) {
+      struct timespec ts;
+      ts.tv_sec = backoff / 1000;
+      ts.tv_nsec = (backoff % 1000) * 1000000;
+      nanosleep(&ts, 0);
+    }
+
+    backoff *= 2;
+    result = sgio_once(fd, cmdp, cmd_len, dxferp, dxfer_len, dxfer_direction);
+
+  }
+
+  return result;
+
+}
+
+/*
+ * Function: sgio_register
+ * -----------------------
+ * Registers a target reached through a handler rather than a device node,
+ * returning a handle that may be passed to sgio in place of a descriptor.
+ * Registering may move the table every command looks handlers up in, so
+ * must not overlap any command.
+ * handler: Function executing requests for the target
+ * context: Value passed back to the handler identifying the target
+ * backoff: Whether transient failures are retried after sleeping, false
+ *          for handlers which delay retries themselves
+ * traced: Whether commands are recorded in the trace, false for handlers
+ *         which record the commands they issue themselves
+ */
+int sgio_register(SgioHandler handler, int context, bool backoff, bool traced) {
+
+  sgio_target target;
+  target.handler = handler;
+  target.context = context;
+  target.backoff = backoff;
+  target.traced = traced;
+  handlers.push_back(target);
+
+  return SGIO_HANDLE_BASE + handlers.size() - 1;
+
+}
+
+/*
+ * Function: sgio_execute
+ * ----------------------
+ * Executes a prepared SG_IO request with the kernel or the handler of a
+ * registered target, returning an errno or zero
+ * fd: File descriptor or handle returned by sgio_register
+ * hdr: Reference to the request, its status fields are filled in
+ */
+int sgio_execute(int fd, sg_io_hdr_t& hdr) {
+
+  if(sgio_handle(fd)) {
+    const sgio_target& target = handlers[fd - SGIO_HANDLE_BASE];
+    return target.handler(target.context, hdr);
+  }
+
+  return ioctl(fd, SG_IO, &hdr) < 0 ? errno : 0;
+
+}
+
+/*
+ * Function: sgio_handle
+ * ---------------------
+ * Returns whether a descriptor is a handle returned by sgio_register
+ * fd: Descriptor to test
+ */
+bool sgio_handle(int fd) {
+
+  return fd >= SGIO_HANDLE_BASE && fd - SGIO_HANDLE_BASE < static_cast<int>(handlers.size());
+
+}
@@ -0,0 +1,220 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _sgio_H_
+#define _sgio_H_
+
+#include <stdint.h>
+#include <scsi/sg.h>
+#include <iostream>
+
+using namespace std;
+
+/* Class Declarations */
+class SgioResult;
+
+/* Linux host status codes */
+const uint16_t SG_HOST_OK         = 0x00;
+const uint16_t SG_HOST_BUS_BUSY   = 0x02;
+const uint16_t SG_HOST_ERROR      = 0x07;
+const uint16_t SG_HOST_SOFT_ERROR = 0x0b;
+const uint16_t SG_HOST_IMM_RETRY  = 0x0c;
+const uint16_t SG_HOST_REQUEUE    = 0x0d;
+
+/* Linux driver status codes */
+const uint16_t SG_DRIVER_SENSE = 0x08;
+
+/* Retry policy for transient failures */
+const int SGIO_RETRIES    = 3;
+const int SGIO_BACKOFF_MS = 10;
+
+/* Descriptors at or above this refer to targets added with sgio_register */
+const int SGIO_HANDLE_BASE = 0x40000000;
+
+/*
+ * Type: SgioHandler
+ * -----------------
+ * Signature of a function executing an SG_IO request for a target that has
+ * no device node of its own, returning an errno or zero.  The handler
+ * fills in the status fields and sense data of the header as the kernel
+ * would.
+ */
+typedef int (*SgioHandler)(int context, sg_io_hdr_t& hdr);
+
+/*
+ * Class: SgioResult
+ * -----------------
+ * Outcome of an SG_IO command, covering ioctl failure, SCSI status, host
+ * and driver status and the decoded sense key, ASC and ASCQ
+ */
+class SgioResult {
+
+public:
+  /**
+   * Function: SgioResult::SgioResult()
+   * ----------------------------------
+   * Class constructor, creates a successful result
+   */
+  SgioResult();
+
+  /**
+   * Function: SgioResult::SgioResult(const sg_io_hdr_t&, int)
+   * ---------------------------------------------------------
+   * Class constructor to decode a completed SG_IO header
+   * hdr: Reference to the completed SG_IO header
+   * error: errno of a failed ioctl, otherwise zero
+   */
+  SgioResult(const sg_io_hdr_t& hdr, int error);
+
+  /**
+   * Function: SgioResult::ok()
+   * --------------------------
+   * Returns whether the command completed and the data can be trusted
+   */
+  bool ok() const;
+
+  /**
+   * Function: SgioResult::transient()
+   * ---------------------------------
+   * Returns whether the command failed for a reason that is worth retrying
+   */
+  bool transient() const;
+
+  /**
+   * Function: SgioResult::getError()
+   * --------------------------------
+   * Returns the errno of a failed ioctl, zero if the ioctl succeeded
+   */
+  inline int getError() const {
+    return error;
+  }
+
+  /**
+   * Function: SgioResult::getSenseKey()
+   * -----------------------------------
+   * Returns the sense key if sense data was returned
+   */
+  inline uint8_t getSenseKey() const {
+    return sense_key;
+  }
+
+  /**
+   * Function: SgioResult::getASC()
+   * ------------------------------
+   * Returns the additional sense code if sense data was returned
+   */
+  inline uint8_t getASC() const {
+    return asc;
+  }
+
+  /**
+   * Function: SgioResult::getASCQ()
+   * -------------------------------
+   * Returns the additional sense code qualifier if sense data was returned
+   */
+  inline uint8_t getASCQ() const {
+    return ascq;
+  }
+
+  friend ostream& operator<<(ostream& o, const SgioResult& result);
+
+private:
+  int error;
+  uint8_t status;
+  uint16_t host_status;
+  uint16_t driver_status;
+  bool sense;
+  uint8_t sense_key;
+  uint8_t asc;
+  uint8_t ascq;
+
+};
+
+/**
+ * Function: operator<<(ostream&, const SgioResult&)
+ * -------------------------------------------------
+ * Function to dump a human readable failure reason to an output stream
+ * o: Class implementing std::ostream
+ * result: Reference to a SgioResult class
+ */
+ostream& operator<<(ostream& o, const SgioResult& result);
+
+/*
+ * Function: sense_decode
+ * ----------------------
+ * Extracts the sense key, ASC and ASCQ from fixed or descriptor format
+ * sense data, returns false if the format is not recognised
+ */
+bool sense_decode(const uint8_t* sense, int len, uint8_t& key, uint8_t& asc, uint8_t& ascq);
+
+/*
+ * Function: sgio
+ * --------------
+ * Sends a CDB to the target device and recieves a response, transient
+ * failures are retried with exponential backoff
+ *
+ * fd: File descriptor pointing at a SCSI or SCSI generic device node
+ * cmdp: Pointer to a SCSI CDB
+ * cmd_len: Length of the CDB
+ * dxferp: Pointer to the SCSI data buffer
+ * dxfer_len: Length of the SCSI data buffer
+ * dxfer_direction: SG_DXFER_FROM_DEV or SG_DXFER_TO_DEV, ignored if there
+ *                  is no data to transfer
+ */
+SgioResult sgio(int fd, unsigned char* cmdp, int cmd_len, unsigned char* dxferp, int dxfer_len,
+                int dxfer_direction = SG_DXFER_FROM_DEV);
+
+/*
+ * Function: sgio_register
+ * -----------------------
+ * Registers a target reached through a handler rather than a device node,
+ * returning a handle that may be passed to sgio in place of a descriptor.
+ * Registering may move the table every command looks handlers up in, so
+ * must not overlap any command.
+ * handler: Function executing requests for the target
+ * context: Value passed back to the handler identifying the target
+ * backoff: Whether transient failures are retried after sleeping, false
+ *          for handlers which delay retries themselves
+ * traced: Whether commands are recorded in the trace, false for handlers
+ *         which record the commands they issue themselves
+ */
+int sgio_register(SgioHandler handler, int context, bool backoff = true, bool traced = true);
+
+/*
+ * Function: sgio_execute
+ * ----------------------
+ * Executes a prepared SG_IO request with the kernel or the handler of a
+ * registered target, returning an errno or zero
+ * fd: File descriptor or handle returned by sgio_register
+ * hdr: Reference to the request, its status fields are filled in
+ */
+int sgio_execute(int fd, sg_io_hdr_t& hdr);
+
+/*
+ * Function: sgio_handle
+ * ---------------------
+ * Returns whether a descriptor is a handle returned by sgio_register
+ * fd: Descriptor to test
+ */
+bool sgio_handle(int fd);
+
+#endif//_sgio_H_
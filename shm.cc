@@ -0,0 +1,295 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "shm.h"
+
+/*
+ * Function: shm_copy
+ * ------------------
+ * Copies a string into a fixed size field, truncating and terminating it
+ * field: Field to receive the string
+ * size: Size of the field
+ * text: String to copy
+ */
+void shm_copy(char* field, size_t size, const string& text) {
+
+  size_t length = text.copy(field, size - 1);
+  memset(field + length, 0, size - length);
+
+}
+
+ShmWriter::~ShmWriter() {
+
+  if(!segment)
+    return;
+
+  munmap(segment, sizeof(shm_segment));
+  shm_unlink(name.c_str());
+
+}
+
+/*
+ * Method: open
+ * ------------
+ * Creates the segment, replacing any left by a previous writer.  Returns
+ * false with errno set on error.
+ * name: Name of the segment e.g. /check_scsi_smart
+ */
+bool ShmWriter::open(const string& name) {
+
+  // Readers still mapping an old segment keep it, new ones get this one
+  shm_unlink(name.c_str());
+
+  int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+  if(fd == -1)
+    return false;
+
+  if(ftruncate(fd, sizeof(shm_segment)) == -1) {
+    int error = errno;
+    close(fd);
+    shm_unlink(name.c_str());
+    errno = error;
+    return false;
+  }
+
+  void* address = mmap(0, sizeof(shm_segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if(address == MAP_FAILED) {
+    int error = errno;
+    shm_unlink(name.c_str());
+    errno = error;
+    return false;
+  }
+
+  this->name = name;
+  segment = static_cast<shm_segment*>(address);
+
+  // The file is zero filled, so every slot is free with an even sequence
+  segment->version = SHM_VERSION;
+  segment->slots = SHM_SLOTS;
+  segment->slot_size = sizeof(shm_slot);
+  segment->started = time(0);
+  __atomic_store_n(&segment->magic, SHM_MAGIC, __ATOMIC_RELEASE);
+
+  return true;
+
+}
+
+/*
+ * Method: allocate
+ * ----------------
+ * Returns a free slot, or -1 if all are in use
+ */
+int ShmWriter::allocate() {
+
+  for(uint32_t i = 0; i < segment->slots; i++) {
+    if(!allocated[i]) {
+      allocated[i] = true;
+      return i;
+    }
+  }
+
+  return -1;
+
+}
+
+/*
+ * Method: release
+ * ---------------
+ * Clears a slot so readers see no device there
+ * slot: Slot returned by allocate
+ */
+void ShmWriter::release(int slot) {
+
+  shm_report report;
+  memset(&report, 0, sizeof(report));
+  publish(slot, report);
+
+  allocated[slot] = false;
+
+}
+
+/*
+ * Method: publish
+ * ---------------
+ * Replaces a slot's report
+ * slot: Slot returned by allocate
+ * report: Reference to the report
+ */
+void ShmWriter::publish(int slot, const shm_report& report) {
+
+  shm_slot& target = segment->slot[slot];
+
+  // An odd sequence tells readers to retry, the fences keep the report's
+  // stores between the two increments
+  uint32_t sequence = target.sequence;
+  __atomic_store_n(&target.sequence, sequence + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  memcpy(&target.report, &report, sizeof(report));
+
+  __atomic_store_n(&target.sequence, sequence + 2, __ATOMIC_RELEASE);
+
+}
+
+ShmReader::~ShmReader() {
+
+  if(segment)
+    munmap(const_cast<shm_segment*>(segment), sizeof(shm_segment));
+
+}
+
+/*
+ * Method: open
+ * ------------
+ * Maps the segment, returning false with errno set on error, EPROTO if
+ * it isn't a segment this reader understands
+ * name: Name of the segment e.g. /check_scsi_smart
+ */
+bool ShmReader::open(const string& name) {
+
+  int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if(fd == -1)
+    return false;
+
+  struct stat st;
+  if(fstat(fd, &st) == -1 || st.st_size != sizeof(shm_segment)) {
+    close(fd);
+    errno = EPROTO;
+    return false;
+  }
+
+  void* address = mmap(0, sizeof(shm_segment), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if(address == MAP_FAILED)
+    return false;
+
+  const shm_segment* mapped = static_cast<const shm_segment*>(address);
+  if(__atomic_load_n(&mapped->magic, __ATOMIC_ACQUIRE) != SHM_MAGIC || mapped->version != SHM_VERSION ||
+     mapped->slots != SHM_SLOTS || mapped->slot_size != sizeof(shm_slot)) {
+    munmap(address, sizeof(shm_segment));
+    errno = EPROTO;
+    return false;
+  }
+
+  segment = mapped;
+
+  return true;
+
+}
+
+/*
+ * Method: read
+ * ------------
+ * Copies a consistent snapshot of a slot's report, retrying while the
+ * writer is updating it.  Returns 1 if the slot is in use, 0 if not, or
+ * -1 with errno EAGAIN if the writer never finished updating it.
+ * slot: Slot to read
+ * report: Reference to receive the report
+ */
+int ShmReader::read(int slot, shm_report& report) const {
+
+  const shm_slot& source = segment->slot[slot];
+
+  // A daemon killed mid-publish leaves the sequence odd for good
+  for(int i = 0; i < SHM_READ_RETRIES; i++) {
+
+    uint32_t before = __atomic_load_n(&source.sequence, __ATOMIC_ACQUIRE);
+    if(before & 1) {
+      sched_yield();
+      continue;
+    }
+
+    memcpy(&report, &source.report, sizeof(report));
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if(__atomic_load_n(&source.sequence, __ATOMIC_RELAXED) == before)
+      return report.in_use ? 1 : 0;
+
+  }
+
+  errno = EAGAIN;
+  return -1;
+
+}
+
+/*
+ * Method: find
+ * ------------
+ * Copies the report for a drive, returning false with errno ENOENT if
+ * there is none, or EAGAIN if a slot that may hold it couldn't be read
+ * key: Identity key of the drive e.g. FAKE_DRIVE_FAKE0001
+ * report: Reference to receive the report
+ */
+bool ShmReader::find(const string& key, shm_report& report) const {
+
+  int error = ENOENT;
+
+  if(!key.empty()) {
+    for(int i = 0; i < slots(); i++) {
+      int used = read(i, report);
+      if(used < 0)
+        error = EAGAIN;
+      else if(used && key == report.key)
+        return true;
+    }
+  }
+
+  errno = error;
+  return false;
+
+}
+
+/*
+ * Method: find_node
+ * -----------------
+ * Copies the report for whichever drive was last checked at a device
+ * node, returning false with errno as for find if there is none
+ * node: Device node e.g. /dev/sg3
+ * report: Reference to receive the report
+ */
+bool ShmReader::find_node(const string& node, shm_report& report) const {
+
+  int error = ENOENT;
+
+  for(int i = 0; i < slots(); i++) {
+    int used = read(i, report);
+    if(used < 0)
+      error = EAGAIN;
+    else if(used && node == report.node)
+      return true;
+  }
+
+  errno = error;
+  return false;
+
+}
@@ -0,0 +1,260 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef _shm_H_
+#define _shm_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "smart.h"
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/* Name of the segment the daemon publishes results in by default */
+const char* const SHM_NAME_DEFAULT = "/check_scsi_smart";
+
+/* Identifies a segment and the layout of its slots */
+const uint32_t SHM_MAGIC         = 0x534d5254;
+const uint32_t SHM_VERSION       = 2;
+
+/* Seconds a result may outlive its next check before it is stale */
+const time_t SHM_STALE_GRACE     = 300;
+
+/* Times a reader retries a slot the writer is updating before giving up,
+ * yielding in between, so a writer that died mid-publish can't hang it */
+const int SHM_READ_RETRIES       = 10000;
+
+/* Devices the segment holds results for */
+const uint32_t SHM_SLOTS         = 256;
+
+/* Sizes of the text fields of a slot, including the terminator */
+const size_t SHM_NODE_SIZE       = 64;
+const size_t SHM_IDENTITY_SIZE   = 128;
+const size_t SHM_KEY_SIZE        = 128;
+const size_t SHM_STATUS_SIZE     = 512;
+const size_t SHM_PERFDATA_SIZE   = 4096;
+
+/*
+ * Struct: shm_attribute
+ * ---------------------
+ * A SMART attribute as last read from the device
+ */
+typedef struct {
+  uint64_t raw;
+  uint8_t  id;
+  uint8_t  value;
+  uint8_t  threshold;
+  uint8_t  prefail;
+  uint8_t  worst;
+  uint8_t  reserved[3];
+} shm_attribute;
+
+/*
+ * Struct: shm_report
+ * ------------------
+ * The result of a device's last check.  Times are seconds since the epoch,
+ * a slot not in use describes no device.  The key identifies the drive
+ * itself, as in the state directory, so it is found again whichever node
+ * it appears as.
+ */
+typedef struct {
+  uint8_t       in_use;
+  uint8_t       code;
+  uint8_t       tier;
+  uint8_t       attributes_num;
+  uint32_t      reserved;
+  uint64_t      checked;
+  uint64_t      due;
+  char          node[SHM_NODE_SIZE];
+  char          key[SHM_KEY_SIZE];
+  char          identity[SHM_IDENTITY_SIZE];
+  char          status[SHM_STATUS_SIZE];
+  char          perfdata[SHM_PERFDATA_SIZE];
+  shm_attribute attributes[SMART_ATTRIBUTE_NUM];
+} shm_report;
+
+/*
+ * Struct: shm_slot
+ * ----------------
+ * A report guarded by a sequence lock, the sequence is odd while the
+ * writer is updating the report
+ */
+typedef struct {
+  uint32_t   sequence;
+  uint32_t   reserved;
+  shm_report report;
+} shm_slot;
+
+/*
+ * Struct: shm_segment
+ * -------------------
+ * Layout of the segment, the magic is written last so a reader never sees
+ * a segment that is still being initialized
+ */
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t slots;
+  uint32_t slot_size;
+  uint64_t started;
+  uint64_t reserved;
+  shm_slot slot[SHM_SLOTS];
+} shm_segment;
+
+/*
+ * Function: shm_copy
+ * ------------------
+ * Copies a string into a fixed size field, truncating and terminating it
+ * field: Field to receive the string
+ * size: Size of the field
+ * text: String to copy
+ */
+void shm_copy(char* field, size_t size, const string& text);
+
+/*
+ * Class: ShmWriter
+ * ----------------
+ * Publishes reports into a shared memory segment.  There is a single
+ * writer, readers never block it.
+ */
+class ShmWriter {
+
+private:
+
+  string name;
+  shm_segment* segment;
+  vector<bool> allocated;
+
+public:
+
+  ShmWriter() : segment(0), allocated(SHM_SLOTS) {}
+  ~ShmWriter();
+
+  /*
+   * Method: open
+   * ------------
+   * Creates the segment, replacing any left by a previous writer.  Returns
+   * false with errno set on error.
+   * name: Name of the segment e.g. /check_scsi_smart
+   */
+  bool open(const string& name);
+
+  /*
+   * Method: allocate
+   * ----------------
+   * Returns a free slot, or -1 if all are in use
+   */
+  int allocate();
+
+  /*
+   * Method: release
+   * ---------------
+   * Clears a slot so readers see no device there
+   * slot: Slot returned by allocate
+   */
+  void release(int slot);
+
+  /*
+   * Method: publish
+   * ---------------
+   * Replaces a slot's report
+   * slot: Slot returned by allocate
+   * report: Reference to the report
+   */
+  void publish(int slot, const shm_report& report);
+
+};
+
+/*
+ * Class: ShmReader
+ * ----------------
+ * Reads reports from a shared memory segment.  Once open reading is
+ * lock free and makes no system calls.
+ */
+class ShmReader {
+
+private:
+
+  const shm_segment* segment;
+
+public:
+
+  ShmReader() : segment(0) {}
+  ~ShmReader();
+
+  /*
+   * Method: open
+   * ------------
+   * Maps the segment, returning false with errno set on error, EPROTO if
+   * it isn't a segment this reader understands
+   * name: Name of the segment e.g. /check_scsi_smart
+   */
+  bool open(const string& name);
+
+  /*
+   * Method: slots
+   * -------------
+   * Returns the number of slots in the segment
+   */
+  int slots() const { return segment->slots; }
+
+  /*
+   * Method: read
+   * ------------
+   * Copies a consistent snapshot of a slot's report, retrying while the
+   * writer is updating it.  Returns 1 if the slot is in use, 0 if not, or
+   * -1 with errno EAGAIN if the writer never finished updating it.
+   * slot: Slot to read
+   * report: Reference to receive the report
+   */
+  int read(int slot, shm_report& report) const;
+
+  /*
+   * Method: find
+   * ------------
+   * Copies the report for a drive, returning false with errno ENOENT if
+   * there is none, or EAGAIN if a slot that may hold it couldn't be read
+   * key: Identity key of the drive e.g. FAKE_DRIVE_FAKE0001
+   * report: Reference to receive the report
+   */
+  bool find(const string& key, shm_report& report) const;
+
+  /*
+   * Method: find_node
+   * -----------------
+   * Copies the report for whichever drive was last checked at a device
+   * node, returning false with errno as for find if there is none
+   * node: Device node e.g. /dev/sg3
+   * report: Reference to receive the report
+   */
+  bool find_node(const string& node, shm_report& report) const;
+
+};
+
+#endif//_shm_H_
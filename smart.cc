@@ -34,6 +34,7 @@ SmartAttribute::SmartAttribute(const smart_attribute& attribute)
   pre_fail(StorageEndian::swap(attribute.flags) & 0x1),
   offline(StorageEndian::swap(attribute.flags) & 0x2),
   value(StorageEndian::swap(attribute.value)),
+  worst(StorageEndian::swap(attribute.worst)),
   raw((static_cast<uint64_t>(StorageEndian::swap(attribute.raw_hi)) << 32) |
        static_cast<uint64_t>(StorageEndian::swap(attribute.raw_lo))) {
 
@@ -58,6 +59,37 @@ SmartAttribute::SmartAttribute(const smart_attribute& attribute)
 
 }
 
+/**
+ * Function: SmartAttribute::isFailureCounter()
+ * --------------------------------------------
+ * Checks whether the raw value counts media or interface failures, rather
+ * than usage which advances on every healthy drive
+ */
+bool SmartAttribute::isFailureCounter() const {
+
+  switch(id) {
+    case 5:   // Reallocated sector count
+    case 10:  // Spin retry count
+    case 11:  // Recalibration retries
+    case 171: // Program fail count
+    case 172: // Erase fail count
+    case 181: // Program fail count
+    case 182: // Erase fail count
+    case 183: // Runtime bad block
+    case 184: // End to end error
+    case 187: // Reported uncorrectable errors
+    case 188: // Command timeout
+    case 196: // Reallocated event count
+    case 197: // Current pending sector count
+    case 198: // Offline uncorrectable
+    case 199: // UDMA CRC error count
+      return true;
+    default:
+      return false;
+  }
+
+}
+
 /**
  * Function: SmartAttribute::operator<=(const SmartThreshold&)
  * -----------------------------------------------------------
@@ -70,6 +102,294 @@ bool SmartAttribute::operator<=(const SmartThreshold& threshold) const {
 
 }
 
+/* Names of the attributes, indexed by ID */
+static const char* labels[] = {
+  // 0x00
+  "unknown",
+  "read_error_rate",
+  "throughput_performance",
+  "spin_up_time",
+  "start_stop_count",
+  "reallocated_sectors_count",
+  "read_channel_margin",
+  "seek_error_rate",
+  "seek_time_performance",
+  "power_on_hours",
+  "spin_retry_count",
+  "recalibration_retries",
+  "power_cycle_count",
+  "soft_read_error_rate",
+  "unknown",
+  "unknown",
+  // 0x10
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "current_helium_level",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  // 0x20
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  // 0x30
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  // 0x40
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  // 0x50
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  // 0x60
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  // 0x70
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  // 0x80
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  // 0x90
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  // 0xa0
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "available_reserved_space",
+  "ssd_program_fail_count",
+  "ssd_erase_fail_count",
+  "ssd_wear_leveling_count",
+  "unexpected_power_loss_count",
+  "power_loss_protection_failure",
+  // 0xb0
+  "erase_fail_count",
+  "wear_range_delta",
+  "unknown",
+  "used_reserved_block_count_total",
+  "unused_reserved_block_count_total",
+  "program_fail_count_total",
+  "erase_fail_count",
+  "sata_downshift_error_count",
+  "end_to_end_error",
+  "head_stability",
+  "induced_op_vibration_detection",
+  "reported_uncorrectable_errors",
+  "command_timeout",
+  "high_fly_writes",
+  "airflow_temperature",
+  "g_sense_error_rate",
+  // 0xc0
+  "power_off_retract_count",
+  "load_cycle_count",
+  "temperature",
+  "hardware_ecc_recovered",
+  "reallocation_event_count",
+  "current_pending_sector_count",
+  "uncorrectable_sector_count",
+  "ultradma_crc_error_count",
+  "multi_zone_error_rate",
+  "soft_read_error_rate",
+  "data_address_mark_errors",
+  "run_out_cancel",
+  "soft_ecc_correction",
+  "thermal_asperity_rate",
+  "flying_height",
+  "spin_height_current",
+  // 0xd0
+  "spin_buzz",
+  "offline_seek_performance",
+  "vibration_during_write",
+  "vibration_during_write",
+  "shock_during_write",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "disk_shift",
+  "g_sense_error_rate",
+  "loaded_hours",
+  "load_unload_retry_count",
+  // 0xe0
+  "load_friction",
+  "load_unload_cycle_count",
+  "load_in_time",
+  "torque_amplification_count",
+  "power_off_retract_cycle",
+  "unknown",
+  "drive_life_protection_status",
+  "temperature",
+  "available_reserved_space",
+  "media_wearout_indicator",
+  "average_erase_count",
+  "good_block_count",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  // 0xf0
+  "flying_head_hours",
+  "total_lbas_written",
+  "total_lbas_read",
+  "total_lbas_written_expanded",
+  "total_lbas_read_expanded",
+  "unknown",
+  "unknown",
+  "unknown",
+  "unknown",
+  "nand_writes_1gib",
+  "read_error_retry_rate",
+  "minimum_spares_remaining",
+  "newly_added_bad_flash_block",
+  "unknown",
+  "free_fall_protection",
+  "unknown",
+};
+
+/**
+ * Function: smart_attribute_label
+ * -------------------------------
+ * Returns the name of a SMART attribute e.g. reallocated_sectors_count
+ * id: Attribute ID
+ */
+const char* smart_attribute_label(uint8_t id) {
+
+  return labels[id];
+
+}
+
 /**
  * Function: operator<<(ostream&, const SmartAttribute&)
  * ----------------------------------------
@@ -79,282 +399,7 @@ bool SmartAttribute::operator<=(const SmartThreshold& threshold) const {
  */
 ostream& operator<<(ostream& o, const SmartAttribute& attribute) {
 
-  static const char* labels[] = {
-    // 0x00
-    "unknown",
-    "read_error_rate",
-    "throughput_performance",
-    "spin_up_time",
-    "start_stop_count",
-    "reallocated_sectors_count",
-    "read_channel_margin",
-    "seek_error_rate",
-    "seek_time_performance",
-    "power_on_hours",
-    "spin_retry_count",
-    "recalibration_retries",
-    "power_cycle_count",
-    "soft_read_error_rate",
-    "unknown",
-    "unknown",
-    // 0x10
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "current_helium_level",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    // 0x20
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    // 0x30
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    // 0x40
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    // 0x50
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    // 0x60
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    // 0x70
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    // 0x80
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    // 0x90
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    // 0xa0
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "available_reserved_space",
-    "ssd_program_fail_count",
-    "ssd_erase_fail_count",
-    "ssd_wear_leveling_count",
-    "unexpected_power_loss_count",
-    "power_loss_protection_failure",
-    // 0xb0
-    "erase_fail_count",
-    "wear_range_delta",
-    "unknown",
-    "used_reserved_block_count_total",
-    "unused_reserved_block_count_total",
-    "program_fail_count_total",
-    "erase_fail_count",
-    "sata_downshift_error_count",
-    "end_to_end_error",
-    "head_stability",
-    "induced_op_vibration_detection",
-    "reported_uncorrectable_errors",
-    "command_timeout",
-    "high_fly_writes",
-    "airflow_temperature",
-    "g_sense_error_rate",
-    // 0xc0
-    "power_off_retract_count",
-    "load_cycle_count",
-    "temperature",
-    "hardware_ecc_recovered",
-    "reallocation_event_count",
-    "current_pending_sector_count",
-    "uncorrectable_sector_count",
-    "ultradma_crc_error_count",
-    "multi_zone_error_rate",
-    "soft_read_error_rate",
-    "data_address_mark_errors",
-    "run_out_cancel",
-    "soft_ecc_correction",
-    "thermal_asperity_rate",
-    "flying_height",
-    "spin_height_current",
-    // 0xd0
-    "spin_buzz",
-    "offline_seek_performance",
-    "vibration_during_write",
-    "vibration_during_write",
-    "shock_during_write",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "disk_shift",
-    "g_sense_error_rate",
-    "loaded_hours",
-    "load_unload_retry_count",
-    // 0xe0
-    "load_friction",
-    "load_unload_cycle_count",
-    "load_in_time",
-    "torque_amplification_count",
-    "power_off_retract_cycle",
-    "unknown",
-    "drive_life_protection_status",
-    "temperature",
-    "available_reserved_space",
-    "media_wearout_indicator",
-    "average_erase_count",
-    "good_block_count",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    // 0xf0
-    "flying_head_hours",
-    "total_lbas_written",
-    "total_lbas_read",
-    "total_lbas_written_expanded",
-    "total_lbas_read_expanded",
-    "unknown",
-    "unknown",
-    "unknown",
-    "unknown",
-    "nand_writes_1gib",
-    "read_error_retry_rate",
-    "minimum_spares_remaining",
-    "newly_added_bad_flash_block",
-    "unknown",
-    "free_fall_protection",
-    "unknown",
-  };
-
-  o << dec << static_cast<unsigned int>(attribute.id) << "_" << labels[attribute.id] << "=" << attribute.raw;
+  o << dec << static_cast<unsigned int>(attribute.id) << "_" << smart_attribute_label(attribute.id) << "=" << attribute.raw;
 
   return o;
 
@@ -369,3 +414,76 @@ ostream& operator<<(ostream& o, const SmartAttribute& attribute) {
 SmartThreshold::SmartThreshold(const smart_threshold& threshold)
 : threshold(StorageEndian::swap(threshold.threshold))
 {}
+
+/*
+ * Function: smart_self_test_results
+ * ---------------------------------
+ * Extracts results from a SMART self-test log, most recent first, and
+ * returns the number found
+ * log: Reference to the self-test log
+ * results: Array to receive results, must hold SMART_SELF_TEST_LOG_DESCRIPTORS
+ */
+int smart_self_test_results(const smart_self_test_log& log, smart_self_test_result* results) {
+
+  int index = StorageEndian::swap(log.index);
+  if(!index || index > SMART_SELF_TEST_LOG_DESCRIPTORS)
+    return 0;
+
+  // Walk back from the most recent entry, unused entries are zeroed
+  int num = 0;
+  for(int i=0; i<SMART_SELF_TEST_LOG_DESCRIPTORS; i++) {
+
+    int slot = (index - 1 - i + SMART_SELF_TEST_LOG_DESCRIPTORS) % SMART_SELF_TEST_LOG_DESCRIPTORS;
+    const smart_self_test_descriptor& descriptor = log.descriptors[slot];
+
+    if(!descriptor.subcommand)
+      break;
+
+    results[num].type = StorageEndian::swap(descriptor.subcommand);
+    results[num].status = StorageEndian::swap(descriptor.status);
+    results[num].timestamp = StorageEndian::swap(descriptor.timestamp);
+    num++;
+
+  }
+
+  return num;
+
+}
+
+/*
+ * Function: smart_ext_self_test_results
+ * -------------------------------------
+ * Extracts results from an extended self-test log, most recent first, and
+ * returns the number found
+ * pages: Extended self-test log pages
+ * num: Number of pages
+ * results: Array to receive results, must hold num * SMART_EXT_SELF_TEST_LOG_DESCRIPTORS
+ */
+int smart_ext_self_test_results(const smart_ext_self_test_log* pages, int num, smart_self_test_result* results) {
+
+  int descriptors = num * SMART_EXT_SELF_TEST_LOG_DESCRIPTORS;
+
+  int index = num ? StorageEndian::swap(pages[0].index) : 0;
+  if(!index || index > descriptors)
+    return 0;
+
+  int found = 0;
+  for(int i=0; i<descriptors; i++) {
+
+    int slot = (index - 1 - i + descriptors) % descriptors;
+    const smart_ext_self_test_descriptor& descriptor =
+      pages[slot / SMART_EXT_SELF_TEST_LOG_DESCRIPTORS].descriptors[slot % SMART_EXT_SELF_TEST_LOG_DESCRIPTORS];
+
+    if(!descriptor.subcommand)
+      break;
+
+    results[found].type = StorageEndian::swap(descriptor.subcommand);
+    results[found].status = StorageEndian::swap(descriptor.status);
+    results[found].timestamp = StorageEndian::swap(descriptor.timestamp);
+    found++;
+
+  }
+
+  return found;
+
+}
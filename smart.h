@@ -33,10 +33,12 @@ class SmartAttribute;
 class SmartThreshold;
 
 /* SMART functions */
-const uint8_t SMART_READ_DATA       = 0xd0;
-const uint8_t SMART_READ_THRESHOLDS = 0xd1;
-const uint8_t SMART_READ_LOG        = 0xd5;
-const uint8_t SMART_RETURN_STATUS   = 0xda;
+const uint8_t SMART_READ_DATA                  = 0xd0;
+const uint8_t SMART_READ_THRESHOLDS            = 0xd1;
+const uint8_t SMART_EXECUTE_OFF_LINE_IMMEDIATE = 0xd4;
+const uint8_t SMART_READ_LOG                   = 0xd5;
+const uint8_t SMART_WRITE_LOG                  = 0xd6;
+const uint8_t SMART_RETURN_STATUS              = 0xda;
 
 /* SMART off-line status */
 const uint8_t SMART_OFF_LINE_STATUS_NEVER_STARTED  = 0x00;
@@ -46,6 +48,29 @@ const uint8_t SMART_OFF_LINE_STATUS_SUSPENDED      = 0x04;
 const uint8_t SMART_OFF_LINE_STATUS_ABORTED_HOST   = 0x05;
 const uint8_t SMART_OFF_LINE_STATUS_ABORTED_DEVICE = 0x06;
 
+/* SMART self-test subcommands, captive variants set the top bit */
+const uint8_t SMART_SELF_TEST_SHORT      = 0x01;
+const uint8_t SMART_SELF_TEST_EXTENDED   = 0x02;
+const uint8_t SMART_SELF_TEST_CONVEYANCE = 0x03;
+const uint8_t SMART_SELF_TEST_CAPTIVE    = 0x80;
+
+/* SMART self-test execution status, held in the top nibble */
+const uint8_t SMART_SELF_TEST_STATUS_COMPLETED   = 0x0;
+const uint8_t SMART_SELF_TEST_STATUS_ABORTED     = 0x1;
+const uint8_t SMART_SELF_TEST_STATUS_INTERRUPTED = 0x2;
+const uint8_t SMART_SELF_TEST_STATUS_FATAL       = 0x3;
+const uint8_t SMART_SELF_TEST_STATUS_READ_FAILED = 0x7;
+const uint8_t SMART_SELF_TEST_STATUS_DAMAGE      = 0x8;
+const uint8_t SMART_SELF_TEST_STATUS_IN_PROGRESS = 0xf;
+
+/* Self-test log descriptors */
+const uint8_t SMART_SELF_TEST_LOG_DESCRIPTORS     = 21;
+const uint8_t SMART_EXT_SELF_TEST_LOG_DESCRIPTORS = 19;
+
+/* Error log entries per sector */
+const uint8_t SMART_LOG_ENTRIES     = 5;
+const uint8_t SMART_EXT_LOG_ENTRIES = 4;
+
 /* Attributes in a smart_data page */
 const uint8_t SMART_ATTRIBUTE_NUM = 30;
 
@@ -182,17 +207,177 @@ typedef struct __attribute__((packed)) {
 /*
  * Struct: smart_log_summary
  * -------------------------
- * Top level log summary containing upto 5 errors
+ * Top level log summary containing upto 5 errors.  The comprehensive log
+ * shares this layout, its entries forming a single ring across sectors with
+ * the index and count only valid in the first.
  */
 typedef struct __attribute__((packed)) {
   uint8_t version;
   uint8_t index;
-  smart_log_data data[5];
+  smart_log_data data[SMART_LOG_ENTRIES];
   uint16_t count;
   uint8_t reserved[57];
   uint8_t checksum;
 } smart_log_summary;
 
+/*
+ * Struct: smart_ext_log_command
+ * -----------------------------
+ * Extended comprehensive log command with 48-bit registers
+ */
+typedef struct __attribute__((packed)) {
+  uint8_t  control;
+  uint16_t feature;
+  uint16_t count;
+  uint8_t  lba[6];
+  uint8_t  device;
+  uint8_t  command;
+  uint8_t  reserved;
+  uint32_t timestamp;
+} smart_ext_log_command;
+
+/*
+ * Struct: smart_ext_log_error
+ * ---------------------------
+ * Extended comprehensive log error with 48-bit registers
+ */
+typedef struct __attribute__((packed)) {
+  uint8_t  transport;
+  uint8_t  error;
+  uint16_t count;
+  uint8_t  lba[6];
+  uint8_t  device;
+  uint8_t  status;
+  uint8_t  extended[19];
+  uint8_t  state;
+  uint16_t timestamp;
+} smart_ext_log_error;
+
+/*
+ * Struct: smart_ext_log_data
+ * --------------------------
+ * Extended error and the preceding commands leading up to it
+ */
+typedef struct __attribute__((packed)) {
+  smart_ext_log_command command[5];
+  smart_ext_log_error   error;
+} smart_ext_log_data;
+
+/*
+ * Struct: smart_ext_log
+ * ---------------------
+ * Page of the extended comprehensive error log, the entries of all pages
+ * form a single ring and the index and count in the first page describe it
+ */
+typedef struct __attribute__((packed)) {
+  uint8_t            version;
+  uint8_t            reserved1;
+  uint16_t           index;
+  smart_ext_log_data data[SMART_EXT_LOG_ENTRIES];
+  uint16_t           count;
+  uint8_t            reserved2[9];
+  uint8_t            checksum;
+} smart_ext_log;
+
+/*
+ * Struct: smart_self_test_descriptor
+ * ----------------------------------
+ * Result of a single self-test in the SMART self-test log
+ */
+typedef struct __attribute__((packed)) {
+  uint8_t  subcommand;
+  uint8_t  status;
+  uint16_t timestamp;
+  uint8_t  checkpoint;
+  uint32_t failing_lba;
+  uint8_t  vendor[15];
+} smart_self_test_descriptor;
+
+/*
+ * Struct: smart_self_test_log
+ * ---------------------------
+ * SMART self-test log, a ring of 21 descriptors where index points at the
+ * most recent entry
+ */
+typedef struct __attribute__((packed)) {
+  uint16_t                   revision;
+  smart_self_test_descriptor descriptors[SMART_SELF_TEST_LOG_DESCRIPTORS];
+  uint16_t                   vendor;
+  uint8_t                    index;
+  uint16_t                   reserved;
+  uint8_t                    checksum;
+} smart_self_test_log;
+
+/*
+ * Struct: smart_ext_self_test_descriptor
+ * --------------------------------------
+ * Result of a single self-test in the extended self-test log
+ */
+typedef struct __attribute__((packed)) {
+  uint8_t  subcommand;
+  uint8_t  status;
+  uint16_t timestamp;
+  uint8_t  checkpoint;
+  uint8_t  failing_lba[6];
+  uint8_t  vendor[15];
+} smart_ext_self_test_descriptor;
+
+/*
+ * Struct: smart_ext_self_test_log
+ * -------------------------------
+ * Page of the extended self-test log, the descriptors of all pages form a
+ * single ring and the index in the first page points at the most recent
+ */
+typedef struct __attribute__((packed)) {
+  uint8_t                        version;
+  uint8_t                        reserved1;
+  uint16_t                       index;
+  smart_ext_self_test_descriptor descriptors[SMART_EXT_SELF_TEST_LOG_DESCRIPTORS];
+  uint8_t                        vendor[2];
+  uint8_t                        reserved2[11];
+  uint8_t                        checksum;
+} smart_ext_self_test_log;
+
+/*
+ * Struct: smart_self_test_result
+ * ------------------------------
+ * Log format independent view of a self-test log descriptor
+ */
+typedef struct {
+  uint8_t  type;
+  uint8_t  status;
+  uint16_t timestamp;
+} smart_self_test_result;
+
+/*
+ * Function: smart_self_test_results
+ * ---------------------------------
+ * Extracts results from a SMART self-test log, most recent first, and
+ * returns the number found
+ * log: Reference to the self-test log
+ * results: Array to receive results, must hold SMART_SELF_TEST_LOG_DESCRIPTORS
+ */
+int smart_self_test_results(const smart_self_test_log& log, smart_self_test_result* results);
+
+/*
+ * Function: smart_ext_self_test_results
+ * -------------------------------------
+ * Extracts results from an extended self-test log, most recent first, and
+ * returns the number found
+ * pages: Extended self-test log pages
+ * num: Number of pages
+ * results: Array to receive results, must hold num * SMART_EXT_SELF_TEST_LOG_DESCRIPTORS
+ */
+int smart_ext_self_test_results(const smart_ext_self_test_log* pages, int num, smart_self_test_result* results);
+
+/*
+ * Function: smart_attribute_label
+ * -------------------------------
+ * Returns the name of a SMART attribute e.g. reallocated_sectors_count
+ * id: Attribute ID
+ */
+const char* smart_attribute_label(uint8_t id);
+
 /*
  * Class: SmartAttribute
  * ---------------
@@ -227,6 +412,24 @@ public:
     return pre_fail;
   }
 
+  /**
+   * Function: SmartAttribute:getValue()
+   * -----------------------------------
+   * Return the normalized value
+   */
+  inline uint8_t getValue() const {
+    return value;
+  }
+
+  /**
+   * Function: SmartAttribute:getWorst()
+   * -----------------------------------
+   * Return the lowest normalized value the drive has recorded
+   */
+  inline uint8_t getWorst() const {
+    return worst;
+  }
+
   /**
    * Function: SmartAttribute:getRaw()
    * ---------------------------------
@@ -245,6 +448,14 @@ public:
     return id != 0;
   }
 
+  /**
+   * Function: SmartAttribute::isFailureCounter()
+   * --------------------------------------------
+   * Checks whether the raw value counts media or interface failures, rather
+   * than usage which advances on every healthy drive
+   */
+  bool isFailureCounter() const;
+
   /**
    * Function: SmartAttribute::valueValid()
    * --------------------------------------
@@ -269,6 +480,7 @@ private:
   bool pre_fail;
   bool offline;
   uint8_t value;
+  uint8_t worst;
   uint64_t raw;
 
 };
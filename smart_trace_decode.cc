@@ -0,0 +1,158 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Description
+ * -----------
+ * Decodes binary command traces captured by check_scsi_smart --trace into
+ * a human readable form, one command per line.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "endian.h"
+#include "sgio.h"
+#include "trace.h"
+
+#include <iostream>
+#include <iomanip>
+
+using namespace std;
+
+const char* const BINARY = "smart_trace_decode";
+
+/*
+ * Function: dump_bytes
+ * --------------------
+ * Print a buffer as space separated hex octets
+ * o: Output stream
+ * buf: Buffer to print
+ * len: Length of the buffer
+ */
+void dump_bytes(ostream& o, const uint8_t* buf, int len) {
+
+  for(int i=0; i<len; i++) {
+    if(i)
+      o << " ";
+    o << hex << setw(2) << setfill('0') << static_cast<unsigned int>(buf[i]);
+  }
+
+  o << dec << setfill(' ');
+
+}
+
+/*
+ * Function: dump_sense
+ * --------------------
+ * Print the sense key, ASC and ASCQ for fixed or descriptor format sense
+ * o: Output stream
+ * sense: Sense buffer
+ * len: Length of the sense buffer
+ */
+void dump_sense(ostream& o, const uint8_t* sense, int len) {
+
+  uint8_t key, asc, ascq;
+  if(!sense_decode(sense, len, key, asc, ascq))
+    return;
+
+  o << hex << setfill('0')
+    << " key=" << setw(1) << static_cast<unsigned int>(key)
+    << " asc=" << setw(2) << static_cast<unsigned int>(asc)
+    << " ascq=" << setw(2) << static_cast<unsigned int>(ascq)
+    << dec << setfill(' ');
+
+}
+
+/*
+ * Function: main
+ * --------------
+ * Reads records from the named trace file, or stdin, and prints them
+ */
+int main(int argc, char** argv) {
+
+  if(argc > 2) {
+    cerr << "Usage:" << endl
+         << BINARY << " [<trace>]" << endl;
+    return 1;
+  }
+
+  FILE* in = stdin;
+  if(argc == 2 && !(in = fopen(argv[1], "rb"))) {
+    cerr << BINARY << ": unable to open " << argv[1] << endl;
+    return 1;
+  }
+
+  trace_record r;
+  unsigned long n = 0;
+
+  while(fread(&r, sizeof(trace_record), 1, in) == 1) {
+
+    if(StorageEndian::swap(r.magic) != TRACE_MAGIC ||
+       StorageEndian::swap(r.length) != sizeof(trace_record)) {
+      cerr << BINARY << ": corrupt record at offset " << n * sizeof(trace_record) << endl;
+      return 1;
+    }
+
+    uint64_t timestamp = StorageEndian::swap(r.timestamp);
+    int cdb_len = min(r.cdb_len, TRACE_CDB_MAX);
+    int sense_len = min(r.sense_len, TRACE_SENSE_MAX);
+
+    cout << timestamp / 1000000 << "." << setw(6) << setfill('0') << timestamp % 1000000 << setfill(' ')
+         << " duration=" << StorageEndian::swap(r.duration) << "us"
+         << " cdb=[";
+    dump_bytes(cout, r.cdb, cdb_len);
+    cout << "]"
+         << " xfer=" << StorageEndian::swap(r.dxfer_len)
+         << " resid=" << StorageEndian::swap(r.resid);
+
+    int32_t error = StorageEndian::swap(r.error);
+    if(error) {
+      cout << " error=" << strerror(error) << endl;
+      n++;
+      continue;
+    }
+
+    cout << hex << setfill('0')
+         << " status=0x" << setw(2) << static_cast<unsigned int>(r.status)
+         << " host=0x" << setw(2) << StorageEndian::swap(r.host_status)
+         << " driver=0x" << setw(2) << StorageEndian::swap(r.driver_status)
+         << dec << setfill(' ');
+
+    if(sense_len) {
+      cout << " sense=[";
+      dump_bytes(cout, r.sense, sense_len);
+      cout << "]";
+      dump_sense(cout, r.sense, sense_len);
+    }
+
+    cout << endl;
+    n++;
+
+  }
+
+  if(in != stdin)
+    fclose(in);
+
+  return 0;
+
+}
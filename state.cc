@@ -0,0 +1,347 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+#include "state.h"
+
+#include <fstream>
+
+/**
+ * Function: StateFile::StateFile(const string&)
+ * ---------------------------------------------
+ * Class constructor, no I/O is performed until load or save
+ * path: Path of the backing file
+ */
+StateFile::StateFile(const string& path)
+: path(path)
+{}
+
+thread_local StateCache* state_cache = 0;
+
+/**
+ * Function: StateFile::load()
+ * ---------------------------
+ * Reads the backing file, a missing file is treated as empty state
+ */
+bool StateFile::load() {
+
+  return state_cache ? state_cache->load(*this) : read();
+
+}
+
+/**
+ * Function: StateFile::save()
+ * ---------------------------
+ * Atomically replaces the backing file, creating its directory if need be
+ */
+bool StateFile::save() const {
+
+  if(!state_cache)
+    return write();
+
+  state_cache->save(*this);
+
+  return true;
+
+}
+
+/**
+ * Function: StateFile::update(const string&, uint64_t)
+ * ----------------------------------------------------
+ * Sets a single value in a file shared by concurrent checks.  The file
+ * is re-read and saved under an exclusive lock so values set by other
+ * checks since it was loaded aren't lost.
+ * key: Name of the value
+ * value: Value to store
+ */
+bool StateFile::update(const string& key, uint64_t value) {
+
+  if(!state_cache)
+    return write_value(key, value);
+
+  state_cache->update(*this, key, value);
+
+  return true;
+
+}
+
+/*
+ * Method: read
+ * ------------
+ * Reads the backing file as load does, bypassing any cache
+ */
+bool StateFile::read() {
+
+  values.clear();
+
+  ifstream in(path.c_str());
+  if(!in)
+    return true;
+
+  string key;
+  uint64_t value;
+  while(in >> key >> value)
+    values[key] = value;
+
+  return in.eof();
+
+}
+
+/*
+ * Method: write
+ * -------------
+ * Replaces the backing file as save does, bypassing any cache
+ */
+bool StateFile::write() const {
+
+  string::size_type slash = path.rfind('/');
+  if(slash != string::npos && slash)
+    mkdir(path.substr(0, slash).c_str(), 0755);
+
+  // Write aside and rename so a concurrent reader never sees a partial file
+  string temp = path + ".tmp." + to_string(getpid());
+
+  {
+    ofstream out(temp.c_str());
+    for(map<string, uint64_t>::const_iterator i = values.begin(); i != values.end(); i++)
+      out << i->first << " " << i->second << endl;
+
+    if(!out) {
+      unlink(temp.c_str());
+      return false;
+    }
+  }
+
+  return rename(temp.c_str(), path.c_str()) == 0;
+
+}
+
+/*
+ * Method: write_value
+ * -------------------
+ * Sets a single value in the backing file as update does, bypassing any
+ * cache
+ * key: Name of the value
+ * value: Value to store
+ */
+bool StateFile::write_value(const string& key, uint64_t value) {
+
+  string::size_type slash = path.rfind('/');
+  if(slash != string::npos && slash)
+    mkdir(path.substr(0, slash).c_str(), 0755);
+
+  // The lock lives beside the file as rename replaces the file's inode
+  string lock = path + ".lock";
+  int fd = open(lock.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if(fd == -1)
+    return false;
+
+  bool ok = flock(fd, LOCK_EX) == 0 && read();
+  if(ok) {
+    set(key, value);
+    ok = write();
+  }
+
+  close(fd);
+
+  return ok;
+
+}
+
+/**
+ * Function: StateFile::get(const string&, uint64_t&)
+ * --------------------------------------------------
+ * Looks up a value, returning false if it has never been set
+ * key: Name of the value
+ * value: Reference to receive the value
+ */
+bool StateFile::get(const string& key, uint64_t& value) const {
+
+  map<string, uint64_t>::const_iterator i = values.find(key);
+  if(i == values.end())
+    return false;
+
+  value = i->second;
+
+  return true;
+
+}
+
+/**
+ * Function: StateFile::set(const string&, uint64_t)
+ * -------------------------------------------------
+ * Sets a value to be persisted on the next save
+ * key: Name of the value
+ * value: Value to store
+ */
+void StateFile::set(const string& key, uint64_t value) {
+
+  values[key] = value;
+
+}
+
+/*
+ * Method: begin
+ * -------------
+ * Starts another run, discarding the changes the previous one made
+ */
+void StateCache::begin() {
+
+  saved.clear();
+  updated.clear();
+
+}
+
+/*
+ * Method: commit
+ * --------------
+ * Writes the changes of the last run, returning false if a saved file
+ * couldn't be written.  Updates are best effort, as they are for a check
+ * writing them itself.
+ * failed: Reference to receive the path of the file which wasn't written
+ */
+bool StateCache::commit(string& failed) {
+
+  bool ok = true;
+
+  for(map<string, map<string, uint64_t> >::const_iterator i = saved.begin(); i != saved.end(); i++) {
+    StateFile file(i->first);
+    file.values = i->second;
+    if(!file.write() && ok) {
+      failed = i->first;
+      ok = false;
+    }
+  }
+
+  for(map<string, map<string, uint64_t> >::const_iterator i = updated.begin(); i != updated.end(); i++) {
+    StateFile file(i->first);
+    for(map<string, uint64_t>::const_iterator j = i->second.begin(); j != i->second.end(); j++)
+      file.write_value(j->first, j->second);
+  }
+
+  saved.clear();
+  updated.clear();
+
+  return ok;
+
+}
+
+/*
+ * Method: load
+ * ------------
+ * Fills a file with its values as of its first load in this cache, then
+ * whatever the current run saved or updated
+ * file: Reference to the file to fill
+ */
+bool StateCache::load(StateFile& file) {
+
+  map<string, pair<bool, map<string, uint64_t> > >::iterator first = loaded.find(file.path);
+  if(first == loaded.end()) {
+    bool ok = file.read();
+    first = loaded.insert(make_pair(file.path, make_pair(ok, file.values))).first;
+  }
+
+  map<string, map<string, uint64_t> >::const_iterator current = saved.find(file.path);
+  file.values = current != saved.end() ? current->second : first->second.second;
+
+  current = updated.find(file.path);
+  if(current != updated.end())
+    for(map<string, uint64_t>::const_iterator i = current->second.begin(); i != current->second.end(); i++)
+      file.values[i->first] = i->second;
+
+  return first->second.first;
+
+}
+
+/*
+ * Method: save
+ * ------------
+ * Holds a file's values to be written on commit, replacing any updates
+ * made to it before
+ * file: Reference to the file saved
+ */
+void StateCache::save(const StateFile& file) {
+
+  saved[file.path] = file.values;
+  updated.erase(file.path);
+
+}
+
+/*
+ * Method: update
+ * --------------
+ * Holds a single value to be written on commit, and reloads the file with
+ * it set as update would
+ * file: Reference to the file updated
+ * key: Name of the value
+ * value: Value to store
+ */
+void StateCache::update(StateFile& file, const string& key, uint64_t value) {
+
+  updated[file.path][key] = value;
+  load(file);
+
+}
+
+/*
+ * Function: state_path
+ * --------------------
+ * Returns the state file path for a device within a state directory
+ * dir: State directory
+ * key: Device key, path separators are flattened
+ */
+string state_path(const string& dir, const string& key) {
+
+  string name = key;
+  while(!name.empty() && name[0] == '/')
+    name.erase(0, 1);
+
+  for(string::iterator i = name.begin(); i != name.end(); i++)
+    if(*i == '/')
+      *i = '_';
+
+  return dir + "/" + name + ".state";
+
+}
+
+/*
+ * Function: state_hash
+ * --------------------
+ * Returns a 64-bit FNV-1a hash of a string so it can be held as a value
+ * text: String to hash
+ */
+uint64_t state_hash(const string& text) {
+
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for(string::const_iterator i = text.begin(); i != text.end(); i++) {
+    hash ^= static_cast<uint8_t>(*i);
+    hash *= 0x100000001b3ULL;
+  }
+
+  return hash;
+
+}
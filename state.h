@@ -0,0 +1,196 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _state_H_
+#define _state_H_
+
+#include <stdint.h>
+#include <map>
+#include <string>
+
+using namespace std;
+
+/* Default location of per-device state */
+const char* const STATE_DIR_DEFAULT = "/var/lib/check_scsi_smart";
+
+/* Name of the SAT variant cache shared by all devices */
+const char* const STATE_SAT_VARIANTS = "sat-variants";
+
+/* Key holding a hash of the identity of the device the state belongs to */
+const char* const STATE_IDENTITY = "identity";
+
+/*
+ * Class: StateFile
+ * ----------------
+ * Small persistent key/value store holding what a previous check of a
+ * device saw, so the next check only needs to look at what changed
+ */
+class StateFile {
+
+public:
+  /**
+   * Function: StateFile::StateFile(const string&)
+   * ---------------------------------------------
+   * Class constructor, no I/O is performed until load or save
+   * path: Path of the backing file
+   */
+  StateFile(const string& path);
+
+  /**
+   * Function: StateFile::load()
+   * ---------------------------
+   * Reads the backing file, a missing file is treated as empty state
+   */
+  bool load();
+
+  /**
+   * Function: StateFile::save()
+   * ---------------------------
+   * Atomically replaces the backing file, creating its directory if need be
+   */
+  bool save() const;
+
+  /**
+   * Function: StateFile::update(const string&, uint64_t)
+   * ----------------------------------------------------
+   * Sets a single value in a file shared by concurrent checks.  The file
+   * is re-read and saved under an exclusive lock so values set by other
+   * checks since it was loaded aren't lost.
+   * key: Name of the value
+   * value: Value to store
+   */
+  bool update(const string& key, uint64_t value);
+
+  /**
+   * Function: StateFile::get(const string&, uint64_t&)
+   * --------------------------------------------------
+   * Looks up a value, returning false if it has never been set
+   * key: Name of the value
+   * value: Reference to receive the value
+   */
+  bool get(const string& key, uint64_t& value) const;
+
+  /**
+   * Function: StateFile::set(const string&, uint64_t)
+   * -------------------------------------------------
+   * Sets a value to be persisted on the next save
+   * key: Name of the value
+   * value: Value to store
+   */
+  void set(const string& key, uint64_t value);
+
+  /**
+   * Function: StateFile::clear()
+   * ----------------------------
+   * Discards all values, e.g. when they belong to a different device
+   */
+  inline void clear() {
+    values.clear();
+  }
+
+  /**
+   * Function: StateFile::empty()
+   * ----------------------------
+   * Returns whether no values are held
+   */
+  inline bool empty() const {
+    return values.empty();
+  }
+
+private:
+  friend class StateCache;
+
+  string path;
+  map<string, uint64_t> values;
+
+  bool read();
+  bool write() const;
+  bool write_value(const string& key, uint64_t value);
+
+};
+
+/*
+ * Class: StateCache
+ * -----------------
+ * Holds the state files of a check that is run more than once, as a sweep
+ * runs each check again as responses arrive.  While installed as
+ * state_cache a file is read on its first load only, and every run sees
+ * it as it was then plus the run's own changes.  Nothing is written until
+ * the last run is committed.
+ */
+class StateCache {
+
+public:
+
+  /*
+   * Method: begin
+   * -------------
+   * Starts another run, discarding the changes the previous one made
+   */
+  void begin();
+
+  /*
+   * Method: commit
+   * --------------
+   * Writes the changes of the last run, returning false if a saved file
+   * couldn't be written.  Updates are best effort, as they are for a
+   * check writing them itself.
+   * failed: Reference to receive the path of the file which wasn't written
+   */
+  bool commit(string& failed);
+
+private:
+  friend class StateFile;
+
+  // Each file as first loaded and whether it read cleanly, then what the
+  // current run saved and updated
+  map<string, pair<bool, map<string, uint64_t> > > loaded;
+  map<string, map<string, uint64_t> > saved;
+  map<string, map<string, uint64_t> > updated;
+
+  bool load(StateFile& file);
+  void save(const StateFile& file);
+  void update(StateFile& file, const string& key, uint64_t value);
+
+};
+
+/* Cache the calling thread's state files go through, if any */
+extern thread_local StateCache* state_cache;
+
+/*
+ * Function: state_path
+ * --------------------
+ * Returns the state file path for a device within a state directory
+ * dir: State directory
+ * key: Device key, path separators are flattened
+ */
+string state_path(const string& dir, const string& key);
+
+/*
+ * Function: state_hash
+ * --------------------
+ * Returns a 64-bit FNV-1a hash of a string so it can be held as a value
+ * text: String to hash
+ */
+uint64_t state_hash(const string& text);
+
+#endif//_state_H_
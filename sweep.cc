@@ -0,0 +1,1079 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+/*
+ * Sweeps are built from C++20 coroutines, so this file alone is compiled
+ * as C++20 and nothing coroutine related escapes into sweep.h.
+ *
+ * The checks themselves are unchanged synchronous code.  Each runs against
+ * a registered handle which answers from the responses collected so far.
+ * The first command without a response abandons the check, the coroutine
+ * waits for that command and then runs the check again.  Commands are
+ * issued at most once, and evaluating a check is cheap next to waiting
+ * for a drive.  State files go through a cache held for the check, so
+ * each is read once and only the last run's changes are written.
+ *
+ * Replayed responses aren't traced, each command is traced once when it
+ * completes, timed from when it was issued to the device.
+ *
+ * Queued commands are collected by one epoll loop.  Every command has the
+ * same deadline, so deadlines expire in the order commands were queued and
+ * a single timerfd armed for the earliest covers them all.  Retries of
+ * transient failures wait out their backoff on the same timer, sgio never
+ * sleeps for a registered handle so replaying a check doesn't block.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <sys/sysmacros.h>
+#include <linux/major.h>
+#include <scsi/sg.h>
+
+#include "sweep.h"
+#include "sgio.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <coroutine>
+#include <list>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <utility>
+
+/*
+ * Class: FramePool
+ * ----------------
+ * Fixed size blocks holding coroutine frames.  Blocks are reused rather
+ * than returned to the heap, so memory stays flat across sweeps.
+ */
+class FramePool {
+
+private:
+
+  vector<unique_ptr<char[]>> chunks;
+  vector<void*> free;
+
+public:
+
+  size_t heap;
+
+  FramePool() : heap(0) {}
+
+  /*
+   * Method: allocate
+   * ----------------
+   * Returns a block for a frame, growing the pool if none are free
+   * size: Bytes the frame needs
+   */
+  void* allocate(size_t size) {
+
+    if(size > SWEEP_FRAME_SIZE) {
+      heap++;
+      return ::operator new(size);
+    }
+
+    if(free.empty()) {
+      chunks.push_back(unique_ptr<char[]>(new char[SWEEP_FRAME_SIZE * SWEEP_FRAME_CHUNK]));
+      for(size_t i = 0; i < SWEEP_FRAME_CHUNK; i++)
+        free.push_back(chunks.back().get() + i * SWEEP_FRAME_SIZE);
+    }
+
+    void* frame = free.back();
+    free.pop_back();
+
+    return frame;
+
+  }
+
+  /*
+   * Method: release
+   * ---------------
+   * Returns a frame's block to the pool
+   * frame: Frame to release
+   * size: Bytes the frame needed
+   */
+  void release(void* frame, size_t size) {
+
+    if(size > SWEEP_FRAME_SIZE)
+      ::operator delete(frame);
+    else
+      free.push_back(frame);
+
+  }
+
+  /*
+   * Method: pooled
+   * --------------
+   * Returns the number of blocks in the pool
+   */
+  size_t pooled() const {
+
+    return chunks.size() * SWEEP_FRAME_CHUNK;
+
+  }
+
+};
+
+static FramePool frames;
+
+/*
+ * Class: CheckTask
+ * ----------------
+ * A device check running as a coroutine.  It starts suspended and stays
+ * suspended when finished, so the scheduler decides when it runs and
+ * when its frame is released.
+ */
+class CheckTask {
+
+public:
+
+  struct promise_type {
+
+    static void* operator new(size_t size) {
+      return frames.allocate(size);
+    }
+
+    static void operator delete(void* frame, size_t size) {
+      frames.release(frame, size);
+    }
+
+    CheckTask get_return_object() {
+      return CheckTask(coroutine_handle<promise_type>::from_promise(*this));
+    }
+
+    suspend_always initial_suspend() noexcept { return {}; }
+    suspend_always final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { terminate(); }
+
+  };
+
+  coroutine_handle<promise_type> handle;
+
+  CheckTask() : handle(0) {}
+  explicit CheckTask(coroutine_handle<promise_type> handle) : handle(handle) {}
+  CheckTask(const CheckTask&) = delete;
+
+  CheckTask& operator=(CheckTask&& other) {
+    if(handle)
+      handle.destroy();
+    handle = exchange(other.handle, nullptr);
+    return *this;
+  }
+
+  ~CheckTask() {
+    if(handle)
+      handle.destroy();
+  }
+
+};
+
+/*
+ * Struct: sweep_response
+ * ----------------------
+ * A command's outcome as the check will see it
+ */
+struct sweep_response {
+  int error;
+  bool transient;
+  uint8_t status;
+  uint16_t host_status;
+  uint16_t driver_status;
+  int resid;
+  string sense;
+  string data;
+};
+
+/*
+ * Class: SweepSlot
+ * ----------------
+ * Where one device at a time is checked.  Each slot keeps the handle its
+ * checks run against, handles are recycled between sweeps.
+ */
+class SweepSlot {
+
+public:
+
+  int handle;
+  int context;
+  int fd;
+  int flags;
+  bool asynchronous;
+  bool waiting;
+  size_t index;
+  sg_device device;
+  CheckTask task;
+
+  // When the queued command is given up on, and its place among the others
+  uint64_t deadline;
+  list<SweepSlot*>::iterator queued;
+
+  // When the command was issued, for the trace
+  uint64_t timestamp;
+  uint64_t started;
+
+  // Responses by request, in the order the check issued them
+  map<string, vector<sweep_response>> responses;
+  map<string, size_t> seen;
+
+  // State files as the check's first run read them
+  StateCache state;
+
+  // The command being issued for the check, and milliseconds to wait
+  // before issuing a retry
+  bool missed;
+  int backoff;
+  string key;
+  sg_io_hdr_t hdr;
+  unsigned char cdb[16];
+  unsigned char sense[32];
+  vector<unsigned char> buffer;
+
+  SweepSlot();
+  ~SweepSlot();
+
+  int replay(sg_io_hdr_t& request);
+
+};
+
+/* Slots by context, and the handles of contexts not in use */
+static vector<SweepSlot*> sweep_slots;
+static vector<int> sweep_handles;
+static vector<int> sweep_free;
+
+/*
+ * Function: sweep_handler
+ * -----------------------
+ * Passes a request for a registered handle to its slot
+ */
+static int sweep_handler(int context, sg_io_hdr_t& hdr) {
+
+  return sweep_slots[context]->replay(hdr);
+
+}
+
+/*
+ * Function: sweep_key
+ * -------------------
+ * Returns what identifies a request, data sent to the device included
+ * hdr: Reference to the request
+ */
+static string sweep_key(const sg_io_hdr_t& hdr) {
+
+  string key(reinterpret_cast<const char*>(hdr.cmdp), hdr.cmd_len);
+  key += ":" + to_string(hdr.dxfer_direction) + ":" + to_string(hdr.dxfer_len);
+
+  if(hdr.dxfer_direction == SG_DXFER_TO_DEV)
+    key.append(static_cast<const char*>(hdr.dxferp), hdr.dxfer_len);
+
+  return key;
+
+}
+
+/*
+ * Method: SweepSlot
+ * -----------------
+ * Takes an unused context, registering a handle if there is none
+ */
+SweepSlot::SweepSlot() : fd(-1), flags(-1), asynchronous(false), waiting(false), index(0), timestamp(0), started(0),
+                         missed(false), backoff(0) {
+
+  if(sweep_free.empty()) {
+    sweep_slots.push_back(0);
+    sweep_handles.push_back(sgio_register(sweep_handler, sweep_slots.size() - 1, false, false));
+    sweep_free.push_back(sweep_slots.size() - 1);
+  }
+
+  context = sweep_free.back();
+  sweep_free.pop_back();
+
+  handle = sweep_handles[context];
+  sweep_slots[context] = this;
+
+}
+
+/*
+ * Method: ~SweepSlot
+ * ------------------
+ * Returns the context for reuse
+ */
+SweepSlot::~SweepSlot() {
+
+  sweep_slots[context] = 0;
+  sweep_free.push_back(context);
+
+}
+
+/*
+ * Method: replay
+ * --------------
+ * Answers a request from the responses collected so far.  The first
+ * request without one becomes the command to issue, and fails so the
+ * check is abandoned.  A request made again, such as a re-read after a
+ * bad checksum, is answered by the next response to it.  One made again
+ * after transient failures waits as long as sgio would have slept.
+ * request: Reference to the request from the check
+ */
+int SweepSlot::replay(sg_io_hdr_t& request) {
+
+  string request_key = sweep_key(request);
+  size_t occurrence = seen[request_key]++;
+
+  map<string, vector<sweep_response>>::const_iterator recorded = responses.find(request_key);
+  if(recorded != responses.end() && occurrence < recorded->second.size()) {
+
+    const sweep_response& response = recorded->second[occurrence];
+
+    if(request.dxfer_direction == SG_DXFER_FROM_DEV) {
+      memset(request.dxferp, 0, request.dxfer_len);
+      memcpy(request.dxferp, response.data.data(), min<size_t>(response.data.size(), request.dxfer_len));
+    }
+
+    request.sb_len_wr = min<size_t>(response.sense.size(), request.mx_sb_len);
+    memcpy(request.sbp, response.sense.data(), request.sb_len_wr);
+
+    request.status = response.status;
+    request.host_status = response.host_status;
+    request.driver_status = response.driver_status;
+    request.resid = response.resid;
+
+    return response.error;
+
+  }
+
+  if(!missed) {
+
+    missed = true;
+    key = request_key;
+
+    memcpy(cdb, request.cmdp, min<size_t>(request.cmd_len, sizeof(cdb)));
+    buffer.assign(request.dxfer_len, 0);
+    if(request.dxfer_direction == SG_DXFER_TO_DEV)
+      memcpy(buffer.data(), request.dxferp, request.dxfer_len);
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.interface_id = 'S';
+    hdr.dxfer_direction = request.dxfer_direction;
+    hdr.cmd_len = min<size_t>(request.cmd_len, sizeof(cdb));
+    hdr.mx_sb_len = sizeof(sense);
+    hdr.dxfer_len = request.dxfer_len;
+    hdr.dxferp = buffer.data();
+    hdr.cmdp = cdb;
+    hdr.sbp = sense;
+    hdr.pack_id = context;
+
+    backoff = 0;
+    if(recorded != responses.end())
+      for(vector<sweep_response>::const_reverse_iterator i = recorded->second.rbegin();
+          i != recorded->second.rend() && i->transient; i++)
+        backoff = backoff ? backoff * 2 : SGIO_BACKOFF_MS;
+
+  }
+
+  return ECANCELED;
+
+}
+
+/*
+ * Struct: sweep_completion
+ * ------------------------
+ * A queued command that has completed or passed its deadline
+ */
+struct sweep_completion {
+  SweepSlot* slot;
+  int error;
+  bool expired;
+};
+
+/*
+ * Class: SweepScheduler
+ * ---------------------
+ * Runs device checks as coroutines on one thread, waiting on every
+ * device with a command in flight at once
+ */
+class SweepScheduler {
+
+private:
+
+  const CheckOptions& options;
+  vector<sweep_result>& results;
+  vector<int>* lent;
+  SweepOpen open;
+  SweepAsynchronous asynchronous;
+  uint64_t deadline;
+
+  // Queued commands in the order their deadlines fall, and retries by when
+  // they are due
+  int epoll;
+  int timer;
+  uint64_t armed;
+  list<SweepSlot*> deadlines;
+  multimap<uint64_t, SweepSlot*> retries;
+
+  // Completions are collected before any check resumes, as resuming opens
+  // and closes descriptors the rest of the events may refer to
+  sweep_completion completions[SWEEP_COMPLETIONS];
+  size_t completed;
+
+  bool start(SweepSlot& slot, const sg_device& device, size_t index);
+  void finish(SweepSlot& slot, bool expired = false);
+  bool send(SweepSlot& slot, int& error);
+  void complete(SweepSlot& slot, int error);
+  void collect(SweepSlot& slot);
+  void expire();
+  void arm();
+
+public:
+
+  SweepScheduler(const CheckOptions& options, vector<sweep_result>& results, vector<int>* lent, SweepOpen open,
+                 SweepAsynchronous asynchronous, int deadline);
+  ~SweepScheduler();
+
+  bool replay(SweepSlot& slot);
+  void abandon(SweepSlot& slot);
+  bool submit(SweepSlot& slot);
+  void run(const vector<sg_device>& devices, size_t concurrency);
+
+};
+
+/*
+ * Struct: SweepCommand
+ * --------------------
+ * Awaits the command a check is missing.  Commands that can't be queued
+ * are executed at once and the check carries on without suspending.
+ */
+struct SweepCommand {
+
+  SweepScheduler& scheduler;
+  SweepSlot& slot;
+
+  bool await_ready() {
+    return !scheduler.submit(slot);
+  }
+
+  void await_suspend(coroutine_handle<>) {
+    slot.waiting = true;
+  }
+
+  void await_resume() {}
+
+};
+
+/*
+ * Function: sweep_check
+ * ---------------------
+ * Checks the device in a slot, one command at a time
+ * scheduler: Reference to the scheduler running the check
+ * slot: Reference to the slot holding the device
+ */
+static CheckTask sweep_check(SweepScheduler& scheduler, SweepSlot& slot) {
+
+  for(int commands = 0; !scheduler.replay(slot); commands++) {
+
+    if(commands == SWEEP_COMMANDS) {
+      scheduler.abandon(slot);
+      co_return;
+    }
+
+    co_await SweepCommand{scheduler, slot};
+
+  }
+
+}
+
+/*
+ * Method: SweepScheduler
+ * ----------------------
+ * Creates the epoll instance waiting on queued commands and the timer
+ * for their deadlines.  Without them every command is issued directly.
+ * Devices are opened for each check, unless descriptors are lent.
+ */
+SweepScheduler::SweepScheduler(const CheckOptions& options, vector<sweep_result>& results, vector<int>* lent,
+                               SweepOpen open, SweepAsynchronous asynchronous, int deadline)
+: options(options), results(results), lent(lent), open(open), asynchronous(asynchronous),
+  deadline(static_cast<uint64_t>(deadline) * 1000), armed(0), completed(0) {
+
+  epoll = epoll_create1(EPOLL_CLOEXEC);
+  timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+  // The timer is told apart from devices by having no slot
+  struct epoll_event event;
+  event.events = EPOLLIN;
+  event.data.ptr = 0;
+  if(epoll != -1 && (timer == -1 || epoll_ctl(epoll, EPOLL_CTL_ADD, timer, &event) == -1)) {
+    close(epoll);
+    epoll = -1;
+  }
+
+}
+
+/*
+ * Method: ~SweepScheduler
+ * -----------------------
+ * Closes the epoll instance and timer
+ */
+SweepScheduler::~SweepScheduler() {
+
+  if(epoll != -1)
+    close(epoll);
+  if(timer != -1)
+    close(timer);
+
+}
+
+/*
+ * Method: replay
+ * --------------
+ * Runs the check against the responses collected so far, returning true
+ * and storing the result if none were missing.  Only then is what the
+ * check saved to its state files written.
+ * slot: Reference to the slot holding the device
+ */
+bool SweepScheduler::replay(SweepSlot& slot) {
+
+  slot.seen.clear();
+  slot.missed = false;
+  slot.backoff = 0;
+
+  stringstream out, perf;
+  device_health health;
+
+  // Runs abandoned for a missing response leave no trace in the state
+  // directory, and see the same state as the first
+  slot.state.begin();
+  state_cache = &slot.state;
+  int code = check_open_device(slot.handle, slot.device, options, "", out, perf, &health);
+  state_cache = 0;
+  if(slot.missed)
+    return false;
+
+  sweep_result& result = results[slot.index];
+  result.code = code;
+  result.out = out.str();
+  result.perf = perf.str();
+  result.health = health;
+
+  string failed;
+  if(!slot.state.commit(failed)) {
+    result.code = NAGIOS_UNKNOWN;
+    result.out = "UNKNOWN: unable to write state file " + failed;
+    result.perf.clear();
+  }
+
+  return true;
+
+}
+
+/*
+ * Method: abandon
+ * ---------------
+ * Gives up on a check that keeps issuing commands
+ * slot: Reference to the slot holding the device
+ */
+void SweepScheduler::abandon(SweepSlot& slot) {
+
+  sweep_result& result = results[slot.index];
+  result.code = NAGIOS_UNKNOWN;
+  result.out = "UNKNOWN: check of " + slot.device.node + " issued too many commands";
+
+}
+
+/*
+ * Method: submit
+ * --------------
+ * Issues the command a check is missing, returning true if it was queued
+ * or is waiting out a backoff and false if it has already completed
+ * slot: Reference to the slot holding the device
+ */
+bool SweepScheduler::submit(SweepSlot& slot) {
+
+  if(slot.backoff && epoll != -1) {
+    retries.insert(make_pair(Trace::monotonic() + slot.backoff * 1000, &slot));
+    arm();
+    return true;
+  }
+
+  // Without a timer nothing else runs meanwhile, so the backoff is slept
+  if(slot.backoff) {
+    struct timespec ts;
+    ts.tv_sec = slot.backoff / 1000;
+    ts.tv_nsec = (slot.backoff % 1000) * 1000000;
+    nanosleep(&ts, 0);
+  }
+
+  int error;
+  if(send(slot, error))
+    return true;
+
+  complete(slot, error);
+
+  return false;
+
+}
+
+/*
+ * Method: send
+ * ------------
+ * Queues the command a check is missing, or issues it at once if its
+ * descriptor can't queue commands, returning true if it was queued
+ * slot: Reference to the slot holding the device
+ * error: Reference to receive the errno from issuing the command, or zero
+ */
+bool SweepScheduler::send(SweepSlot& slot, int& error) {
+
+  slot.timestamp = Trace::now();
+  slot.started = Trace::monotonic();
+
+  if(slot.asynchronous) {
+
+    if(write(slot.fd, &slot.hdr, sizeof(slot.hdr)) != sizeof(slot.hdr)) {
+      error = errno;
+      return false;
+    }
+
+    slot.deadline = Trace::monotonic() + deadline;
+    slot.queued = deadlines.insert(deadlines.end(), &slot);
+    arm();
+
+    return true;
+
+  }
+
+  error = sgio_execute(slot.fd, slot.hdr);
+
+  return false;
+
+}
+
+/*
+ * Method: complete
+ * ----------------
+ * Records the outcome of the command a check was missing
+ * slot: Reference to the slot holding the device
+ * error: errno from issuing the command, or zero
+ */
+void SweepScheduler::complete(SweepSlot& slot, int error) {
+
+  trace.record(slot.hdr, error, slot.timestamp, Trace::monotonic() - slot.started);
+
+  sweep_response response;
+  response.error = error;
+  response.transient = SgioResult(slot.hdr, error).transient();
+  response.status = slot.hdr.status;
+  response.host_status = slot.hdr.host_status;
+  response.driver_status = slot.hdr.driver_status;
+  response.resid = slot.hdr.resid;
+  response.sense = string(reinterpret_cast<char*>(slot.sense), min<int>(slot.hdr.sb_len_wr, sizeof(slot.sense)));
+  if(slot.hdr.dxfer_direction == SG_DXFER_FROM_DEV)
+    response.data = string(reinterpret_cast<char*>(slot.buffer.data()), slot.buffer.size());
+
+  slot.responses[slot.key].push_back(response);
+
+}
+
+/*
+ * Method: start
+ * -------------
+ * Opens a device and starts its check, returning true if the check is
+ * waiting on a command and false if it has finished
+ * slot: Reference to a free slot
+ * device: Reference to the device
+ * index: Where the device's result goes
+ */
+bool SweepScheduler::start(SweepSlot& slot, const sg_device& device, size_t index) {
+
+  sweep_result& result = results[index];
+
+  // A descriptor lent already closed fails as any other would
+  errno = EBADF;
+  int fd = lent ? (*lent)[index] : open(device.node);
+  if(fd == -1) {
+    result.code = NAGIOS_UNKNOWN;
+    result.out = "UNKNOWN: unable to open device " + device.node + ": " + strerror(errno);
+    return false;
+  }
+
+  slot.fd = fd;
+  slot.flags = -1;
+  slot.index = index;
+  slot.device = device;
+  slot.asynchronous = epoll != -1 && asynchronous(fd);
+  slot.responses.clear();
+  slot.state = StateCache();
+
+  // Completions are read without blocking, an event left over from a
+  // descriptor since closed finds nothing to read
+  if(slot.asynchronous) {
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = &slot;
+    int flags = fcntl(fd, F_GETFL);
+    if(flags != -1 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) != -1)
+      slot.flags = flags;
+    slot.asynchronous = slot.flags != -1 && epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event) != -1;
+  }
+
+  // NVMe devices, and nodes that take no SCSI commands at all, are checked
+  // directly as they would be by check_device
+  int sg_version;
+  if(!slot.asynchronous && !sgio_handle(fd) &&
+     (ioctl(fd, SG_GET_VERSION_NUM, &sg_version) == -1 || sg_version < 30000)) {
+    stringstream out, perf;
+    result.code = check_open_device(fd, device, options, "", out, perf, &result.health);
+    result.out = out.str();
+    result.perf = perf.str();
+    finish(slot);
+    return false;
+  }
+
+  slot.task = sweep_check(*this, slot);
+  slot.task.handle.resume();
+  if(!slot.task.handle.done())
+    return true;
+
+  finish(slot);
+
+  return false;
+
+}
+
+/*
+ * Method: finish
+ * --------------
+ * Releases a finished check's frame and closes its device, or hands a
+ * lent descriptor back as it came
+ * slot: Reference to the slot holding the device
+ * expired: Whether the check was given up as a command passed its deadline
+ */
+void SweepScheduler::finish(SweepSlot& slot, bool expired) {
+
+  if(slot.asynchronous)
+    epoll_ctl(epoll, EPOLL_CTL_DEL, slot.fd, 0);
+
+  slot.task = CheckTask();
+  slot.responses.clear();
+  slot.state = StateCache();
+  slot.waiting = false;
+
+  // A command past its deadline is left to the driver, which discards its
+  // response once the descriptor is closed, so even a lent one is closed
+  // rather than have the response read by the next check
+  if(lent && !expired) {
+    if(slot.flags != -1)
+      fcntl(slot.fd, F_SETFL, slot.flags);
+  } else {
+    close_device(slot.fd);
+    if(lent)
+      (*lent)[slot.index] = -1;
+  }
+
+  slot.fd = -1;
+
+}
+
+/*
+ * Method: collect
+ * ---------------
+ * Reads a completed command back from the driver onto the completion
+ * queue, the header returned points at the slot's own buffers
+ * slot: Reference to the slot whose descriptor is readable
+ */
+void SweepScheduler::collect(SweepSlot& slot) {
+
+  if(!slot.waiting)
+    return;
+
+  // errno only means anything when the read failed outright, a short
+  // read leaves whatever an earlier call put there
+  int error = 0;
+  ssize_t n = read(slot.fd, &slot.hdr, sizeof(slot.hdr));
+  if(n == -1) {
+    if(errno == EAGAIN || errno == EINTR)
+      return;
+    error = errno;
+  }
+  else if(n != sizeof(slot.hdr))
+    error = EIO;
+
+  deadlines.erase(slot.queued);
+  slot.waiting = false;
+
+  sweep_completion& completion = completions[completed++];
+  completion.slot = &slot;
+  completion.error = error;
+  completion.expired = false;
+
+}
+
+/*
+ * Method: expire
+ * --------------
+ * Moves commands past their deadline onto the completion queue while it
+ * has room, and issues retries whose backoff is over.  Any left over are
+ * handled on the next wait.
+ */
+void SweepScheduler::expire() {
+
+  uint64_t expirations;
+  if(read(timer, &expirations, sizeof(expirations)) == -1 && errno != EAGAIN)
+    return;
+
+  armed = 0;
+
+  uint64_t now = Trace::monotonic();
+  while(!deadlines.empty() && deadlines.front()->deadline <= now && completed < SWEEP_COMPLETIONS) {
+
+    SweepSlot& slot = *deadlines.front();
+    deadlines.pop_front();
+    slot.waiting = false;
+
+    sweep_completion& completion = completions[completed++];
+    completion.slot = &slot;
+    completion.error = ETIMEDOUT;
+    completion.expired = true;
+
+  }
+
+  while(!retries.empty() && retries.begin()->first <= now && completed < SWEEP_COMPLETIONS) {
+
+    SweepSlot& slot = *retries.begin()->second;
+    retries.erase(retries.begin());
+
+    int error;
+    if(send(slot, error))
+      continue;
+
+    slot.waiting = false;
+
+    sweep_completion& completion = completions[completed++];
+    completion.slot = &slot;
+    completion.error = error;
+    completion.expired = false;
+
+  }
+
+}
+
+/*
+ * Method: arm
+ * -----------
+ * Sets the timer for the earliest deadline or retry, or stops it if
+ * nothing is waiting
+ */
+void SweepScheduler::arm() {
+
+  uint64_t due = deadlines.empty() ? 0 : deadlines.front()->deadline;
+  if(!retries.empty() && (!due || retries.begin()->first < due))
+    due = retries.begin()->first;
+
+  if(due == armed)
+    return;
+
+  struct itimerspec spec;
+  memset(&spec, 0, sizeof(spec));
+  spec.it_value.tv_sec = due / 1000000;
+  spec.it_value.tv_nsec = (due % 1000000) * 1000;
+
+  if(timerfd_settime(timer, TFD_TIMER_ABSTIME, &spec, 0) == 0)
+    armed = due;
+
+}
+
+/*
+ * Method: run
+ * -----------
+ * Checks every device, a slot starts the next device as soon as its
+ * check finishes
+ * devices: Devices to check
+ * concurrency: Devices checked at once
+ */
+void SweepScheduler::run(const vector<sg_device>& devices, size_t concurrency) {
+
+  vector<unique_ptr<SweepSlot>> slots;
+  size_t next = 0;
+  size_t running = 0;
+
+  auto launch = [&](SweepSlot& slot) {
+    while(next < devices.size()) {
+      size_t index = next++;
+      if(start(slot, devices[index], index)) {
+        running++;
+        return;
+      }
+    }
+  };
+
+  for(size_t i = 0; i < min(concurrency, devices.size()); i++) {
+    slots.push_back(unique_ptr<SweepSlot>(new SweepSlot()));
+    launch(*slots.back());
+  }
+
+  struct epoll_event events[SWEEP_COMPLETIONS];
+  while(running) {
+
+    int ready = epoll_wait(epoll, events, SWEEP_COMPLETIONS, -1);
+    if(ready == -1)
+      continue;
+
+    // The timer is handled last, so completions queued by every device
+    // event leave it room
+    bool timed = false;
+    completed = 0;
+    for(int i = 0; i < ready; i++) {
+      if(events[i].data.ptr)
+        collect(*static_cast<SweepSlot*>(events[i].data.ptr));
+      else
+        timed = true;
+    }
+
+    if(timed)
+      expire();
+
+    for(size_t i = 0; i < completed; i++) {
+
+      SweepSlot& slot = *completions[i].slot;
+
+      if(completions[i].expired) {
+        trace.record(slot.hdr, ETIMEDOUT, slot.timestamp, Trace::monotonic() - slot.started);
+        sweep_result& result = results[slot.index];
+        result.code = NAGIOS_UNKNOWN;
+        result.out = "UNKNOWN: command to " + slot.device.node + " timed out after " +
+                     to_string(deadline / 1000) + "ms";
+      } else {
+        complete(slot, completions[i].error);
+        slot.task.handle.resume();
+      }
+
+      if(completions[i].expired || slot.task.handle.done()) {
+        finish(slot, completions[i].expired);
+        running--;
+        launch(slot);
+      }
+
+    }
+
+    arm();
+
+  }
+
+}
+
+/*
+ * Function: sweep_asynchronous
+ * ----------------------------
+ * Returns whether a descriptor is a SCSI generic character device, the
+ * only kind that queues commands written to it
+ * fd: Descriptor to test
+ */
+bool sweep_asynchronous(int fd) {
+
+  struct stat st;
+  if(sgio_handle(fd) || fstat(fd, &st) == -1)
+    return false;
+
+  return S_ISCHR(st.st_mode) && major(st.st_rdev) == SCSI_GENERIC_MAJOR;
+
+}
+
+/*
+ * Function: sweep_devices
+ * -----------------------
+ * Checks many devices at once on a single thread.  Each check is a
+ * coroutine which waits for one command at a time, so a slow device
+ * doesn't hold up the others.  Results are returned in device order and
+ * match those of check_device.
+ * devices: Devices to check
+ * options: Reference to the check options
+ * concurrency: Devices checked at once
+ * open: Opens each device
+ * asynchronous: Whether commands to a descriptor may be queued
+ * deadline: Milliseconds a queued command may take
+ */
+vector<sweep_result> sweep_devices(const vector<sg_device>& devices, const CheckOptions& options,
+                                   size_t concurrency, SweepOpen open, SweepAsynchronous asynchronous,
+                                   int deadline) {
+
+  vector<sweep_result> results(devices.size());
+
+  struct rlimit limit;
+  if(getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY)
+    concurrency = min<size_t>(concurrency, limit.rlim_cur / 2);
+
+  SweepScheduler scheduler(options, results, 0, open, asynchronous, deadline);
+  scheduler.run(devices, max<size_t>(concurrency, 1));
+
+  return results;
+
+}
+
+/*
+ * Function: sweep_open_devices
+ * ----------------------------
+ * Checks devices that are already open as sweep_devices does, leaving
+ * them open.  A device whose command passed its deadline is closed, as
+ * the driver may yet complete the command onto it, and its descriptor set
+ * to -1.
+ * devices: Devices to check
+ * fds: Reference to the descriptor of each device
+ * options: Reference to the check options
+ * concurrency: Devices checked at once
+ * asynchronous: Whether commands to a descriptor may be queued
+ * deadline: Milliseconds a queued command may take
+ */
+vector<sweep_result> sweep_open_devices(const vector<sg_device>& devices, vector<int>& fds,
+                                        const CheckOptions& options, size_t concurrency,
+                                        SweepAsynchronous asynchronous, int deadline) {
+
+  vector<sweep_result> results(devices.size());
+
+  SweepScheduler scheduler(options, results, &fds, 0, asynchronous, deadline);
+  scheduler.run(devices, max<size_t>(concurrency, 1));
+
+  return results;
+
+}
+
+/*
+ * Function: sweep_frames
+ * ----------------------
+ * Reports the coroutine frame pool's size, which stays flat once it has
+ * grown to the largest sweep
+ * pooled: Reference to receive the number of frames in the pool
+ * heap: Reference to receive the number of frames too large for the pool
+ */
+void sweep_frames(size_t& pooled, size_t& heap) {
+
+  pooled = frames.pooled();
+  heap = frames.heap;
+
+}
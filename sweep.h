@@ -0,0 +1,140 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef _sweep_H_
+#define _sweep_H_
+
+#include <stddef.h>
+
+#include "check.h"
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/* Devices checked at once, capped at half the open file limit */
+const size_t SWEEP_CONCURRENCY  = 1024;
+
+/* Completions collected from each wait before any check is resumed */
+const size_t SWEEP_COMPLETIONS  = 64;
+
+/* Milliseconds a queued command may take before its device is given up */
+const int SWEEP_DEADLINE         = 30000;
+
+/* Bytes in each pooled coroutine frame, larger frames come from the heap */
+const size_t SWEEP_FRAME_SIZE   = 512;
+
+/* Frames added to the pool whenever it runs dry */
+const size_t SWEEP_FRAME_CHUNK  = 64;
+
+/* Commands a single check may issue before it is abandoned */
+const int SWEEP_COMMANDS         = 512;
+
+/*
+ * Struct: sweep_result
+ * --------------------
+ * The result of checking one device, performance data labels are
+ * unprefixed
+ */
+struct sweep_result {
+  int code;
+  string out;
+  string perf;
+  device_health health;
+};
+
+/*
+ * Type: SweepOpen
+ * ---------------
+ * Opens a device as open_device does, returning a descriptor or handle
+ */
+typedef int (*SweepOpen)(const string& node);
+
+/*
+ * Type: SweepAsynchronous
+ * -----------------------
+ * Returns whether commands to a descriptor may be queued with write and
+ * collected with read rather than issued with SG_IO
+ */
+typedef bool (*SweepAsynchronous)(int fd);
+
+/*
+ * Function: sweep_asynchronous
+ * ----------------------------
+ * Returns whether a descriptor is a SCSI generic character device, the
+ * only kind that queues commands written to it
+ * fd: Descriptor to test
+ */
+bool sweep_asynchronous(int fd);
+
+/*
+ * Function: sweep_devices
+ * -----------------------
+ * Checks many devices at once on a single thread.  Each check is a
+ * coroutine which waits for one command at a time, so a slow device
+ * doesn't hold up the others.  Results are returned in device order and
+ * match those of check_device.
+ * devices: Devices to check
+ * options: Reference to the check options
+ * concurrency: Devices checked at once
+ * open: Opens each device
+ * asynchronous: Whether commands to a descriptor may be queued
+ * deadline: Milliseconds a queued command may take
+ */
+vector<sweep_result> sweep_devices(const vector<sg_device>& devices, const CheckOptions& options,
+                                   size_t concurrency = SWEEP_CONCURRENCY, SweepOpen open = open_device,
+                                   SweepAsynchronous asynchronous = sweep_asynchronous,
+                                   int deadline = SWEEP_DEADLINE);
+
+/*
+ * Function: sweep_open_devices
+ * ----------------------------
+ * Checks devices that are already open as sweep_devices does, leaving
+ * them open.  A device whose command passed its deadline is closed, as
+ * the driver may yet complete the command onto it, and its descriptor set
+ * to -1.
+ * devices: Devices to check
+ * fds: Reference to the descriptor of each device
+ * options: Reference to the check options
+ * concurrency: Devices checked at once
+ * asynchronous: Whether commands to a descriptor may be queued
+ * deadline: Milliseconds a queued command may take
+ */
+vector<sweep_result> sweep_open_devices(const vector<sg_device>& devices, vector<int>& fds,
+                                        const CheckOptions& options, size_t concurrency = SWEEP_CONCURRENCY,
+                                        SweepAsynchronous asynchronous = sweep_asynchronous,
+                                        int deadline = SWEEP_DEADLINE);
+
+/*
+ * Function: sweep_frames
+ * ----------------------
+ * Reports the coroutine frame pool's size, which stays flat once it has
+ * grown to the largest sweep
+ * pooled: Reference to receive the number of frames in the pool
+ * heap: Reference to receive the number of frames too large for the pool
+ */
+void sweep_frames(size_t& pooled, size_t& heap);
+
+#endif//_sweep_H_
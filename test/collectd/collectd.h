@@ -0,0 +1,41 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef _collectd_H_
+#define _collectd_H_
+
+/*
+ * The parts of collectd's collectd.h used by the scsi_smart plugin, so it
+ * can be tested without collectd's source tree
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <syslog.h>
+
+typedef uint64_t cdtime_t;
+
+#define DATA_MAX_NAME_LEN 128
+
+#endif//_collectd_H_
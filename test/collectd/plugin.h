@@ -0,0 +1,100 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef _plugin_H_
+#define _plugin_H_
+
+/*
+ * The parts of collectd's plugin.h and oconfig.h used by the scsi_smart
+ * plugin, implemented by the test to record what the plugin does
+ */
+
+#include "collectd.h"
+
+typedef double gauge_t;
+typedef int64_t derive_t;
+
+union value_u {
+  gauge_t gauge;
+  derive_t derive;
+};
+typedef union value_u value_t;
+
+struct value_list_s {
+  value_t* values;
+  size_t values_len;
+  cdtime_t time;
+  cdtime_t interval;
+  char host[DATA_MAX_NAME_LEN];
+  char plugin[DATA_MAX_NAME_LEN];
+  char plugin_instance[DATA_MAX_NAME_LEN];
+  char type[DATA_MAX_NAME_LEN];
+  char type_instance[DATA_MAX_NAME_LEN];
+  void* meta;
+};
+typedef struct value_list_s value_list_t;
+
+#define OCONFIG_TYPE_STRING  0
+#define OCONFIG_TYPE_NUMBER  1
+#define OCONFIG_TYPE_BOOLEAN 2
+
+struct oconfig_value_s {
+  union {
+    char* string;
+    double number;
+    int boolean;
+  } value;
+  int type;
+};
+typedef struct oconfig_value_s oconfig_value_t;
+
+struct oconfig_item_s;
+typedef struct oconfig_item_s oconfig_item_t;
+struct oconfig_item_s {
+  char* key;
+  oconfig_value_t* values;
+  int values_num;
+  oconfig_item_t* parent;
+  oconfig_item_t* children;
+  int children_num;
+};
+
+typedef int (*plugin_init_cb)(void);
+typedef int (*plugin_read_cb)(void);
+typedef int (*plugin_shutdown_cb)(void);
+
+int plugin_register_complex_config(const char* type, int (*callback)(oconfig_item_t*));
+int plugin_register_init(const char* name, plugin_init_cb callback);
+int plugin_register_read(const char* name, plugin_read_cb callback);
+int plugin_register_shutdown(const char* name, plugin_shutdown_cb callback);
+
+int plugin_dispatch_values(value_list_t const* vl);
+
+void plugin_log(int level, const char* format, ...);
+
+#define ERROR(...) plugin_log(LOG_ERR, __VA_ARGS__)
+#define WARNING(...) plugin_log(LOG_WARNING, __VA_ARGS__)
+#define INFO(...) plugin_log(LOG_INFO, __VA_ARGS__)
+
+#endif//_plugin_H_
@@ -0,0 +1,302 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef _fake_ata_H_
+#define _fake_ata_H_
+
+#include <string.h>
+#include <stdint.h>
+#include <scsi/sg.h>
+
+#include "ata.h"
+#include "scsi.h"
+#include "smart.h"
+
+#include <map>
+#include <vector>
+
+using namespace std;
+
+/* Attributes reported by the fake drive, 5 has fallen below its threshold */
+const uint8_t  FAKE_ATA_IDS[]        = { 1, 5, 9, 194 };
+const uint8_t  FAKE_ATA_VALUES[]     = { 100, 5, 100, 100 };
+const uint32_t FAKE_ATA_RAW[]        = { 100, 8, 23052, 35 };
+const uint8_t  FAKE_ATA_THRESHOLD    = 10;
+const int      FAKE_ATA_ATTRIBUTES   = 4;
+
+/* Number of commands the fake drive has executed */
+static int fake_ata_commands = 0;
+
+/* SMART READ DATA pages returned with a bad checksum before a good one */
+static int fake_ata_corrupt = 0;
+
+/* Self-test execution status and offline capability in the SMART data */
+static uint8_t fake_ata_self_test_status = 0x00;
+static uint8_t fake_ata_capability = 0x10;
+
+/* Subcommand of the last SMART EXECUTE OFF-LINE IMMEDIATE, zero if none */
+static uint8_t fake_ata_self_test = 0;
+
+/*
+ * Struct: fake_ata_read
+ * ---------------------
+ * A log read the fake drive has answered
+ */
+struct fake_ata_read {
+  uint8_t log;
+  uint16_t page;
+  uint16_t count;
+  uint16_t features;
+};
+
+/* Logs held by the fake drive by address, both directories list them all */
+static map<uint8_t, vector<unsigned char> > fake_ata_logs;
+
+/* Log reads answered, directories excepted, in the order they were made */
+static vector<fake_ata_read> fake_ata_reads;
+
+/* Data last written to each log with SMART WRITE LOG */
+static map<uint8_t, vector<unsigned char> > fake_ata_written;
+
+/* CDBs the bridge rejects as invalid, e.g. all but some ATA PASS-THROUGH
+   variants, or null to accept everything */
+static bool (*fake_ata_reject)(const unsigned char* cdb, int len) = 0;
+
+/* Peripheral device type and unit serial number the bridge reports */
+static uint8_t fake_ata_type = SCSI_TYPE_DIRECT_ACCESS;
+static const char* fake_ata_bridge_serial = "BRIDGE0001";
+
+/*
+ * Function: fake_ata_string
+ * -------------------------
+ * Stores an IDENTIFY DEVICE string, which holds two characters per word
+ * with the first in the high byte
+ */
+static void fake_ata_string(unsigned char* buf, int word, int words, const char* text) {
+
+  memset(buf + word * 2, ' ', words * 2);
+  for(int i = 0; text[i] && i < words * 2; i++)
+    buf[word * 2 + (i ^ 1)] = text[i];
+
+}
+
+/*
+ * Function: fake_ata_sum
+ * ----------------------
+ * Sets the trailing checksum byte of a SMART page
+ */
+static void fake_ata_sum(unsigned char* buf) {
+
+  uint8_t sum = 0;
+  for(size_t i = 0; i < SECTOR_SIZE - 1; i++)
+    sum += buf[i];
+  buf[SECTOR_SIZE - 1] = -sum;
+
+}
+
+/*
+ * Function: fake_ata_log
+ * ----------------------
+ * Returns a log, or pages of one, building the directories from the logs
+ * held
+ */
+static void fake_ata_log(unsigned char* buf, size_t len, uint8_t log, uint16_t page, uint16_t count,
+                         uint16_t features = 0) {
+
+  if(log == ATA_LOG_ADDRESS_DIRECTORY) {
+    buf[0] = 0x01;
+    for(map<uint8_t, vector<unsigned char> >::iterator i = fake_ata_logs.begin(); i != fake_ata_logs.end(); i++) {
+      uint16_t sectors = i->second.size() / SECTOR_SIZE;
+      buf[i->first * 2] = sectors;
+      buf[i->first * 2 + 1] = sectors >> 8;
+    }
+    return;
+  }
+
+  fake_ata_read read = { log, page, count, features };
+  fake_ata_reads.push_back(read);
+
+  map<uint8_t, vector<unsigned char> >::iterator held = fake_ata_logs.find(log);
+  size_t offset = page * SECTOR_SIZE;
+  if(held != fake_ata_logs.end() && offset < held->second.size())
+    memcpy(buf, &held->second[offset], min(len, held->second.size() - offset));
+
+}
+
+/*
+ * Function: fake_ata_sense
+ * ------------------------
+ * Completes a command with CHECK CONDITION and descriptor format sense
+ */
+static void fake_ata_sense(sg_io_hdr_t& hdr, uint8_t sense_key, uint8_t asc, uint8_t ascq) {
+
+  hdr.status = SCSI_STATUS_CHECK_CONDITION;
+  hdr.driver_status = SG_DRIVER_SENSE;
+
+  memset(hdr.sbp, 0, hdr.mx_sb_len);
+  hdr.sbp[0] = SCSI_SENSE_DESCRIPTOR_CURRENT;
+  hdr.sbp[1] = sense_key;
+  hdr.sbp[2] = asc;
+  hdr.sbp[3] = ascq;
+  hdr.sb_len_wr = min<int>(hdr.mx_sb_len, 8);
+
+}
+
+/*
+ * Function: fake_ata_inquiry
+ * --------------------------
+ * Answers INQUIRY as the bridge, with standard data or its unit serial
+ * number
+ */
+static void fake_ata_inquiry(unsigned char* buf, size_t len, const unsigned char* cdb) {
+
+  unsigned char data[SCSI_INQUIRY_LENGTH];
+  memset(data, 0, sizeof(data));
+
+  if(!(cdb[1] & 0x01)) {
+    data[0] = fake_ata_type;
+    memcpy(data + 8, "FAKE    ", 8);
+    memcpy(data + 16, "BRIDGE          ", 16);
+  } else if(cdb[2] == SCSI_VPD_UNIT_SERIAL_NUMBER) {
+    data[1] = SCSI_VPD_UNIT_SERIAL_NUMBER;
+    data[3] = strlen(fake_ata_bridge_serial);
+    memcpy(data + 4, fake_ata_bridge_serial, data[3]);
+  }
+
+  memcpy(buf, data, min(len, sizeof(data)));
+
+}
+
+/*
+ * Function: fake_ata
+ * ------------------
+ * Stands in for an ATA drive behind a SAT, answering INQUIRY as the
+ * bridge, IDENTIFY DEVICE, the SMART commands and reads of the logs it
+ * holds, recording log writes and returning empty data for everything
+ * else.  Either form of ATA PASS-THROUGH is accepted unless rejected by
+ * fake_ata_reject, and completes with sense if CK_COND is set.
+ */
+static int fake_ata(int context, sg_io_hdr_t& hdr) {
+
+  fake_ata_commands++;
+
+  hdr.status = 0;
+  hdr.host_status = 0;
+  hdr.driver_status = 0;
+  hdr.sb_len_wr = 0;
+  hdr.resid = 0;
+
+  unsigned char* cdb = hdr.cmdp;
+  if(fake_ata_reject && fake_ata_reject(cdb, hdr.cmd_len)) {
+    fake_ata_sense(hdr, SCSI_SENSE_KEY_ILLEGAL_REQUEST, 0x24, 0x00);
+    return 0;
+  }
+
+  unsigned char* buf = static_cast<unsigned char*>(hdr.dxferp);
+  bool from_device = hdr.dxfer_direction == SG_DXFER_FROM_DEV && hdr.dxfer_len;
+  if(from_device)
+    memset(buf, 0, hdr.dxfer_len);
+
+  if(cdb[0] == SPC_INQUIRY) {
+    if(from_device)
+      fake_ata_inquiry(buf, hdr.dxfer_len, cdb);
+    return 0;
+  }
+
+  // The 12-byte form carries 28-bit registers only, at other offsets
+  uint8_t command, feature, log;
+  uint16_t count, page, features;
+  if(cdb[0] == SBC_ATA_PASS_THROUGH) {
+    command = cdb[14];
+    feature = cdb[4];
+    features = cdb[3] << 8 | feature;
+    count = cdb[5] << 8 | cdb[6];
+    log = cdb[8];
+    page = cdb[9] << 8 | cdb[10];
+  } else if(cdb[0] == SBC_ATA_PASS_THROUGH_12) {
+    command = cdb[9];
+    feature = features = cdb[3];
+    count = cdb[4];
+    log = cdb[5];
+    page = 0;
+  } else {
+    return 0;
+  }
+
+  // The ATA registers are returned as sense on request
+  if(cdb[2] & 0x20)
+    fake_ata_sense(hdr, SCSI_SENSE_KEY_RECOVERED_ERROR, 0x00, 0x1d);
+
+  if(command == ATA_SMART && feature == SMART_EXECUTE_OFF_LINE_IMMEDIATE)
+    fake_ata_self_test = log;
+
+  if(command == ATA_SMART && feature == SMART_WRITE_LOG)
+    fake_ata_written[log].assign(buf, buf + hdr.dxfer_len);
+
+  if(!from_device)
+    return 0;
+
+  // SMART, General Purpose Logging and SCT data tables are supported
+  if(command == ATA_IDENTIFY_DEVICE) {
+    fake_ata_string(buf, 10, 10, "FAKE0001");
+    fake_ata_string(buf, 23, 4, "1.0");
+    fake_ata_string(buf, 27, 20, "FAKE DRIVE");
+    buf[82 * 2] = 0x01;
+    buf[84 * 2] = 0x20;
+    buf[84 * 2 + 1] = 0x40;
+    buf[85 * 2] = 0x01;
+    buf[206 * 2] = 0x21;
+  } else if(command == ATA_SMART && feature == SMART_READ_DATA) {
+    for(int i = 0; i < FAKE_ATA_ATTRIBUTES; i++) {
+      unsigned char* attribute = buf + 2 + i * 12;
+      attribute[0] = FAKE_ATA_IDS[i];
+      attribute[1] = i < 2 ? 0x01 : 0x00;
+      attribute[3] = FAKE_ATA_VALUES[i];
+      attribute[4] = FAKE_ATA_VALUES[i];
+      memcpy(attribute + 5, &FAKE_ATA_RAW[i], 4);
+    }
+    buf[363] = fake_ata_self_test_status;
+    buf[367] = fake_ata_capability;
+    fake_ata_sum(buf);
+    if(fake_ata_corrupt > 0) {
+      fake_ata_corrupt--;
+      buf[SECTOR_SIZE - 1]++;
+    }
+  } else if(command == ATA_SMART && feature == SMART_READ_THRESHOLDS) {
+    for(int i = 0; i < FAKE_ATA_ATTRIBUTES; i++) {
+      buf[2 + i * 12] = FAKE_ATA_IDS[i];
+      buf[2 + i * 12 + 1] = FAKE_ATA_THRESHOLD;
+    }
+    fake_ata_sum(buf);
+  } else if(command == ATA_SMART && feature == SMART_READ_LOG) {
+    fake_ata_log(buf, hdr.dxfer_len, log, 0, count);
+  } else if(command == ATA_READ_LOG_EXT || command == ATA_READ_LOG_DMA_EXT) {
+    fake_ata_log(buf, hdr.dxfer_len, log, page, count, features);
+  }
+
+  return 0;
+
+}
+
+#endif//_fake_ata_H_
@@ -0,0 +1,47 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _test_H_
+#define _test_H_
+
+#include <iostream>
+
+using namespace std;
+
+/* Number of failed checks, the exit status of a test */
+static int test_failures = 0;
+
+/*
+ * Macro: CHECK
+ * ------------
+ * Records a failure if the condition does not hold
+ */
+#define CHECK(condition) \
+  do { \
+    if(!(condition)) { \
+      cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << endl; \
+      test_failures++; \
+    } \
+  } while(0)
+
+#endif//_test_H_
@@ -0,0 +1,133 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ata.h"
+#include "check.h"
+#include "sgio.h"
+#include "test.h"
+#include "fake_ata.h"
+
+#include <sstream>
+#include <string>
+
+/* What the fake drive reports when its SMART data is read cleanly */
+const char* const TEST_STATUS = "CRITICAL: prdfail 1, advisory 0, critical 0, warning 0, logs 0, "
+                                "model FAKE DRIVE, serial FAKE0001, firmware 1.0";
+
+/*
+ * Function: byte_sum
+ * ------------------
+ * Sums a sector a byte at a time, as ata_checksum must
+ */
+static uint8_t byte_sum(const unsigned char* buf) {
+
+  uint8_t sum = 0;
+  for(size_t i = 0; i < SECTOR_SIZE; i++)
+    sum += buf[i];
+
+  return sum;
+
+}
+
+/*
+ * Function: check
+ * ---------------
+ * Checks the fake drive, returning the Nagios code
+ */
+static int check(int fd, const sg_device& device, const CheckOptions& options, string& out, string& perf) {
+
+  stringstream out_stream, perf_stream;
+  int code = check_open_device(fd, device, options, "", out_stream, perf_stream);
+
+  out = out_stream.str();
+  perf = perf_stream.str();
+
+  return code;
+
+}
+
+int main() {
+
+  // The lane sums agree with a plain byte loop whatever the data, including
+  // every byte saturated and patterns that carry between lanes
+  unsigned char buf[SECTOR_SIZE];
+  srand(1);
+  for(int round = 0; round < 64; round++) {
+    for(size_t i = 0; i < SECTOR_SIZE; i++)
+      buf[i] = round == 0 ? 0xff : round == 1 ? 0x00 : round == 2 ? (i & 1 ? 0xff : 0x01) : rand();
+    CHECK(ata_checksum(buf) == byte_sum(buf));
+  }
+
+  // A page completed with its checksum byte sums to zero
+  fake_ata_sum(buf);
+  CHECK(ata_checksum(buf) == 0);
+  buf[100] ^= 0x10;
+  CHECK(ata_checksum(buf) != 0);
+
+  char temp[] = "/tmp/test_checksum.XXXXXX";
+  CHECK(mkdtemp(temp));
+
+  sg_device device;
+  device.node = "fake";
+  device.device_class = DEVICE_CLASS_ATA;
+
+  CheckOptions options;
+  options.state_dir = temp;
+
+  int fd = sgio_register(fake_ata, 0);
+
+  string out, perf;
+
+  // A clean page is read once
+  int before = fake_ata_commands;
+  CHECK(check(fd, device, options, out, perf) == NAGIOS_CRITICAL);
+  CHECK(out == TEST_STATUS);
+  CHECK(perf.find(" checksum_errors=0;;;;") != string::npos);
+  int clean = fake_ata_commands - before;
+
+  // A corrupt page is read again, and counted, but the check goes on
+  fake_ata_corrupt = 1;
+  before = fake_ata_commands;
+  CHECK(check(fd, device, options, out, perf) == NAGIOS_CRITICAL);
+  CHECK(out == TEST_STATUS);
+  CHECK(perf.find(" checksum_errors=1;;;;") != string::npos);
+  CHECK(fake_ata_commands - before == clean + 1);
+  CHECK(fake_ata_corrupt == 0);
+
+  // A page that never validates fails after the retries are spent
+  fake_ata_corrupt = ATA_CHECKSUM_RETRIES + 1;
+  CHECK(check(fd, device, options, out, perf) == NAGIOS_UNKNOWN);
+  CHECK(out == "UNKNOWN: SMART READ DATA failed: invalid checksum");
+  CHECK(perf == " checksum_errors=" + to_string(ATA_CHECKSUM_RETRIES + 1) + ";;;;");
+  CHECK(fake_ata_corrupt == 0);
+
+  string command = "rm -rf " + string(temp);
+  CHECK(system(command.c_str()) == 0);
+
+  return test_failures;
+
+}
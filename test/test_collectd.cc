@@ -0,0 +1,242 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern "C" {
+#include "collectd.h"
+#include "plugin.h"
+}
+
+#include "scsismart.h"
+#include "sgio.h"
+#include "test.h"
+#include "fake_ata.h"
+
+#include <string>
+#include <vector>
+
+/* Defined by the plugin */
+extern "C" void module_register(void);
+extern int (*scsi_smart_open)(scsismart_device* device, const char* node);
+
+/*
+ * Struct: dispatched
+ * ------------------
+ * Values the plugin dispatched
+ */
+struct dispatched {
+  string plugin_instance;
+  string type;
+  string type_instance;
+  vector<double> values;
+};
+
+static int (*config_callback)(oconfig_item_t*) = 0;
+static plugin_init_cb init_callback = 0;
+static plugin_read_cb read_callback = 0;
+static plugin_shutdown_cb shutdown_callback = 0;
+static vector<dispatched> values;
+static int opens = 0;
+
+extern "C" {
+
+int plugin_register_complex_config(const char* type, int (*callback)(oconfig_item_t*)) {
+  config_callback = callback;
+  return 0;
+}
+
+int plugin_register_init(const char* name, plugin_init_cb callback) {
+  init_callback = callback;
+  return 0;
+}
+
+int plugin_register_read(const char* name, plugin_read_cb callback) {
+  read_callback = callback;
+  return 0;
+}
+
+int plugin_register_shutdown(const char* name, plugin_shutdown_cb callback) {
+  shutdown_callback = callback;
+  return 0;
+}
+
+int plugin_dispatch_values(value_list_t const* vl) {
+  dispatched d;
+  d.plugin_instance = vl->plugin_instance;
+  d.type = vl->type;
+  d.type_instance = vl->type_instance;
+  for(size_t i = 0; i < vl->values_len; i++)
+    d.values.push_back(vl->values[i].gauge);
+  CHECK(!strcmp(vl->plugin, "scsi_smart"));
+  values.push_back(d);
+  return 0;
+}
+
+void plugin_log(int level, const char* format, ...) {
+}
+
+}
+
+/* Whether the fake drive has stopped answering */
+static bool unplugged = false;
+
+/*
+ * Function: fake_disk
+ * -------------------
+ * The fake ATA drive, failing every command once unplugged
+ */
+static int fake_disk(int context, sg_io_hdr_t& hdr) {
+
+  if(unplugged) {
+    errno = EIO;
+    return -1;
+  }
+
+  return fake_ata(context, hdr);
+
+}
+
+/*
+ * Function: fake_open
+ * -------------------
+ * Opens a fake ATA drive in place of the device node
+ */
+static int fake_open(scsismart_device* device, const char* node) {
+
+  opens++;
+  device->fd = sgio_register(fake_disk, 0);
+  strcpy(device->node, node);
+
+  return 0;
+
+}
+
+/*
+ * Function: find
+ * --------------
+ * Returns the values dispatched with a type and type instance, or null
+ */
+static const dispatched* find(const string& type, const string& type_instance) {
+
+  for(vector<dispatched>::iterator i = values.begin(); i != values.end(); i++)
+    if(i->type == type && i->type_instance == type_instance)
+      return &*i;
+
+  return 0;
+
+}
+
+int main() {
+
+  char temp[] = "/tmp/test_collectd.XXXXXX";
+  CHECK(mkdtemp(temp));
+
+  scsi_smart_open = fake_open;
+  module_register();
+  CHECK(config_callback && init_callback && read_callback && shutdown_callback);
+
+  // <Plugin scsi_smart> Device "/dev/sda" Device "/dev/sdb" StateDir ... </Plugin>
+  oconfig_value_t config_values[3];
+  config_values[0].type = OCONFIG_TYPE_STRING;
+  config_values[0].value.string = const_cast<char*>("/dev/sda");
+  config_values[1].type = OCONFIG_TYPE_STRING;
+  config_values[1].value.string = const_cast<char*>("/dev/sdb");
+  config_values[2].type = OCONFIG_TYPE_STRING;
+  config_values[2].value.string = temp;
+
+  oconfig_item_t children[3];
+  memset(children, 0, sizeof(children));
+  const char* keys[] = { "Device", "Device", "StateDir" };
+  for(int i = 0; i < 3; i++) {
+    children[i].key = const_cast<char*>(keys[i]);
+    children[i].values = config_values + i;
+    children[i].values_num = 1;
+  }
+
+  oconfig_item_t block;
+  memset(&block, 0, sizeof(block));
+  block.key = const_cast<char*>("Plugin");
+  block.children = children;
+  block.children_num = 3;
+
+  CHECK(config_callback(&block) == 0);
+  CHECK(init_callback() == 0);
+  CHECK(opens == 2);
+
+  // Each interval checks both disks without opening them again
+  for(int interval = 0; interval < 3; interval++) {
+    values.clear();
+    int commands = fake_ata_commands;
+    CHECK(read_callback() == 0);
+    CHECK(fake_ata_commands > commands);
+  }
+  CHECK(opens == 2);
+
+  // Values dispatched in the last interval, both disks are the same drive
+  const dispatched* d = find("smart_attribute", "5_reallocated_sectors_count");
+  CHECK(d && d->plugin_instance == "FAKE_DRIVE_FAKE0001");
+  CHECK(d && d->values.size() == 4 && d->values[0] == 5 && d->values[1] == 5 &&
+        d->values[2] == FAKE_ATA_THRESHOLD && d->values[3] == 8);
+
+  d = find("smart_badsectors", "5_reallocated_sectors_count");
+  CHECK(d && d->values.size() == 1 && d->values[0] == 8);
+  d = find("temperature", "194_temperature");
+  CHECK(d && d->values[0] == 35);
+  d = find("smart_poweron", "9_power_on_hours");
+  CHECK(d && d->values[0] == 23052 * 3600.0);
+  d = find("gauge", "status");
+  CHECK(d && d->values[0] == SCSISMART_CRITICAL);
+  d = find("gauge", "checksum_errors");
+  CHECK(d && d->values[0] == 0);
+
+  // Attributes aren't dispatched a second time as gauges
+  CHECK(!find("gauge", "5_reallocated_sectors_count"));
+  CHECK(values.size() == 2 * (1 + FAKE_ATA_ATTRIBUTES + 3 + 1));
+
+  // A read that can't identify the drive stays with its history
+  unplugged = true;
+  values.clear();
+  CHECK(read_callback() == 0);
+  d = find("gauge", "status");
+  CHECK(d && d->values[0] == SCSISMART_UNKNOWN);
+  CHECK(d && d->plugin_instance == "FAKE_DRIVE_FAKE0001");
+  unplugged = false;
+
+  CHECK(shutdown_callback() == 0);
+
+  // Misspelt options are rejected
+  char bogus_key[] = "Devices";
+  children[0].key = bogus_key;
+  CHECK(config_callback(&block) == -1);
+
+  string command = "rm -rf " + string(temp);
+  CHECK(system(command.c_str()) == 0);
+
+  return test_failures;
+
+}
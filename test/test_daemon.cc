@@ -0,0 +1,357 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "daemon.h"
+#include "test.h"
+
+#include <deque>
+#include <fstream>
+#include <map>
+
+/* Root of the fake sysfs tree and device directory */
+static string root;
+static string dev;
+
+/*
+ * Class: FakeUeventSource
+ * -----------------------
+ * Delivers injected uevents, a pipe makes the descriptor poll readable
+ * while any are pending
+ */
+class FakeUeventSource : public UeventSource {
+
+private:
+
+  int pipes[2];
+  deque<int> results;
+  deque<uevent> events;
+
+public:
+
+  FakeUeventSource() { pipe(pipes); }
+  ~FakeUeventSource() { close(pipes[0]); close(pipes[1]); }
+
+  void inject(const string& action, const string& name) {
+    uevent event;
+    event.action = action;
+    event.subsystem = UEVENT_SUBSYSTEM_SG;
+    event.devname = name;
+    events.push_back(event);
+    results.push_back(UEVENT_RECEIVED);
+    write(pipes[1], "", 1);
+  }
+
+  void overflow() {
+    events.push_back(uevent());
+    results.push_back(UEVENT_OVERFLOW);
+    write(pipes[1], "", 1);
+  }
+
+  int fd() const { return pipes[0]; }
+
+  int receive(uevent& event) {
+    if(results.empty())
+      return UEVENT_NONE;
+    char byte;
+    read(pipes[0], &byte, 1);
+    int result = results.front();
+    event = events.front();
+    results.pop_front();
+    events.pop_front();
+    return result;
+  }
+
+};
+
+/*
+ * Function: put
+ * -------------
+ * Writes a file below the fake root
+ */
+static void put(const string& path, const string& value) {
+
+  ofstream out((root + path).c_str());
+  out << value << endl;
+
+}
+
+/*
+ * Function: plug
+ * --------------
+ * Adds a SCSI generic device to sysfs and creates its node
+ */
+static void plug(const string& name, const string& address, const string& type, const string& vendor) {
+
+  string target = root + "/devices/" + address;
+  mkdir(target.c_str(), 0755);
+
+  string sg = root + "/class/scsi_generic/" + name;
+  mkdir(sg.c_str(), 0755);
+  symlink(target.c_str(), (sg + "/device").c_str());
+
+  put("/devices/" + address + "/type", type);
+  put("/devices/" + address + "/vendor", vendor);
+
+  ofstream node((dev + "/" + name).c_str());
+
+}
+
+/*
+ * Function: unplug
+ * ----------------
+ * Removes a SCSI generic device from sysfs and its node
+ */
+static void unplug(const string& name) {
+
+  string sg = root + "/class/scsi_generic/" + name;
+  unlink((sg + "/device").c_str());
+  rmdir(sg.c_str());
+  unlink((dev + "/" + name).c_str());
+
+}
+
+int main() {
+
+  // Kernel uevents have an ACTION@DEVPATH header, udev's rebroadcasts don't
+  const char message[] = "add@/devices/pci0000:00/host0/target0:0:0/0:0:0:0/scsi_generic/sg0\0"
+                         "ACTION=add\0DEVPATH=/devices/pci0000:00/host0/target0:0:0/0:0:0:0/scsi_generic/sg0\0"
+                         "SUBSYSTEM=scsi_generic\0DEVNAME=sg0\0SEQNUM=1234\0MAJOR=21\0MINOR=0";
+  uevent event;
+  CHECK(uevent_parse(message, sizeof(message), event));
+  CHECK(event.action == "add");
+  CHECK(event.subsystem == "scsi_generic");
+  CHECK(event.devname == "sg0");
+
+  const char nameless[] = "remove@/devices/host0/scsi_generic/sg4\0ACTION=remove\0"
+                          "DEVPATH=/devices/host0/scsi_generic/sg4\0SUBSYSTEM=scsi_generic";
+  CHECK(uevent_parse(nameless, sizeof(nameless), event));
+  CHECK(event.devname == "sg4");
+
+  const char udev[] = "libudev\0\xfe\xed\xca\xfe";
+  CHECK(!uevent_parse(udev, sizeof(udev), event));
+
+  char temp[] = "/tmp/test_daemon.XXXXXX";
+  CHECK(mkdtemp(temp));
+  root = temp;
+  dev = root + "/dev";
+
+  const char* dirs[] = { "/class", "/class/scsi_generic", "/class/scsi_host", "/devices", "/dev" };
+  for(size_t i = 0; i < sizeof(dirs) / sizeof(dirs[0]); i++)
+    mkdir((root + dirs[i]).c_str(), 0755);
+
+  plug("sg0", "0:0:0:0", "0", "ATA");
+  plug("sg1", "0:0:1:0", "13", "HP");
+
+  map<string, int> checks;
+  map<string, int> fds;
+  map<string, device_health> healths;
+  FakeUeventSource source;
+  Daemon daemon(source, root, dev, [&](const vector<sg_device>& devices, vector<int>& descriptors) {
+    vector<device_health> results;
+    for(size_t i = 0; i < devices.size(); i++) {
+      checks[devices[i].name]++;
+      fds[devices[i].name] = descriptors[i];
+      results.push_back(healths[devices[i].name]);
+    }
+    return results;
+  }, 100, 1000);
+
+  string name = "/test_daemon." + to_string(getpid());
+  ShmWriter writer;
+  ShmReader reader;
+  CHECK(writer.open(name));
+  CHECK(reader.open(name));
+  daemon.publish(writer);
+
+  // Devices present at start are checked at once, enclosures never
+  daemon.synchronize(1000);
+  CHECK(daemon.size() == 1);
+  CHECK(daemon.monitoring("sg0"));
+  CHECK(!daemon.monitoring("sg1"));
+  CHECK(daemon.timeout(1000) == 0);
+
+  daemon.run_due(1000);
+  CHECK(checks["sg0"] == 1);
+
+  // Each check is published with its schedule
+  shm_report report;
+  CHECK(reader.find_node(dev + "/sg0", report));
+  CHECK(report.tier == DAEMON_TIER_NORMAL);
+  CHECK(report.due - report.checked == 100);
+  CHECK(daemon.timeout(1000) == 100 * 1000);
+
+  // The descriptor stays open between checks
+  int fd = fds["sg0"];
+  daemon.run_due(1100);
+  CHECK(checks["sg0"] == 2);
+  CHECK(fds["sg0"] == fd);
+  CHECK(fcntl(fd, F_GETFD) != -1);
+
+  // A hotplugged device is checked once udev has created its node
+  plug("sg2", "0:0:2:0", "0", "SEAGATE");
+  source.inject(UEVENT_ACTION_ADD, "sg2");
+  daemon.drain(1150);
+  CHECK(daemon.monitoring("sg2"));
+  CHECK(daemon.find("sg2")->device.device_class == DEVICE_CLASS_SAS);
+  daemon.run_due(1150);
+  CHECK(checks["sg2"] == 0);
+  daemon.run_due(1150 + DAEMON_SETTLE);
+  CHECK(checks["sg2"] == 1);
+
+  // A node which hasn't appeared yet is retried after the settle time
+  plug("sg3", "0:0:3:0", "0", "ATA");
+  unlink((dev + "/sg3").c_str());
+  source.inject(UEVENT_ACTION_ADD, "sg3");
+  daemon.drain(1160);
+  daemon.run_due(1160 + DAEMON_SETTLE);
+  CHECK(checks["sg3"] == 0);
+  CHECK(daemon.find("sg3")->due == 1160 + 2 * DAEMON_SETTLE);
+  ofstream((dev + "/sg3").c_str());
+  daemon.run_due(1160 + 2 * DAEMON_SETTLE);
+  CHECK(checks["sg3"] == 1);
+
+  // Removal closes the descriptor and the device is never checked again
+  fd = fds["sg0"];
+  unplug("sg0");
+  source.inject(UEVENT_ACTION_REMOVE, "sg0");
+  daemon.drain(1170);
+  CHECK(!daemon.monitoring("sg0"));
+  CHECK(fcntl(fd, F_GETFD) == -1);
+  CHECK(!reader.find_node(dev + "/sg0", report));
+  daemon.run_due(5000);
+  CHECK(checks["sg0"] == 2);
+
+  // Lost events are recovered by reading sysfs again
+  unplug("sg2");
+  plug("sg4", "0:0:4:0", "0", "ATA");
+  source.overflow();
+  daemon.drain(6000);
+  CHECK(!daemon.monitoring("sg2"));
+  CHECK(daemon.monitoring("sg4"));
+  CHECK(daemon.size() == 2);
+
+  // A healthy device backs off once it has been quiet for a few checks
+  device_health health;
+  health.valid = true;
+  health.counters = 1;
+  health.margin = 100;
+  healths["sg4"] = health;
+
+  time_t now = 6000;
+  for(int i = 0; i <= DAEMON_QUIET_CHECKS; i++) {
+    CHECK(daemon.find("sg4")->tier == DAEMON_TIER_NORMAL);
+    daemon.run_due(now);
+    now = daemon.find("sg4")->due;
+  }
+  CHECK(daemon.find("sg4")->tier == DAEMON_TIER_HEALTHY);
+  CHECK(now == 6300 + DAEMON_HEALTHY_INTERVAL);
+
+  // Beyond a revolution of the wheel it stays put until its time comes
+  CHECK(daemon.timeout(6300) <= (now - 6300) * 1000);
+  daemon.run_due(now - 1);
+  CHECK(checks["sg4"] == DAEMON_QUIET_CHECKS + 1);
+  daemon.run_due(now);
+  CHECK(checks["sg4"] == DAEMON_QUIET_CHECKS + 2);
+
+  // A failure counter moving makes it suspect, new errors urgent
+  daemon_device device = *daemon.find("sg4");
+  health.counters = 2;
+  CHECK(daemon_tier(device, health) == DAEMON_TIER_SUSPECT);
+  device.health = health;
+  CHECK(daemon_tier(device, health) == DAEMON_TIER_NORMAL);
+  health.errors = 1;
+  CHECK(daemon_tier(device, health) == DAEMON_TIER_URGENT);
+  device.health = health;
+
+  // As does a value nearing its threshold, or a warning
+  health.margin = DAEMON_MARGIN_URGENT;
+  CHECK(daemon_tier(device, health) == DAEMON_TIER_URGENT);
+  health.margin = DAEMON_MARGIN_SUSPECT;
+  CHECK(daemon_tier(device, health) == DAEMON_TIER_SUSPECT);
+  health.margin = 100;
+  health.degraded = true;
+  CHECK(daemon_tier(device, health) == DAEMON_TIER_SUSPECT);
+
+  // A failed check compares with nothing
+  CHECK(daemon_tier(device, device_health()) == DAEMON_TIER_NORMAL);
+  CHECK(device.quiet == 0);
+
+  // Every device due is checked in one sweep, and one whose descriptor the
+  // sweep had to close is opened again for its next check
+  {
+    vector<size_t> sweeps;
+    map<string, int> seen;
+    Daemon batch(source, root, dev, [&](const vector<sg_device>& devices, vector<int>& descriptors) {
+      sweeps.push_back(devices.size());
+      for(size_t i = 0; i < devices.size(); i++) {
+        seen[devices[i].name] = descriptors[i];
+        if(devices[i].name == "sg3") {
+          close(descriptors[i]);
+          descriptors[i] = -1;
+        }
+      }
+      return vector<device_health>(devices.size());
+    }, 100, 7000);
+
+    batch.synchronize(7000);
+    batch.run_due(7000);
+    CHECK(sweeps == vector<size_t>({ 2 }));
+    CHECK(batch.find("sg3")->fd == -1);
+    CHECK(batch.find("sg4")->fd == seen["sg4"] && fcntl(seen["sg4"], F_GETFD) != -1);
+
+    batch.run_due(7100);
+    CHECK(sweeps == vector<size_t>({ 2, 2 }));
+    CHECK(seen["sg3"] != -1);
+  }
+
+  // Timers cancel in place and fire in order of when they were due
+  TimerWheel wheel(0);
+  TimerWheel::Timer cancelled = wheel.add(5, "cancelled");
+  wheel.add(WHEEL_SLOTS + 3, "later");
+  wheel.add(3, "first");
+  wheel.add(4, "second");
+  wheel.cancel(cancelled);
+  CHECK(wheel.size() == 3);
+  CHECK(wheel.timeout(0) == 3000);
+
+  vector<string> expired;
+  wheel.expire(10, expired);
+  CHECK(expired.size() == 2 && expired[0] == "first" && expired[1] == "second");
+  wheel.expire(WHEEL_SLOTS + 2, expired);
+  CHECK(expired.size() == 2);
+  wheel.expire(3 * WHEEL_SLOTS, expired);
+  CHECK(expired.size() == 3 && expired[2] == "later");
+  CHECK(wheel.empty());
+
+  string command = "rm -rf " + root;
+  CHECK(system(command.c_str()) == 0);
+
+  return test_failures;
+
+}
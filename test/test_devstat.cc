@@ -0,0 +1,142 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "check.h"
+#include "devstat.h"
+#include "sgio.h"
+#include "test.h"
+#include "fake_ata.h"
+
+#include <sstream>
+#include <string>
+
+/*
+ * Function: put_statistic
+ * -----------------------
+ * Stores a statistic with its supported and valid flags
+ */
+static void put_statistic(vector<unsigned char>& log, uint8_t page, uint16_t offset, uint64_t value,
+                          bool valid = true) {
+
+  uint64_t qword = value | DEVSTAT_FLAG_SUPPORTED | (valid ? DEVSTAT_FLAG_VALID : 0);
+  for(int i = 0; i < 8; i++)
+    log[page * SECTOR_SIZE + offset + i] = qword >> (i * 8);
+
+}
+
+/*
+ * Function: check
+ * ---------------
+ * Checks the fake drive, returning the Nagios code
+ */
+static int check(int fd, const CheckOptions& options, string& out, string& perf) {
+
+  sg_device device;
+  device.node = "fake";
+  device.device_class = DEVICE_CLASS_ATA;
+
+  stringstream out_stream, perf_stream;
+  int code = check_open_device(fd, device, options, "", out_stream, perf_stream);
+
+  out = out_stream.str();
+  perf = perf_stream.str();
+
+  return code;
+
+}
+
+int main() {
+
+  char temp[] = "/tmp/test_devstat.XXXXXX";
+  CHECK(mkdtemp(temp));
+
+  // Eight pages, of which the drive implements general, rotating media,
+  // general errors and temperature
+  vector<unsigned char> log(8 * SECTOR_SIZE);
+  const uint8_t supported[] = { 0, 1, 3, 4, 5 };
+  log[DEVSTAT_SUPPORTED_COUNT] = sizeof(supported);
+  memcpy(&log[DEVSTAT_SUPPORTED_COUNT + 1], supported, sizeof(supported));
+
+  for(size_t i = 1; i < sizeof(supported); i++)
+    log[supported[i] * SECTOR_SIZE + 2] = supported[i];
+
+  put_statistic(log, 1, 0x10, 23052);
+  put_statistic(log, 1, 0x40, 7, false);
+  put_statistic(log, 3, 0x20, 8);
+  put_statistic(log, 4, 0x08, 3);
+  put_statistic(log, 5, 0x08, 0xfb);
+
+  fake_ata_logs[ATA_LOG_ADDRESS_DEVSTAT] = log;
+
+  int fd = sgio_register(fake_ata, 0);
+
+  CheckOptions options;
+  options.state_dir = temp;
+  options.warning_named["devstat_reported_uncorrectable_errors"] = 1;
+  options.critical_named["devstat_reallocated_sectors"] = 100;
+
+  string out, perf;
+
+  // Nothing is read unless pages are asked for
+  CHECK(check(fd, options, out, perf) == NAGIOS_CRITICAL);
+  CHECK(fake_ata_reads.empty());
+  CHECK(perf.find("devstat_") == string::npos);
+
+  // Only pages both asked for and implemented are read, consecutive ones
+  // in a single command
+  const uint8_t pages[] = { 7, 5, 1, 4, 3 };
+  options.devstat_pages.assign(pages, pages + sizeof(pages));
+
+  CHECK(check(fd, options, out, perf) == NAGIOS_CRITICAL);
+  CHECK(out == "CRITICAL: prdfail 1, advisory 0, critical 0, warning 1, logs 0, "
+               "model FAKE DRIVE, serial FAKE0001, firmware 1.0");
+
+  CHECK(fake_ata_reads.size() == 3);
+  CHECK(fake_ata_reads[0].log == ATA_LOG_ADDRESS_DEVSTAT && fake_ata_reads[0].page == 0 && fake_ata_reads[0].count == 1);
+  CHECK(fake_ata_reads[1].page == 1 && fake_ata_reads[1].count == 1);
+  CHECK(fake_ata_reads[2].page == 3 && fake_ata_reads[2].count == 3);
+
+  // Invalid statistics are skipped, signed ones sign extended
+  CHECK(perf.find(" devstat_power_on_hours=23052;;;;") != string::npos);
+  CHECK(perf.find("devstat_pending_errors") == string::npos);
+  CHECK(perf.find(" devstat_reallocated_sectors=8;;100;;") != string::npos);
+  CHECK(perf.find(" devstat_reported_uncorrectable_errors=3;1;;;") != string::npos);
+  CHECK(perf.find(" devstat_current_temperature=-5;;;;") != string::npos);
+
+  // A page whose header names another page is ignored
+  fake_ata_logs[ATA_LOG_ADDRESS_DEVSTAT][3 * SECTOR_SIZE + 2] = 0;
+  fake_ata_reads.clear();
+  CHECK(check(fd, options, out, perf) == NAGIOS_CRITICAL);
+  CHECK(perf.find("devstat_reallocated_sectors") == string::npos);
+  CHECK(perf.find(" devstat_reported_uncorrectable_errors=3;1;;;") != string::npos);
+
+  string command = "rm -rf " + string(temp);
+  CHECK(system(command.c_str()) == 0);
+
+  return test_failures;
+
+}
@@ -0,0 +1,113 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "discover.h"
+#include "test.h"
+
+#include <fstream>
+
+/* Root of the fake sysfs tree */
+static string root;
+
+/*
+ * Function: put
+ * -------------
+ * Writes a sysfs attribute
+ */
+static void put(const string& path, const string& value) {
+
+  ofstream out((root + path).c_str());
+  out << value << endl;
+
+}
+
+/*
+ * Function: add_device
+ * --------------------
+ * Adds a SCSI generic device whose device link resolves to an H:C:T:L
+ * directory, as in the real tree
+ */
+static void add_device(const string& name, const string& address, const string& type, const string& vendor) {
+
+  string target = root + "/devices/" + address;
+  mkdir(target.c_str(), 0755);
+
+  string sg = root + "/class/scsi_generic/" + name;
+  mkdir(sg.c_str(), 0755);
+  symlink(target.c_str(), (sg + "/device").c_str());
+
+  put("/devices/" + address + "/type", type);
+  put("/devices/" + address + "/vendor", vendor);
+
+}
+
+int main() {
+
+  char temp[] = "/tmp/test_discover.XXXXXX";
+  CHECK(mkdtemp(temp));
+  root = temp;
+
+  const char* dirs[] = { "/class", "/class/scsi_generic", "/class/scsi_host", "/class/scsi_host/host2",
+                         "/devices" };
+  for(size_t i = 0; i < sizeof(dirs) / sizeof(dirs[0]); i++)
+    mkdir((root + dirs[i]).c_str(), 0755);
+  put("/class/scsi_host/host2/proc_name", "megaraid_sas");
+
+  // A SAT exposes the ATA Information VPD page, libata reports vendor ATA
+  add_device("sg0", "0:0:0:0", "0", "ATA     ");
+  add_device("sg1", "1:0:0:0", "0", "WDC     ");
+  put("/devices/1:0:0:0/vpd_pg89", "");
+  add_device("sg2", "1:0:1:0", "0", "SEAGATE ");
+  add_device("sg3", "1:0:2:0", "13", "HPE     ");
+  add_device("sg10", "2:2:0:0", "0", "AVAGO   ");
+  add_device("sg4", "3:0:0:0", "8", "HP      ");
+
+  CHECK(sysfs_classify(root, "sg0") == DEVICE_CLASS_ATA);
+  CHECK(sysfs_classify(root, "sg1") == DEVICE_CLASS_ATA);
+  CHECK(sysfs_classify(root, "sg2") == DEVICE_CLASS_SAS);
+  CHECK(sysfs_classify(root, "sg3") == DEVICE_CLASS_ENCLOSURE);
+  CHECK(sysfs_classify(root, "sg10") == DEVICE_CLASS_RAID);
+  CHECK(sysfs_classify(root, "sg4") == DEVICE_CLASS_OTHER);
+  CHECK(sysfs_classify(root, "sg99") == DEVICE_CLASS_UNKNOWN);
+
+  // Devices are listed in numeric order with their nodes
+  vector<sg_device> devices = sysfs_discover(root);
+  CHECK(devices.size() == 6);
+  if(devices.size() == 6) {
+    CHECK(devices[0].name == "sg0" && devices[0].node == "/dev/sg0");
+    CHECK(devices[4].name == "sg4");
+    CHECK(devices[5].name == "sg10" && devices[5].device_class == DEVICE_CLASS_RAID);
+  }
+
+  CHECK(sysfs_discover(root + "/missing").empty());
+
+  string cleanup = "rm -rf " + root;
+  CHECK(system(cleanup.c_str()) == 0);
+
+  return test_failures;
+
+}
@@ -0,0 +1,193 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "check.h"
+#include "smart.h"
+#include "sgio.h"
+#include "test.h"
+#include "fake_ata.h"
+
+#include <sstream>
+#include <string>
+
+/* Pages of the fake extended comprehensive error log */
+const int TEST_PAGES    = 3;
+const int TEST_CAPACITY = TEST_PAGES * SMART_EXT_LOG_ENTRIES;
+
+/* The fake drive's log, the index and count are only valid in the first page */
+static smart_ext_log pages[TEST_PAGES];
+
+/*
+ * Function: put_error
+ * -------------------
+ * Stores the error register of an entry in the ring
+ */
+static void put_error(int entry, uint8_t error) {
+
+  pages[entry / SMART_EXT_LOG_ENTRIES].data[entry % SMART_EXT_LOG_ENTRIES].error.error = error;
+
+}
+
+/*
+ * Function: hold_log
+ * ------------------
+ * Gives the fake drive the log as it stands, clearing the reads made so far
+ * index: Most recent entry, one based, or zero if the log is empty
+ * count: Errors the drive has logged over its lifetime
+ */
+static void hold_log(uint16_t index, uint16_t count) {
+
+  pages[0].index = index;
+  pages[0].count = count;
+
+  vector<unsigned char>& log = fake_ata_logs[ATA_LOG_ADDRESS_EXT_COMPREHENSIVE];
+  log.resize(sizeof(pages));
+  for(int i = 0; i < TEST_PAGES; i++) {
+    unsigned char* page = reinterpret_cast<unsigned char*>(&pages[i]);
+    fake_ata_sum(page);
+    memcpy(&log[i * SECTOR_SIZE], page, SECTOR_SIZE);
+  }
+
+  fake_ata_reads.clear();
+
+}
+
+/*
+ * Function: read_pages
+ * --------------------
+ * Returns whether the log was read in exactly these commands, each a first
+ * page and count
+ */
+static bool read_pages(const vector<pair<int, int> >& expected) {
+
+  if(fake_ata_reads.size() != expected.size())
+    return false;
+
+  for(size_t i = 0; i < expected.size(); i++)
+    if(fake_ata_reads[i].log != ATA_LOG_ADDRESS_EXT_COMPREHENSIVE || fake_ata_reads[i].page != expected[i].first ||
+       fake_ata_reads[i].count != expected[i].second)
+      return false;
+
+  return true;
+
+}
+
+/*
+ * Function: check
+ * ---------------
+ * Checks the fake drive, returning the Nagios code
+ */
+static int check(int fd, const CheckOptions& options, string& out, string& perf) {
+
+  sg_device device;
+  device.node = "fake";
+  device.device_class = DEVICE_CLASS_ATA;
+
+  stringstream out_stream, perf_stream;
+  int code = check_open_device(fd, device, options, "", out_stream, perf_stream);
+
+  out = out_stream.str();
+  perf = perf_stream.str();
+
+  return code;
+
+}
+
+int main() {
+
+  char temp[] = "/tmp/test_error_log.XXXXXX";
+  CHECK(mkdtemp(temp));
+
+  memset(pages, 0, sizeof(pages));
+  int fd = sgio_register(fake_ata, 0);
+
+  CheckOptions options;
+  options.state_dir = temp;
+  options.error_log = true;
+
+  string out, perf;
+
+  // An empty log costs only its first page
+  hold_log(0, 0);
+  CHECK(check(fd, options, out, perf) == NAGIOS_CRITICAL);
+  CHECK(out.find(", new errors 0,") != string::npos);
+  CHECK(perf.find(" error_log_count=0;;;;") != string::npos);
+  CHECK(perf.find(" new_errors=0;;;;") != string::npos);
+  CHECK(read_pages({ { 0, 1 } }));
+
+  // The first errors fill the ring from the start, every page with a new
+  // entry is read and the rest in one command
+  for(int i = 0; i < 9; i++)
+    put_error(i, ATA_ERROR_ABRT);
+  hold_log(9, 9);
+  CHECK(check(fd, options, out, perf) == NAGIOS_CRITICAL);
+  CHECK(out.find(", new errors 9,") != string::npos);
+  CHECK(perf.find(" new_abrt_errors=9;;;;") != string::npos);
+  CHECK(read_pages({ { 0, 1 }, { 1, 2 } }));
+
+  // Four more wrap around the end, only the pages holding them are read
+  put_error(9, ATA_ERROR_UNC);
+  put_error(10, ATA_ERROR_IDNF | ATA_ERROR_ABRT);
+  put_error(11, ATA_ERROR_ICRC);
+  put_error(0, ATA_ERROR_UNC);
+  hold_log(1, 13);
+  CHECK(check(fd, options, out, perf) == NAGIOS_CRITICAL);
+  CHECK(out.find(", new errors 4,") != string::npos);
+  CHECK(perf.find(" error_log_count=13;;;;") != string::npos);
+  CHECK(perf.find(" new_unc_errors=2;;;;") != string::npos);
+  CHECK(perf.find(" new_icrc_errors=1;;;;") != string::npos);
+  CHECK(perf.find(" new_idnf_errors=1;;;;") != string::npos);
+  CHECK(perf.find(" new_abrt_errors=1;;;;") != string::npos);
+  CHECK(read_pages({ { 0, 1 }, { 2, 1 } }));
+
+  // Nothing new, nothing beyond the first page
+  fake_ata_reads.clear();
+  CHECK(check(fd, options, out, perf) == NAGIOS_CRITICAL);
+  CHECK(out.find(", new errors 0,") != string::npos);
+  CHECK(read_pages({ { 0, 1 } }));
+
+  // More errors than the ring holds are capped at its size
+  for(int i = 0; i < TEST_CAPACITY; i++)
+    put_error(i, ATA_ERROR_UNC);
+  hold_log(4, 40);
+  CHECK(check(fd, options, out, perf) == NAGIOS_CRITICAL);
+  CHECK(out.find(", new errors " + to_string(TEST_CAPACITY) + ",") != string::npos);
+  CHECK(perf.find(" new_unc_errors=" + to_string(TEST_CAPACITY) + ";;;;") != string::npos);
+  CHECK(read_pages({ { 0, 1 }, { 1, 2 } }));
+
+  // An index beyond the ring can't be trusted, nothing is counted
+  hold_log(TEST_CAPACITY + 1, 45);
+  CHECK(check(fd, options, out, perf) == NAGIOS_CRITICAL);
+  CHECK(out.find(", new errors 0,") != string::npos);
+  CHECK(read_pages({ { 0, 1 } }));
+
+  string command = "rm -rf " + string(temp);
+  CHECK(system(command.c_str()) == 0);
+
+  return test_failures;
+
+}
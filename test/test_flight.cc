@@ -0,0 +1,199 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <glob.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "check.h"
+#include "daemon.h"
+#include "flight.h"
+#include "sgio.h"
+#include "test.h"
+#include "fake_ata.h"
+
+#include <fstream>
+#include <sstream>
+
+/*
+ * Function: check
+ * ---------------
+ * Checks the fake drive as an invocation coalescing through dir would,
+ * returning the Nagios code
+ */
+static int check(int fd, const CheckOptions& options, const string& dir, const string& prefix, string& out,
+                 string& perf, device_health& health) {
+
+  sg_device device;
+  device.node = "fake";
+  device.device_class = DEVICE_CLASS_ATA;
+
+  health = device_health();
+
+  stringstream out_stream, perf_stream;
+  int code = check_coalesced(fd, device, options, dir, prefix, out_stream, perf_stream, &health);
+
+  out = out_stream.str();
+  perf = perf_stream.str();
+
+  return code;
+
+}
+
+/*
+ * Function: age_results
+ * ---------------------
+ * Backdates every recorded result
+ */
+static void age_results(const string& dir, time_t seconds) {
+
+  glob_t found;
+  CHECK(glob((dir + "/fake.*[^k]").c_str(), 0, 0, &found) == 0);
+
+  for(size_t i = 0; i < found.gl_pathc; i++) {
+    ifstream in(found.gl_pathv[i]);
+    string contents((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    contents.replace(0, contents.find('\n'), "checked " + to_string(time(0) - seconds));
+    ofstream(found.gl_pathv[i]) << contents;
+  }
+
+  globfree(&found);
+
+}
+
+int main() {
+
+  char temp[] = "/tmp/test_flight.XXXXXX";
+  CHECK(mkdtemp(temp));
+  string dir = temp;
+
+  int fd = sgio_register(fake_ata, 0);
+
+  CheckOptions options;
+  options.state_dir = dir + "/state";
+  options.coalesce = 60;
+
+  string out, perf;
+  device_health health;
+
+  // The first invocation reads the drive, the checksum re-read included
+  fake_ata_corrupt = 1;
+  CHECK(check(fd, options, dir, "", out, perf, health) == NAGIOS_CRITICAL);
+  CHECK(perf.find(" checksum_errors=1;;;;") != string::npos);
+  CHECK(health.key == "FAKE_DRIVE_FAKE0001");
+  CHECK(fake_ata_corrupt == 0);
+  int commands = fake_ata_commands;
+  CHECK(commands > 0);
+
+  // The next with the same options reuses its result without a command,
+  // adding its own prefix
+  string first = out;
+  CHECK(check(fd, options, dir, "sda_", out, perf, health) == NAGIOS_CRITICAL);
+  CHECK(fake_ata_commands == commands);
+  CHECK(out == first);
+  CHECK(perf.find(" sda_checksum_errors=1;;;;") != string::npos);
+  CHECK(perf.find(" checksum_errors") == string::npos);
+  CHECK(health.valid && health.degraded && health.key == "FAKE_DRIVE_FAKE0001");
+
+  // Other options report differently so read the drive themselves
+  CheckOptions other = options;
+  other.warning_thresholds[194] = 30;
+  CHECK(check(fd, other, dir, "", out, perf, health) == NAGIOS_CRITICAL);
+  CHECK(fake_ata_commands > commands);
+  CHECK(perf.find(" 194_temperature=35;30;;;") != string::npos);
+  CHECK(perf.find(" checksum_errors=0;;;;") != string::npos);
+  commands = fake_ata_commands;
+
+  // Results older than the TTL are not reused
+  age_results(dir, 61);
+  CHECK(check(fd, options, dir, "", out, perf, health) == NAGIOS_CRITICAL);
+  CHECK(fake_ata_commands > commands);
+  CHECK(perf.find(" checksum_errors=0;;;;") != string::npos);
+
+  // A page which never validates fails the check, which isn't recorded so
+  // the next invocation reads the drive again
+  age_results(dir, 61);
+  fake_ata_corrupt = 1 + ATA_CHECKSUM_RETRIES;
+  CHECK(check(fd, options, dir, "", out, perf, health) == NAGIOS_UNKNOWN);
+  CHECK(out == "UNKNOWN: SMART READ DATA failed: invalid checksum");
+  commands = fake_ata_commands;
+  CHECK(check(fd, options, dir, "", out, perf, health) == NAGIOS_CRITICAL);
+  CHECK(fake_ata_commands > commands);
+  CHECK(perf.find(" checksum_errors=0;;;;") != string::npos);
+
+  // Waiting too long for another invocation checks the device directly
+  pid_t pid = fork();
+  if(!pid) {
+    int lock = open((dir + "/drive.lock").c_str(), O_RDWR | O_CREAT, 0644);
+    flock(lock, LOCK_EX);
+    sleep(2);
+    _exit(0);
+  }
+  usleep(200000);
+  {
+    SingleFlight flight;
+    CHECK(!flight.begin(dir, "drive", 0));
+    flight_result result;
+    CHECK(!flight.load("options", 60, result));
+  }
+  waitpid(pid, 0, 0);
+
+  // Once the lock is free results are recorded and found by their options
+  {
+    SingleFlight flight;
+    CHECK(flight.begin(dir, "drive", 0));
+    flight_result result = { NAGIOS_WARNING, "KEY", "WARNING: status line", " label=1;;;;" };
+    CHECK(flight.save("options", result));
+    result.key = "multiple\nlines";
+    CHECK(!flight.save("other", result));
+
+    flight_result loaded;
+    CHECK(flight.load("options", 60, loaded));
+    CHECK(loaded.code == NAGIOS_WARNING && loaded.key == "KEY" && loaded.out == "WARNING: status line" &&
+          loaded.perf == " label=1;;;;");
+    CHECK(!flight.load("other", 60, loaded));
+  }
+
+  // Nodes which aren't devices are named for themselves, SCSI devices by wwid
+  CHECK(flight_key(dir, "megaraid,3:/dev/sda") == "megaraid_3_dev_sda");
+
+  string sysfs = dir + "/sys";
+  const char* dirs[] = { "", "/dev", "/dev/char", "/dev/char/1:3", "/dev/char/1:3/device" };
+  for(size_t i = 0; i < sizeof(dirs) / sizeof(dirs[0]); i++)
+    mkdir((sysfs + dirs[i]).c_str(), 0755);
+  CHECK(flight_key(sysfs, "/dev/null") == "dev_char_1_3");
+  ofstream((sysfs + "/dev/char/1:3/device/wwid").c_str()) << "t10.ATA     ST4000DM000-1F2168                      Z300MZ7D" << endl;
+  CHECK(flight_key(sysfs, "/dev/null") == "t10.ATA_ST4000DM000-1F2168_Z300MZ7D");
+
+  string command = "rm -rf " + dir;
+  CHECK(system(command.c_str()) == 0);
+
+  return test_failures;
+
+}
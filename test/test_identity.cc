@@ -0,0 +1,92 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <string.h>
+
+#include "ata.h"
+#include "endian.h"
+#include "test.h"
+
+#include <sstream>
+
+/*
+ * Function: put_string
+ * --------------------
+ * Stores an ATA string field, two characters per word high byte first and
+ * space padded
+ */
+static void put_string(uint16_t* identify, int word, int words, const char* text) {
+
+  char field[80];
+  memset(field, ' ', sizeof(field));
+  memcpy(field, text, strlen(text));
+
+  for(int i = 0; i < words; i++)
+    identify[word + i] = StorageEndian::swap(static_cast<uint16_t>((field[2 * i] << 8) | field[2 * i + 1]));
+
+}
+
+int main() {
+
+  uint16_t identify[SECTOR_SIZE / 2];
+  memset(identify, 0, sizeof(identify));
+
+  put_string(identify, 10, 10, "  Z1Z2ABCD");
+  put_string(identify, 23, 4, "CC43");
+  put_string(identify, 27, 20, "ST4000DM000-1F2168");
+
+  // Strings are byte swapped per word and stripped of padding
+  AtaIdentity identity(identify);
+  CHECK(identity.getSerial() == "Z1Z2ABCD");
+  CHECK(identity.getFirmware() == "CC43");
+  CHECK(identity.getModel() == "ST4000DM000-1F2168");
+  CHECK(identity.getWWN() == 0);
+  CHECK(identity.key() == "ST4000DM000-1F2168_Z1Z2ABCD");
+
+  // The WWN is only trusted when word 87 is valid and flags it
+  identify[108] = StorageEndian::swap(static_cast<uint16_t>(0x5000));
+  identify[109] = StorageEndian::swap(static_cast<uint16_t>(0xc500));
+  identify[110] = StorageEndian::swap(static_cast<uint16_t>(0xa1b2));
+  identify[111] = StorageEndian::swap(static_cast<uint16_t>(0xc3d4));
+  CHECK(AtaIdentity(identify).getWWN() == 0);
+
+  identify[87] = StorageEndian::swap(static_cast<uint16_t>(0x4100));
+  AtaIdentity named(identify);
+  CHECK(named.getWWN() == 0x5000c500a1b2c3d4ULL);
+  CHECK(named.key() == "wwn-0x5000c500a1b2c3d4");
+
+  stringstream out;
+  out << named;
+  CHECK(out.str() == "model ST4000DM000-1F2168, serial Z1Z2ABCD, firmware CC43, wwn 0x5000c500a1b2c3d4");
+
+  // Characters unsafe in a file name are replaced, no serial means no key
+  identify[87] = 0;
+  put_string(identify, 27, 20, "WDC WD40EFRX/68N32N0");
+  CHECK(AtaIdentity(identify).key() == "WDC_WD40EFRX_68N32N0_Z1Z2ABCD");
+
+  put_string(identify, 10, 10, "");
+  CHECK(AtaIdentity(identify).key().empty());
+
+  return test_failures;
+
+}
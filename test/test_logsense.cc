@@ -0,0 +1,226 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <string.h>
+#include <stdint.h>
+#include <scsi/sg.h>
+
+#include "check.h"
+#include "logsense.h"
+#include "scsi.h"
+#include "sgio.h"
+#include "test.h"
+
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/* Log pages held by the fake drive by code */
+static map<uint8_t, vector<unsigned char> > pages;
+
+/* Allocation lengths of each LOG SENSE by page, in the order they were made */
+static map<uint8_t, vector<uint16_t> > reads;
+
+/*
+ * Function: start_page
+ * --------------------
+ * Gives the fake drive an empty log page
+ */
+static void start_page(uint8_t page) {
+
+  pages[page].assign(LOG_PAGE_HEADER, 0);
+  pages[page][0] = page;
+
+}
+
+/*
+ * Function: put_parameter
+ * -----------------------
+ * Appends a big-endian parameter to a log page, updating its length
+ */
+static void put_parameter(uint8_t page, uint16_t code, uint64_t value, uint8_t length) {
+
+  vector<unsigned char>& buf = pages[page];
+  buf.push_back(code >> 8);
+  buf.push_back(code);
+  buf.push_back(0);
+  buf.push_back(length);
+  for(int i = length - 1; i >= 0; i--)
+    buf.push_back(i < 8 ? value >> (i * 8) : 0);
+
+  uint16_t size = buf.size() - LOG_PAGE_HEADER;
+  buf[2] = size >> 8;
+  buf[3] = size;
+
+}
+
+/*
+ * Function: fake_sas
+ * ------------------
+ * Stands in for a SAS drive, answering LOG SENSE for the pages it holds
+ * with no more than the allocation length
+ */
+static int fake_sas(int context, sg_io_hdr_t& hdr) {
+
+  hdr.status = 0;
+  hdr.host_status = 0;
+  hdr.driver_status = 0;
+  hdr.sb_len_wr = 0;
+  hdr.resid = 0;
+
+  unsigned char* cdb = hdr.cmdp;
+  if(cdb[0] != SPC_LOG_SENSE)
+    return 0;
+
+  uint8_t page = cdb[2] & LOG_PAGE_CODE_MASK;
+  uint16_t len = cdb[7] << 8 | cdb[8];
+  reads[page].push_back(len);
+
+  unsigned char* buf = static_cast<unsigned char*>(hdr.dxferp);
+  memset(buf, 0, hdr.dxfer_len);
+
+  map<uint8_t, vector<unsigned char> >::iterator held = pages.find(page);
+  if(held != pages.end()) {
+    size_t copied = min<size_t>(len, held->second.size());
+    memcpy(buf, &held->second[0], copied);
+    hdr.resid = hdr.dxfer_len - copied;
+  }
+
+  return 0;
+
+}
+
+/*
+ * Function: check
+ * ---------------
+ * Checks the fake drive, returning the Nagios code
+ */
+static int check(int fd, string& out, string& perf) {
+
+  sg_device device;
+  device.node = "fake";
+  device.device_class = DEVICE_CLASS_SAS;
+
+  CheckOptions options;
+
+  stringstream out_stream, perf_stream;
+  int code = check_open_device(fd, device, options, "", out_stream, perf_stream);
+
+  out = out_stream.str();
+  perf = perf_stream.str();
+
+  return code;
+
+}
+
+int main() {
+
+  // Write errors are not supported so must never be asked for
+  const uint8_t supported[] = {
+    LOG_PAGE_SUPPORTED, LOG_PAGE_READ_ERRORS, LOG_PAGE_NON_MEDIUM_ERRORS, LOG_PAGE_TEMPERATURE,
+    LOG_PAGE_START_STOP, LOG_PAGE_INFORMATIONAL_EXCEPTIONS,
+  };
+
+  start_page(LOG_PAGE_SUPPORTED);
+  pages[LOG_PAGE_SUPPORTED].insert(pages[LOG_PAGE_SUPPORTED].end(), supported, supported + sizeof(supported));
+  pages[LOG_PAGE_SUPPORTED][3] = sizeof(supported);
+
+  start_page(LOG_PAGE_INFORMATIONAL_EXCEPTIONS);
+  put_parameter(LOG_PAGE_INFORMATIONAL_EXCEPTIONS, LOG_IE_GENERAL, 0x00002300, 4);
+
+  start_page(LOG_PAGE_TEMPERATURE);
+  put_parameter(LOG_PAGE_TEMPERATURE, LOG_TEMPERATURE_CURRENT, 35, 2);
+  put_parameter(LOG_PAGE_TEMPERATURE, LOG_TEMPERATURE_REFERENCE, 60, 2);
+
+  start_page(LOG_PAGE_READ_ERRORS);
+  put_parameter(LOG_PAGE_READ_ERRORS, LOG_ERRORS_CORRECTED, 1234, 4);
+  put_parameter(LOG_PAGE_READ_ERRORS, LOG_ERRORS_PROCESSED, 5000000000000ULL, 8);
+  put_parameter(LOG_PAGE_READ_ERRORS, LOG_ERRORS_UNCORRECTED, 0, 4);
+
+  start_page(LOG_PAGE_NON_MEDIUM_ERRORS);
+  put_parameter(LOG_PAGE_NON_MEDIUM_ERRORS, 0x0000, 7, 4);
+
+  start_page(LOG_PAGE_START_STOP);
+  put_parameter(LOG_PAGE_START_STOP, LOG_START_STOP_SPECIFIED, 50000, 4);
+  put_parameter(LOG_PAGE_START_STOP, LOG_START_STOP_ACCUMULATED, 120, 4);
+  put_parameter(LOG_PAGE_START_STOP, LOG_LOAD_UNLOAD_SPECIFIED, 600000, 4);
+  put_parameter(LOG_PAGE_START_STOP, LOG_LOAD_UNLOAD_ACCUMULATED, 600000, 4);
+
+  int fd = sgio_register(fake_sas, 0);
+
+  string out, perf;
+
+  // Exceeding the specified load-unload cycles is advisory
+  CHECK(check(fd, out, perf) == NAGIOS_WARNING);
+  CHECK(out == "WARNING: prdfail 0, advisory 1, critical 0, warning 0");
+  CHECK(perf.find(" scsi_ie_asc=0;;;;") != string::npos);
+  CHECK(perf.find(" scsi_temperature=35;;60;;") != string::npos);
+  CHECK(perf.find(" scsi_read_corrected=1234;;;;") != string::npos);
+  CHECK(perf.find(" scsi_read_gigabytes=5000;;;;") != string::npos);
+  CHECK(perf.find(" scsi_read_uncorrected=0;;;;") != string::npos);
+  CHECK(perf.find(" scsi_non_medium_errors=7;;;;") != string::npos);
+  CHECK(perf.find(" scsi_start_stop_cycles=120;;;;") != string::npos);
+  CHECK(perf.find(" scsi_load_unload_cycles=600000;;;;") != string::npos);
+  CHECK(perf.find("scsi_write") == string::npos);
+
+  // Every page is read as its header then with its exact length
+  CHECK(!reads.count(LOG_PAGE_WRITE_ERRORS));
+  CHECK(!reads.count(LOG_PAGE_VERIFY_ERRORS));
+  for(map<uint8_t, vector<unsigned char> >::iterator i = pages.begin(); i != pages.end(); i++) {
+    CHECK(reads[i->first].size() == 2);
+    CHECK(reads[i->first][0] == LOG_PAGE_HEADER);
+    CHECK(reads[i->first][1] == i->second.size());
+  }
+
+  // A failure prediction is critical, and the temperature reaching the
+  // reference is too
+  start_page(LOG_PAGE_INFORMATIONAL_EXCEPTIONS);
+  put_parameter(LOG_PAGE_INFORMATIONAL_EXCEPTIONS, LOG_IE_GENERAL, 0x5d102300, 4);
+  start_page(LOG_PAGE_TEMPERATURE);
+  put_parameter(LOG_PAGE_TEMPERATURE, LOG_TEMPERATURE_CURRENT, 61, 2);
+  put_parameter(LOG_PAGE_TEMPERATURE, LOG_TEMPERATURE_REFERENCE, 60, 2);
+
+  CHECK(check(fd, out, perf) == NAGIOS_CRITICAL);
+  CHECK(out == "CRITICAL: prdfail 1, advisory 1, critical 1, warning 0");
+  CHECK(perf.find(" scsi_ie_asc=93;;;;") != string::npos);
+  CHECK(perf.find(" scsi_ie_ascq=16;;;;") != string::npos);
+  CHECK(perf.find(" scsi_temperature=61;;60;;") != string::npos);
+
+  // A temperature not available is not reported
+  start_page(LOG_PAGE_TEMPERATURE);
+  put_parameter(LOG_PAGE_TEMPERATURE, LOG_TEMPERATURE_CURRENT, LOG_TEMPERATURE_INVALID, 2);
+  CHECK(check(fd, out, perf) == NAGIOS_CRITICAL);
+  CHECK(perf.find("scsi_temperature") == string::npos);
+
+  // A device answering with another page is not trusted
+  pages[LOG_PAGE_NON_MEDIUM_ERRORS][0] = LOG_PAGE_READ_ERRORS;
+  CHECK(check(fd, out, perf) == NAGIOS_UNKNOWN);
+  CHECK(out == "UNKNOWN: LOG SENSE failed: device returned the wrong page");
+
+  return test_failures;
+
+}
@@ -0,0 +1,143 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <string.h>
+#include <errno.h>
+#include <stddef.h>
+#include <scsi/scsi.h>
+
+#include "ata.h"
+#include "scsi.h"
+#include "sgio.h"
+#include "megaraid.h"
+#include "test.h"
+
+/* Host number reported for the volume and the drives present behind it */
+const int TEST_HOST   = 5;
+const int TEST_ATA    = 3;
+const int TEST_ABSENT = 7;
+
+/* Last packet seen by the fake controller */
+static megasas_iocpacket last;
+
+/*
+ * Function: fake_ioctl
+ * --------------------
+ * Stands in for the megaraid_sas driver, answering IDENTIFY DEVICE for the
+ * ATA drive and rejecting everything else with sense data
+ */
+static int fake_ioctl(int fd, unsigned long request, void* arg) {
+
+  if(request == SCSI_IOCTL_GET_IDLUN) {
+    static_cast<int*>(arg)[0] = TEST_HOST << 24;
+    return 0;
+  }
+
+  if(request != MEGASAS_IOC_FIRMWARE) {
+    errno = ENOTTY;
+    return -1;
+  }
+
+  megasas_iocpacket* packet = static_cast<megasas_iocpacket*>(arg);
+  megasas_pthru_frame* frame = reinterpret_cast<megasas_pthru_frame*>(packet->frame);
+  last = *packet;
+
+  if(packet->host_no != TEST_HOST || frame->target_id == TEST_ABSENT) {
+    frame->cmd_status = MFI_STAT_DEVICE_NOT_FOUND;
+    return 0;
+  }
+
+  if(frame->target_id == TEST_ATA && frame->cdb[0] == SBC_ATA_PASS_THROUGH && frame->cdb[14] == ATA_IDENTIFY_DEVICE) {
+    unsigned char* buf = static_cast<unsigned char*>(packet->sgl[0].iov_base);
+    memset(buf, 0, packet->sgl[0].iov_len);
+    buf[82 * 2] = 0x01;
+    frame->cmd_status = MFI_STAT_OK;
+    return 0;
+  }
+
+  // The driver writes sense data to the user address held at sense_off
+  unsigned long address;
+  memcpy(&address, packet->frame + packet->sense_off, sizeof(address));
+  unsigned char* sense = reinterpret_cast<unsigned char*>(address);
+  memset(sense, 0, packet->sense_len);
+  sense[0] = SCSI_SENSE_FIXED_CURRENT;
+  sense[2] = SCSI_SENSE_KEY_ILLEGAL_REQUEST;
+  sense[7] = 10;
+  sense[12] = 0x20;
+
+  frame->cmd_status = MFI_STAT_SCSI_DONE_WITH_ERROR;
+  frame->scsi_status = SCSI_STATUS_CHECK_CONDITION;
+
+  return 0;
+
+}
+
+int main() {
+
+  megaraid_ioctl = fake_ioctl;
+  megaraid_node = "/dev/null";
+
+  // IDENTIFY DEVICE is tunnelled to the drive with the data buffer mapped
+  int fd = megaraid_open("/dev/null", TEST_ATA);
+  CHECK(fd != -1);
+  CHECK(sgio_handle(fd));
+
+  uint16_t identify[SECTOR_SIZE / 2];
+  memset(identify, 0xff, sizeof(identify));
+  SgioResult result = ata_identify(fd, reinterpret_cast<unsigned char*>(identify));
+  CHECK(result.ok());
+  CHECK(identify[0] == 0);
+  CHECK(reinterpret_cast<unsigned char*>(identify)[82 * 2] == 0x01);
+
+  megasas_pthru_frame* frame = reinterpret_cast<megasas_pthru_frame*>(last.frame);
+  CHECK(last.host_no == TEST_HOST);
+  CHECK(frame->cmd == MFI_CMD_PD_SCSI_IO);
+  CHECK(frame->target_id == TEST_ATA);
+  CHECK(frame->cdb_len == 16);
+  CHECK(frame->flags == MFI_FRAME_DIR_READ);
+  CHECK(frame->data_xfer_len == SECTOR_SIZE);
+  CHECK(last.sge_count == 1);
+  CHECK(last.sgl_off == offsetof(megasas_pthru_frame, sgl));
+  CHECK(last.sgl[0].iov_len == SECTOR_SIZE);
+
+  // Errors carry the drive's SCSI status and sense data
+  unsigned char inquiry[SCSI_INQUIRY_LENGTH];
+  int other = megaraid_open("/dev/null", TEST_ATA + 1);
+  CHECK(other != -1 && other != fd);
+  result = scsi_inquiry(other, false, 0, inquiry, sizeof(inquiry));
+  CHECK(!result.ok());
+  CHECK(!result.getError());
+  CHECK(result.getSenseKey() == SCSI_SENSE_KEY_ILLEGAL_REQUEST);
+  CHECK(result.getASC() == 0x20);
+
+  // An absent drive fails the command outright
+  int absent = megaraid_open("/dev/null", TEST_ABSENT);
+  result = ata_identify(absent, reinterpret_cast<unsigned char*>(identify));
+  CHECK(result.getError() == ENODEV);
+
+  // Drive numbers are a single byte
+  CHECK(megaraid_open("/dev/null", 256) == -1);
+
+  return test_failures;
+
+}
@@ -0,0 +1,259 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "metrics.h"
+#include "test.h"
+
+#include <algorithm>
+
+/*
+ * Function: listen_local
+ * ----------------------
+ * Binds a socket to an ephemeral loopback port
+ * type: SOCK_STREAM or SOCK_DGRAM
+ * port: Reference to receive the port
+ */
+static int listen_local(int type, string& port) {
+
+  int sock = socket(AF_INET, type, 0);
+
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  bind(sock, (struct sockaddr*)&address, sizeof(address));
+  if(type == SOCK_STREAM)
+    listen(sock, 4);
+
+  socklen_t length = sizeof(address);
+  getsockname(sock, (struct sockaddr*)&address, &length);
+  port = to_string(ntohs(address.sin_port));
+
+  return sock;
+
+}
+
+/*
+ * Function: receive
+ * -----------------
+ * Reads whatever is waiting on a socket
+ * sock: Socket to read
+ */
+static string receive(int sock) {
+
+  char buffer[METRICS_BATCH * 2];
+  ssize_t length = recv(sock, buffer, sizeof(buffer), MSG_DONTWAIT);
+
+  return length > 0 ? string(buffer, length) : "";
+
+}
+
+/* Sends left before the fake connection breaks, then bytes it takes of the last */
+static int sends_before_break;
+static size_t break_after;
+
+/*
+ * Function: short_send
+ * --------------------
+ * Passes sends through until the connection breaks part way through one,
+ * which takes some bytes and then fails as a reset would
+ */
+static ssize_t short_send(int sock, const void* buf, size_t len, int flags) {
+
+  if(sends_before_break-- > 0)
+    return send(sock, buf, len, flags);
+
+  if(sends_before_break == -1)
+    return send(sock, buf, min(len, break_after), flags);
+
+  metrics_send = send;
+  errno = EPIPE;
+  return -1;
+
+}
+
+int main() {
+
+  // Values come from performance data, whatever follows them is ignored
+  vector<metric> metrics = perfdata_metrics(" 5_reallocated_sectors_count=8;;;; sda_temp.max=-3;;;; bad=x;;;; =1");
+  CHECK(metrics.size() == 2);
+  CHECK(metrics[0].name == "5_reallocated_sectors_count" && metrics[0].value == 8);
+  CHECK(metrics[1].name == "sda_temp_max" && metrics[1].value == -3);
+
+  string host, port;
+  CHECK(metrics_endpoint("graphite", GRAPHITE_PORT_DEFAULT, host, port) && host == "graphite" && port == "2003");
+  CHECK(metrics_endpoint("[::1]:2004", GRAPHITE_PORT_DEFAULT, host, port) && host == "::1" && port == "2004");
+  CHECK(!metrics_endpoint("graphite:", GRAPHITE_PORT_DEFAULT, host, port));
+  CHECK(!metrics_endpoint(":2003", GRAPHITE_PORT_DEFAULT, host, port));
+
+  // Graphite batches reuse one connection
+  int server = listen_local(SOCK_STREAM, port);
+  {
+    GraphiteSink sink("127.0.0.1", port);
+    CHECK(sink.add("smart.web01.Z1Z2ABCD", metrics, 1500000000));
+    CHECK(sink.flush());
+
+    int client = accept(server, 0, 0);
+    usleep(10000);
+    CHECK(receive(client) ==
+          "smart.web01.Z1Z2ABCD.5_reallocated_sectors_count 8 1500000000\n"
+          "smart.web01.Z1Z2ABCD.sda_temp_max -3 1500000000\n");
+
+    CHECK(sink.add("smart.web01.Z1Z2ABCD", metrics, 1500000060));
+    CHECK(sink.flush());
+    usleep(10000);
+    CHECK(receive(client) ==
+          "smart.web01.Z1Z2ABCD.5_reallocated_sectors_count 8 1500000060\n"
+          "smart.web01.Z1Z2ABCD.sda_temp_max -3 1500000060\n");
+
+    // Once the server drops the connection the next batch opens another
+    close(client);
+    usleep(10000);
+    bool sent = true;
+    for(int i = 0; i < 3; i++) {
+      sent = sink.add("smart.web01.Z1Z2ABCD", metrics, 1500000120 + i) && sink.flush() && sent;
+      usleep(10000);
+    }
+    CHECK(sent);
+
+    client = accept(server, 0, 0);
+    usleep(10000);
+    CHECK(receive(client).find("1500000122\n") != string::npos);
+    close(client);
+  }
+
+  // A connection broken part way through a line drops what is left of it
+  // rather than sending its tail as a line of its own
+  {
+    GraphiteSink sink("127.0.0.1", port);
+    sends_before_break = 0;
+    break_after = 10;
+    metrics_send = short_send;
+    CHECK(sink.add("smart.web01.Z1Z2ABCD", metrics, 1500000180));
+    CHECK(sink.flush());
+    CHECK(metrics_send == send);
+
+    int client = accept(server, 0, 0);
+    usleep(10000);
+    CHECK(receive(client) == "smart.web0");
+    close(client);
+
+    client = accept(server, 0, 0);
+    usleep(10000);
+    CHECK(receive(client) == "smart.web01.Z1Z2ABCD.sda_temp_max -3 1500000180\n");
+
+    // Cut at the end of a line nothing more is lost
+    sends_before_break = 0;
+    break_after = strlen("smart.web01.Z1Z2ABCD.5_reallocated_sectors_count 8 1500000240\n");
+    metrics_send = short_send;
+    CHECK(sink.add("smart.web01.Z1Z2ABCD", metrics, 1500000240));
+    CHECK(sink.flush());
+
+    usleep(10000);
+    CHECK(receive(client) == "smart.web01.Z1Z2ABCD.5_reallocated_sectors_count 8 1500000240\n");
+    close(client);
+
+    client = accept(server, 0, 0);
+    usleep(10000);
+    CHECK(receive(client) == "smart.web01.Z1Z2ABCD.sda_temp_max -3 1500000240\n");
+    close(client);
+  }
+  close(server);
+
+  // Nothing listening is reported rather than losing the batch silently
+  {
+    GraphiteSink sink("127.0.0.1", port);
+    CHECK(sink.add("smart.web01.Z1Z2ABCD", metrics, 1500000000));
+    CHECK(!sink.flush());
+  }
+
+  // A server that never answers is given up on rather than stalling the
+  // checks, its full accept queue drops the connection request
+  server = listen_local(SOCK_STREAM, port);
+  listen(server, 0);
+  {
+    GraphiteSink first("127.0.0.1", port), second("127.0.0.1", port);
+    CHECK(first.add("smart.web01.Z1Z2ABCD", metrics, 1500000000));
+    CHECK(first.flush());
+
+    time_t start = time(0);
+    CHECK(second.add("smart.web01.Z1Z2ABCD", metrics, 1500000000));
+    CHECK(!second.flush() && errno == ETIMEDOUT);
+    CHECK(time(0) - start <= 2 * METRICS_TIMEOUT / 1000 + 1);
+  }
+  close(server);
+
+  // StatsD gauges are packed into datagrams no larger than the limit
+  server = listen_local(SOCK_DGRAM, port);
+  {
+    StatsdSink sink("127.0.0.1", port);
+    CHECK(sink.add("smart.web01.Z1Z2ABCD", metrics, 0));
+    CHECK(sink.flush());
+    usleep(10000);
+    CHECK(receive(server) ==
+          "smart.web01.Z1Z2ABCD.5_reallocated_sectors_count:8|g\n"
+          "smart.web01.Z1Z2ABCD.sda_temp_max:0|g\n"
+          "smart.web01.Z1Z2ABCD.sda_temp_max:-3|g");
+
+    vector<metric> many;
+    for(int i = 0; i < 200; i++) {
+      metric m;
+      m.name = "attribute_" + to_string(i);
+      m.value = i;
+      many.push_back(m);
+    }
+    CHECK(sink.add("smart.web01.Z1Z2ABCD", many, 0));
+    CHECK(sink.flush());
+    usleep(10000);
+
+    int lines = 0;
+    int datagrams = 0;
+    for(string datagram; !(datagram = receive(server)).empty(); datagrams++) {
+      CHECK(datagram.size() <= METRICS_DATAGRAM);
+      lines += count(datagram.begin(), datagram.end(), '\n') + 1;
+    }
+    CHECK(lines == 200);
+    CHECK(datagrams > 1 && datagrams < 200);
+
+    // Datagrams go through the same hook, so a failed send is reported
+    sends_before_break = -1;
+    metrics_send = short_send;
+    CHECK(sink.add("smart.web01.Z1Z2ABCD", metrics, 0));
+    CHECK(!sink.flush() && errno == EPIPE);
+    CHECK(metrics_send == send);
+    CHECK(receive(server).empty());
+  }
+  close(server);
+
+  return test_failures;
+
+}
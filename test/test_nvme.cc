@@ -0,0 +1,141 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <sys/ioctl.h>
+#include <linux/nvme_ioctl.h>
+
+#include "nvme.h"
+#include "test.h"
+
+/* Status returned by the fake controller for an unsupported log page */
+const int TEST_INVALID_LOG = 0x109;
+
+/* Last command seen by the fake controller */
+static nvme_admin_cmd last;
+
+/*
+ * Function: fake_ioctl
+ * --------------------
+ * Stands in for the NVMe driver, answering Identify Controller and the
+ * SMART / Health Information log
+ */
+static int fake_ioctl(int fd, unsigned long request, void* arg) {
+
+  if(request != NVME_IOCTL_ADMIN_CMD) {
+    errno = ENOTTY;
+    return -1;
+  }
+
+  nvme_admin_cmd* cmd = static_cast<nvme_admin_cmd*>(arg);
+  last = *cmd;
+
+  unsigned char* buf = reinterpret_cast<unsigned char*>(static_cast<uintptr_t>(cmd->addr));
+  memset(buf, 0, cmd->data_len);
+
+  if(cmd->opcode == NVME_ADMIN_IDENTIFY) {
+    nvme_id_ctrl* id = reinterpret_cast<nvme_id_ctrl*>(buf);
+    memcpy(id->sn, "S3EVNX0K123456      ", sizeof(id->sn));
+    id->wctemp = 273 + 77;
+    id->cctemp = 273 + 82;
+    return 0;
+  }
+
+  if(cmd->opcode == NVME_ADMIN_GET_LOG_PAGE && (cmd->cdw10 & 0xff) == NVME_LOG_SMART) {
+    nvme_smart_log* log = reinterpret_cast<nvme_smart_log*>(buf);
+    log->temperature = 273 + 37;
+    log->media_errors[0] = 5;
+    log->power_on_hours[0] = 0x34;
+    log->power_on_hours[1] = 0x12;
+    log->data_units_read[8] = 1;
+    return 0;
+  }
+
+  return TEST_INVALID_LOG;
+
+}
+
+int main() {
+
+  nvme_ioctl = fake_ioctl;
+
+  // Identify Controller selects the controller structure
+  nvme_id_ctrl id;
+  NvmeResult result = nvme_identify_controller(-1, id);
+  CHECK(result.ok());
+  CHECK(last.opcode == NVME_ADMIN_IDENTIFY);
+  CHECK(last.cdw10 == NVME_IDENTIFY_CNS_CONTROLLER);
+  CHECK(last.data_len == NVME_IDENTIFY_SIZE);
+  CHECK(!memcmp(id.sn, "S3EVNX0K123456", 14));
+
+  // Kelvin converts to Celsius, zero means unreported
+  int celsius = 0;
+  CHECK(nvme_temperature(id.wctemp, celsius) && celsius == 77);
+  CHECK(nvme_temperature(273, celsius) && celsius == 0);
+  CHECK(!nvme_temperature(0, celsius));
+
+  // A 512 byte log is 128 dwords, zero based in the upper half of cdw10
+  nvme_smart_log log;
+  result = nvme_get_log_page(-1, NVME_LOG_SMART, NVME_NSID_ALL, reinterpret_cast<unsigned char*>(&log), sizeof(log));
+  CHECK(result.ok());
+  CHECK(last.opcode == NVME_ADMIN_GET_LOG_PAGE);
+  CHECK(last.nsid == NVME_NSID_ALL);
+  CHECK(last.cdw10 == (NVME_LOG_SMART | (127u << 16)));
+  CHECK(last.cdw11 == 0);
+  CHECK(nvme_temperature(log.temperature, celsius) && celsius == 37);
+  CHECK(nvme_counter(log.media_errors) == 5);
+  CHECK(nvme_counter(log.power_on_hours) == 0x1234);
+
+  // Counters beyond 64 bits saturate rather than wrap
+  CHECK(nvme_counter(log.data_units_read) == INT64_MAX);
+  uint8_t counter[16];
+  memset(counter, 0, sizeof(counter));
+  memset(counter, 0xff, 8);
+  CHECK(nvme_counter(counter) == INT64_MAX);
+  counter[7] = 0x7f;
+  CHECK(nvme_counter(counter) == INT64_MAX);
+  counter[0] = 0xfe;
+  CHECK(nvme_counter(counter) == INT64_MAX - 1);
+
+  // Transfers over 64K dwords carry the upper bits in cdw11
+  uint32_t len = (0x10000 + 1) * 4;
+  unsigned char* big = new unsigned char[len];
+  result = nvme_get_log_page(-1, 0xc0, 1, big, len);
+  CHECK(last.cdw10 == 0xc0);
+  CHECK(last.cdw11 == 1);
+  delete [] big;
+
+  // Controller status and ioctl failures are told apart
+  CHECK(!result.ok());
+  CHECK(!result.getError());
+
+  nvme_ioctl = [](int, unsigned long, void*) { errno = ENOTTY; return -1; };
+  result = nvme_identify_controller(-1, id);
+  CHECK(!result.ok());
+  CHECK(result.getError() == ENOTTY);
+
+  return test_failures;
+
+}
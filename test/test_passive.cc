@@ -0,0 +1,181 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "passive.h"
+#include "test.h"
+
+#include <fstream>
+#include <sstream>
+
+/* Sizes of the writes made, and how many may succeed */
+static vector<size_t> writes;
+static size_t writes_allowed;
+
+/*
+ * Function: fake_write
+ * --------------------
+ * Records the size of each write, failing those beyond the allowance
+ */
+static ssize_t fake_write(int fd, const void* buf, size_t count) {
+
+  if(writes.size() == writes_allowed) {
+    errno = EAGAIN;
+    return -1;
+  }
+
+  writes.push_back(count);
+
+  return count;
+
+}
+
+int main() {
+
+  vector<passive_result> results(2);
+  results[0].timestamp = 1500000000;
+  results[0].host = "web01";
+  results[0].service = "SMART wwn-0x5000c500a1b2c3d4";
+  results[0].code = 2;
+  results[0].output = "CRITICAL: prdfail 1 | reallocated_sectors_count=8;;;;";
+  results[1].timestamp = 1500000001;
+  results[1].host = "web01";
+  results[1].service = "SMART ST4000DM000_Z300MZ7D";
+  results[1].code = 0;
+  results[1].output = "OK: prdfail 0\nforged\tline";
+
+  // Line breaks can't start another command or result
+  CHECK(passive_external_commands(results) ==
+        "[1500000000] PROCESS_SERVICE_CHECK_RESULT;web01;SMART wwn-0x5000c500a1b2c3d4;2;"
+        "CRITICAL: prdfail 1 | reallocated_sectors_count=8;;;;\n"
+        "[1500000001] PROCESS_SERVICE_CHECK_RESULT;web01;SMART ST4000DM000_Z300MZ7D;0;OK: prdfail 0 forged\tline\n");
+
+  CHECK(passive_nsca(results) ==
+        "web01\tSMART wwn-0x5000c500a1b2c3d4\t2\tCRITICAL: prdfail 1 | reallocated_sectors_count=8;;;;\n"
+        "web01\tSMART ST4000DM000_Z300MZ7D\t0\tOK: prdfail 0 forged line\n");
+
+  // Long output is cut to fit a line in PIPE_BUF, losing only whole labels
+  // of performance data
+  vector<passive_result> large(1, results[0]);
+  large[0].output = "CRITICAL: prdfail 1 |";
+  for(int i = 0; large[0].output.size() < 2 * PIPE_BUF; i++)
+    large[0].output += " label_" + to_string(i) + "=" + to_string(i * 7919) + ";;;;";
+
+  string line = passive_external_commands(large);
+  CHECK(line.size() <= PIPE_BUF);
+  CHECK(line.size() > PIPE_BUF - 32);
+  CHECK(line.find('\n') == line.size() - 1);
+  CHECK(line.compare(line.size() - 5, 5, ";;;;\n") == 0);
+  string kept = line.substr(line.find("CRITICAL"), line.size() - line.find("CRITICAL") - 1);
+  CHECK(large[0].output.compare(0, kept.size(), kept) == 0 && large[0].output[kept.size()] == ' ');
+
+  // Status text alone is simply cut
+  large[0].output = string(2 * PIPE_BUF, 'x');
+  CHECK(passive_external_commands(large).size() == PIPE_BUF);
+
+  // Performance data with no whole label left goes, bar and all
+  large[0].output = "CRITICAL: prdfail 1 | " + string(2 * PIPE_BUF, 'x') + "=1;;;;";
+  line = passive_external_commands(large);
+  CHECK(line.compare(line.size() - 21, 21, ";CRITICAL: prdfail 1\n") == 0);
+
+  char temp[] = "/tmp/test_passive.XXXXXX";
+  CHECK(mkdtemp(temp));
+
+  // Each command is written by itself
+  string file = string(temp) + "/commands";
+  ofstream(file.c_str()).close();
+  passive_write_fd = fake_write;
+  writes_allowed = 3;
+  results.push_back(large[0]);
+  string commands = passive_external_commands(results);
+  CHECK(passive_write(file, commands));
+  CHECK(writes.size() == 3);
+  size_t total = 0;
+  for(size_t i = 0; i < writes.size(); i++) {
+    CHECK(writes[i] <= PIPE_BUF);
+    CHECK(commands[total + writes[i] - 1] == '\n');
+    total += writes[i];
+  }
+  CHECK(total == commands.size());
+
+  // A write failing part way is reported
+  writes.clear();
+  writes_allowed = 1;
+  CHECK(!passive_write(file, commands));
+  CHECK(errno == EAGAIN);
+  CHECK(writes.size() == 1);
+
+  passive_write_fd = write;
+  results.pop_back();
+
+  string fifo = string(temp) + "/nagios.cmd";
+  CHECK(mkfifo(fifo.c_str(), 0600) == 0);
+
+  // A command file nobody is reading fails rather than hanging the sweep
+  CHECK(!passive_write(fifo, "lost\n"));
+  CHECK(errno == ENXIO);
+
+  // Otherwise the whole buffer arrives, even beyond the pipe's capacity
+  string buffer;
+  for(int i = 0; i < 2000; i++)
+    buffer += passive_external_commands(results);
+
+  string output = string(temp) + "/received";
+  pid_t pid = fork();
+  if(!pid) {
+    // _exit skips destructors, so the output is flushed by closing it first
+    {
+      ifstream in(fifo.c_str());
+      ofstream out(output.c_str());
+      out << in.rdbuf();
+    }
+    _exit(0);
+  }
+
+  // Wait for the reader to open its end
+  bool written = false;
+  for(int i = 0; i < 100 && !written; i++) {
+    written = passive_write(fifo, buffer);
+    if(!written)
+      usleep(10000);
+  }
+  CHECK(written);
+  waitpid(pid, 0, 0);
+
+  ifstream in(output.c_str());
+  stringstream received;
+  received << in.rdbuf();
+  CHECK(received.str() == buffer);
+
+  string command = "rm -rf " + string(temp);
+  CHECK(system(command.c_str()) == 0);
+
+  return test_failures;
+
+}
@@ -0,0 +1,138 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "check.h"
+#include "phy.h"
+#include "sgio.h"
+#include "test.h"
+#include "fake_ata.h"
+
+#include <sstream>
+#include <string>
+
+/*
+ * Function: put_counter
+ * ---------------------
+ * Appends a counter of a number of words to the log page
+ */
+static void put_counter(vector<unsigned char>& page, int& offset, uint16_t id, int words, uint64_t value) {
+
+  uint16_t header = id | (words << PHY_EVENT_SIZE_SHIFT);
+  page[offset++] = header;
+  page[offset++] = header >> 8;
+
+  for(int i = 0; i < words * 2; i++)
+    page[offset++] = value >> (i * 8);
+
+}
+
+/*
+ * Function: check
+ * ---------------
+ * Checks the fake drive, returning the Nagios code
+ */
+static int check(int fd, const CheckOptions& options, string& out, string& perf) {
+
+  sg_device device;
+  device.node = "fake";
+  device.device_class = DEVICE_CLASS_ATA;
+
+  stringstream out_stream, perf_stream;
+  int code = check_open_device(fd, device, options, "", out_stream, perf_stream);
+
+  out = out_stream.str();
+  perf = perf_stream.str();
+
+  return code;
+
+}
+
+int main() {
+
+  char temp[] = "/tmp/test_phy.XXXXXX";
+  CHECK(mkdtemp(temp));
+
+  // Standard counters of each size, one we don't report and a vendor one
+  vector<unsigned char> page(SECTOR_SIZE);
+  int offset = PHY_EVENT_FIRST;
+  put_counter(page, offset, 0x001, 2, 12);
+  put_counter(page, offset, 0x00a, 1, 3);
+  put_counter(page, offset, 0x00c, 1, 5);
+  put_counter(page, offset, 0x009 | PHY_EVENT_VENDOR_FLAG, 1, 9);
+  put_counter(page, offset, 0x00b, 4, 0x100000000ULL);
+  fake_ata_sum(&page[0]);
+
+  fake_ata_logs[ATA_LOG_ADDRESS_SATA_PHY] = page;
+
+  int fd = sgio_register(fake_ata, 0);
+
+  CheckOptions options;
+  options.state_dir = temp;
+  options.phy_events = true;
+  options.warning_named["phy_icrc_errors"] = 10;
+
+  string out, perf;
+
+  CHECK(check(fd, options, out, perf) == NAGIOS_CRITICAL);
+  CHECK(out == "CRITICAL: prdfail 1, advisory 0, critical 0, warning 1, logs 0, "
+               "model FAKE DRIVE, serial FAKE0001, firmware 1.0");
+
+  CHECK(fake_ata_reads.size() == 1);
+  CHECK(fake_ata_reads[0].log == ATA_LOG_ADDRESS_SATA_PHY && fake_ata_reads[0].count == 1);
+  CHECK(fake_ata_reads[0].features == 0);
+
+  CHECK(perf.find(" phy_icrc_errors=12;10;;;") != string::npos);
+  CHECK(perf.find(" phy_comreset_register_fis=3;;;;") != string::npos);
+  CHECK(perf.find(" phy_h2d_fis_crc_errors=4294967296;;;;") != string::npos);
+  CHECK(perf.find("phy_rdy_to_nrdy_transitions") == string::npos);
+  CHECK(perf.find("=5;") == string::npos);
+
+  // Resetting asks the drive to clear the counters as they are read
+  options.phy_reset = true;
+  fake_ata_reads.clear();
+  CHECK(check(fd, options, out, perf) == NAGIOS_CRITICAL);
+  CHECK(fake_ata_reads.size() == 1 && fake_ata_reads[0].features == PHY_EVENT_FEATURE_RESET);
+
+  // A corrupt page is read again, unless reading it reset the counters
+  fake_ata_logs[ATA_LOG_ADDRESS_SATA_PHY][SECTOR_SIZE - 1]++;
+
+  fake_ata_reads.clear();
+  CHECK(check(fd, options, out, perf) == NAGIOS_UNKNOWN);
+  CHECK(out == "UNKNOWN: READ LOG EXT SATA phy event counters failed: invalid checksum");
+  CHECK(fake_ata_reads.size() == 1);
+
+  options.phy_reset = false;
+  fake_ata_reads.clear();
+  CHECK(check(fd, options, out, perf) == NAGIOS_UNKNOWN);
+  CHECK(fake_ata_reads.size() == 1 + ATA_CHECKSUM_RETRIES);
+
+  string command = "rm -rf " + string(temp);
+  CHECK(system(command.c_str()) == 0);
+
+  return test_failures;
+
+}
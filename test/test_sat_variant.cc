@@ -0,0 +1,215 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ata.h"
+#include "check.h"
+#include "sgio.h"
+#include "state.h"
+#include "test.h"
+#include "fake_ata.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+/* ATA PASS-THROUGH variants the bridge accepts */
+static vector<uint8_t> accepted;
+
+/* ATA PASS-THROUGH variants sent, in order */
+static vector<uint8_t> sent;
+
+/*
+ * Function: reject
+ * ----------------
+ * Rejects ATA PASS-THROUGH in any variant the bridge doesn't accept,
+ * recording the variant of each
+ */
+static bool reject(const unsigned char* cdb, int len) {
+
+  if(cdb[0] != SBC_ATA_PASS_THROUGH && cdb[0] != SBC_ATA_PASS_THROUGH_12)
+    return false;
+
+  uint8_t variant = SAT_VARIANT_DEFAULT;
+  if(cdb[0] == SBC_ATA_PASS_THROUGH_12)
+    variant |= SAT_VARIANT_12;
+  if(cdb[2] & 0x20)
+    variant |= SAT_VARIANT_CK_COND;
+  if(cdb[2] & 0x10)
+    variant |= SAT_VARIANT_T_TYPE;
+
+  sent.push_back(variant);
+
+  return find(accepted.begin(), accepted.end(), variant) == accepted.end();
+
+}
+
+/*
+ * Function: bridge
+ * ----------------
+ * Sets up the bridge for a case
+ * serial: Unit serial number of the bridge, empty for none
+ * variant: The only variant accepted, SAT_VARIANT_NONE for none
+ */
+static void bridge(const char* serial, uint8_t variant) {
+
+  fake_ata_bridge_serial = serial;
+  fake_ata_type = SCSI_TYPE_DIRECT_ACCESS;
+
+  accepted.clear();
+  if(variant != SAT_VARIANT_NONE)
+    accepted.push_back(variant);
+
+}
+
+/*
+ * Function: identify
+ * ------------------
+ * Reads IDENTIFY DEVICE data through the bridge, returning whether the ATA
+ * command set is available and recording the variants and number of
+ * commands sent
+ */
+static bool identify(int fd, const string& state_dir, int& commands) {
+
+  uint16_t buf[SECTOR_SIZE / 2];
+  SgioResult sgio_result;
+
+  sent.clear();
+  fake_ata_commands = 0;
+  bool ata = identify_device(fd, buf, state_dir, sgio_result);
+  commands = fake_ata_commands;
+
+  CHECK(!sgio_result.getError());
+
+  return ata;
+
+}
+
+/*
+ * Function: cached
+ * ----------------
+ * Returns the variant cached for a bridge, or -1 if there is none
+ */
+static int cached(const string& state_dir, const string& identity) {
+
+  StateFile cache(state_path(state_dir, STATE_SAT_VARIANTS));
+  uint64_t variant;
+  if(!cache.load() || !cache.get(identity, variant))
+    return -1;
+
+  return variant;
+
+}
+
+int main() {
+
+  char temp[] = "/tmp/test_sat_variant.XXXXXX";
+  CHECK(mkdtemp(temp));
+
+  fake_ata_reject = reject;
+  int fd = sgio_register(fake_ata, 0);
+  int commands;
+
+  // A bridge taking the default form isn't even asked who it is
+  bridge("DEFAULT", SAT_VARIANT_DEFAULT);
+  CHECK(identify(fd, temp, commands));
+  CHECK(commands == 1);
+  CHECK(cached(temp, "FAKE_BRIDGE_DEFAULT") == -1);
+
+  // Rejecting the 16-byte form falls back to the 12-byte one, after asking
+  // for the identity and the device type
+  bridge("TWELVE", SAT_VARIANT_12);
+  CHECK(identify(fd, temp, commands));
+  CHECK(commands == 5);
+  CHECK(sent == vector<uint8_t>({ SAT_VARIANT_DEFAULT, SAT_VARIANT_12 }));
+  CHECK(ata_get_sat_variant(fd) == SAT_VARIANT_12);
+  CHECK(cached(temp, "FAKE_BRIDGE_TWELVE") == SAT_VARIANT_12);
+
+  // The cache goes straight to it without probing
+  CHECK(identify(fd, temp, commands));
+  CHECK(commands == 4);
+  CHECK(sent == vector<uint8_t>({ SAT_VARIANT_DEFAULT, SAT_VARIANT_12 }));
+  CHECK(ata_get_sat_variant(fd) == SAT_VARIANT_12);
+
+  // CK_COND completes with sense holding the registers, which still counts
+  bridge("CK_COND", SAT_VARIANT_CK_COND);
+  CHECK(identify(fd, temp, commands));
+  CHECK(sent == vector<uint8_t>({ SAT_VARIANT_DEFAULT, SAT_VARIANT_12, SAT_VARIANT_CK_COND }));
+  CHECK(ata_get_sat_variant(fd) == SAT_VARIANT_CK_COND);
+  CHECK(cached(temp, "FAKE_BRIDGE_CK_COND") == SAT_VARIANT_CK_COND);
+
+  bridge("TWELVE_CK_COND", SAT_VARIANT_12 | SAT_VARIANT_CK_COND);
+  CHECK(identify(fd, temp, commands));
+  CHECK(sent.size() == 4 && sent.back() == (SAT_VARIANT_12 | SAT_VARIANT_CK_COND));
+  CHECK(ata_get_sat_variant(fd) == (SAT_VARIANT_12 | SAT_VARIANT_CK_COND));
+  CHECK(cached(temp, "FAKE_BRIDGE_TWELVE_CK_COND") == (SAT_VARIANT_12 | SAT_VARIANT_CK_COND));
+
+  // Nothing working is cached too, so the next check gives up after the
+  // default form and the identity
+  bridge("NONE", SAT_VARIANT_NONE);
+  CHECK(!identify(fd, temp, commands));
+  CHECK(sent.size() == static_cast<size_t>(sat_variant_num));
+  CHECK(ata_get_sat_variant(fd) == SAT_VARIANT_DEFAULT);
+  CHECK(cached(temp, "FAKE_BRIDGE_NONE") == SAT_VARIANT_NONE);
+
+  CHECK(!identify(fd, temp, commands));
+  CHECK(commands == 3);
+  CHECK(sent == vector<uint8_t>({ SAT_VARIANT_DEFAULT }));
+  CHECK(ata_get_sat_variant(fd) == SAT_VARIANT_DEFAULT);
+
+  // Anything but a block device is never probed
+  bridge("OPTICAL", SAT_VARIANT_12);
+  fake_ata_type = 0x05;
+  CHECK(!identify(fd, temp, commands));
+  CHECK(sent == vector<uint8_t>({ SAT_VARIANT_DEFAULT }));
+
+  // A bridge with no identity can't be cached so is probed every time
+  bridge("", SAT_VARIANT_12);
+  CHECK(identify(fd, temp, commands));
+  CHECK(commands == 5);
+  CHECK(identify(fd, temp, commands));
+  CHECK(commands == 5);
+  CHECK(sent == vector<uint8_t>({ SAT_VARIANT_DEFAULT, SAT_VARIANT_12 }));
+
+  // Devices behind different bridges each keep their own variant, until
+  // closed so a reused descriptor starts from the default
+  int other = sgio_register(fake_ata, 0);
+  bridge("TWELVE", SAT_VARIANT_12);
+  CHECK(identify(fd, temp, commands));
+  bridge("CK_COND", SAT_VARIANT_CK_COND);
+  CHECK(identify(other, temp, commands));
+  CHECK(ata_get_sat_variant(fd) == SAT_VARIANT_12);
+  CHECK(ata_get_sat_variant(other) == SAT_VARIANT_CK_COND);
+  close_device(other);
+  CHECK(ata_get_sat_variant(other) == SAT_VARIANT_DEFAULT);
+  CHECK(ata_get_sat_variant(fd) == SAT_VARIANT_12);
+
+  string command = "rm -rf " + string(temp);
+  CHECK(system(command.c_str()) == 0);
+
+  return test_failures;
+
+}
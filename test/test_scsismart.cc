@@ -0,0 +1,139 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "scsismart.h"
+#include "sgio.h"
+#include "test.h"
+#include "fake_ata.h"
+
+#include <stdexcept>
+#include <string>
+
+/*
+ * Function: throwing
+ * ------------------
+ * A target whose every command fails with an exception the library
+ * doesn't expect
+ */
+static int throwing(int, sg_io_hdr_t&) {
+
+  throw out_of_range("throwing");
+
+}
+
+int main() {
+
+  char temp[] = "/tmp/test_scsismart.XXXXXX";
+  CHECK(mkdtemp(temp));
+
+  CHECK(scsismart_abi_version() == SCSISMART_ABI_VERSION);
+
+  scsismart_device device;
+  device.fd = sgio_register(fake_ata, 0);
+  strcpy(device.node, "fake");
+
+  scsismart_options options;
+  scsismart_options_init(&options);
+  options.state_dir = temp;
+
+  // A result not sized by the caller is rejected before the drive is touched
+  scsismart_result result;
+  memset(&result, 0, sizeof(result));
+  CHECK(scsismart_check(&device, &options, &result) == -1 && errno == EINVAL);
+  CHECK(fake_ata_commands == 0);
+
+  result.size = sizeof(result);
+  options.warning = "bogus";
+  CHECK(scsismart_check(&device, &options, &result) == -1 && errno == EINVAL);
+
+  // The failing prefail attribute is critical, everything read is returned
+  options.warning = "194:30";
+  CHECK(scsismart_check(&device, &options, &result) == SCSISMART_CRITICAL);
+  CHECK(result.code == SCSISMART_CRITICAL);
+  CHECK(!strcmp(result.status, "CRITICAL: prdfail 1, advisory 0, critical 0, warning 1, logs 0, "
+                               "model FAKE DRIVE, serial FAKE0001, firmware 1.0"));
+  CHECK(!strcmp(result.key, "FAKE_DRIVE_FAKE0001"));
+  CHECK(!strcmp(result.identity, "model FAKE DRIVE, serial FAKE0001, firmware 1.0"));
+
+  CHECK(result.attributes_num == FAKE_ATA_ATTRIBUTES);
+  CHECK(result.attributes[1].id == 5 && result.attributes[1].value == 5 && result.attributes[1].raw == 8);
+  CHECK(result.attributes[1].threshold == FAKE_ATA_THRESHOLD && result.attributes[1].prefail);
+
+  // Fields of the first version stay where callers built against it expect
+  CHECK(offsetof(scsismart_attribute, threshold) == 10 && offsetof(scsismart_attribute, prefail) == 11);
+  CHECK(sizeof(scsismart_attribute) == 16);
+
+  CHECK(result.values_num == FAKE_ATA_ATTRIBUTES + 1 && !result.values_dropped);
+  CHECK(!strcmp(result.values[3].label, "194_temperature") && result.values[3].value == 35);
+  CHECK(!strcmp(result.values[4].label, "checksum_errors") && result.values[4].value == 0);
+
+  // Options and results too small for any version of the header are rejected
+  options.size = offsetof(scsismart_options, state_dir);
+  CHECK(scsismart_check(&device, &options, &result) == -1 && errno == EINVAL);
+  options.size = sizeof(options);
+  result.size = offsetof(scsismart_result, values);
+  CHECK(scsismart_check(&device, &options, &result) == -1 && errno == EINVAL);
+
+  // A caller built against a later header keeps the fields it added
+  struct {
+    scsismart_result result;
+    char later[16];
+  } larger;
+  memset(&larger, 0xff, sizeof(larger));
+  larger.result.size = sizeof(larger);
+  CHECK(scsismart_check(&device, &options, &larger.result) == SCSISMART_CRITICAL);
+  CHECK(larger.result.size == sizeof(scsismart_result));
+  CHECK(larger.result.values_num == FAKE_ATA_ATTRIBUTES + 1);
+  CHECK(static_cast<unsigned char>(larger.later[0]) == 0xff &&
+        static_cast<unsigned char>(larger.later[sizeof(larger.later) - 1]) == 0xff);
+
+  uint16_t identify[SCSISMART_IDENTIFY_WORDS];
+  CHECK(scsismart_identify(&device, temp, identify) == 0);
+  CHECK(identify[82] & 0x01);
+
+  scsismart_close(&device);
+  CHECK(device.fd == -1);
+
+  // No exception unwinds into a C caller
+  device.fd = sgio_register(throwing, 0);
+  result.size = sizeof(result);
+  CHECK(scsismart_identify(&device, temp, identify) == -1 && errno == EIO);
+  CHECK(scsismart_check(&device, &options, &result) == -1 && errno == EIO);
+  scsismart_close(&device);
+
+  // Opening a missing node reports why
+  CHECK(scsismart_open(&device, "/dev/nonexistent") == -1 && errno == ENOENT);
+
+  string command = "rm -rf " + string(temp);
+  CHECK(system(command.c_str()) == 0);
+
+  return test_failures;
+
+}
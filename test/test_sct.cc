@@ -0,0 +1,151 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "check.h"
+#include "sct.h"
+#include "sgio.h"
+#include "state.h"
+#include "test.h"
+#include "fake_ata.h"
+
+#include <sstream>
+#include <string>
+
+/* State key of the fake drive */
+const char* const TEST_KEY = "FAKE_DRIVE_FAKE0001";
+
+/*
+ * Function: check
+ * ---------------
+ * Checks the fake drive, returning the Nagios code
+ */
+static int check(int fd, const CheckOptions& options, string& out, string& perf) {
+
+  sg_device device;
+  device.node = "fake";
+  device.device_class = DEVICE_CLASS_ATA;
+
+  stringstream out_stream, perf_stream;
+  int code = check_open_device(fd, device, options, "", out_stream, perf_stream);
+
+  out = out_stream.str();
+  perf = perf_stream.str();
+
+  return code;
+
+}
+
+/*
+ * Function: checked_ago
+ * ---------------------
+ * Backdates the last temperature history check
+ */
+static void checked_ago(const string& dir, int seconds) {
+
+  StateFile state(state_path(dir, TEST_KEY));
+  CHECK(state.load());
+  state.set("sct_temperature_time", time(0) - seconds);
+  CHECK(state.save());
+
+}
+
+int main() {
+
+  char temp[] = "/tmp/test_sct.XXXXXX";
+  CHECK(mkdtemp(temp));
+
+  // Ten samples a minute apart, the most recent at index 3 and the two
+  // oldest never taken
+  const int8_t samples[] = { 30, 31, 32, 65, 20, 20, 20, 20, SCT_TEMPERATURE_INVALID, SCT_TEMPERATURE_INVALID };
+
+  sct_temperature_history history;
+  memset(&history, 0, sizeof(history));
+  history.interval = 1;
+  history.max_op_limit = 60;
+  history.size = sizeof(samples);
+  history.index = 3;
+  memcpy(history.samples, samples, sizeof(samples));
+
+  unsigned char* buf = reinterpret_cast<unsigned char*>(&history);
+  fake_ata_logs[ATA_LOG_ADDRESS_SCT_DATA].assign(buf, buf + SECTOR_SIZE);
+
+  int fd = sgio_register(fake_ata, 0);
+
+  CheckOptions options;
+  options.state_dir = temp;
+
+  string out, perf;
+
+  // Not asked for, not read
+  CHECK(check(fd, options, out, perf) == NAGIOS_CRITICAL);
+  CHECK(perf.find("sct_temperature") == string::npos);
+  CHECK(fake_ata_written.empty());
+
+  // The first check covers the whole table, skipping samples not taken
+  options.temperature_history = true;
+  CHECK(check(fd, options, out, perf) == NAGIOS_CRITICAL);
+  CHECK(perf.find(" sct_temperature=65;;;;") != string::npos);
+  CHECK(perf.find(" sct_temperature_min=20;;;;") != string::npos);
+  CHECK(perf.find(" sct_temperature_max=65;;;;") != string::npos);
+  CHECK(perf.find(" sct_temperature_samples=8;;;;") != string::npos);
+
+  // The table is requested through the SCT command log
+  const vector<unsigned char>& written = fake_ata_written[ATA_LOG_ADDRESS_SCT_COMMAND];
+  CHECK(written.size() == SECTOR_SIZE);
+  if(written.size() == SECTOR_SIZE) {
+    const sct_command* command = reinterpret_cast<const sct_command*>(&written[0]);
+    CHECK(command->action_code == SCT_ACTION_DATA_TABLE);
+    CHECK(command->function_code == SCT_FUNCTION_READ_TABLE);
+    CHECK(command->table_id == SCT_TABLE_TEMPERATURE_HISTORY);
+  }
+
+  // Checking again straight away only covers the latest sample
+  CHECK(check(fd, options, out, perf) == NAGIOS_CRITICAL);
+  CHECK(perf.find(" sct_temperature_min=65;;;;") != string::npos);
+  CHECK(perf.find(" sct_temperature_samples=1;;;;") != string::npos);
+
+  // Three minutes on covers the samples since, plus the one straddling the
+  // last check
+  checked_ago(temp, 3 * 60);
+  CHECK(check(fd, options, out, perf) == NAGIOS_CRITICAL);
+  CHECK(perf.find(" sct_temperature_min=30;;;;") != string::npos);
+  CHECK(perf.find(" sct_temperature_max=65;;;;") != string::npos);
+  CHECK(perf.find(" sct_temperature_samples=4;;;;") != string::npos);
+
+  // An index outside the table yields nothing
+  history.index = history.size;
+  fake_ata_logs[ATA_LOG_ADDRESS_SCT_DATA].assign(buf, buf + SECTOR_SIZE);
+  CHECK(check(fd, options, out, perf) == NAGIOS_CRITICAL);
+  CHECK(perf.find("sct_temperature") == string::npos);
+
+  string command = "rm -rf " + string(temp);
+  CHECK(system(command.c_str()) == 0);
+
+  return test_failures;
+
+}
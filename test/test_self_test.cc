@@ -0,0 +1,178 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "check.h"
+#include "smart.h"
+#include "sgio.h"
+#include "test.h"
+#include "fake_ata.h"
+
+#include <sstream>
+#include <string>
+
+/* Power on hours of the fake drive, attribute 9 */
+const uint16_t TEST_HOURS = 23052;
+
+/*
+ * Function: put_test
+ * ------------------
+ * Stores a result in the SMART self-test log
+ */
+static void put_test(smart_self_test_log& log, int slot, uint8_t type, uint8_t status, uint16_t timestamp) {
+
+  log.descriptors[slot].subcommand = type;
+  log.descriptors[slot].status = status << 4;
+  log.descriptors[slot].timestamp = timestamp;
+
+}
+
+/*
+ * Function: hold_log
+ * ------------------
+ * Gives the fake drive a log, completing its checksum
+ */
+template<class Log>
+static void hold_log(uint8_t address, Log& log) {
+
+  unsigned char* buf = reinterpret_cast<unsigned char*>(&log);
+  fake_ata_sum(buf);
+  fake_ata_logs[address].assign(buf, buf + sizeof(log));
+
+}
+
+/*
+ * Function: check
+ * ---------------
+ * Checks the fake drive, returning the Nagios code
+ */
+static int check(int fd, const CheckOptions& options, string& out, string& perf) {
+
+  sg_device device;
+  device.node = "fake";
+  device.device_class = DEVICE_CLASS_ATA;
+
+  stringstream out_stream, perf_stream;
+  int code = check_open_device(fd, device, options, "", out_stream, perf_stream);
+
+  out = out_stream.str();
+  perf = perf_stream.str();
+
+  return code;
+
+}
+
+int main() {
+
+  char temp[] = "/tmp/test_self_test.XXXXXX";
+  CHECK(mkdtemp(temp));
+
+  const string identity = ", model FAKE DRIVE, serial FAKE0001, firmware 1.0";
+  const string summary = "CRITICAL: prdfail 1, advisory 0, critical 0, warning 0, logs 0, self-test ";
+
+  // An extended test passed 52 hours ago, then a short one 2 hours ago,
+  // the index points at the most recent
+  smart_self_test_log log;
+  memset(&log, 0, sizeof(log));
+  put_test(log, 0, SMART_SELF_TEST_EXTENDED, SMART_SELF_TEST_STATUS_COMPLETED, TEST_HOURS - 52);
+  put_test(log, 1, SMART_SELF_TEST_SHORT | SMART_SELF_TEST_CAPTIVE, SMART_SELF_TEST_STATUS_COMPLETED, TEST_HOURS - 2);
+  log.index = 2;
+  hold_log(ATA_LOG_ADDRESS_SELF_TEST, log);
+
+  int fd = sgio_register(fake_ata, 0);
+
+  CheckOptions options;
+  options.state_dir = temp;
+  options.self_test_log = true;
+  options.warning_named["hours_since_extended_self_test"] = 168;
+
+  string out, perf;
+
+  CHECK(check(fd, options, out, perf) == NAGIOS_CRITICAL);
+  CHECK(out == summary + "passed" + identity);
+  CHECK(perf.find(" self_test_status=0;;;;") != string::npos);
+  CHECK(perf.find(" hours_since_extended_self_test=52;168;;;") != string::npos);
+
+  // A failed test is critical in itself
+  put_test(log, 1, SMART_SELF_TEST_SHORT, SMART_SELF_TEST_STATUS_READ_FAILED, TEST_HOURS - 2);
+  hold_log(ATA_LOG_ADDRESS_SELF_TEST, log);
+  CHECK(check(fd, options, out, perf) == NAGIOS_CRITICAL);
+  CHECK(out == summary + "failed" + identity);
+  CHECK(perf.find(" self_test_status=7;;;;") != string::npos);
+
+  // The extended log is preferred where the drive has one
+  smart_ext_self_test_log ext;
+  memset(&ext, 0, sizeof(ext));
+  ext.descriptors[0].subcommand = SMART_SELF_TEST_SHORT;
+  ext.descriptors[0].status = SMART_SELF_TEST_STATUS_ABORTED << 4;
+  ext.descriptors[0].timestamp = TEST_HOURS - 1;
+  ext.index = 1;
+  hold_log(ATA_LOG_ADDRESS_EXT_SELF_TEST, ext);
+
+  fake_ata_reads.clear();
+  CHECK(check(fd, options, out, perf) == NAGIOS_CRITICAL);
+  CHECK(out == summary + "aborted" + identity);
+  CHECK(perf.find("hours_since_extended_self_test") == string::npos);
+  CHECK(fake_ata_reads.size() == 1 && fake_ata_reads[0].log == ATA_LOG_ADDRESS_EXT_SELF_TEST);
+  fake_ata_logs.erase(ATA_LOG_ADDRESS_EXT_SELF_TEST);
+
+  // A short test isn't started while the last passed within the interval
+  put_test(log, 1, SMART_SELF_TEST_SHORT, SMART_SELF_TEST_STATUS_COMPLETED, TEST_HOURS - 2);
+  hold_log(ATA_LOG_ADDRESS_SELF_TEST, log);
+  options.self_test = SMART_SELF_TEST_SHORT;
+  CHECK(check(fd, options, out, perf) == NAGIOS_CRITICAL);
+  CHECK(out == summary + "passed" + identity);
+  CHECK(fake_ata_self_test == 0);
+
+  // Once it is older than the interval one is started
+  put_test(log, 1, SMART_SELF_TEST_SHORT, SMART_SELF_TEST_STATUS_COMPLETED, TEST_HOURS - 30);
+  hold_log(ATA_LOG_ADDRESS_SELF_TEST, log);
+  CHECK(check(fd, options, out, perf) == NAGIOS_CRITICAL);
+  CHECK(out == summary + "passed, started short" + identity);
+  CHECK(fake_ata_self_test == SMART_SELF_TEST_SHORT);
+
+  // Nothing is started while a test is running, its progress is reported
+  fake_ata_self_test = 0;
+  fake_ata_self_test_status = SMART_SELF_TEST_STATUS_IN_PROGRESS << 4 | 3;
+  CHECK(check(fd, options, out, perf) == NAGIOS_CRITICAL);
+  CHECK(out == summary + "in progress" + identity);
+  CHECK(perf.find(" self_test_remaining=30;;;;") != string::npos);
+  CHECK(fake_ata_self_test == 0);
+
+  // Drives without self-test support say so and aren't asked to run one
+  fake_ata_self_test_status = 0;
+  fake_ata_capability = 0;
+  fake_ata_reads.clear();
+  CHECK(check(fd, options, out, perf) == NAGIOS_CRITICAL);
+  CHECK(out == summary + "unsupported" + identity);
+  CHECK(fake_ata_reads.empty() && fake_ata_self_test == 0);
+
+  string command = "rm -rf " + string(temp);
+  CHECK(system(command.c_str()) == 0);
+
+  return test_failures;
+
+}
@@ -0,0 +1,191 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <scsi/sg.h>
+
+#include "scsi.h"
+#include "sgio.h"
+#include "test.h"
+
+/*
+ * Struct: test_completion
+ * -----------------------
+ * How the fake device completes a command
+ */
+struct test_completion {
+  int error;
+  uint8_t status;
+  uint16_t host_status;
+  uint8_t sense_key;
+  uint8_t asc;
+  uint8_t ascq;
+};
+
+const test_completion TEST_GOOD              = { 0, SCSI_STATUS_GOOD, SG_HOST_OK, 0, 0, 0 };
+const test_completion TEST_UNIT_ATTENTION    = { 0, SCSI_STATUS_CHECK_CONDITION, SG_HOST_OK, SCSI_SENSE_KEY_UNIT_ATTENTION, 0x29, 0x00 };
+const test_completion TEST_BECOMING_READY    = { 0, SCSI_STATUS_CHECK_CONDITION, SG_HOST_OK, SCSI_SENSE_KEY_NOT_READY, 0x04, 0x01 };
+const test_completion TEST_NEEDS_START       = { 0, SCSI_STATUS_CHECK_CONDITION, SG_HOST_OK, SCSI_SENSE_KEY_NOT_READY, 0x04, 0x02 };
+const test_completion TEST_ILLEGAL_REQUEST   = { 0, SCSI_STATUS_CHECK_CONDITION, SG_HOST_OK, SCSI_SENSE_KEY_ILLEGAL_REQUEST, 0x20, 0x00 };
+const test_completion TEST_RECOVERED         = { 0, SCSI_STATUS_CHECK_CONDITION, SG_HOST_OK, SCSI_SENSE_KEY_RECOVERED_ERROR, 0x00, 0x1d };
+
+/* Completions the fake device works through, the last repeats */
+static const test_completion* script;
+static int script_len;
+static int executed;
+
+/* Handle of the fake device */
+static int device;
+
+/*
+ * Function: fake_device
+ * ---------------------
+ * Completes each command as the script says, with fixed format sense
+ */
+static int fake_device(int context, sg_io_hdr_t& hdr) {
+
+  const test_completion& completion = script[executed < script_len ? executed : script_len - 1];
+  executed++;
+
+  hdr.status = completion.status;
+  hdr.host_status = completion.host_status;
+  hdr.driver_status = completion.sense_key ? SG_DRIVER_SENSE : 0;
+  hdr.sb_len_wr = 0;
+  hdr.resid = 0;
+
+  if(completion.sense_key) {
+    memset(hdr.sbp, 0, hdr.mx_sb_len);
+    hdr.sbp[0] = SCSI_SENSE_FIXED_CURRENT;
+    hdr.sbp[2] = completion.sense_key;
+    hdr.sbp[7] = 10;
+    hdr.sbp[12] = completion.asc;
+    hdr.sbp[13] = completion.ascq;
+    hdr.sb_len_wr = 18;
+  }
+
+  return completion.error;
+
+}
+
+/*
+ * Function: run
+ * -------------
+ * Sends a command to the fake device working through a script, returning
+ * the result sgio settled on
+ * completions: Script of completions
+ * len: Number of completions in the script
+ */
+static SgioResult run(const test_completion* completions, int len) {
+
+  script = completions;
+  script_len = len;
+  executed = 0;
+
+  unsigned char cdb[16] = { SBC_ATA_PASS_THROUGH };
+  unsigned char buf[512];
+
+  return sgio(device, cdb, sizeof(cdb), buf, sizeof(buf));
+
+}
+
+/*
+ * Function: transient
+ * -------------------
+ * Returns whether a single completion is considered worth retrying
+ */
+static bool transient(const test_completion& completion) {
+
+  return run(&completion, 1).transient();
+
+}
+
+int main() {
+
+  device = sgio_register(fake_device, 0);
+
+  // Resets and drives spinning up clear by themselves, anything else
+  // about the command won't change on a retry
+  CHECK(transient(TEST_UNIT_ATTENTION));
+  CHECK(transient(TEST_BECOMING_READY));
+  CHECK(!transient(TEST_NEEDS_START));
+  CHECK(!transient(TEST_ILLEGAL_REQUEST));
+  CHECK(!transient(TEST_GOOD));
+
+  // Host statuses the midlayer would itself requeue are retried
+  const uint16_t retried[] = { SG_HOST_BUS_BUSY, SG_HOST_SOFT_ERROR, SG_HOST_IMM_RETRY, SG_HOST_REQUEUE };
+  for(size_t i = 0; i < sizeof(retried) / sizeof(retried[0]); i++) {
+    test_completion completion = { 0, SCSI_STATUS_GOOD, retried[i], 0, 0, 0 };
+    CHECK(transient(completion));
+  }
+
+  test_completion host_error = { 0, SCSI_STATUS_GOOD, SG_HOST_ERROR, 0, 0, 0 };
+  CHECK(!transient(host_error));
+
+  // So are a busy target and interrupted ioctls, but not failed ones
+  test_completion busy = { 0, SCSI_STATUS_BUSY, SG_HOST_OK, 0, 0, 0 };
+  test_completion full = { 0, SCSI_STATUS_TASK_SET_FULL, SG_HOST_OK, 0, 0, 0 };
+  test_completion interrupted = { EINTR, SCSI_STATUS_GOOD, SG_HOST_OK, 0, 0, 0 };
+  test_completion failed = { EIO, SCSI_STATUS_GOOD, SG_HOST_OK, 0, 0, 0 };
+  CHECK(transient(busy));
+  CHECK(transient(full));
+  CHECK(transient(interrupted));
+  CHECK(!transient(failed));
+
+  // Check condition without sense can't be diagnosed, so isn't retried
+  test_completion no_sense = { 0, SCSI_STATUS_CHECK_CONDITION, SG_HOST_OK, 0, 0, 0 };
+  CHECK(!transient(no_sense));
+
+  // Recovered errors carry good data
+  SgioResult result = run(&TEST_RECOVERED, 1);
+  CHECK(result.ok() && executed == 1);
+
+  // A bus reset then a drive spinning up are retried through to success
+  const test_completion reset[] = { TEST_UNIT_ATTENTION, TEST_BECOMING_READY, TEST_GOOD };
+  result = run(reset, 3);
+  CHECK(result.ok());
+  CHECK(executed == 3);
+
+  // Retries are bounded, the last failure is what the caller sees
+  result = run(&TEST_UNIT_ATTENTION, 1);
+  CHECK(!result.ok());
+  CHECK(executed == 1 + SGIO_RETRIES);
+  CHECK(result.getSenseKey() == SCSI_SENSE_KEY_UNIT_ATTENTION && result.getASC() == 0x29);
+
+  // Permanent failures are returned at once
+  result = run(&TEST_ILLEGAL_REQUEST, 1);
+  CHECK(!result.ok() && executed == 1);
+  CHECK(result.getSenseKey() == SCSI_SENSE_KEY_ILLEGAL_REQUEST);
+
+  // Descriptor format sense decodes to the same fields
+  uint8_t sense[8] = { SCSI_SENSE_DESCRIPTOR_CURRENT, SCSI_SENSE_KEY_NOT_READY, 0x04, 0x01 };
+  uint8_t key, asc, ascq;
+  CHECK(sense_decode(sense, sizeof(sense), key, asc, ascq));
+  CHECK(key == SCSI_SENSE_KEY_NOT_READY && asc == 0x04 && ascq == 0x01);
+  CHECK(!sense_decode(sense, 2, key, asc, ascq));
+
+  return test_failures;
+
+}
@@ -0,0 +1,181 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "scsismart.h"
+#include "shm.h"
+#include "test.h"
+
+/*
+ * Function: fill
+ * --------------
+ * Fills a report so that a torn read would mix two fills
+ */
+static void fill(shm_report& report, char c) {
+
+  memset(&report, 0, sizeof(report));
+  report.in_use = 1;
+  report.code = c & 3;
+  memset(report.status, c, sizeof(report.status) - 1);
+  memset(report.perfdata, c, sizeof(report.perfdata) - 1);
+  shm_copy(report.node, sizeof(report.node), "/dev/sg0");
+  shm_copy(report.key, sizeof(report.key), "FAKE_DRIVE_FAKE0001");
+
+}
+
+int main() {
+
+  string name = "/test_shm." + to_string(getpid());
+
+  ShmWriter writer;
+  CHECK(writer.open(name));
+
+  ShmReader reader;
+  CHECK(reader.open(name));
+  CHECK(reader.slots() == static_cast<int>(SHM_SLOTS));
+
+  // Slots are handed out once until released
+  int slot = writer.allocate();
+  CHECK(slot == 0);
+  CHECK(writer.allocate() == 1);
+  writer.release(1);
+  CHECK(writer.allocate() == 1);
+
+  // Nothing is visible until published
+  shm_report report;
+  CHECK(reader.read(slot, report) == 0);
+  CHECK(!reader.find("FAKE_DRIVE_FAKE0001", report));
+  CHECK(!reader.find_node("/dev/sg0", report));
+
+  shm_report published;
+  fill(published, 'a');
+  published.attributes_num = 1;
+  published.attributes[0].id = 5;
+  published.attributes[0].raw = 12;
+  shm_copy(published.identity, sizeof(published.identity), string(1000, 'x'));
+  writer.publish(slot, published);
+
+  CHECK(reader.find("FAKE_DRIVE_FAKE0001", report));
+  CHECK(report.attributes_num == 1 && report.attributes[0].id == 5 && report.attributes[0].raw == 12);
+  CHECK(strlen(report.identity) == SHM_IDENTITY_SIZE - 1);
+  CHECK(!reader.find("", report));
+  CHECK(!reader.find("/dev/sg0", report));
+
+  // The drive is found by its key whichever node it moves to
+  shm_copy(published.node, sizeof(published.node), "/dev/sg5");
+  writer.publish(slot, published);
+  CHECK(reader.find("FAKE_DRIVE_FAKE0001", report));
+  CHECK(!strcmp(report.node, "/dev/sg5"));
+  CHECK(reader.find_node("/dev/sg5", report));
+  CHECK(!reader.find_node("/dev/sg0", report));
+
+  // The C API reads the same reports
+  scsismart_reader c_reader;
+  CHECK(scsismart_reader_open(&c_reader, name.c_str()) == 0);
+  CHECK(scsismart_reader_slots(&c_reader) == static_cast<int>(SHM_SLOTS));
+
+  scsismart_published c_report;
+  memset(&c_report, 0, sizeof(c_report));
+  CHECK(scsismart_reader_find(&c_reader, "FAKE_DRIVE_FAKE0001", &c_report) == -1 && errno == EINVAL);
+
+  c_report.size = sizeof(c_report);
+  CHECK(scsismart_reader_find(&c_reader, "FAKE_DRIVE_FAKE0001", &c_report) == 0);
+  CHECK(c_report.code == published.code && !strcmp(c_report.node, "/dev/sg5"));
+  CHECK(!strcmp(c_report.key, "FAKE_DRIVE_FAKE0001"));
+  CHECK(strlen(c_report.identity) == SHM_IDENTITY_SIZE - 1);
+  CHECK(strlen(c_report.perfdata) == SHM_PERFDATA_SIZE - 1);
+  CHECK(c_report.attributes_num == 1 && c_report.attributes[0].id == 5 && c_report.attributes[0].raw == 12);
+  CHECK(scsismart_reader_find(&c_reader, "OTHER_DRIVE", &c_report) == -1 && errno == ENOENT);
+
+  CHECK(scsismart_reader_read(&c_reader, slot, &c_report) == 1);
+  CHECK(scsismart_reader_read(&c_reader, slot + 2, &c_report) == 0);
+  CHECK(scsismart_reader_read(&c_reader, -1, &c_report) == -1 && errno == EINVAL);
+  CHECK(scsismart_reader_read(&c_reader, SHM_SLOTS, &c_report) == -1 && errno == EINVAL);
+
+  scsismart_reader_close(&c_reader);
+  CHECK(!c_reader.segment);
+  CHECK(scsismart_reader_open(&c_reader, "/test_shm.missing") == -1 && errno == ENOENT);
+
+  // A reader racing the writer only ever sees whole reports
+  pid_t pid = fork();
+  if(!pid) {
+    shm_report a, b;
+    fill(a, 'a');
+    fill(b, 'b');
+    for(int i = 0; i < 200000; i++)
+      writer.publish(slot, i & 1 ? b : a);
+    _exit(0);
+  }
+
+  int torn = 0;
+  for(int i = 0; i < 200000; i++) {
+    if(reader.read(slot, report) < 0)
+      continue;
+    char c = report.status[0];
+    if(report.code != (c & 3) || report.status[SHM_STATUS_SIZE - 2] != c ||
+       report.perfdata[SHM_PERFDATA_SIZE - 2] != c)
+      torn++;
+  }
+  CHECK(torn == 0);
+
+  int status;
+  waitpid(pid, &status, 0);
+  CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+  // A writer dying mid-publish leaves the sequence odd, readers give up
+  // rather than spin forever
+  int fd = shm_open(name.c_str(), O_RDWR, 0);
+  CHECK(fd != -1);
+  shm_segment* segment = static_cast<shm_segment*>(mmap(0, sizeof(shm_segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+  CHECK(segment != MAP_FAILED);
+  close(fd);
+
+  segment->slot[slot].sequence |= 1;
+  errno = 0;
+  CHECK(reader.read(slot, report) == -1 && errno == EAGAIN);
+  CHECK(!reader.find("FAKE_DRIVE_FAKE0001", report) && errno == EAGAIN);
+  CHECK(!reader.find_node("/dev/sg5", report) && errno == EAGAIN);
+
+  CHECK(scsismart_reader_open(&c_reader, name.c_str()) == 0);
+  CHECK(scsismart_reader_read(&c_reader, slot, &c_report) == -1 && errno == EAGAIN);
+  CHECK(scsismart_reader_find(&c_reader, "FAKE_DRIVE_FAKE0001", &c_report) == -1 && errno == EAGAIN);
+  scsismart_reader_close(&c_reader);
+
+  segment->slot[slot].sequence++;
+  CHECK(reader.read(slot, report) == 1);
+  munmap(segment, sizeof(shm_segment));
+
+  // Released slots read as empty
+  writer.release(slot);
+  CHECK(!reader.find("FAKE_DRIVE_FAKE0001", report));
+
+  return test_failures;
+
+}
@@ -0,0 +1,379 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+#include "sweep.h"
+#include "scsi.h"
+#include "sgio.h"
+#include "test.h"
+#include "trace.h"
+#include "fake_ata.h"
+
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* Devices in each sweep, more than are checked at once */
+const int TEST_DEVICES    = 40;
+const int TEST_CONCURRENT = 16;
+
+/* Drives that never answer, more than one wait collects, and their deadline */
+const int TEST_SILENT     = 150;
+const int TEST_DEADLINE   = 50;
+
+/* Descriptors which queue commands, and the threads answering them */
+static set<int> queued;
+static vector<thread> drives;
+static mutex drive_lock;
+static vector<int> silent;
+
+/*
+ * Function: open_handle
+ * ---------------------
+ * Opens a fake drive as a registered handle, "missing" fails
+ */
+static int open_handle(const string& node) {
+
+  if(node == "missing") {
+    errno = ENOENT;
+    return -1;
+  }
+
+  return sgio_register(fake_ata, 0);
+
+}
+
+/* Commands each fake drive has answered with a unit attention */
+static vector<int> attentions;
+
+/*
+ * Function: attention
+ * -------------------
+ * Answers a fake drive's first command with a unit attention, as after a
+ * bus reset, and the rest as the drive would
+ */
+static int attention(int context, sg_io_hdr_t& hdr) {
+
+  if(attentions[context]++)
+    return fake_ata(0, hdr);
+
+  memset(hdr.sbp, 0, hdr.mx_sb_len);
+  hdr.sbp[0] = SCSI_SENSE_FIXED_CURRENT;
+  hdr.sbp[2] = SCSI_SENSE_KEY_UNIT_ATTENTION;
+  hdr.sbp[12] = 0x29;
+  hdr.sb_len_wr = 18;
+  hdr.status = SCSI_STATUS_CHECK_CONDITION;
+  hdr.driver_status = SG_DRIVER_SENSE;
+
+  return 0;
+
+}
+
+/*
+ * Function: open_attention
+ * ------------------------
+ * Opens a fake drive which has just seen a bus reset
+ */
+static int open_attention(const string& node) {
+
+  attentions.push_back(0);
+
+  return sgio_register(attention, attentions.size() - 1);
+
+}
+
+/* The SAT variant cache, and commands sent while it existed */
+static string variants;
+static int variants_seen;
+
+/*
+ * Function: reject_sixteen
+ * ------------------------
+ * Rejects the 16-byte ATA PASS-THROUGH, as a bridge only taking the
+ * 12-byte form would
+ */
+static bool reject_sixteen(const unsigned char* cdb, int len) {
+
+  return cdb[0] == SBC_ATA_PASS_THROUGH;
+
+}
+
+/*
+ * Function: watched
+ * -----------------
+ * Answers as a fake drive, counting commands sent once the SAT variant
+ * cache has been written
+ */
+static int watched(int context, sg_io_hdr_t& hdr) {
+
+  struct stat st;
+  if(stat(variants.c_str(), &st) == 0)
+    variants_seen++;
+
+  return fake_ata(0, hdr);
+
+}
+
+/*
+ * Function: open_watched
+ * ----------------------
+ * Opens a fake drive whose commands watch the SAT variant cache
+ */
+static int open_watched(const string& node) {
+
+  return sgio_register(watched, 0);
+
+}
+
+/*
+ * Function: serve
+ * ---------------
+ * Answers requests written to one end of a socket pair as the sg driver
+ * would, each is read back once it has completed
+ */
+static void serve(int fd) {
+
+  sg_io_hdr_t hdr;
+  while(read(fd, &hdr, sizeof(hdr)) == sizeof(hdr)) {
+    {
+      lock_guard<mutex> guard(drive_lock);
+      fake_ata(0, hdr);
+    }
+    if(write(fd, &hdr, sizeof(hdr)) != sizeof(hdr))
+      break;
+  }
+
+  close(fd);
+
+}
+
+/*
+ * Function: open_queued
+ * ---------------------
+ * Opens a fake drive which queues commands, answered by its own thread
+ */
+static int open_queued(const string& node) {
+
+  int fds[2];
+  if(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds) == -1)
+    return -1;
+
+  queued.insert(fds[0]);
+  drives.push_back(thread(serve, fds[1]));
+
+  return fds[0];
+
+}
+
+/*
+ * Function: open_silent
+ * ---------------------
+ * Opens a fake drive which queues commands and never completes them
+ */
+static int open_silent(const string& node) {
+
+  int fds[2];
+  if(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds) == -1)
+    return -1;
+
+  queued.insert(fds[0]);
+  silent.push_back(fds[1]);
+
+  return fds[0];
+
+}
+
+/*
+ * Function: is_queued
+ * -------------------
+ * Returns whether a descriptor was opened by open_queued
+ */
+static bool is_queued(int fd) {
+
+  return queued.count(fd);
+
+}
+
+int main() {
+
+  char temp[] = "/tmp/test_sweep.XXXXXX";
+  CHECK(mkdtemp(temp));
+
+  CheckOptions options;
+  options.state_dir = temp;
+
+  sg_device device;
+  device.node = "fake";
+
+  // The result of checking one drive directly, and the commands it took
+  stringstream expected_out, expected_perf;
+  device_health expected_health;
+  int commands = fake_ata_commands;
+  int expected = check_open_device(sgio_register(fake_ata, 0), device, options, "", expected_out,
+                                   expected_perf, &expected_health);
+  commands = fake_ata_commands - commands;
+  CHECK(expected == NAGIOS_CRITICAL);
+  CHECK(commands > 0);
+
+  vector<sg_device> devices(TEST_DEVICES, device);
+  devices[3].node = "missing";
+
+  // Each drive gets the same result, with every command issued only once
+  int before = fake_ata_commands;
+  vector<sweep_result> results = sweep_devices(devices, options, TEST_CONCURRENT, open_handle);
+  CHECK(fake_ata_commands - before == (TEST_DEVICES - 1) * commands);
+
+  CHECK(results.size() == devices.size());
+  for(size_t i = 0; i < results.size(); i++) {
+    if(i == 3)
+      continue;
+    CHECK(results[i].code == expected);
+    CHECK(results[i].out == expected_out.str());
+    CHECK(results[i].perf == expected_perf.str());
+    CHECK(results[i].health.key == expected_health.key);
+  }
+
+  CHECK(results[3].code == NAGIOS_UNKNOWN);
+  CHECK(results[3].out == "UNKNOWN: unable to open device missing: " + string(strerror(ENOENT)));
+
+  // Prefixing the labels afterwards matches checking with the prefix
+  stringstream prefixed_out, prefixed_perf;
+  check_open_device(sgio_register(fake_ata, 0), device, options, "sda_", prefixed_out, prefixed_perf, 0);
+  CHECK(prefix_labels(results[0].perf, "sda_") == prefixed_perf.str());
+
+  // Frames fit the pool, which stops growing once it holds a full sweep
+  size_t pooled, heap;
+  sweep_frames(pooled, heap);
+  CHECK(pooled >= (size_t)TEST_CONCURRENT && heap == 0);
+
+  sweep_devices(devices, options, TEST_CONCURRENT, open_handle);
+  size_t repooled;
+  sweep_frames(repooled, heap);
+  CHECK(repooled == pooled && heap == 0);
+
+  // After a bus reset every drive's retry waits out its backoff at once,
+  // rather than each replay sleeping in turn
+  uint64_t start = Trace::monotonic();
+  before = fake_ata_commands;
+  results = sweep_devices(vector<sg_device>(TEST_DEVICES, device), options, TEST_DEVICES, open_attention);
+  uint64_t elapsed = Trace::monotonic() - start;
+  CHECK(elapsed >= SGIO_BACKOFF_MS * 1000 && elapsed < TEST_DEVICES * SGIO_BACKOFF_MS * 1000);
+  CHECK(fake_ata_commands - before == TEST_DEVICES * commands);
+  for(size_t i = 0; i < results.size(); i++) {
+    CHECK(results[i].code == expected);
+    CHECK(results[i].out == expected_out.str());
+  }
+
+  // Queued commands complete out of order across every drive at once
+  devices[3].node = "fake";
+  results = sweep_devices(devices, options, TEST_CONCURRENT, open_queued, is_queued);
+  for(size_t i = 0; i < drives.size(); i++)
+    drives[i].join();
+
+  CHECK(drives.size() == devices.size());
+  for(size_t i = 0; i < results.size(); i++) {
+    CHECK(results[i].code == expected);
+    CHECK(results[i].out == expected_out.str());
+    CHECK(results[i].perf == expected_perf.str());
+  }
+
+  // Drives that never answer are given up on once their commands expire,
+  // however many expire at once
+  vector<sg_device> unanswered(TEST_SILENT, device);
+  results = sweep_devices(unanswered, options, TEST_SILENT, open_silent, is_queued, TEST_DEADLINE);
+  for(size_t i = 0; i < silent.size(); i++)
+    close(silent[i]);
+
+  CHECK(silent.size() == unanswered.size());
+  for(size_t i = 0; i < results.size(); i++) {
+    CHECK(results[i].code == NAGIOS_UNKNOWN);
+    CHECK(results[i].out == "UNKNOWN: command to fake timed out after 50ms");
+  }
+
+  // Lent descriptors are handed back open and as they came, except one
+  // whose command expired as it may yet be answered onto it
+  size_t first = drives.size();
+  vector<int> lent;
+  for(int i = 0; i < 4; i++)
+    lent.push_back(open_queued("fake"));
+  lent.push_back(open_silent("fake"));
+
+  vector<int> given = lent;
+  results = sweep_open_devices(vector<sg_device>(lent.size(), device), lent, options, TEST_CONCURRENT,
+                               is_queued, TEST_DEADLINE);
+  for(size_t i = 0; i < 4; i++) {
+    CHECK(results[i].code == expected);
+    CHECK(lent[i] == given[i]);
+    CHECK(!(fcntl(lent[i], F_GETFL) & O_NONBLOCK));
+    close(lent[i]);
+  }
+  for(size_t i = first; i < drives.size(); i++)
+    drives[i].join();
+
+  CHECK(results[4].code == NAGIOS_UNKNOWN);
+  CHECK(lent[4] == -1 && fcntl(given[4], F_GETFD) == -1);
+  close(silent.back());
+
+  // Every run of a check sees the state directory as the first did, the
+  // variant found for the bridge is only written once the check is done
+  CheckOptions replayed;
+  replayed.state_dir = string(temp) + "/replayed";
+  variants = state_path(replayed.state_dir, STATE_SAT_VARIANTS);
+  variants_seen = 0;
+  fake_ata_reject = reject_sixteen;
+  results = sweep_devices(vector<sg_device>(1, device), replayed, 1, open_watched);
+  fake_ata_reject = 0;
+
+  CHECK(results[0].code == expected);
+  CHECK(variants_seen == 0);
+  StateFile cache(variants);
+  uint64_t variant;
+  CHECK(cache.load() && cache.get("FAKE_BRIDGE_BRIDGE0001", variant) && variant == SAT_VARIANT_12);
+
+  // Each command is traced once as it completes, replaying it isn't
+  string path = string(temp) + "/trace";
+  CHECK(trace.open(path.c_str()));
+  sweep_devices(vector<sg_device>(4, device), options, TEST_CONCURRENT, open_handle);
+  trace.flush();
+
+  struct stat st;
+  CHECK(stat(path.c_str(), &st) == 0);
+  CHECK(st.st_size == static_cast<off_t>(4 * commands * sizeof(trace_record)));
+
+  string command = "rm -rf " + string(temp);
+  CHECK(system(command.c_str()) == 0);
+
+  return test_failures;
+
+}
@@ -0,0 +1,236 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "endian.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <atomic>
+
+using namespace std;
+
+Trace trace;
+
+/*
+ * Function: trace_signal_set
+ * --------------------------
+ * Fills a signal set with the signals which flush the trace
+ * signals: Reference to the set
+ */
+static void trace_signal_set(sigset_t& signals) {
+
+  sigemptyset(&signals);
+  for(size_t i = 0; i < sizeof(TRACE_SIGNALS) / sizeof(TRACE_SIGNALS[0]); i++)
+    sigaddset(&signals, TRACE_SIGNALS[i]);
+
+}
+
+/*
+ * Function: trace_signal
+ * ----------------------
+ * Flushes the trace and terminates the process as the signal would have,
+ * flush only calls write(2) and sigprocmask(2) so is safe in a handler.
+ * The flushing signals are blocked while any flush runs, this one
+ * included, so the handler never interrupts one.
+ * sig: Signal received
+ */
+static void trace_signal(int sig) {
+
+  trace.flush();
+
+  signal(sig, SIG_DFL);
+  raise(sig);
+
+}
+
+/**
+ * Function: Trace::Trace()
+ * ------------------------
+ * Class constructor, tracing is disabled until open is called
+ */
+Trace::Trace()
+: fd(-1),
+  buffer(0),
+  capacity(0),
+  used(0)
+{}
+
+/**
+ * Function: Trace::~Trace()
+ * -------------------------
+ * Class destructor, flushes any outstanding records
+ */
+Trace::~Trace() {
+
+  flush();
+
+  if(fd != -1)
+    close(fd);
+
+  delete [] buffer;
+
+}
+
+/**
+ * Function: Trace::open(const char*, size_t)
+ * ------------------------------------------
+ * Opens the trace file for appending and allocates the record buffer
+ * path: Path to the trace file
+ * records: Number of records to buffer before forcing a write
+ */
+bool Trace::open(const char* path, size_t records) {
+
+  fd = ::open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if(fd == -1)
+    return false;
+
+  // Allocate up front so recording never touches the heap
+  capacity = max(records, static_cast<size_t>(1));
+  buffer = new trace_record[capacity];
+  used = 0;
+
+  // A killed check never runs static destructors, so flush from the signal
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = trace_signal;
+  trace_signal_set(action.sa_mask);
+  for(size_t i = 0; i < sizeof(TRACE_SIGNALS) / sizeof(TRACE_SIGNALS[0]); i++)
+    sigaction(TRACE_SIGNALS[i], &action, 0);
+
+  return true;
+
+}
+
+/**
+ * Function: Trace::record(const sg_io_hdr_t&, int, uint64_t, uint32_t)
+ * --------------------------------------------------------------------
+ * Appends a completed command to the record buffer
+ * hdr: Reference to the completed SG_IO header
+ * error: errno of a failed ioctl, otherwise zero
+ * timestamp: Wall clock time the command was issued in microseconds
+ * duration: Command duration in microseconds
+ */
+void Trace::record(const sg_io_hdr_t& hdr, int error, uint64_t timestamp, uint32_t duration) {
+
+  if(fd == -1)
+    return;
+
+  // Only ever hit on very long sweeps, the common case is a single write at exit
+  if(size_t(used) == capacity)
+    flush();
+
+  // The count is only bumped once the record is complete, a signal may flush at any point
+  trace_record& r = buffer[used];
+  memset(&r, 0, sizeof(trace_record));
+
+  uint8_t cdb_len = min(hdr.cmd_len, TRACE_CDB_MAX);
+  uint8_t sense_len = error ? 0 : min(hdr.sb_len_wr, TRACE_SENSE_MAX);
+
+  r.magic         = StorageEndian::swap(TRACE_MAGIC);
+  r.version       = StorageEndian::swap(TRACE_VERSION);
+  r.length        = StorageEndian::swap(static_cast<uint16_t>(sizeof(trace_record)));
+  r.timestamp     = StorageEndian::swap(timestamp);
+  r.duration      = StorageEndian::swap(duration);
+  r.dxfer_len     = StorageEndian::swap(static_cast<uint32_t>(hdr.dxfer_len));
+  r.resid         = StorageEndian::swap(static_cast<int32_t>(hdr.resid));
+  r.error         = StorageEndian::swap(static_cast<int32_t>(error));
+  r.host_status   = StorageEndian::swap(static_cast<uint16_t>(hdr.host_status));
+  r.driver_status = StorageEndian::swap(static_cast<uint16_t>(hdr.driver_status));
+  r.status        = hdr.status;
+  r.cdb_len       = cdb_len;
+  r.sense_len     = sense_len;
+
+  memcpy(r.cdb, hdr.cmdp, cdb_len);
+  memcpy(r.sense, hdr.sbp, sense_len);
+
+  // Keeps the compiler from sinking the stores above past the count
+  atomic_signal_fence(memory_order_release);
+  used = used + 1;
+
+}
+
+/**
+ * Function: Trace::flush()
+ * ------------------------
+ * Writes all buffered records to the trace file
+ */
+void Trace::flush() {
+
+  if(fd == -1 || !used)
+    return;
+
+  // A signal arriving mid-write would flush the same records again, or
+  // the rest of a torn one, so it waits until the buffer is empty
+  sigset_t signals, saved;
+  trace_signal_set(signals);
+  sigprocmask(SIG_BLOCK, &signals, &saved);
+
+  // O_APPEND keeps records from concurrent checks whole
+  const char* p = reinterpret_cast<const char*>(buffer);
+  size_t remaining = size_t(used) * sizeof(trace_record);
+
+  while(remaining) {
+    ssize_t n = write(fd, p, remaining);
+    if(n <= 0)
+      break;
+    p += n;
+    remaining -= n;
+  }
+
+  used = 0;
+
+  sigprocmask(SIG_SETMASK, &saved, 0);
+
+}
+
+/**
+ * Function: Trace::now()
+ * ----------------------
+ * Returns the wall clock time in microseconds
+ */
+uint64_t Trace::now() {
+
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+
+}
+
+/**
+ * Function: Trace::monotonic()
+ * ----------------------------
+ * Returns the monotonic clock in microseconds for measuring durations
+ */
+uint64_t Trace::monotonic() {
+
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+
+}
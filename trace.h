@@ -0,0 +1,151 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _trace_H_
+#define _trace_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <signal.h>
+#include <scsi/sg.h>
+
+/* Trace record identification */
+const uint32_t TRACE_MAGIC   = 0x54435353; // "SSCT" on disk
+const uint16_t TRACE_VERSION = 1;
+
+/* Record limits */
+const uint8_t TRACE_CDB_MAX   = 16;
+const uint8_t TRACE_SENSE_MAX = 32;
+
+/* Signals which flush the trace before terminating the process */
+const int TRACE_SIGNALS[] = { SIGTERM, SIGINT, SIGALRM };
+
+/* Number of records buffered in memory before a write is forced */
+const size_t TRACE_RECORDS_DEFAULT = 256;
+
+/*
+ * Struct: trace_record
+ * --------------------
+ * Fixed size binary record describing a single SCSI command and its
+ * completion.  All multi-byte fields are stored little-endian so traces
+ * can be decoded on a different host to the one that captured them.
+ */
+typedef struct __attribute__((packed)) {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t length;
+  uint64_t timestamp;
+  uint32_t duration;
+  uint32_t dxfer_len;
+  int32_t  resid;
+  int32_t  error;
+  uint16_t host_status;
+  uint16_t driver_status;
+  uint8_t  status;
+  uint8_t  cdb_len;
+  uint8_t  sense_len;
+  uint8_t  reserved;
+  uint8_t  cdb[TRACE_CDB_MAX];
+  uint8_t  sense[TRACE_SENSE_MAX];
+} trace_record;
+
+/*
+ * Class: Trace
+ * ------------
+ * Captures SCSI commands into a preallocated buffer which is appended to
+ * the trace file in a single write when flushed or destroyed, or when the
+ * process is killed by SIGTERM, SIGINT or SIGALRM e.g. on a plugin
+ * timeout, which is when the trace matters most.  A closed
+ * trace silently discards records so callers need not check if tracing
+ * is enabled.
+ */
+class Trace {
+
+public:
+  /**
+   * Function: Trace::Trace()
+   * ------------------------
+   * Class constructor, tracing is disabled until open is called
+   */
+  Trace();
+
+  /**
+   * Function: Trace::~Trace()
+   * -------------------------
+   * Class destructor, flushes any outstanding records
+   */
+  ~Trace();
+
+  /**
+   * Function: Trace::open(const char*, size_t)
+   * ------------------------------------------
+   * Opens the trace file for appending and allocates the record buffer
+   * path: Path to the trace file
+   * records: Number of records to buffer before forcing a write
+   */
+  bool open(const char* path, size_t records = TRACE_RECORDS_DEFAULT);
+
+  /**
+   * Function: Trace::record(const sg_io_hdr_t&, int, uint64_t, uint32_t)
+   * --------------------------------------------------------------------
+   * Appends a completed command to the record buffer
+   * hdr: Reference to the completed SG_IO header
+   * error: errno of a failed ioctl, otherwise zero
+   * timestamp: Wall clock time the command was issued in microseconds
+   * duration: Command duration in microseconds
+   */
+  void record(const sg_io_hdr_t& hdr, int error, uint64_t timestamp, uint32_t duration);
+
+  /**
+   * Function: Trace::flush()
+   * ------------------------
+   * Writes all buffered records to the trace file
+   */
+  void flush();
+
+  /**
+   * Function: Trace::now()
+   * ----------------------
+   * Returns the wall clock time in microseconds
+   */
+  static uint64_t now();
+
+  /**
+   * Function: Trace::monotonic()
+   * ----------------------------
+   * Returns the monotonic clock in microseconds for measuring durations
+   */
+  static uint64_t monotonic();
+
+private:
+  int fd;
+  trace_record* buffer;
+  size_t capacity;
+  // Read by the signal flush, only bumped once a record is complete
+  volatile sig_atomic_t used;
+
+};
+
+/* Process wide command trace */
+extern Trace trace;
+
+#endif//_trace_H_
@@ -0,0 +1,170 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+
+#include "uevent.h"
+
+/*
+ * Function: uevent_parse
+ * ----------------------
+ * Parses a kernel uevent, an ACTION@DEVPATH header followed by NUL
+ * separated KEY=VALUE pairs.  Returns false if the buffer isn't a kernel
+ * uevent e.g. one rebroadcast by udev.
+ * buffer: Message as received from the socket
+ * length: Length of the message
+ * event: Reference to receive the parsed fields
+ */
+bool uevent_parse(const char* buffer, size_t length, uevent& event) {
+
+  event = uevent();
+
+  const char* end = buffer + length;
+  const char* field = buffer;
+
+  size_t header = strnlen(field, length);
+  if(!memchr(field, '@', header))
+    return false;
+
+  for(field += header + 1; field < end; ) {
+
+    size_t size = strnlen(field, end - field);
+    string pair(field, size);
+    field += size + 1;
+
+    string::size_type equals = pair.find('=');
+    if(equals == string::npos)
+      continue;
+
+    string key = pair.substr(0, equals);
+    string value = pair.substr(equals + 1);
+
+    if(key == "ACTION")
+      event.action = value;
+    else if(key == "DEVPATH")
+      event.devpath = value;
+    else if(key == "SUBSYSTEM")
+      event.subsystem = value;
+    else if(key == "DEVNAME")
+      event.devname = value;
+
+  }
+
+  // Older kernels omit DEVNAME for class devices, the path ends with it
+  if(event.devname.empty() && !event.devpath.empty())
+    event.devname = event.devpath.substr(event.devpath.rfind('/') + 1);
+
+  // udev publishes device nodes in /dev, the kernel relative to it
+  if(!event.devname.compare(0, 5, "/dev/"))
+    event.devname.erase(0, 5);
+
+  return !event.action.empty() && !event.subsystem.empty();
+
+}
+
+NetlinkUeventSource::~NetlinkUeventSource() {
+
+  if(sock != -1)
+    close(sock);
+
+}
+
+/*
+ * Method: open
+ * ------------
+ * Subscribes to kernel uevents, returning false with errno set on error
+ */
+bool NetlinkUeventSource::open() {
+
+  sock = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+  if(sock == -1)
+    return false;
+
+  // Best effort, the kernel caps this at rmem_max without privilege
+  int size = UEVENT_RECEIVE_BUFFER;
+  if(setsockopt(sock, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size)) == -1)
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+  // Group 1 is the kernel's broadcast, udev rebroadcasts on group 2
+  struct sockaddr_nl address;
+  memset(&address, 0, sizeof(address));
+  address.nl_family = AF_NETLINK;
+  address.nl_groups = 1;
+
+  if(bind(sock, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) == -1) {
+    int error = errno;
+    close(sock);
+    sock = -1;
+    errno = error;
+    return false;
+  }
+
+  return true;
+
+}
+
+/*
+ * Method: receive
+ * ---------------
+ * Returns UEVENT_RECEIVED with the next pending event, UEVENT_NONE when
+ * there are no more without blocking, or UEVENT_OVERFLOW when events
+ * have been lost and the caller must resynchronize
+ * event: Reference to receive the event
+ */
+int NetlinkUeventSource::receive(uevent& event) {
+
+  char buffer[UEVENT_BUFFER_SIZE];
+
+  while(true) {
+
+    struct sockaddr_nl sender;
+    struct iovec iov = { buffer, sizeof(buffer) };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = &sender;
+    msg.msg_namelen = sizeof(sender);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    ssize_t length = recvmsg(sock, &msg, 0);
+    if(length == -1) {
+      if(errno == EINTR)
+        continue;
+      return errno == ENOBUFS ? UEVENT_OVERFLOW : UEVENT_NONE;
+    }
+
+    // Only the kernel may tell us about devices, anything else is spoofed
+    if(sender.nl_pid != 0 || (msg.msg_flags & MSG_TRUNC))
+      continue;
+
+    if(uevent_parse(buffer, length, event))
+      return UEVENT_RECEIVED;
+
+  }
+
+}
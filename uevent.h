@@ -0,0 +1,132 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef _uevent_H_
+#define _uevent_H_
+
+#include <stddef.h>
+#include <string>
+
+using namespace std;
+
+/* Subsystem and actions the daemon follows */
+const char* const UEVENT_SUBSYSTEM_SG    = "scsi_generic";
+const char* const UEVENT_ACTION_ADD      = "add";
+const char* const UEVENT_ACTION_REMOVE   = "remove";
+
+/* Kernel uevents are limited to a page of environment */
+const size_t UEVENT_BUFFER_SIZE          = 8192;
+
+/* Receive buffer requested so a burst of hotplug events isn't dropped */
+const int UEVENT_RECEIVE_BUFFER          = 1024 * 1024;
+
+/* Outcomes of UeventSource::receive */
+const int UEVENT_NONE                    = 0;
+const int UEVENT_RECEIVED                = 1;
+const int UEVENT_OVERFLOW                = 2;
+
+/*
+ * Struct: uevent
+ * --------------
+ * The fields of a kernel uevent the daemon acts upon
+ */
+struct uevent {
+  string action;
+  string devpath;
+  string subsystem;
+  string devname;
+};
+
+/*
+ * Function: uevent_parse
+ * ----------------------
+ * Parses a kernel uevent, an ACTION@DEVPATH header followed by NUL
+ * separated KEY=VALUE pairs.  Returns false if the buffer isn't a kernel
+ * uevent e.g. one rebroadcast by udev.
+ * buffer: Message as received from the socket
+ * length: Length of the message
+ * event: Reference to receive the parsed fields
+ */
+bool uevent_parse(const char* buffer, size_t length, uevent& event);
+
+/*
+ * Class: UeventSource
+ * -------------------
+ * Somewhere uevents come from, a descriptor which polls readable when
+ * receive has something to return
+ */
+class UeventSource {
+
+public:
+
+  virtual ~UeventSource() {}
+
+  /*
+   * Method: fd
+   * ----------
+   * Returns the descriptor to poll for events
+   */
+  virtual int fd() const = 0;
+
+  /*
+   * Method: receive
+   * ---------------
+   * Returns UEVENT_RECEIVED with the next pending event, UEVENT_NONE when
+   * there are no more without blocking, or UEVENT_OVERFLOW when events
+   * have been lost and the caller must resynchronize
+   * event: Reference to receive the event
+   */
+  virtual int receive(uevent& event) = 0;
+
+};
+
+/*
+ * Class: NetlinkUeventSource
+ * --------------------------
+ * Receives uevents broadcast by the kernel over netlink
+ */
+class NetlinkUeventSource : public UeventSource {
+
+private:
+
+  int sock;
+
+public:
+
+  NetlinkUeventSource() : sock(-1) {}
+  ~NetlinkUeventSource();
+
+  /*
+   * Method: open
+   * ------------
+   * Subscribes to kernel uevents, returning false with errno set on error
+   */
+  bool open();
+
+  int fd() const { return sock; }
+  int receive(uevent& event);
+
+};
+
+#endif//_uevent_H_
@@ -0,0 +1,128 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "wheel.h"
+
+#include <algorithm>
+
+/*
+ * Method: add
+ * -----------
+ * Adds a timer, those already due fire on the next expiry
+ * due: When the timer fires
+ * name: Returned by expire when it does
+ */
+TimerWheel::Timer TimerWheel::add(time_t due, const string& name) {
+
+  // The slot for the current second has been visited already
+  time_t slot = max(due, current + 1);
+
+  Slot& timers = slots[slot % slots.size()];
+  count++;
+
+  return timers.insert(timers.end(), make_pair(due, name));
+
+}
+
+/*
+ * Method: cancel
+ * --------------
+ * Removes a timer which has yet to fire
+ * timer: Returned by add
+ */
+void TimerWheel::cancel(Timer timer) {
+
+  time_t slot = max(timer->first, current + 1);
+  slots[slot % slots.size()].erase(timer);
+  count--;
+
+}
+
+/*
+ * Method: expire
+ * --------------
+ * Advances the clock, appending the names of timers which have fired, in
+ * order of when they were due
+ * now: Current time
+ * expired: Vector to receive the names
+ */
+void TimerWheel::expire(time_t now, vector<string>& expired) {
+
+  if(now <= current)
+    return;
+
+  // After a long sleep each slot need only be visited once
+  time_t first = current + 1;
+  if(now - current > static_cast<time_t>(slots.size()))
+    first = now - slots.size() + 1;
+
+  vector<pair<time_t, string> > fired;
+  for(time_t t = first; t <= now && count; t++) {
+
+    Slot& timers = slots[t % slots.size()];
+    for(Timer i = timers.begin(); i != timers.end(); ) {
+      if(i->first <= now) {
+        fired.push_back(*i);
+        i = timers.erase(i);
+        count--;
+      } else {
+        i++;
+      }
+    }
+
+  }
+
+  current = now;
+
+  stable_sort(fired.begin(), fired.end(), [](const pair<time_t, string>& a, const pair<time_t, string>& b) {
+    return a.first < b.first;
+  });
+
+  for(vector<pair<time_t, string> >::iterator i = fired.begin(); i != fired.end(); i++)
+    expired.push_back(i->second);
+
+}
+
+/*
+ * Method: timeout
+ * ---------------
+ * Returns milliseconds until the first occupied slot comes round, or -1
+ * if the wheel is empty.  Timers a revolution or more away may wake the
+ * caller early, but never late.
+ * now: Current time
+ */
+int TimerWheel::timeout(time_t now) const {
+
+  if(!count)
+    return -1;
+
+  for(size_t i = 1; i <= slots.size(); i++) {
+    time_t t = current + i;
+    if(!slots[t % slots.size()].empty())
+      return t <= now ? 0 : (t - now) * 1000;
+  }
+
+  return -1;
+
+}
@@ -0,0 +1,113 @@
+/*
+ * SMART Nagios/Icinga Disk Check
+ * ------------------------------
+ *
+ * License
+ * -------
+ * (C) 2015-2017 Simon Murray <spjmurray@yahoo.co.uk>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef _wheel_H_
+#define _wheel_H_
+
+#include <stddef.h>
+#include <time.h>
+
+#include <list>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+/* Slots in the wheel, each one second wide, so a revolution takes an hour */
+const size_t WHEEL_SLOTS = 4096;
+
+/*
+ * Class: TimerWheel
+ * -----------------
+ * Hashed timing wheel of named timers.  Adding and cancelling a timer is
+ * O(1), expiry visits only the slots the clock has passed, and timers due
+ * beyond a revolution wait in their slot until their time comes round.
+ */
+class TimerWheel {
+
+public:
+
+  typedef list<pair<time_t, string> > Slot;
+  typedef Slot::iterator Timer;
+
+private:
+
+  vector<Slot> slots;
+  time_t current;
+  size_t count;
+
+public:
+
+  /*
+   * Method: TimerWheel
+   * ------------------
+   * Creates an empty wheel whose clock is yet to visit now
+   * now: Current time
+   */
+  TimerWheel(time_t now) : slots(WHEEL_SLOTS), current(now - 1), count(0) {}
+
+  /*
+   * Method: add
+   * -----------
+   * Adds a timer, those already due fire on the next expiry
+   * due: When the timer fires
+   * name: Returned by expire when it does
+   */
+  Timer add(time_t due, const string& name);
+
+  /*
+   * Method: cancel
+   * --------------
+   * Removes a timer which has yet to fire
+   * timer: Returned by add
+   */
+  void cancel(Timer timer);
+
+  /*
+   * Method: expire
+   * --------------
+   * Advances the clock, appending the names of timers which have fired, in
+   * order of when they were due
+   * now: Current time
+   * expired: Vector to receive the names
+   */
+  void expire(time_t now, vector<string>& expired);
+
+  /*
+   * Method: timeout
+   * ---------------
+   * Returns milliseconds until the first occupied slot comes round, or -1
+   * if the wheel is empty.  Timers a revolution or more away may wake the
+   * caller early, but never late.
+   * now: Current time
+   */
+  int timeout(time_t now) const;
+
+  size_t size() const { return count; }
+  bool empty() const { return !count; }
+
+};
+
+#endif//_wheel_H_